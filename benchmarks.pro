@@ -0,0 +1,18 @@
+# Benchmarks which need the whole program (the real schema, NoteTable,
+# WriteBatch, ...).  They are built from the program's sources, but only
+# when asked for, & aren't part of the test run in testsrc:
+#     qmake -o Makefile.benchmarks benchmarks.pro
+#     make -f Makefile.benchmarks
+#     qmake-build-release/benchmarks
+include(nixnote2.pro)
+
+QT += testlib
+TARGET = benchmarks
+
+SOURCES -= src/main.cpp
+SOURCES += testsrc/benchmarks.cpp
+HEADERS += testsrc/benchmarks.h
+
+# Nothing to strip or install
+QMAKE_POST_LINK =
+INSTALLS =
@@ -107,6 +107,7 @@ SOURCES += \
     src/filters/filterengine.cpp \
     src/filters/notesortfilterproxymodel.cpp \
     src/filters/remotequery.cpp \
+    src/filters/searchquery.cpp \
     src/gui/browserWidgets/authoreditor.cpp \
     src/gui/browserWidgets/colormenu.cpp \
     src/gui/browserWidgets/dateeditor.cpp \
@@ -187,23 +188,37 @@ SOURCES += \
     src/settings/colorsettings.cpp \
     src/settings/filemanager.cpp \
     src/settings/startupconfig.cpp \
+    src/sql/blobstore.cpp \
+    src/sql/changelog.cpp \
+    src/sql/changeset.cpp \
     src/sql/configstore.cpp \
+    src/sql/connectionpool.cpp \
+    src/sql/contentcompressor.cpp \
     src/sql/databaseconnection.cpp \
     src/sql/databaseupgrade.cpp \
     src/sql/datastore.cpp \
     src/sql/favoritesrecord.cpp \
     src/sql/favoritestable.cpp \
     src/sql/filewatchertable.cpp \
+    src/sql/fulltextindex.cpp \
+    src/sql/lidallocator.cpp \
+    src/sql/lidmap.cpp \
     src/sql/linkednotebooktable.cpp \
+    src/sql/materializedsearch.cpp \
     src/sql/notebooktable.cpp \
+    src/sql/noteloader.cpp \
     src/sql/notemetadata.cpp \
     src/sql/notetable.cpp \
     src/sql/nsqlquery.cpp \
     src/sql/resourcetable.cpp \
+    src/sql/rowstore.cpp \
     src/sql/searchtable.cpp \
     src/sql/sharednotebooktable.cpp \
+    src/sql/statementcache.cpp \
     src/sql/tagtable.cpp \
+    src/sql/trigramindex.cpp \
     src/sql/usertable.cpp \
+    src/sql/writebatch.cpp \
     src/html/attachmenticonbuilder.cpp \
     src/html/enmlformatter.cpp \
     src/html/NoteFormatterBase.cpp \
@@ -212,11 +227,15 @@ SOURCES += \
     src/html/thumbnailer.cpp \
     src/threads/browserrunner.cpp \
     src/threads/counterrunner.cpp \
+    src/threads/databasemaintenance.cpp \
+    src/threads/databasewriter.cpp \
     src/threads/indexrunner.cpp \
+    src/threads/searchrunner.cpp \
     src/threads/syncrunner.cpp \
     src/utilities/crossmemorymapper.cpp \
     src/utilities/debugtool.cpp \
     src/utilities/encrypt.cpp \
+    src/utilities/lidbitmap.cpp \
     src/utilities/mimereference.cpp \
     src/utilities/noteindexer.cpp \
     src/utilities/nuuid.cpp \
@@ -302,6 +321,7 @@ HEADERS  += \
     src/filters/filterengine.h \
     src/filters/notesortfilterproxymodel.h \
     src/filters/remotequery.h \
+    src/filters/searchquery.h \
     src/gui/browserWidgets/authoreditor.h \
     src/gui/browserWidgets/colormenu.h \
     src/gui/browserWidgets/dateeditor.h \
@@ -390,23 +410,37 @@ HEADERS  += \
     src/settings/colorsettings.h \
     src/settings/filemanager.h \
     src/settings/startupconfig.h \
+    src/sql/blobstore.h \
+    src/sql/changelog.h \
+    src/sql/changeset.h \
     src/sql/configstore.h \
+    src/sql/connectionpool.h \
+    src/sql/contentcompressor.h \
     src/sql/databaseconnection.h \
     src/sql/databaseupgrade.h \
     src/sql/datastore.h \
     src/sql/favoritesrecord.h \
     src/sql/favoritestable.h \
     src/sql/filewatchertable.h \
+    src/sql/fulltextindex.h \
+    src/sql/lidallocator.h \
+    src/sql/lidmap.h \
     src/sql/linkednotebooktable.h \
+    src/sql/materializedsearch.h \
     src/sql/notebooktable.h \
+    src/sql/noteloader.h \
     src/sql/notemetadata.h \
     src/sql/notetable.h \
     src/sql/nsqlquery.h \
     src/sql/resourcetable.h \
+    src/sql/rowstore.h \
     src/sql/searchtable.h \
     src/sql/sharednotebooktable.h \
+    src/sql/statementcache.h \
     src/sql/tagtable.h \
+    src/sql/trigramindex.h \
     src/sql/usertable.h \
+    src/sql/writebatch.h \
     src/html/attachmenticonbuilder.h \
     src/html/enmlformatter.h \
     src/html/NoteFormatterBase.h \
@@ -415,11 +449,15 @@ HEADERS  += \
     src/html/thumbnailer.h \
     src/threads/browserrunner.h \
     src/threads/counterrunner.h \
+    src/threads/databasemaintenance.h \
+    src/threads/databasewriter.h \
     src/threads/indexrunner.h \
+    src/threads/searchrunner.h \
     src/threads/syncrunner.h \
     src/utilities/crossmemorymapper.h \
     src/utilities/debugtool.h \
     src/utilities/encrypt.h \
+    src/utilities/lidbitmap.h \
     src/utilities/mimereference.h \
     src/utilities/noteindexer.h \
     src/utilities/nuuid.h \
@@ -107,6 +107,8 @@ qint32 AddNote::createResource(Resource &r, int sequence, QByteArray data,  QStr
     qint32 lid = noteLid;
     ConfigStore cs(global.db);
     qint32 rlid = cs.incrementLidCounter();
+    if (rlid < 0)
+        return -1;
 
     QByteArray hash = QCryptographicHash::hash(data, QCryptographicHash::Md5);
 
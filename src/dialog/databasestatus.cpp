@@ -23,10 +23,25 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include <QPushButton>
 #include "src/sql/notetable.h"
 #include "src/sql/resourcetable.h"
+#include "src/sql/statementcache.h"
+#include "src/threads/databasemaintenance.h"
+#include "src/threads/searchrunner.h"
 #include "src/global.h"
 
 extern Global global;
 
+
+// Format a size in bytes for display
+static QString formatSize(qint64 bytes) {
+    return QString::number(double(bytes) / (1024*1024), 'f', 1) + " MB";
+}
+
+
+// Format a before & after pair for display
+static QString formatChange(QString before, QString after) {
+    return before + " -> " + after;
+}
+
 DatabaseStatus::DatabaseStatus(QWidget *parent) :
     QDialog(parent)
 {
@@ -54,6 +69,45 @@ DatabaseStatus::DatabaseStatus(QWidget *parent) :
     textGrid->addWidget(new QLabel(QString::number(unindexedResources)),4,2);
     textGrid->addWidget(new QLabel(tr("Thumbnails needed:")), 5,1);
     textGrid->addWidget(new QLabel(QString::number(thumbnailsNeeded)),5,2);
+    textGrid->addWidget(new QLabel(tr("Statement cache hits:")), 6,1);
+    textGrid->addWidget(new QLabel(QString::number(global.db->statementCache->hits())),6,2);
+    textGrid->addWidget(new QLabel(tr("Statement cache misses:")), 7,1);
+    textGrid->addWidget(new QLabel(QString::number(global.db->statementCache->misses())),7,2);
+
+    // Figures from the last idle time maintenance run
+    textGrid->addWidget(new QLabel(tr("Last maintenance:")), 8,1);
+    MaintenanceReport report;
+    if (global.dbMaintenance != nullptr)
+        report = global.dbMaintenance->getReport();
+    QString lastRun = tr("Not run yet");
+    if (report.finished.isValid())
+        lastRun = report.finished.toString(Qt::SystemLocaleShortDate);
+    if (global.dbMaintenance != nullptr && global.dbMaintenance->isRunning())
+        lastRun = lastRun + " " + tr("(running now)");
+    textGrid->addWidget(new QLabel(lastRun), 8,2);
+    if (report.finished.isValid()) {
+        textGrid->addWidget(new QLabel(tr("Database size:")), 9,1);
+        textGrid->addWidget(new QLabel(formatChange(formatSize(report.sizeBefore), formatSize(report.sizeAfter))), 9,2);
+        textGrid->addWidget(new QLabel(tr("Free space:")), 10,1);
+        textGrid->addWidget(new QLabel(formatChange(formatSize(report.freeBefore), formatSize(report.freeAfter))), 10,2);
+        textGrid->addWidget(new QLabel(tr("Search index segments:")), 11,1);
+        textGrid->addWidget(new QLabel(formatChange(QString::number(report.segmentsBefore), QString::number(report.segmentsAfter))), 11,2);
+        textGrid->addWidget(new QLabel(tr("Analyze time:")), 12,1);
+        textGrid->addWidget(new QLabel(QString::number(report.analyzeTime) + " ms"), 12,2);
+        textGrid->addWidget(new QLabel(tr("Search index merge time:")), 13,1);
+        textGrid->addWidget(new QLabel(QString::number(report.ftsTime) + " ms"), 13,2);
+        textGrid->addWidget(new QLabel(tr("Vacuum time:")), 14,1);
+        textGrid->addWidget(new QLabel(QString::number(report.vacuumTime) + " ms"), 14,2);
+    }
+
+    // Time from a search while typing to its result being shown
+    QString latency;
+    if (global.searchRunner != nullptr)
+        latency = global.searchRunner->latencyReport();
+    if (latency == "")
+        latency = tr("No searches yet");
+    textGrid->addWidget(new QLabel(tr("Search latency:")), 15,1);
+    textGrid->addWidget(new QLabel(latency), 15,2);
 
 
     QHBoxLayout *buttonLayout = new QHBoxLayout();
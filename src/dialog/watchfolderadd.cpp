@@ -123,6 +123,8 @@ void WatchFolderAdd::onClicked() {
     if (lid <= 0) {
         ConfigStore cs(global.db);
         lid = cs.incrementLidCounter();
+        if (lid < 0)
+            return;
     } else {
         ft.expunge(lid);
     }
@@ -19,12 +19,17 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 
 #include "filtercriteria.h"
 
+#include <QCryptographicHash>
+#include <algorithm>
+
 FilterCriteria::FilterCriteria(QObject *parent) :
     QObject(parent)
 {
     valueSet = false;
     notebook = nullptr;
     notebookIsSet = false;
+    notebookLid = -1;
+    notebookIsStack = false;
     tags.clear();
     tagsIsSet = false;
     savedSearch = nullptr;
@@ -32,6 +37,7 @@ FilterCriteria::FilterCriteria(QObject *parent) :
     searchString = "";
     searchStringIsSet = false;
     attribute = nullptr;
+    attributeId = -1;
     attributeIsSet = false;
     deletedOnly = false;
     deletedOnlyIsSet = false;
@@ -64,10 +70,25 @@ QTreeWidgetItem* FilterCriteria::getNotebook() {
 
 void FilterCriteria::setNotebook(QTreeWidgetItem &item) {
     notebook = &item;
+    notebookIsStack = item.data(0, Qt::UserRole).toString() == "STACK";
+    notebookLid = notebookIsStack ? -1 : item.data(0, Qt::UserRole).toInt();
+    notebookName = item.text(0);
     notebookIsSet = true;
     valueSet = true;
 }
 
+qint32 FilterCriteria::getNotebookLid() {
+    return notebookLid;
+}
+
+QString FilterCriteria::getNotebookName() {
+    return notebookName;
+}
+
+bool FilterCriteria::isNotebookStack() {
+    return notebookIsStack;
+}
+
 void FilterCriteria::unsetNotebook() {
     notebookIsSet = false;
 }
@@ -86,10 +107,16 @@ QList<QTreeWidgetItem*> FilterCriteria::getTags() {
 
 void FilterCriteria::setTags(QList<QTreeWidgetItem*> &items) {
     tags.append(items);
+    for (int i=0; i<items.size(); i++)
+        tagLids.append(items[i]->data(0, Qt::UserRole).toInt());
     tagsIsSet = true;
     valueSet = true;
 }
 
+QList<qint32> FilterCriteria::getTagLids() {
+    return tagLids;
+}
+
 bool FilterCriteria::isTagsSet() {
     return tagsIsSet;
 }
@@ -133,10 +160,15 @@ QTreeWidgetItem* FilterCriteria::getAttribute() {
 
 void FilterCriteria::setAttribute(QTreeWidgetItem &item) {
     attribute = &item;
+    attributeId = item.data(0, Qt::UserRole).toInt();
     attributeIsSet = true;
     valueSet = true;
 }
 
+qint32 FilterCriteria::getAttributeId() {
+    return attributeId;
+}
+
 bool FilterCriteria::isAttributeSet() {
     return attributeIsSet;
 }
@@ -316,3 +348,35 @@ void FilterCriteria::duplicate(FilterCriteria &newFilter) {
     newFilter.resetLid = resetLid;
     newFilter.resetSearchString = resetSearchString;
 }
+
+
+
+// A hash of everything which decides the notes the criteria select
+// (notebook, tags, search string, attribute, trash & favorite).  The
+// selected notes don't change the filter so they are left out.  Tags
+// are sorted, so the order they were picked in doesn't matter.
+QByteArray FilterCriteria::getHash() {
+    QStringList parts;
+    if (valueSet) {
+        if (notebookIsSet)
+            parts.append("notebook:" + (notebookIsStack ? QString("STACK") : QString::number(notebookLid))
+                         + ":" + notebookName);
+        if (tagsIsSet) {
+            QList<qint32> sortedLids = tagLids;
+            std::sort(sortedLids.begin(), sortedLids.end());
+            QStringList tagList;
+            for (int i=0; i<sortedLids.size(); i++)
+                tagList.append(QString::number(sortedLids[i]));
+            parts.append("tags:" + tagList.join(","));
+        }
+        if (searchStringIsSet)
+            parts.append("search:" + searchString.trimmed());
+        if (attributeIsSet)
+            parts.append("attribute:" + QString::number(attributeId));
+        if (deletedOnlyIsSet)
+            parts.append(QString("trash:") + (deletedOnly ? "1" : "0"));
+        if (favoriteIsSet)
+            parts.append("favorite:" + QString::number(favoriteLid));
+    }
+    return QCryptographicHash::hash(parts.join("\n").toUtf8(), QCryptographicHash::Sha1);
+}
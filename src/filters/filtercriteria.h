@@ -29,6 +29,13 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include <QTreeWidgetItem>
 #include <QList>
 
+//***********************************************************
+// What the note list is filtered by.  The lids & names of
+// the notebook, tags & attribute are copied from the tree
+// items when they are set (on the GUI thread), so a search
+// running on another thread never reads the items.
+//***********************************************************
+
 class FilterCriteria : public QObject
 {
     Q_OBJECT
@@ -36,14 +43,19 @@ private:
     bool valueSet;
     QTreeWidgetItem *notebook;
     bool notebookIsSet;
+    qint32 notebookLid;
+    QString notebookName;
+    bool notebookIsStack;
 
     QList<QTreeWidgetItem*> tags;
+    QList<qint32> tagLids;
     bool tagsIsSet;
 
     NSearchViewItem *savedSearch;
     bool savedSearchIsSet;
 
     QTreeWidgetItem *attribute;
+    qint32 attributeId;
     bool attributeIsSet;
 
     QString searchString;
@@ -67,12 +79,16 @@ public:
 
     QTreeWidgetItem* getNotebook();
     void setNotebook(QTreeWidgetItem &item);
+    qint32 getNotebookLid();
+    QString getNotebookName();
+    bool isNotebookStack();
     bool isNotebookSet();
     void unsetNotebook();
     bool resetNotebook;
 
     QList<QTreeWidgetItem*> getTags();
     void setTags(QList<QTreeWidgetItem*> &items);
+    QList<qint32> getTagLids();
     bool isTagsSet();
     void unsetTags();
     bool resetTags;
@@ -85,6 +101,7 @@ public:
 
     QTreeWidgetItem* getAttribute();
     void setAttribute(QTreeWidgetItem &item);
+    qint32 getAttributeId();
     bool isAttributeSet();
     void unsetAttribute();
     bool resetAttribute;
@@ -120,6 +137,7 @@ public:
     bool resetFavorite;
 
     void duplicate(FilterCriteria &criteria);
+    QByteArray getHash();              // Canonical hash of what the criteria select
 
 
 signals:
@@ -29,30 +29,88 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include "src/sql/nsqlquery.h"
 #include "src/sql/favoritesrecord.h"
 #include "src/sql/favoritestable.h"
+#include "src/sql/changelog.h"
+#include "src/sql/trigramindex.h"
+#include "src/sql/fulltextindex.h"
+#include "src/sql/rowstore.h"
+#include "src/sql/materializedsearch.h"
+#include "src/threads/databasewriter.h"
 
 #include <QtSql>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QCache>
+#include <QSet>
 
+#define FILTER_CACHE_SIZE 64
+#define FILTER_RESULT_CACHE_SIZE 32
+#define FILTER_CANCEL_ROWS 1024       // Rows read between checks for a newer search
+#define FILTER_RANK_POINTS 10      // Relevance the best full text match gets
+#define MATERIALIZED_SEARCH_MAX_CHANGES 200   // Changed notes rechecked one at a time, more & the search is run again
 
 extern Global global;
 
+// The search settings are read here, so an engine which runs on another
+// thread (see SearchRunner) has to be created on the GUI thread.
 FilterEngine::FilterEngine(QObject *parent) :
     QObject(parent)
 {
+    activeQuery = nullptr;
+    singleLid = -1;
+    materializing = false;
+    db = global.db;
+    minimumWeight = global.getMinimumRecognitionWeight();
+    tagSelectionOr = global.getTagSelectionOr();
+    latestGeneration = nullptr;
+    generation = 0;
+    sequence = -1;
+}
+
+
+// An engine with the connection, settings & generation of another one.
+// It doesn't read the settings, so it can be made on any thread.
+FilterEngine::FilterEngine(const FilterEngine *other) :
+    QObject(nullptr)
+{
+    activeQuery = nullptr;
+    singleLid = -1;
+    materializing = false;
+    db = other->db;
+    minimumWeight = other->minimumWeight;
+    tagSelectionOr = other->tagSelectionOr;
+    latestGeneration = other->latestGeneration;
+    generation = other->generation;
+    sequence = other->sequence;
+}
+
+
+// Run the statements on another connection
+void FilterEngine::setDatabase(DatabaseConnection *db) {
+    this->db = db;
+}
+
+
+// Give up on the search once "latest" moves past "generation".  The
+// statement which is running finishes, but nothing more is started.
+void FilterEngine::setGeneration(const QAtomicInt *latest, qint32 generation) {
+    latestGeneration = latest;
+    this->generation = generation;
+}
+
+
+// Has a newer search made this one pointless?
+bool FilterEngine::isCancelled() {
+    return latestGeneration != nullptr && latestGeneration->load() != generation;
 }
 
 
 
-// prepare SQL query for selection by tag
+// prepare SQL query selecting the notes with a tag
 // searched string is in "searchStr"
-// relevance==0 means we a doing primary search
-// relevance>0 means we are doing relevance update search
-// "negativeSearch" may only be passed for relevance==0 and means negative search
+// "isRelevanceUpdate" means the query is used to boost relevance, in which case
+// the tag name is right truncated like a title search
 //
-void setupTagSelectionQuery(NSqlQuery &sql, QString searchStr, int relevance, bool negativeSearch) {
-
-    // 0:  search (may then be positive or negative)
-    // >0: relevance update
-    bool isRelevanceUpdate = relevance > 0;
+void setupTagSelectionQuery(NSqlQuery &sql, QString searchStr, bool isRelevanceUpdate) {
 
     // is it wildcard search?
     bool isWildcardSearch = searchStr.contains("*");
@@ -63,61 +121,35 @@ void setupTagSelectionQuery(NSqlQuery &sql, QString searchStr, int relevance, bo
         isWildcardSearch = true;
     }
 
+    // Tag names used to be matched against DataStore.data, which is declared
+    // "collate nocase".  Tags.name isn't, so the collation is given here to
+    // keep tag: case insensitive, the same as the "like" wildcard match.
     QString cmdStr;
-    QString selectionPart;
     if (!isWildcardSearch) {
-        selectionPart = QString(
-            "("
-                "select lid from datastore where key=:notetagkey"
-                "  and data in (select lid from DataStore where data=:tagname and key=:tagnamekey)"
-                ")"
+        cmdStr = QString(
+            "select noteLid from NoteTags"
+            "  where tagLid in (select lid from Tags where name=:tagname collate nocase)"
         );
     } else {
-        selectionPart = QString(
-            "("
-                "select lid from datastore where key=:notetagkey"
-                "  and data in (select lid from DataStore where data like :tagname and key=:tagnamekey)"
-                ")"
+        cmdStr = QString(
+            "select noteLid from NoteTags"
+            "  where tagLid in (select lid from Tags where name like :tagname)"
         );
 
         searchStr = searchStr.replace("*", "%");
     }
-    if (!isRelevanceUpdate) {
-        // positive search: filter out records where tag is not found => "not"
-        // negative search: filter out record where tag IS found
-        QString negateStr = negativeSearch ? QString("") : QString("not");
-        cmdStr = QString("delete from filter where lid ") + negateStr + QString(" in ") + selectionPart;
-    } else {
-        // update record where tag IS found
-        cmdStr = QString("update filter set relevance=relevance+:relevance where lid in ") + selectionPart;
-    }
 
     sql.prepare(cmdStr);
     QLOG_DEBUG() << "Tag search query(" << searchStr
-                 << ", relevance=" << relevance
-                 << ", negative:" << negativeSearch
+                 << ", relevance update:" << isRelevanceUpdate
                  << "): " + cmdStr;
     sql.bindValue(":tagname", searchStr);
-    sql.bindValue(":tagnamekey", TAG_NAME);
-    sql.bindValue(":notetagkey", NOTE_TAG_LID);
-
-    if (isRelevanceUpdate) {
-        sql.bindValue(":relevance", relevance);
-    }
 }
 
-// prepare SQL query for selection by note title
+// prepare SQL query selecting the notes with a title
 // searched string is in "searchStr"
-// relevance==0 means we a doing primary search
-// relevance>0 means we are doing relevance update search
-// "negativeSearch" may only be passed for relevance==0 and means negative search
 //
-void setupTitleSelectionQuery(NSqlQuery &sql, QString searchStr, int relevance, bool negativeSearch) {
-    searchStr = searchStr.replace("*", "%");
-    // 0:  search (may then be positive or negative)
-    // >0: relevance update
-    bool isRelevanceUpdate = relevance > 0;
-
+void setupTitleSelectionQuery(NSqlQuery &sql, QString searchStr) {
     // this may happen only if someone posts "intitle:" without term, which doesn't give much sense either
     if (searchStr == "") {
         searchStr = "*";
@@ -132,51 +164,210 @@ void setupTitleSelectionQuery(NSqlQuery &sql, QString searchStr, int relevance,
     if (!searchStr.startsWith("%"))
         searchStr = QString("%") + searchStr;
 
-    QString cmdStr;
-    QString selectionPart("(select lid from datastore where key=:key and data like :title)");
-
-    if (!isRelevanceUpdate) {
-        // positive search: filter out records (delete) where search term is not found in title => "not"
-        // negative search: filter out record where search term IS found in title => ""
-        QString negateStr = negativeSearch ? QString("") : QString("not");
-        cmdStr = QString("delete from filter where lid ") + negateStr + QString(" in ") + selectionPart;
-    } else {
-        // update record where search term IS found in title
-        cmdStr = QString("update filter set relevance=relevance+:relevance where lid in ") + selectionPart;
-    }
+    QString cmdStr("select lid from datastore where key=:key and data like :title");
     sql.prepare(cmdStr);
-    QLOG_DEBUG() << "Title search query(" << searchStr
-                 << ", relevance=" << relevance
-                 << ", negative:" << negativeSearch
-                 << "): " + cmdStr;
-
+    QLOG_DEBUG() << "Title search query(" << searchStr << "): " + cmdStr;
 
     sql.bindValue(":key", NOTE_TITLE);
     sql.bindValue(":title", searchStr);
+}
+
+
+// Lid sets of the notebook, tag, trash & attribute criteria.  They are
+// reused until the change log shows something in the DataStore changed.
+// The keys of both caches include the change log sequence number the
+// entry was built at, so an entry built before a write which is stored
+// after it is never handed out.  Least recently used entries go first.
+static QMutex cacheMutex;
+static QCache<QString, LidBitmap> bitmapCache(FILTER_CACHE_SIZE);
+static qint64 cacheSequence = -1;
+
+// Results of earlier searches, so going back & forward through the
+// history or switching tabs doesn't filter again.  Least recently used
+// results are dropped first.
+class FilterResult {
+public:
+    LidBitmap lids;
+    QHash<qint32, int> relevance;
+    QHash<qint32, QString> snippets;
+};
+static QCache<QByteArray, FilterResult> resultCache(FILTER_RESULT_CACHE_SIZE);
+
+
+// Run a query & collect the lids it returns.  If the query fails false
+// is returned & the criterion is ignored, as the old "delete from filter"
+// statements were.
+bool FilterEngine::select(NSqlQuery &sql, LidBitmap &lids, bool cache) {
+    if (isCancelled())
+        return false;
+    if (singleLid >= 0)
+        return selectSingle(sql, lids);
+
+    // Without a sequence number there is nothing to tell a stale entry by
+    cache = cache && sequence >= 0;
+    QString key;
+    if (cache) {
+        key = QString::number(sequence) + "\x1f" + sql.lastQuery();
+        QMapIterator<QString, QVariant> i(sql.boundValues());
+        while (i.hasNext()) {
+            i.next();
+            key += "\x1f" + i.key() + "=" + i.value().toString();
+        }
+        QMutexLocker locker(&cacheMutex);
+        LidBitmap *cached = bitmapCache.object(key);
+        if (cached != nullptr) {
+            lids = *cached;
+            return true;
+        }
+    }
+
+    if (!sql.exec())
+        return false;
+    lids.clear();
+    for (qint32 rows=1; sql.next(); rows++) {
+        lids.add(sql.value(0).toInt());
+        if (rows % FILTER_CANCEL_ROWS == 0 && isCancelled())
+            return false;
+    }
 
-    if (isRelevanceUpdate) {
-        sql.bindValue(":relevance", relevance);
+    if (cache) {
+        QMutexLocker locker(&cacheMutex);
+        bitmapCache.insert(key, new LidBitmap(lids));
     }
+    return true;
 }
 
 
-void FilterEngine::filter(FilterCriteria *newCriteria, QList<qint32> *results) {
-    QLOG_TRACE_IN();
-    bool internalSearch = true;
+// Only check if the single note being tested is among the lids the
+// query returns.  SQLite pushes the lid test down into the query.
+bool FilterEngine::selectSingle(NSqlQuery &sql, LidBitmap &lids) {
+    NSqlQuery single(db);
+    single.prepare("with candidates(lid) as (" + sql.lastQuery() + ") "
+                   "select lid from candidates where lid=:singleLid");
+    QMapIterator<QString, QVariant> i(sql.boundValues());
+    while (i.hasNext()) {
+        i.next();
+        single.bindValue(i.key(), i.value());
+    }
+    single.bindValue(":singleLid", singleLid);
+    if (!single.exec())
+        return false;
+    lids.clear();
+    while (single.next())
+        lids.add(single.value(0).toInt());
+    single.finish();
+    return true;
+}
 
-    NSqlQuery sql(global.db);
-    QLOG_DEBUG() << "Purging filters";
-    sql.exec("delete from filter");
-    QLOG_DEBUG() << "Resetting filter table";
-    sql.prepare("Insert into filter (lid,relevance) "
-                    "select lid,0 from NoteTable where notebooklid not in "
-                    "(select lid from datastore where key=:closedNotebooks)");
-    sql.bindValue(":closedNotebooks", NOTEBOOK_IS_CLOSED);
-    sql.exec();
+
+// Drop the notes the query doesn't return (AND).  While a search string
+// is compiled the statement is only recorded, as are the ones below.
+void FilterEngine::keep(NSqlQuery &sql, bool cache) {
+    if (activeQuery != nullptr) {
+        activeQuery->add(SearchPredicate::Intersect, sql);
+        return;
+    }
+    LidBitmap lids;
+    if (select(sql, lids, cache))
+        resultLids &= lids;
+}
+
+
+// Drop the notes the query returns (AND NOT)
+void FilterEngine::remove(NSqlQuery &sql, bool cache) {
+    if (activeQuery != nullptr) {
+        activeQuery->add(SearchPredicate::Except, sql);
+        return;
+    }
+    LidBitmap lids;
+    if (select(sql, lids, cache))
+        resultLids -= lids;
+}
+
+
+// Add the notes the query returns to the "any:" matches (OR)
+void FilterEngine::include(NSqlQuery &sql) {
+    if (activeQuery != nullptr) {
+        activeQuery->add(SearchPredicate::Union, sql);
+        return;
+    }
+    LidBitmap lids;
+    if (select(sql, lids, false))
+        anyMatches |= lids;
+}
+
+
+// Raise the relevance of the matching notes the query returns
+void FilterEngine::boost(NSqlQuery &sql, int value) {
+    if (activeQuery != nullptr) {
+        activeQuery->add(SearchPredicate::Boost, sql, value);
+        return;
+    }
+    LidBitmap lids;
+    if (!select(sql, lids, false))
+        return;
+    lids &= resultLids;
+    QList<qint32> boosted = lids.toList();
+    for (int i=0; i<boosted.size(); i++)
+        relevance[boosted[i]] += value;
+}
+
+
+// Add how well the notes match to their relevance.  The query returns
+// (lid, score) rows, possibly several for a note.  The best note gets
+// FILTER_RANK_POINTS & the others their share of it, so the fixed boosts
+// keep their meaning.
+void FilterEngine::rank(NSqlQuery &sql) {
+    if (activeQuery != nullptr) {
+        activeQuery->add(SearchPredicate::Rank, sql);
+        return;
+    }
+    if (isCancelled() || !sql.exec())
+        return;
+    QHash<qint32, double> scores;
+    double best = 0;
+    for (qint32 rows=1; sql.next(); rows++) {
+        if (rows % FILTER_CANCEL_ROWS == 0 && isCancelled())
+            return;
+        qint32 lid = sql.value(0).toInt();
+        double score = scores.value(lid, 0) + sql.value(1).toDouble();
+        scores.insert(lid, score);
+        best = qMax(best, score);
+    }
+    if (best <= 0)
+        return;
+    QHash<qint32, double>::const_iterator i;
+    for (i=scores.constBegin(); i!=scores.constEnd(); ++i) {
+        if (resultLids.contains(i.key()))
+            relevance[i.key()] += qRound(FILTER_RANK_POINTS * i.value() / best);
+    }
+}
+
+
+// Rank the notes by bm25() for a full text search.  The row weight
+// scales the score, so weak recognition hits count for less.  FTS4 has
+// no bm25(), so nothing is ranked there.
+void FilterEngine::rankContent(QString word) {
+    if (!FullTextIndex::isFts5())
+        return;
+    NSqlQuery sql(db);
+    sql.prepare("select coalesce((select data from DataStore where lid=SearchIndex.lid and key=:key), lid), "
+                "-bm25(SearchIndex) * weight / 100.0 from SearchIndex "
+                "where SearchIndex match :word and weight>=:weight");
+    sql.bindValue(":key", RESOURCE_NOTE_LID);
+    sql.bindValue(":word", word);
+    sql.bindValue(":weight", minimumWeight);
+    rank(sql);
     sql.finish();
-    QLOG_DEBUG() << "Reset complete";
+}
 
 
+void FilterEngine::filter(FilterCriteria *newCriteria, QList<qint32> *results) {
+    QLOG_TRACE_IN();
+    bool internalSearch = true;
+    QElapsedTimer timer;
+    timer.start();
+
     FilterCriteria *criteria = newCriteria;
     if (criteria == nullptr) {
         criteria = global.getCurrentCriteria();
@@ -185,56 +376,188 @@ void FilterEngine::filter(FilterCriteria *newCriteria, QList<qint32> *results) {
         internalSearch = false;
     }
 
-    QLOG_DEBUG() << "Filtering favorite";
-    filterFavorite(criteria);
-    QLOG_DEBUG() << "Filtering notebooks";
-    filterNotebook(criteria);
-    QLOG_DEBUG() << "Filtering tags";
-    filterTags(criteria);
-    QLOG_DEBUG() << "Filtering trash";
-    filterTrash(criteria);
-    QLOG_DEBUG() << "Filtering search string";
-    filterSearchString(criteria);
-    QLOG_DEBUG() << "Filtering attributes";
-    filterAttributes(criteria);
-    QLOG_DEBUG() << "Filtering complete";
-
-    // Now, re-insert any pinned notes
-    sql.prepare("Insert into filter (lid,relevance) select lid,1 from Datastore "
-                    "where key=:key and lid not in (select lid from filter)");
-    sql.bindValue(":key", NOTE_ISPINNED);
-    sql.exec();
+    // Only the searches of the note list are cached
+    bool cached = search(criteria, internalSearch);
 
-    // Remove any selected notes that are not in the filter.
-    NSqlQuery query(global.db);
-    QList <qint32> goodLids;
-    query.exec("select lid from filter;");
-    while (query.next()) {
-        goodLids.append(query.value(0).toInt());
-    }
-    query.finish();
+    QList <qint32> goodLids = resultLids.toList();
 
     if (internalSearch) {
+        apply(resultLids, relevance, snippets, criteria->isSearchStringSet() ? criteria->getSearchString() : QString());
+
         // Remove any selected notes that are not in the filter.
         if (global.filterCriteria.size() > 0) {
             FilterCriteria *criteria = global.getCurrentCriteria();
             QList <qint32> selectedLids;
             criteria->getSelectedNotes(selectedLids);
             for (int i = selectedLids.size() - 1; i >= 0; i--) {
-                if (!goodLids.contains(selectedLids[i]))
+                if (!resultLids.contains(selectedLids[i]))
                     selectedLids.removeAll(selectedLids[i]);
             }
             criteria->setSelectedNotes(selectedLids);
             //global.setMessage(QString("Count: ") + QString::number(goodLids.size()), 0);
         }
     } else {
-        results->clear();
-        for (int i = 0; i < goodLids.size(); i++) {
-            if (!results->contains(goodLids[i])) {
-                results->append(goodLids[i]);
-            }
+        *results = goodLids;
+    }
+    QLOG_DEBUG() << "Filtered " << goodLids.size() << " notes in " << timer.elapsed() << "ms"
+                 << (cached ? " (cached)" : "");
+}
+
+
+// Work out the notes matching the criteria.  With "cache" set an earlier
+// result for the same criteria is reused & a new one is kept.  Returns
+// true if the result came out of the cache.
+bool FilterEngine::search(FilterCriteria *criteria, bool cache) {
+    // Every DataStore write moves the change log on.  Entries built at an
+    // older sequence number can't be used any more, so they are dropped.
+    // A connection still reading an older snapshot only misses the cache.
+    ChangeLog changeLog(db);
+    sequence = changeLog.getHighestSequence();
+    cacheMutex.lock();
+    if (sequence > cacheSequence) {
+        bitmapCache.clear();
+        resultCache.clear();
+        cacheSequence = sequence;
+    }
+    cacheMutex.unlock();
+
+    QByteArray key;
+    if (cache) {
+        key = criteria->getHash();
+        key += QString(" %1 %2 %3 %4").arg(tagSelectionOr)
+                .arg(minimumWeight)
+                .arg(QDate::currentDate().toJulianDay())
+                .arg(sequence).toUtf8();
+        QMutexLocker locker(&cacheMutex);
+        FilterResult *result = resultCache.object(key);
+        if (result != nullptr) {
+            resultLids = result->lids;
+            relevance = result->relevance;
+            snippets = result->snippets;
+            return true;
         }
     }
+
+    evaluate(criteria);
+    snippets.clear();
+    if (cache && criteria->isSearchStringSet() && !isCancelled())
+        searchSnippets(criteria->getSearchString());
+    if (cache && !isCancelled()) {
+        FilterResult *result = new FilterResult();
+        result->lids = resultLids;
+        result->relevance = relevance;
+        result->snippets = snippets;
+        QMutexLocker locker(&cacheMutex);
+        resultCache.insert(key, result);
+    }
+    return false;
+}
+
+
+// Search string & snippets of the result in the note list (GUI thread)
+static QString shownSearch;
+static QHash<qint32, QString> shownSnippets;
+
+// Show a result in the note list.  This writes to the filter table of the
+// GUI connection, so it has to run on the GUI thread.
+void FilterEngine::apply(const LidBitmap &lids, const QHash<qint32, int> &relevance,
+                         const QHash<qint32, QString> &snippets, const QString &searchString) {
+    // Only the final result is written to the filter table
+    global.db->updateFilterTable(lids, relevance);
+    shownSearch = searchString;
+    shownSnippets = snippets;
+
+    // Let the counters see what is in the filter
+    global.setFilteredLids(lids.toList());
+}
+
+
+// The snippet the note list shows for a note.  They are all looked up
+// with the search, so painting a row doesn't query the database.
+QString FilterEngine::getShownSnippet(qint32 lid) {
+    return shownSnippets.value(lid);
+}
+
+
+
+// Check a single note against the criteria, the current ones if none
+// are given.  Every criterion only looks at this note, so the cost
+// doesn't grow with the size of the database.
+bool FilterEngine::matches(qint32 lid, FilterCriteria *criteria) {
+    if (criteria == nullptr)
+        criteria = global.getCurrentCriteria();
+    singleLid = lid;
+    evaluate(criteria);
+    singleLid = -1;
+    return resultLids.contains(lid);
+}
+
+
+// A note was saved, retagged or moved.  Check it against the current
+// criteria & add it to, drop it from or re-rank it in the note list's
+// filter instead of filtering everything again.  Returns true if the
+// note entered or left the list.
+bool FilterEngine::refilter(qint32 lid) {
+    QLOG_TRACE_IN();
+    bool match = matches(lid);
+
+    // The note's text may have changed even if the filter hasn't
+    if (match && shownSearch.trimmed() != "")
+        shownSnippets.insert(lid, noteSnippet(lid, shownSearch));
+    else
+        shownSnippets.remove(lid);
+    if (!global.db->updateFilterLid(lid, match, relevance.value(lid, 0)))
+        return false;
+
+    QList<qint32> lids;
+    if (global.getFilteredLids(lids)) {
+        lids.removeAll(lid);
+        if (match)
+            lids.append(lid);
+        global.setFilteredLids(lids);
+    }
+    return true;
+}
+
+
+
+// Work out the notes which match the criteria
+void FilterEngine::evaluate(FilterCriteria *criteria) {
+    // Start with every note which isn't in a closed notebook
+    resultLids.clear();
+    relevance.clear();
+    NSqlQuery sql(db);
+    sql.prepare("select lid from NoteTable where notebooklid not in "
+                    "(select lid from datastore where key=:closedNotebooks)");
+    sql.bindValue(":closedNotebooks", NOTEBOOK_IS_CLOSED);
+    select(sql, resultLids, true);
+    sql.finish();
+
+    QLOG_DEBUG() << "Filtering favorite";
+    filterFavorite(criteria);
+    QLOG_DEBUG() << "Filtering notebooks";
+    filterNotebook(criteria);
+    QLOG_DEBUG() << "Filtering tags";
+    filterTags(criteria);
+    QLOG_DEBUG() << "Filtering trash";
+    filterTrash(criteria);
+    QLOG_DEBUG() << "Filtering search string";
+    filterSearchString(criteria);
+    QLOG_DEBUG() << "Filtering attributes";
+    filterAttributes(criteria);
+    QLOG_DEBUG() << "Filtering complete";
+
+    // Now, re-insert any pinned notes
+    sql.prepare("select lid from Datastore where key=:key");
+    sql.bindValue(":key", NOTE_ISPINNED);
+    LidBitmap pinned;
+    select(sql, pinned, true);
+    sql.finish();
+    pinned -= resultLids;
+    resultLids |= pinned;
+    QList<qint32> pinnedLids = pinned.toList();
+    for (int i=0; i<pinnedLids.size(); i++)
+        relevance.insert(pinnedLids[i], 1);
 }
 
 
@@ -244,8 +567,8 @@ void FilterEngine::filterAttributes(FilterCriteria *criteria) {
         return;
     QLOG_TRACE_IN();
 
-    int attribute = criteria->getAttribute()->data(0,Qt::UserRole).toInt();
-    NSqlQuery sql(global.db);
+    int attribute = criteria->getAttributeId();
+    NSqlQuery sql(db);
     QDateTime dt;
     dt.setDate(QDate().currentDate());
     int dow = QDate().currentDate().dayOfWeek();
@@ -256,45 +579,45 @@ void FilterEngine::filterAttributes(FilterCriteria *criteria) {
     switch (attribute)
     {
     case CREATED_SINCE_TODAY:
-        sql.prepare("Delete from filter where lid not in (select lid from DataStore where key=:key and datetime(data/1000)>(datetime(:data/1000)))");
+        sql.prepare("select lid from DataStore where key=:key and datetime(data/1000)>(datetime(:data/1000))");
         sql.bindValue(":key", NOTE_CREATED_DATE);
         sql.bindValue(":data", dt.toMSecsSinceEpoch());
         break;
     case CREATED_SINCE_YESTERDAY:
         dt = dt.addDays(-1);
-        sql.prepare("Delete from filter where lid not in (select lid from DataStore where key=:key and datetime(data/1000)>(datetime(:data/1000)))");;
+        sql.prepare("select lid from DataStore where key=:key and datetime(data/1000)>(datetime(:data/1000))");
         sql.bindValue(":key", NOTE_CREATED_DATE);
         sql.bindValue(":data", dt.toMSecsSinceEpoch());
         break;
     case CREATED_SINCE_THIS_WEEK:
         dt = dt.addDays(-1*dow);
-        sql.prepare("Delete from filter where lid not in (select lid from DataStore where key=:key and datetime(data/1000)>(datetime(:data/1000)))");;
+        sql.prepare("select lid from DataStore where key=:key and datetime(data/1000)>(datetime(:data/1000))");
         sql.bindValue(":key", NOTE_CREATED_DATE);
         sql.bindValue(":data", dt.toMSecsSinceEpoch());
         break;
     case CREATED_SINCE_LAST_WEEK:
         dt = dt.addDays(-1*dow-7);
-        sql.prepare("Delete from filter where lid not in (select lid from DataStore where key=:key and datetime(data/1000)>(datetime(:data/1000)))");;
+        sql.prepare("select lid from DataStore where key=:key and datetime(data/1000)>(datetime(:data/1000))");
         sql.bindValue(":key", NOTE_CREATED_DATE);
         sql.bindValue(":data", dt.toMSecsSinceEpoch());
         break;
     case CREATED_SINCE_THIS_MONTH:
         dt = dt.addDays(-1*dom+1);
-        sql.prepare("Delete from filter where lid not in (select lid from DataStore where key=:key and datetime(data/1000)>(datetime(:data/1000)))");;
+        sql.prepare("select lid from DataStore where key=:key and datetime(data/1000)>(datetime(:data/1000))");
         sql.bindValue(":key", NOTE_CREATED_DATE);
         sql.bindValue(":data", dt.toMSecsSinceEpoch());
         break;
     case CREATED_SINCE_LAST_MONTH:
         dt = dt.addDays(-1*dom+1);
         dt = dt.addMonths(-1);
-        sql.prepare("Delete from filter where lid not in (select lid from DataStore where key=:key and datetime(data/1000)>(datetime(:data/1000)))");;
+        sql.prepare("select lid from DataStore where key=:key and datetime(data/1000)>(datetime(:data/1000))");
         sql.bindValue(":key", NOTE_CREATED_DATE);
         sql.bindValue(":data", dt.toMSecsSinceEpoch());
         break;
     case CREATED_SINCE_THIS_YEAR:
         dt = dt.addDays(-1*dom+1);
         dt = dt.addMonths(-1*moy+1);
-        sql.prepare("Delete from filter where lid not in (select lid from DataStore where key=:key and datetime(data/1000)>(datetime(:data/1000)))");;
+        sql.prepare("select lid from DataStore where key=:key and datetime(data/1000)>(datetime(:data/1000))");
         sql.bindValue(":key", NOTE_CREATED_DATE);
         sql.bindValue(":data", dt.toMSecsSinceEpoch());
         break;
@@ -302,50 +625,50 @@ void FilterEngine::filterAttributes(FilterCriteria *criteria) {
         dt = dt.addDays(-1*dom+1);
         dt = dt.addMonths(-1*moy+1);
         dt = dt.addYears(-1);
-        sql.prepare("Delete from filter where lid not in (select lid from DataStore where key=:key and datetime(data/1000)>(datetime(:data/1000)))");;
+        sql.prepare("select lid from DataStore where key=:key and datetime(data/1000)>(datetime(:data/1000))");
         sql.bindValue(":key", NOTE_CREATED_DATE);
         sql.bindValue(":data", dt.toMSecsSinceEpoch());
         break;
     case CREATED_BEFORE_TODAY:
-        sql.prepare("Delete from filter where lid not in (select lid from DataStore where key=:key and datetime(data/1000)<(datetime(:data/1000)))");
+        sql.prepare("select lid from DataStore where key=:key and datetime(data/1000)<(datetime(:data/1000))");
         sql.bindValue(":key", NOTE_CREATED_DATE);
         sql.bindValue(":data", dt.toMSecsSinceEpoch());
         break;
     case CREATED_BEFORE_YESTERDAY:
         dt = dt.addDays(-1);
-        sql.prepare("Delete from filter where lid not in (select lid from DataStore where key=:key and datetime(data/1000)<(datetime(:data/1000)))");;
+        sql.prepare("select lid from DataStore where key=:key and datetime(data/1000)<(datetime(:data/1000))");
         sql.bindValue(":key", NOTE_CREATED_DATE);
         sql.bindValue(":data", dt.toMSecsSinceEpoch());
         break;
     case CREATED_BEFORE_THIS_WEEK:
         dt = dt.addDays(-1*dow);
-        sql.prepare("Delete from filter where lid not in (select lid from DataStore where key=:key and datetime(data/1000)<(datetime(:data/1000)))");;
+        sql.prepare("select lid from DataStore where key=:key and datetime(data/1000)<(datetime(:data/1000))");
         sql.bindValue(":key", NOTE_CREATED_DATE);
         sql.bindValue(":data", dt.toMSecsSinceEpoch());
         break;
     case CREATED_BEFORE_LAST_WEEK:
         dt = dt.addDays(-1*dow-7);
-        sql.prepare("Delete from filter where lid not in (select lid from DataStore where key=:key and datetime(data/1000)<(datetime(:data/1000)))");;
+        sql.prepare("select lid from DataStore where key=:key and datetime(data/1000)<(datetime(:data/1000))");
         sql.bindValue(":key", NOTE_CREATED_DATE);
         sql.bindValue(":data", dt.toMSecsSinceEpoch());
         break;
     case CREATED_BEFORE_THIS_MONTH:
         dt = dt.addDays(-1*dom+1);
-        sql.prepare("Delete from filter where lid not in (select lid from DataStore where key=:key and datetime(data/1000)<(datetime(:data/1000)))");;
+        sql.prepare("select lid from DataStore where key=:key and datetime(data/1000)<(datetime(:data/1000))");
         sql.bindValue(":key", NOTE_CREATED_DATE);
         sql.bindValue(":data", dt.toMSecsSinceEpoch());
         break;
     case CREATED_BEFORE_LAST_MONTH:
         dt = dt.addDays(-1*dom+1);
         dt = dt.addMonths(-1);
-        sql.prepare("Delete from filter where lid not in (select lid from DataStore where key=:key and datetime(data/1000)<(datetime(:data/1000)))");;
+        sql.prepare("select lid from DataStore where key=:key and datetime(data/1000)<(datetime(:data/1000))");
         sql.bindValue(":key", NOTE_CREATED_DATE);
         sql.bindValue(":data", dt.toMSecsSinceEpoch());
         break;
     case CREATED_BEFORE_THIS_YEAR:
         dt = dt.addDays(-1*dom+1);
         dt = dt.addMonths(-1*moy+1);
-        sql.prepare("Delete from filter where lid not in (select lid from DataStore where key=:key and datetime(data/1000)<(datetime(:data/1000)))");;
+        sql.prepare("select lid from DataStore where key=:key and datetime(data/1000)<(datetime(:data/1000))");
         sql.bindValue(":key", NOTE_CREATED_DATE);
         sql.bindValue(":data", dt.toMSecsSinceEpoch());
         break;
@@ -353,50 +676,50 @@ void FilterEngine::filterAttributes(FilterCriteria *criteria) {
         dt = dt.addDays(-1*dom+1);
         dt = dt.addMonths(-1*moy+1);
         dt = dt.addYears(-1);
-        sql.prepare("Delete from filter where lid not in (select lid from DataStore where key=:key and datetime(data/1000)<(datetime(:data/1000)))");;
+        sql.prepare("select lid from DataStore where key=:key and datetime(data/1000)<(datetime(:data/1000))");
         sql.bindValue(":key", NOTE_CREATED_DATE);
         sql.bindValue(":data", dt.toMSecsSinceEpoch());
         break;
     case MODIFIED_SINCE_TODAY:
-        sql.prepare("Delete from filter where lid not in (select lid from DataStore where key=:key and datetime(data/1000)>(datetime(:data/1000)))");
+        sql.prepare("select lid from DataStore where key=:key and datetime(data/1000)>(datetime(:data/1000))");
         sql.bindValue(":key", NOTE_UPDATED_DATE);
         sql.bindValue(":data", dt.toMSecsSinceEpoch());
         break;
     case MODIFIED_SINCE_YESTERDAY:
         dt = dt.addDays(-1);
-        sql.prepare("Delete from filter where lid not in (select lid from DataStore where key=:key and datetime(data/1000)>(datetime(:data/1000)))");;
+        sql.prepare("select lid from DataStore where key=:key and datetime(data/1000)>(datetime(:data/1000))");
         sql.bindValue(":key", NOTE_UPDATED_DATE);
         sql.bindValue(":data", dt.toMSecsSinceEpoch());
         break;
     case MODIFIED_SINCE_THIS_WEEK:
         dt = dt.addDays(-1*dow);
-        sql.prepare("Delete from filter where lid not in (select lid from DataStore where key=:key and datetime(data/1000)>(datetime(:data/1000)))");;
+        sql.prepare("select lid from DataStore where key=:key and datetime(data/1000)>(datetime(:data/1000))");
         sql.bindValue(":key", NOTE_UPDATED_DATE);
         sql.bindValue(":data", dt.toMSecsSinceEpoch());
         break;
     case MODIFIED_SINCE_LAST_WEEK:
         dt = dt.addDays(-1*dow-7);
-        sql.prepare("Delete from filter where lid not in (select lid from DataStore where key=:key and datetime(data/1000)>(datetime(:data/1000)))");;
+        sql.prepare("select lid from DataStore where key=:key and datetime(data/1000)>(datetime(:data/1000))");
         sql.bindValue(":key", NOTE_UPDATED_DATE);
         sql.bindValue(":data", dt.toMSecsSinceEpoch());
         break;
     case MODIFIED_SINCE_THIS_MONTH:
         dt = dt.addDays(-1*dom+1);
-        sql.prepare("Delete from filter where lid not in (select lid from DataStore where key=:key and datetime(data/1000)>(datetime(:data/1000)))");;
+        sql.prepare("select lid from DataStore where key=:key and datetime(data/1000)>(datetime(:data/1000))");
         sql.bindValue(":key", NOTE_UPDATED_DATE);
         sql.bindValue(":data", dt.toMSecsSinceEpoch());
         break;
     case MODIFIED_SINCE_LAST_MONTH:
         dt = dt.addDays(-1*dom+1);
         dt = dt.addMonths(-1);
-        sql.prepare("Delete from filter where lid not in (select lid from DataStore where key=:key and datetime(data/1000)>(datetime(:data/1000)))");;
+        sql.prepare("select lid from DataStore where key=:key and datetime(data/1000)>(datetime(:data/1000))");
         sql.bindValue(":key", NOTE_UPDATED_DATE);
         sql.bindValue(":data", dt.toMSecsSinceEpoch());
         break;
     case MODIFIED_SINCE_THIS_YEAR:
         dt = dt.addDays(-1*dom+1);
         dt = dt.addMonths(-1*moy+1);
-        sql.prepare("Delete from filter where lid not in (select lid from DataStore where key=:key and datetime(data/1000)>(datetime(:data/1000)))");;
+        sql.prepare("select lid from DataStore where key=:key and datetime(data/1000)>(datetime(:data/1000))");
         sql.bindValue(":key", NOTE_UPDATED_DATE);
         sql.bindValue(":data", dt.toMSecsSinceEpoch());
         break;
@@ -404,50 +727,50 @@ void FilterEngine::filterAttributes(FilterCriteria *criteria) {
         dt = dt.addDays(-1*dom+1);
         dt = dt.addMonths(-1*moy+1);
         dt = dt.addYears(-1);
-        sql.prepare("Delete from filter where lid not in (select lid from DataStore where key=:key and datetime(data/1000)>(datetime(:data/1000)))");;
+        sql.prepare("select lid from DataStore where key=:key and datetime(data/1000)>(datetime(:data/1000))");
         sql.bindValue(":key", NOTE_UPDATED_DATE);
         sql.bindValue(":data", dt.toMSecsSinceEpoch());
         break;
     case MODIFIED_BEFORE_TODAY:
-        sql.prepare("Delete from filter where lid not in (select lid from DataStore where key=:key and datetime(data/1000)<(datetime(:data/1000)))");
+        sql.prepare("select lid from DataStore where key=:key and datetime(data/1000)<(datetime(:data/1000))");
         sql.bindValue(":key", NOTE_UPDATED_DATE);
         sql.bindValue(":data", dt.toMSecsSinceEpoch());
         break;
     case MODIFIED_BEFORE_YESTERDAY:
         dt = dt.addDays(-1);
-        sql.prepare("Delete from filter where lid not in (select lid from DataStore where key=:key and datetime(data/1000)<(datetime(:data/1000)))");;
+        sql.prepare("select lid from DataStore where key=:key and datetime(data/1000)<(datetime(:data/1000))");
         sql.bindValue(":key", NOTE_UPDATED_DATE);
         sql.bindValue(":data", dt.toMSecsSinceEpoch());
         break;
     case MODIFIED_BEFORE_THIS_WEEK:
         dt = dt.addDays(-1*dow);
-        sql.prepare("Delete from filter where lid not in (select lid from DataStore where key=:key and datetime(data/1000)<(datetime(:data/1000)))");;
+        sql.prepare("select lid from DataStore where key=:key and datetime(data/1000)<(datetime(:data/1000))");
         sql.bindValue(":key", NOTE_UPDATED_DATE);
         sql.bindValue(":data", dt.toMSecsSinceEpoch());
         break;
     case MODIFIED_BEFORE_LAST_WEEK:
         dt = dt.addDays(-1*dow-7);
-        sql.prepare("Delete from filter where lid not in (select lid from DataStore where key=:key and datetime(data/1000)<(datetime(:data/1000)))");;
+        sql.prepare("select lid from DataStore where key=:key and datetime(data/1000)<(datetime(:data/1000))");
         sql.bindValue(":key", NOTE_UPDATED_DATE);
         sql.bindValue(":data", dt.toMSecsSinceEpoch());
         break;
     case MODIFIED_BEFORE_THIS_MONTH:
         dt = dt.addDays(-1*dom+1);
-        sql.prepare("Delete from filter where lid not in (select lid from DataStore where key=:key and datetime(data/1000)<(datetime(:data/1000)))");;
+        sql.prepare("select lid from DataStore where key=:key and datetime(data/1000)<(datetime(:data/1000))");
         sql.bindValue(":key", NOTE_UPDATED_DATE);
         sql.bindValue(":data", dt.toMSecsSinceEpoch());
         break;
     case MODIFIED_BEFORE_LAST_MONTH:
         dt = dt.addDays(-1*dom+1);
         dt = dt.addMonths(-1);
-        sql.prepare("Delete from filter where lid not in (select lid from DataStore where key=:key and datetime(data/1000)<(datetime(:data/1000)))");;
+        sql.prepare("select lid from DataStore where key=:key and datetime(data/1000)<(datetime(:data/1000))");
         sql.bindValue(":key", NOTE_UPDATED_DATE);
         sql.bindValue(":data", dt.toMSecsSinceEpoch());
         break;
     case MODIFIED_BEFORE_THIS_YEAR:
         dt = dt.addDays(-1*dom+1);
         dt = dt.addMonths(-1*moy+1);
-        sql.prepare("Delete from filter where lid not in (select lid from DataStore where key=:key and datetime(data/1000)<(datetime(:data/1000)))");;
+        sql.prepare("select lid from DataStore where key=:key and datetime(data/1000)<(datetime(:data/1000))");
         sql.bindValue(":key", NOTE_UPDATED_DATE);
         sql.bindValue(":data", dt.toMSecsSinceEpoch());
         break;
@@ -455,91 +778,93 @@ void FilterEngine::filterAttributes(FilterCriteria *criteria) {
         dt = dt.addDays(-1*dom+1);
         dt = dt.addMonths(-1*moy+1);
         dt = dt.addYears(-1);
-        sql.prepare("Delete from filter where lid not in (select lid from DataStore where key=:key and datetime(data/1000)<(datetime(:data/1000)))");;
+        sql.prepare("select lid from DataStore where key=:key and datetime(data/1000)<(datetime(:data/1000))");
         sql.bindValue(":key", NOTE_UPDATED_DATE);
         sql.bindValue(":data", dt.toMSecsSinceEpoch());
         break;
     case CONTAINS_IMAGES:
-        sql.prepare("Delete from filter where lid not in (select data from datastore where key=:notelidkey and lid in (select lid from DataStore where key=:mimekey and data like 'image/%'))");
+        sql.prepare("select data from datastore where key=:notelidkey and lid in (select lid from DataStore where key=:mimekey and data like 'image/%')");
         sql.bindValue(":notelidkey", RESOURCE_NOTE_LID);
         sql.bindValue(":mimekey", RESOURCE_MIME);
         break;
     case CONTAINS_AUDIO:
-        sql.prepare("Delete from filter where lid not in (select data from datastore where key=:notelidkey and lid in (select lid from DataStore where key=:mimekey and data like 'audio/%'))");
+        sql.prepare("select data from datastore where key=:notelidkey and lid in (select lid from DataStore where key=:mimekey and data like 'audio/%')");
         sql.bindValue(":notelidkey", RESOURCE_NOTE_LID);
         sql.bindValue(":mimekey", RESOURCE_MIME);
         break;
     case CONTAINS_INK:
-        sql.prepare("Delete from filter where lid not in (select data from datastore where key=:notelidkey and lid in (select lid from DataStore where key=:mimekey and data = 'application/vnd.evernote.ink'))");
+        sql.prepare("select data from datastore where key=:notelidkey and lid in (select lid from DataStore where key=:mimekey and data = 'application/vnd.evernote.ink')");
         sql.bindValue(":notelidkey", RESOURCE_NOTE_LID);
         sql.bindValue(":mimekey", RESOURCE_MIME);
         break;
     case CONTAINS_ENCRYPTED_TEXT:
-        sql.prepare("Delete from filter where lid not in (select lid from DataStore where key=:encryptedkey)");
+        sql.prepare("select lid from DataStore where key=:encryptedkey");
         sql.bindValue(":encryptedkey", NOTE_HAS_ENCRYPT);
         break;
     case CONTAINS_TODO_ITEMS:
-        sql.prepare("Delete from filter where lid not in (select lid from DataStore where (key=:comp or key=:uncomp) and data=1)");
+        sql.prepare("select lid from DataStore where (key=:comp or key=:uncomp) and data=1");
         sql.bindValue(":comp", NOTE_HAS_TODO_COMPLETED);
         sql.bindValue(":uncomp", NOTE_HAS_TODO_UNCOMPLETED);
         break;
     case CONTAINS_FINISHED_TODO_ITEMS:
-        sql.prepare("Delete from filter where lid not in (select lid from DataStore where key=:comp and data=1)");
+        sql.prepare("select lid from DataStore where key=:comp and data=1");
         sql.bindValue(":comp", NOTE_HAS_TODO_COMPLETED);
         break;
     case CONTAINS_UNFINISHED_TODO_ITEMS:
-        sql.prepare("Delete from filter where lid not in (select lid from DataStore where key=:uncomp and data=1)");
+        sql.prepare("select lid from DataStore where key=:uncomp and data=1");
         sql.bindValue(":uncomp", NOTE_HAS_TODO_UNCOMPLETED);
         break;
     case CONTAINS_PDF_DOCUMENT:
-        sql.prepare("Delete from filter where lid not in (select data from datastore where key=:notelidkey and lid in (select lid from DataStore where key=:mimekey and data ='application/pdf'))");
+        sql.prepare("select data from datastore where key=:notelidkey and lid in (select lid from DataStore where key=:mimekey and data ='application/pdf')");
         sql.bindValue(":notelidkey", RESOURCE_NOTE_LID);
         sql.bindValue(":mimekey", RESOURCE_MIME);
         break;
     case CONTAINS_ATTACHMENT:
-        sql.prepare("Delete from filter where lid not in (select lid from datastore where key=:key)");
+        sql.prepare("select lid from datastore where key=:key");
         sql.bindValue(":key", NOTE_HAS_ATTACHMENT);
         break;
     case CONTAINS_REMINDER:
-            sql.prepare("Delete from filter where lid not in (select lid from datastore where key=:key)");
+            sql.prepare("select lid from datastore where key=:key");
             sql.bindValue(":key", NOTE_ATTRIBUTE_REMINDER_TIME);
             break;
     case CONTAINS_UNCOMPLETED_REMINDER:
-            sql.prepare("Delete from filter where lid not in (select lid from datastore where key=:key)");
+            sql.prepare("select lid from datastore where key=:key");
             sql.bindValue(":key", NOTE_ATTRIBUTE_REMINDER_TIME);
-            sql.exec();
-            sql.prepare("delete from filter where lid in (select lid from datastore where key=:key and data>0)");
+            keep(sql, true);
+            sql.prepare("select lid from datastore where key=:key and data>0");
             sql.bindValue(":key", NOTE_ATTRIBUTE_REMINDER_DONE_TIME);
-            break;
+            remove(sql, true);
+            sql.finish();
+            return;
     case CONTAINS_FUTURE_REMINDER:
-            sql.prepare("Delete from filter where lid not in (select lid from datastore where key=:key and data>:dt)");
+            sql.prepare("select lid from datastore where key=:key and data>:dt");
             sql.bindValue(":key", NOTE_ATTRIBUTE_REMINDER_TIME);
             sql.bindValue(":dt",QDateTime::currentMSecsSinceEpoch());
             break;
     case SOURCE_EMAIL:
-        sql.prepare("Delete from filter where lid not in (select lid from datastore where key=:key and data = 'mail.clip')");
+        sql.prepare("select lid from datastore where key=:key and data = 'mail.clip'");
         sql.bindValue(":key", NOTE_ATTRIBUTE_SOURCE);
         break;
     case SOURCE_EMAILED_TO_EVERNOTE:
-        sql.prepare("Delete from filter where lid not in (select lid from datastore where key=:key and data = 'mail.smtp')");
+        sql.prepare("select lid from datastore where key=:key and data = 'mail.smtp'");
         sql.bindValue(":key", NOTE_ATTRIBUTE_SOURCE);
         break;
     case SOURCE_MOBILE:
-        sql.prepare("Delete from filter where lid not in (select lid from datastore where key=:key and data like 'mobile.%')");
+        sql.prepare("select lid from datastore where key=:key and data like 'mobile.%'");
         sql.bindValue(":key", NOTE_ATTRIBUTE_SOURCE);
         break;
     case SOURCE_WEB_PAGE:
-        sql.prepare("Delete from filter where lid not in (select lid from datastore where key=:key and data = 'web.clip')");
+        sql.prepare("select lid from datastore where key=:key and data = 'web.clip'");
         sql.bindValue(":key", NOTE_ATTRIBUTE_SOURCE);
         break;
     case SOURCE_ANOTHER_APPLICATION:
-        sql.prepare("Delete from filter where lid not in (select lid from datastore where key=:key and data != 'web.clip' and "
-                    "data not like 'mobile.%' and data != 'mail.smtp' and data != 'mail.clip')");
+        sql.prepare("select lid from datastore where key=:key and data != 'web.clip' and "
+                    "data not like 'mobile.%' and data != 'mail.smtp' and data != 'mail.clip'");
         sql.bindValue(":key", NOTE_ATTRIBUTE_SOURCE);
         break;
     }
 
-    sql.exec();
+    keep(sql, true);
     sql.finish();
 }
 
@@ -550,7 +875,7 @@ void FilterEngine::filterFavorite(FilterCriteria *criteria) {
         return;
     QLOG_TRACE_IN();
 
-    FavoritesTable ftable(global.db);
+    FavoritesTable ftable(db);
     FavoritesRecord rec;
     if (!ftable.get(rec, criteria->getFavorite()))
         return;
@@ -561,7 +886,7 @@ void FilterEngine::filterFavorite(FilterCriteria *criteria) {
         rec.type == FavoritesRecord::SharedNotebook ||
         rec.type == FavoritesRecord::SynchronizedNotebook) {
         qint32 notebookLid = rec.target.toInt();
-        NotebookTable ntable(global.db);
+        NotebookTable ntable(db);
         QString guid="";
         if (ntable.getGuid(guid, notebookLid)) {
             filterIndividualNotebook(guid);
@@ -577,30 +902,17 @@ void FilterEngine::filterFavorite(FilterCriteria *criteria) {
     }
 
     if (rec.type == FavoritesRecord::Tag) {
-        NoteTable noteTable(global.db);
-        TagTable tagTable(global.db);
-        NSqlQuery sql(global.db);
-        sql.exec("create temporary table if not exists goodLids (lid integer)");
-        sql.exec("delete from goodLids");
-        QList<qint32> notes;
-        QString tagGuid="";
-        tagTable.getGuid(tagGuid, rec.target.toInt());
-        noteTable.getNotesWithTag(notes, tagGuid);
-        sql.prepare("insert into goodLids (lid) values (:note)");
-        for (qint32 i=0; i<notes.size(); i++) {
-            sql.bindValue(":note", notes[i]);
-            sql.exec();
-        }
-        sql.exec("delete from filter where lid not in (select lid from goodLids)" );
+        NSqlQuery sql(db);
+        sql.prepare("select noteLid from NoteTags where tagLid=:tagLid");
+        sql.bindValue(":tagLid", rec.target.toInt());
+        keep(sql, true);
         sql.finish();
     }
 
     if (rec.type == FavoritesRecord::Note) {
-        NSqlQuery sql(global.db);
-        sql.prepare("delete from filter where lid <> :lid");
-        sql.bindValue(":lid", rec.target);
-        sql.exec();
-        sql.finish();
+        LidBitmap note;
+        note.add(rec.target.toInt());
+        resultLids &= note;
     }
 
 }
@@ -610,14 +922,12 @@ void FilterEngine::filterNotebook(FilterCriteria *criteria) {
         return;
     QLOG_TRACE_IN();
 
-    QString stackTest = criteria->getNotebook()->data(0,Qt::UserRole).toString();
-    if (stackTest == "STACK") {
-        QString stackName = criteria->getNotebook()->text(0);
+    if (criteria->isNotebookStack()) {
+        QString stackName = criteria->getNotebookName();
         filterStack(stackName);
     } else {
-        FilterCriteria *criteria = global.getCurrentCriteria();
-        qint32 notebookLid = criteria->getNotebook()->data(0,Qt::UserRole).toInt();
-        NotebookTable notebookTable(global.db);
+        qint32 notebookLid = criteria->getNotebookLid();
+        NotebookTable notebookTable(db);
         QString notebook;
         notebookTable.getGuid(notebook, notebookLid);
         filterIndividualNotebook(notebook);
@@ -630,14 +940,14 @@ void FilterEngine::filterNotebook(FilterCriteria *criteria) {
 // If they only chose one notebook, then delete everything else
 void FilterEngine::filterIndividualNotebook(QString &notebook) {
     QLOG_TRACE_IN();
-    NotebookTable notebookTable(global.db);
+    NotebookTable notebookTable(db);
     qint32 notebookLid = notebookTable.getLid(notebook);
     // Filter out the records
-    NSqlQuery sql(global.db);
-    sql.prepare("Delete from filter where lid not in (select lid from DataStore where key=:type and data=:notebookLid)");
+    NSqlQuery sql(db);
+    sql.prepare("select lid from DataStore where key=:type and data=:notebookLid");
     sql.bindValue(":type", NOTE_NOTEBOOK_LID);
     sql.bindValue(":notebookLid", notebookLid);
-    sql.exec();
+    keep(sql, true);
     sql.finish();
 }
 
@@ -653,37 +963,26 @@ void FilterEngine::filterStack(QString &stack) {
     if (stack.startsWith("stack:"))
         stack = stack.mid(stack.indexOf("stack:")+6);
 
-    NotebookTable notebookTable(global.db);
+    NotebookTable notebookTable(db);
     QList<qint32> books;
     QList<qint32> stackBooks;
     notebookTable.getAll(books);
     notebookTable.getStack(stackBooks, stack);
 
-    NSqlQuery sql(global.db);
-    if (negative) {
-        sql.exec("create temporary table if not exists goodLids (lid integer)");
-        sql.exec("delete from goodLids");
-        sql.prepare("insert into goodLids (lid) select lid from DataStore where key=:key");
-        sql.bindValue(":key", NOTEBOOK_GUID);
-        sql.exec();
-        sql.prepare("delete from goodLids where lid=:notebookLid");
-    } else {
-        sql.prepare("Delete from filter where lid in (select lid from DataStore where key=:type and data=:notebookLid)");
-        sql.bindValue(":type", NOTE_NOTEBOOK_LID);
-    }
-
+    // A stack search drops the notes in every other notebook, a negative one
+    // drops the notes in the stack.
+    QStringList dropBooks;
     for (qint32 i=0; i<books.size(); i++) {
-        if (!stackBooks.contains(books[i])) {
-            sql.bindValue(":notebookLid", books[i]);
-            sql.exec();
-        }
+        if (stackBooks.contains(books[i]) == negative)
+            dropBooks.append(QString::number(books[i]));
     }
+    if (dropBooks.size() == 0)
+        return;
 
-    if (negative) {
-        sql.prepare("delete from filter where lid in (select lid from DataStore where key=:key and data in (select lid from goodLids))");
-        sql.bindValue(":key", NOTE_NOTEBOOK_LID);
-        sql.exec();
-    }
+    NSqlQuery sql(db);
+    sql.prepare("select lid from DataStore where key=:type and data in (" + dropBooks.join(",") + ")");
+    sql.bindValue(":type", NOTE_NOTEBOOK_LID);
+    remove(sql, true);
     sql.finish();
 }
 
@@ -694,41 +993,24 @@ void FilterEngine::filterTags(FilterCriteria *criteria) {
     if (!criteria->isSet() || !criteria->isTagsSet())
         return;
     QLOG_TRACE_IN();
-    QList<QTreeWidgetItem*> tags = criteria->getTags();
+    QList<qint32> tags = criteria->getTagLids();
 
-    if (!global.getTagSelectionOr()) {
-        NSqlQuery query(global.db);
+    if (!tagSelectionOr) {
+        NSqlQuery query(db);
         for (qint32 i=0; i<tags.size(); i++) {
-            query.prepare("Delete from filter where lid not in (select lid from datastore where key=:notetagkey and data=:data)");
-            query.bindValue(":notetagkey", NOTE_TAG_LID);
-            query.bindValue(":data", tags[i]->data(0,Qt::UserRole).toInt())  ;
-            query.exec();
+            query.prepare("select noteLid from NoteTags where tagLid=:data");
+            query.bindValue(":data", tags[i]);
+            keep(query, true);
         }
         query.finish();
     } else {
-        NoteTable noteTable(global.db);
-        TagTable tagTable(global.db);
-        QList<qint32> goodNotes;
-        for (qint32 i=0; i<tags.size(); i++) {
-            QList<qint32> notes;
-            QString tagGuid;
-            tagTable.getGuid(tagGuid, tags[i]->data(0,Qt::UserRole).toInt());
-            noteTable.getNotesWithTag(notes, tagGuid);
-            for (qint32 j=0; j<notes.size(); j++) {
-                if (!goodNotes.contains(notes[j]))
-                    goodNotes.append(notes[j]);
-            }
-        }
-
-        NSqlQuery sql(global.db);
-        sql.exec("create temporary table if not exists goodLids (lid integer)");
-        sql.exec("delete from goodLids");
-        sql.prepare("insert into goodLids (lid) values (:note)");
-        for (qint32 i=0; i<goodNotes.size(); i++) {
-            sql.bindValue(":note", goodNotes[i]);
-            sql.exec();
-        }
-        sql.exec("delete from filter where lid not in (select lid from goodLids)" );
+        // Keep any note which has at least one of the tags
+        QStringList tagLids;
+        for (qint32 i=0; i<tags.size(); i++)
+            tagLids.append(QString::number(tags[i]));
+        NSqlQuery sql(db);
+        sql.prepare("select noteLid from NoteTags where tagLid in (" + tagLids.join(",") + ")");
+        keep(sql, true);
         sql.finish();
     }
 }
@@ -739,10 +1021,10 @@ void FilterEngine::filterTrash(FilterCriteria *criteria) {
     if (!criteria->isSet() || !criteria->isDeletedOnlySet()
             || (criteria->isDeletedOnlySet() && !criteria->getDeletedOnly()))
     {
-        NSqlQuery sql(global.db);
-        sql.prepare("Delete from filter where lid not in (select lid from DataStore where key=:type and data=1)");
+        NSqlQuery sql(db);
+        sql.prepare("select lid from DataStore where key=:type and data=1");
         sql.bindValue(":type", NOTE_ACTIVE);
-        sql.exec();
+        keep(sql, true);
         sql.finish();
         return;
     }
@@ -750,10 +1032,10 @@ void FilterEngine::filterTrash(FilterCriteria *criteria) {
         return;
 
     // Filter out the records
-    NSqlQuery sql(global.db);
-    sql.prepare("Delete from filter where lid not in (select lid from DataStore where key=:type and data=0)");
+    NSqlQuery sql(db);
+    sql.prepare("select lid from DataStore where key=:type and data=0");
     sql.bindValue(":type", NOTE_ACTIVE);
-    sql.exec();
+    keep(sql, true);
     sql.finish();
 }
 
@@ -768,6 +1050,10 @@ void FilterEngine::filterSearchString(FilterCriteria *criteria) {
     }
     QLOG_TRACE_IN();
 
+    // A materialized saved search has its results stored
+    if (!materializing && filterMaterialized(criteria->getSearchString()))
+        return;
+
     anyFlagSet = false;
     QString searchString = global.normalizeTermForSearchAndIndex(criteria->getSearchString());
 
@@ -780,10 +1066,229 @@ void FilterEngine::filterSearchString(FilterCriteria *criteria) {
     QLOG_DEBUG() << "Original String Search: " << searchString;
     splitSearchTerms(list, searchString);
 
+    // Collect the statements of the terms & run them as one
+    SearchQuery searchQuery;
+    searchQuery.parse(list, anyFlagSet);
+    activeQuery = &searchQuery;
     if (!anyFlagSet)
-        filterSearchStringAll(list);
+        filterSearchStringAll(searchQuery);
     else
-        filterSearchStringAny(list);
+        filterSearchStringAny(searchQuery);
+    activeQuery = nullptr;
+    runSearchQuery(searchQuery);
+}
+
+
+// Use the stored results of a materialized saved search.  They are
+// brought up to date first: only the notes changed since they were
+// stored are checked again.  If the search settings, a tag or a notebook
+// changed, too many notes changed, or the change log was compacted, the
+// query is run again in full.  The new results are stored by the
+// database writer, so any thread can use them.  Returns false if the
+// query isn't a materialized search.
+bool FilterEngine::filterMaterialized(QString searchString) {
+    // Checking a single note is cheaper than bringing the results up to date
+    if (singleLid >= 0)
+        return false;
+    MaterializedSearch store(db);
+    qint32 searchLid;
+    QString key;
+    qint64 sequence;
+    if (!store.find(searchString, searchLid, key, sequence))
+        return false;
+    QLOG_TRACE_IN();
+
+    // The day is part of the settings, as relative dates move on with it
+    QString currentKey = QString("%1 %2 %3 %4").arg(tagSelectionOr)
+            .arg(minimumWeight)
+            .arg(QDate::currentDate().toJulianDay())
+            .arg(searchString);
+    ChangeLog changeLog(db);
+    qint64 latest = changeLog.getHighestSequence();
+    QList<ChangeLogEntry> changes;
+    bool rebuild = key != currentKey || sequence < 0 ||
+            !changeLog.getChanges(changes, sequence, MATERIALIZED_SEARCH_MAX_CHANGES+1) ||
+            changes.size() > MATERIALIZED_SEARCH_MAX_CHANGES;
+
+    // Work out which notes changed
+    LidBitmap changed;
+    ResourceTable resourceTable(db);
+    for (int i=0; !rebuild && i<changes.size(); i++) {
+        switch (changes[i].type) {
+        case CHANGE_ENTITY_NOTE :
+            changed.add(changes[i].lid);
+            rebuild = changed.size() > MATERIALIZED_SEARCH_MAX_CHANGES;
+            break;
+        case CHANGE_ENTITY_RESOURCE : {
+            qint32 noteLid = resourceTable.getNoteLid(changes[i].lid);
+            if (noteLid > 0)
+                changed.add(noteLid);
+            rebuild = changed.size() > MATERIALIZED_SEARCH_MAX_CHANGES;
+            break;
+        }
+        case CHANGE_ENTITY_TAG :
+        case CHANGE_ENTITY_NOTEBOOK :
+        case CHANGE_ENTITY_LINKEDNOTEBOOK :
+        case CHANGE_ENTITY_SHAREDNOTEBOOK :
+            rebuild = true;
+            break;
+        default :
+            break;
+        }
+    }
+
+    FilterEngine engine(this);
+    engine.materializing = true;
+    LidBitmap lids;
+    if (rebuild) {
+        QLOG_DEBUG() << "Rebuilding materialized search " << searchLid;
+        engine.matchSearchString(searchString, lids, -1);
+        if (global.dbWriter != nullptr && !isCancelled()) {
+            global.dbWriter->enqueue([searchLid, currentKey, latest, lids](DatabaseConnection *db) {
+                MaterializedSearch store(db);
+                store.setResults(searchLid, currentKey, latest, lids);
+            });
+        }
+    } else {
+        store.getResults(searchLid, lids);
+        LidBitmap added, removed;
+        QList<qint32> changedLids = changed.toList();
+        for (int i=0; i<changedLids.size(); i++) {
+            LidBitmap match;
+            engine.matchSearchString(searchString, match, changedLids[i]);
+            if (match.contains(changedLids[i]))
+                added.add(changedLids[i]);
+            else
+                removed.add(changedLids[i]);
+        }
+        added -= lids;
+        removed &= lids;
+        lids |= added;
+        lids -= removed;
+        if (latest != sequence && global.dbWriter != nullptr && !isCancelled()) {
+            global.dbWriter->enqueue([searchLid, latest, added, removed](DatabaseConnection *db) {
+                MaterializedSearch store(db);
+                store.updateResults(searchLid, latest, added, removed);
+            });
+        }
+    }
+    resultLids &= lids;
+    return true;
+}
+
+
+// The notes a search string matches on its own, without the closed
+// notebook & pinned note rules of a full filter.  With lid >= 0 only
+// that note is checked.
+void FilterEngine::matchSearchString(QString searchString, LidBitmap &lids, qint32 lid) {
+    FilterCriteria criteria;
+    criteria.setSearchString(searchString);
+    singleLid = lid;
+    resultLids.clear();
+    relevance.clear();
+    NSqlQuery sql(db);
+    sql.prepare("select lid from NoteTable");
+    select(sql, resultLids, true);
+    sql.finish();
+    filterSearchString(&criteria);
+    singleLid = -1;
+    lids = resultLids;
+}
+
+
+// Run a compiled search string.  If the combined statement fails (a bad
+// FTS expression for example) the terms are run one at a time, so only
+// the term in error is ignored.  The relevance boosts run last, once the
+// matching notes are known.
+void FilterEngine::runSearchQuery(SearchQuery &searchQuery) {
+    NSqlQuery sql(db);
+
+    // Figures left by ANALYZE to estimate how many notes each term matches.
+    // Before the first ANALYZE the table doesn't exist & guesses are used.
+    sql.exec("select idx, stat from sqlite_stat1 where idx is not null");
+    while (sql.next())
+        searchQuery.statistics.add(sql.value(0).toString(), sql.value(1).toString());
+
+    if (searchQuery.compile()) {
+        LidBitmap lids;
+        sql.prepare(searchQuery.getSql());
+        QMapIterator<QString, QVariant> v(searchQuery.getValues());
+        while (v.hasNext()) {
+            v.next();
+            sql.bindValue(v.key(), v.value());
+        }
+        bool ok = select(sql, lids, false);
+        if (QsLogging::Logger::instance().loggingLevel() <= QsLogging::DebugLevel)
+            explainSearchQuery(searchQuery);
+
+        if (ok) {
+            resultLids &= lids;
+        } else if (!isCancelled()) {
+            QLOG_DEBUG() << "Combined search failed.  Running the terms one at a time.";
+            anyMatches.clear();
+            QList<SearchPredicate> plan = searchQuery.plan();
+            for (int i=0; i<plan.size(); i++) {
+                sql.prepare(plan[i].sql);
+                QMapIterator<QString, QVariant> v(plan[i].values);
+                while (v.hasNext()) {
+                    v.next();
+                    sql.bindValue(v.key(), v.value());
+                }
+                if (plan[i].type == SearchPredicate::Intersect)
+                    keep(sql);
+                else if (plan[i].type == SearchPredicate::Except)
+                    remove(sql);
+                else
+                    include(sql);
+            }
+            if (searchQuery.any)
+                resultLids &= anyMatches;
+        }
+    }
+
+    for (int i=0; i<searchQuery.boosts.size(); i++) {
+        sql.prepare(searchQuery.boosts[i].sql);
+        QMapIterator<QString, QVariant> v(searchQuery.boosts[i].values);
+        while (v.hasNext()) {
+            v.next();
+            sql.bindValue(v.key(), v.value());
+        }
+        if (searchQuery.boosts[i].type == SearchPredicate::Rank)
+            rank(sql);
+        else
+            boost(sql, searchQuery.boosts[i].boost);
+    }
+    sql.finish();
+}
+
+
+// Log the order the terms of a search run in, the statement & the plan
+// SQLite picked for it.
+void FilterEngine::explainSearchQuery(const SearchQuery &searchQuery) {
+    static const char *typeNames[] = { "intersect", "except", "union", "boost", "rank" };
+    QList<SearchPredicate> list = searchQuery.plan();
+    for (int i=0; i<list.size(); i++) {
+        QString term = list[i].term >= 0 && list[i].term < searchQuery.terms.size()
+                ? searchQuery.terms[list[i].term].text : QString();
+        QLOG_DEBUG() << "Search plan " << i << ": " << typeNames[list[i].type]
+                     << " cost=" << list[i].cost << " term=" << term;
+    }
+    QLOG_DEBUG() << "Search statement: " << searchQuery.getSql();
+
+    NSqlQuery sql(db);
+    sql.prepare("explain query plan " + searchQuery.getSql());
+    QMapIterator<QString, QVariant> i(searchQuery.getValues());
+    while (i.hasNext()) {
+        i.next();
+        sql.bindValue(i.key(), i.value());
+    }
+    if (sql.exec()) {
+        while (sql.next()) {
+            QLOG_DEBUG() << "Query plan: " << sql.value(0).toInt() << " " << sql.value(1).toInt()
+                         << " " << sql.value(3).toString();
+        }
+    }
+    sql.finish();
 }
 
 
@@ -844,118 +1349,142 @@ void FilterEngine::splitSearchTerms(QStringList &words, QString search) {
 }
 
 
+// Prepare a "like" search of the index for the patterns FTS can't do
+// (postfix, hyphen & underscore).  Resource hits count for their note.
+// Once the trigram index is complete it picks out the candidate rows, so
+// only those are compared against the pattern instead of every row.
+void FilterEngine::prepareContentLike(NSqlQuery &sql, QString pattern, bool escaped) {
+    QString match("content like :word");
+    if (escaped)
+        match = match + QString(" escape '/'");
+    bool trigrams = TrigramIndex::isReady();
+    if (trigrams)
+        match = QString("rowid in (select rowid from SearchTrigram where content like :trigrams) and ") + match;
+    sql.prepare("with hits(lid, weight) as (select lid, weight from SearchIndex where " + match + ") "
+                "select lid from hits where weight>=:weight union "
+                "select data from DataStore where key=:key and lid in (select lid from hits where weight>:weight2)");
+    sql.bindValue(":word", pattern);
+    // The trigram table has no escape.  An unescaped "_" matches more rows,
+    // which the pattern itself then drops.
+    if (trigrams)
+        sql.bindValue(":trigrams", QString(pattern).replace("/_", "_"));
+    sql.bindValue(":weight", minimumWeight);
+    sql.bindValue(":weight2", minimumWeight);
+    sql.bindValue(":key", RESOURCE_NOTE_LID);
+}
+
+
 // Filter based upon the words the user specified (as opposed to the notebook, tags ...)
 // this is for the "all" filter (the default), not the "any:"
-// "list" is list of words generated by tokenizing the search term
-void FilterEngine::filterSearchStringAll(QStringList list) {
+// "searchQuery" holds the terms parsed from the search string
+void FilterEngine::filterSearchStringAll(SearchQuery &searchQuery) {
     QLOG_TRACE_IN();
 
     // Filter out the records
-    NSqlQuery sql(global.db), sqlnegative(global.db);
+    NSqlQuery sql(db), sqlnegative(db);
 
+    // A note matches if its text or one of its resources does
     sql.prepare(
-        "Delete from filter where lid not in "
-            "(select lid from SearchIndex where weight>=:weight and content match :word)"
-            "and lid not in (select data from DataStore where key=:key and lid in "
-            "(select lid from SearchIndex where weight>=:weight2 and content match :word2))");
+        "select lid from SearchIndex where weight>=:weight and content match :word "
+            "union select data from DataStore where key=:key and lid in "
+            "(select lid from SearchIndex where weight>=:weight2 and content match :word2)");
     sqlnegative.prepare(
-        "Delete from filter where lid in "
-            "(select lid from SearchIndex where weight>=:weight and content match :word)"
-            " or lid in (select data from DataStore where key=:key and lid in "
-            "(select lid from SearchIndex where weight>=:weight2 and content match :word2))");
+        "select lid from SearchIndex where weight>=:weight and content match :word "
+            "union select data from DataStore where key=:key and lid in "
+            "(select lid from SearchIndex where weight>=:weight2 and content match :word2)");
 
-    sql.bindValue(":weight", global.getMinimumRecognitionWeight());
-    sql.bindValue(":weight2", global.getMinimumRecognitionWeight());
+    sql.bindValue(":weight", minimumWeight);
+    sql.bindValue(":weight2", minimumWeight);
     sql.bindValue(":key", RESOURCE_NOTE_LID);
 
-    sqlnegative.bindValue(":weight", global.getMinimumRecognitionWeight());
-    sqlnegative.bindValue(":weight2", global.getMinimumRecognitionWeight());
+    sqlnegative.bindValue(":weight", minimumWeight);
+    sqlnegative.bindValue(":weight2", minimumWeight);
     sqlnegative.bindValue(":key", RESOURCE_NOTE_LID);
 
-    for (qint32 i = 0; i < list.size(); i++) {
-        QString string = list[i];
-        string.remove(QChar('"'));
-
+    for (qint32 i = 0; i < searchQuery.terms.size(); i++) {
+        const SearchTerm &term = searchQuery.terms[i];
+        QString string = term.text;
         QString origString(string); // copy original unmodified value
+        searchQuery.setCurrentTerm(i);
 
-        // If we have a notebook search request
-        if (string.startsWith("notebook:", Qt::CaseInsensitive) ||
-            string.startsWith("-notebook:", Qt::CaseInsensitive)) {
+        switch (term.field) {
+        case SearchTerm::Notebook:
             filterSearchStringNotebookAll(string);
-        } else if (string.startsWith("stack:", Qt::CaseInsensitive) ||
-                   string.startsWith("-stack:", Qt::CaseInsensitive)) {
+            break;
+        case SearchTerm::Stack:
             filterStack(string);
-        } else if (string.startsWith("todo:", Qt::CaseInsensitive) ||
-                   string.startsWith("-todo:", Qt::CaseInsensitive)) {
+            break;
+        case SearchTerm::Todo:
             filterSearchStringTodoAll(string);
-        } else if (string.startsWith("reminderOrder:", Qt::CaseInsensitive) ||
-                   string.startsWith("-reminderOrder:", Qt::CaseInsensitive)) {
+            break;
+        case SearchTerm::ReminderOrder:
             filterSearchStringReminderOrderAll(string);
-        } else if (string.startsWith("reminderTime:", Qt::CaseInsensitive) ||
-                   string.startsWith("-reminderTime:", Qt::CaseInsensitive)) {
+            break;
+        case SearchTerm::ReminderTime:
             filterSearchStringReminderTimeAll(string);
-        } else if (string.startsWith("reminderDoneTime:", Qt::CaseInsensitive) ||
-                   string.startsWith("-reminderDoneTime:", Qt::CaseInsensitive)) {
+            break;
+        case SearchTerm::ReminderDoneTime:
             filterSearchStringReminderDoneTimeAll(string);
-        } else if (string.startsWith("tag:", Qt::CaseInsensitive) ||
-                   string.startsWith("-tag:", Qt::CaseInsensitive)) {
+            break;
+        case SearchTerm::Tag:
             filterSearchStringTagAll(string);
-        } else if (string.startsWith("intitle:", Qt::CaseInsensitive) ||
-                   string.startsWith("-intitle:", Qt::CaseInsensitive)) {
+            break;
+        case SearchTerm::Title:
             filterSearchStringIntitleAll(string);
-        } else if (string.startsWith("resource:", Qt::CaseInsensitive) ||
-                   string.startsWith("-resource:", Qt::CaseInsensitive)) {
+            break;
+        case SearchTerm::Resource:
             filterSearchStringResourceAll(string);
-        } else if (string.startsWith("longitude:", Qt::CaseInsensitive) ||
-                   string.startsWith("-longitude:", Qt::CaseInsensitive)) {
+            break;
+        case SearchTerm::Longitude:
             filterSearchStringCoordinatesAll(string, NOTE_ATTRIBUTE_LONGITUDE);
-        } else if (string.startsWith("latitude:", Qt::CaseInsensitive) ||
-                   string.startsWith("-latitude:", Qt::CaseInsensitive)) {
+            break;
+        case SearchTerm::Latitude:
             filterSearchStringCoordinatesAll(string, NOTE_ATTRIBUTE_LATITUDE);
-        } else if (string.startsWith("altitude:", Qt::CaseInsensitive) ||
-                   string.startsWith("-altitude:", Qt::CaseInsensitive)) {
+            break;
+        case SearchTerm::Altitude:
             filterSearchStringCoordinatesAll(string, NOTE_ATTRIBUTE_ALTITUDE);
-        } else if (string.startsWith("author:", Qt::CaseInsensitive) ||
-                   string.startsWith("-author:", Qt::CaseInsensitive)) {
+            break;
+        case SearchTerm::Near:
+            filterSearchStringLocationAll(string, true);
+            break;
+        case SearchTerm::Area:
+            filterSearchStringLocationAll(string, false);
+            break;
+        case SearchTerm::Author:
             filterSearchStringAuthorAll(string);
-        } else if (string.startsWith("source:", Qt::CaseInsensitive) ||
-                   string.startsWith("-source:", Qt::CaseInsensitive)) {
+            break;
+        case SearchTerm::Source:
             filterSearchStringSourceAll(string);
-        } else if (string.startsWith("sourceapplication:", Qt::CaseInsensitive) ||
-                   string.startsWith("-sourceapplication:", Qt::CaseInsensitive)) {
+            break;
+        case SearchTerm::SourceApplication:
             filterSearchStringSourceApplicationAll(string);
-        } else if (string.startsWith("contentclass:", Qt::CaseInsensitive) ||
-                   string.startsWith("-contentclass:", Qt::CaseInsensitive)) {
+            break;
+        case SearchTerm::ContentClass:
+        case SearchTerm::PlaceName:
             filterSearchStringContentClassAll(string);
-        } else if (string.startsWith("recotype:", Qt::CaseInsensitive) ||
-                   string.startsWith("-recotype:", Qt::CaseInsensitive)) {
+            break;
+        case SearchTerm::RecognitionType:
             filterSearchStringResourceRecognitionTypeAll(string);
-        } else if (string.startsWith("placename:", Qt::CaseInsensitive) ||
-                   string.startsWith("-placename:", Qt::CaseInsensitive)) {
-            filterSearchStringContentClassAll(string);
-        } else if (string.startsWith("created:", Qt::CaseInsensitive) ||
-                   string.startsWith("-created:", Qt::CaseInsensitive) ||
-                   string.startsWith("updated:", Qt::CaseInsensitive) ||
-                   string.startsWith("-updated:", Qt::CaseInsensitive) ||
-                   string.startsWith("subjectdate:", Qt::CaseInsensitive) ||
-                   string.startsWith("-subjectdate:", Qt::CaseInsensitive)) {
+            break;
+        case SearchTerm::Date:
             filterSearchStringDateAll(string);
-        } else if (string.startsWith("-*")) {   // Negative postfix search.  FTS doesn't do this.
+            break;
+        default:
+            break;
+        }
+
+        // Plain words go to the full text index or a "like" search
+        if (term.field != SearchTerm::Content && term.field != SearchTerm::ContentPattern)
+            continue;
+
+        if (string.startsWith("-*")) {   // Negative postfix search.  FTS doesn't do this.
             string = string.mid(1);
             string = string.replace("*", "%");
             if (!string.endsWith("%"))
                 string = string + QString("%");
-            NSqlQuery prefix(global.db);
-            prefix.prepare(
-                "Delete from filter where lid in (select lid from SearchIndex where weight>=:weight "
-                    "and content like :word) or lid in (select data from DataStore where lid in "
-                    "(select lid from SearchIndex where weight>:weight2 and content like :word2))");
-
-            prefix.bindValue(":weight", global.getMinimumRecognitionWeight());
-            prefix.bindValue(":weight2", global.getMinimumRecognitionWeight());
-            prefix.bindValue(":word", string);
-            prefix.bindValue(":word2", string);
-            prefix.exec();
+            NSqlQuery prefix(db);
+            prepareContentLike(prefix, string, false);
+            remove(prefix);
         } else if (string.indexOf("_") >= 0) {    // underscore search.  FTS doesn't do this.
             string = string.replace("_", "/_");
             string = string.replace("*", "%");
@@ -963,87 +1492,53 @@ void FilterEngine::filterSearchStringAll(QStringList list) {
                 string = string + QString("%");
             if (!string.startsWith("%"))
                 string = QString("%") + string;
-            NSqlQuery prefix(global.db);
-            prefix.prepare(
-                "Delete from filter where lid not in (select lid from SearchIndex where weight>=:weight "
-                    "and content like :word escape '/') and "
-                    "lid not in (select data from DataStore where key=:key and lid in (select lid from SearchIndex "
-                    "where weight>:weight2 and content like :word2 escape '/'))");
-
-            prefix.bindValue(":weight", global.getMinimumRecognitionWeight());
-            prefix.bindValue(":weight2", global.getMinimumRecognitionWeight());
-            prefix.bindValue(":word", string);
-            prefix.bindValue(":word2", string);
-            prefix.bindValue(":key", RESOURCE_NOTE_LID);
-            prefix.exec();
+            NSqlQuery prefix(db);
+            prepareContentLike(prefix, string, true);
+            keep(prefix);
         } else if (string.indexOf("-") >= 0) {    // Hyphen search.  FTS doesn't do this.
             string = string.replace("*", "%");
             if (!string.endsWith("%"))
                 string = string + QString("%");
             if (!string.startsWith("%"))
                 string = QString("%") + string;
-            NSqlQuery prefix(global.db);
-            prefix.prepare(
-                "Delete from filter where lid not in (select lid from SearchIndex where weight>=:weight and content "
-                    "like :word) and lid not in (select data from DataStore where key=:key and lid in (select lid "
-                    "from SearchIndex where weight>:weight2 and content like :word2))");
-
-            prefix.bindValue(":weight", global.getMinimumRecognitionWeight());
-            prefix.bindValue(":weight2", global.getMinimumRecognitionWeight());
-            prefix.bindValue(":word", string);
-            prefix.bindValue(":word2", string);
-            prefix.bindValue(":key", RESOURCE_NOTE_LID);
-            prefix.exec();
+            NSqlQuery prefix(db);
+            prepareContentLike(prefix, string, false);
+            keep(prefix);
         } else if (string.startsWith("*")) {    // Postfix search.  FTS doesn't do this.
             string = string.replace("*", "%");
             if (!string.endsWith("%"))
                 string = string + QString("%");
-            NSqlQuery prefix(global.db);
-            prefix.prepare(
-                "Delete from filter where lid not in (select lid from SearchIndex where weight>=:weight and content "
-                    "like :word) and lid not in (select data from DataStore where key=:key and lid in (select lid "
-                    "from SearchIndex where weight>:weight2 and content like :word2))");
-
-            prefix.bindValue(":weight", global.getMinimumRecognitionWeight());
-            prefix.bindValue(":weight2", global.getMinimumRecognitionWeight());
-            prefix.bindValue(":word", string);
-            prefix.bindValue(":word2", string);
-            prefix.bindValue(":key", RESOURCE_NOTE_LID);
-            prefix.exec();
+            NSqlQuery prefix(db);
+            prepareContentLike(prefix, string, false);
+            keep(prefix);
         } else {
             // Filter not found.  Use FTS search (full text search)
 
             QLOG_TRACE() << "Using FTS search";
             if (string.startsWith("-")) {
-                string = string.remove(0, 1).trimmed();
-                if (!string.endsWith("*"))
-                    string = string + QString("*");
-                if (string.contains(" "))
-                    string = "\"" + string + "\"";
+                string = FullTextIndex::matchQuery(string.remove(0, 1).trimmed(), true);
                 sqlnegative.bindValue(":key", RESOURCE_NOTE_LID);
                 sqlnegative.bindValue(":word", string);
                 sqlnegative.bindValue(":word2", string);
-                sqlnegative.exec();
+                remove(sqlnegative);
             } else {
-                if (!string.endsWith("*"))
-                    string = string + QString("*");
-                if (string.contains(" "))
-                    string = "\"" + string + "\"";
+                string = FullTextIndex::matchQuery(string, true);
                 sql.bindValue(":key", RESOURCE_NOTE_LID);
                 sql.bindValue(":word", string);
                 sql.bindValue(":word2", string);
-                sql.exec();
+                keep(sql);
+                rankContent(string);
             }
 
 
             // update relevance by +1 where search term is found in title
-            NSqlQuery relUpdtSql(global.db);
-            setupTitleSelectionQuery(relUpdtSql, origString, 1, true);
-            relUpdtSql.exec();
+            NSqlQuery relUpdtSql(db);
+            setupTitleSelectionQuery(relUpdtSql, origString);
+            boost(relUpdtSql, 1);
 
             // update relevance by +1 where search term is found as tag value
-            setupTagSelectionQuery(relUpdtSql, origString, 1, true);
-            relUpdtSql.exec();
+            setupTagSelectionQuery(relUpdtSql, origString, true);
+            boost(relUpdtSql, 1);
 
             relUpdtSql.finish();
         }
@@ -1052,8 +1547,9 @@ void FilterEngine::filterSearchStringAll(QStringList list) {
     // after we are finished, check for "important" notes (marked by tag important*)
     // update relevance by +1 where search term is found as tag value
     // here we give boost +3
-    setupTagSelectionQuery(sql, QString("important"), 3, true);
-    sql.exec();
+    searchQuery.setCurrentTerm(-1);
+    setupTagSelectionQuery(sql, QString("important"), true);
+    boost(sql, 3);
 
 
     sql.finish();
@@ -1065,17 +1561,18 @@ void FilterEngine::filterSearchStringAll(QStringList list) {
 void FilterEngine::filterSearchStringIntitleAll(QString searchStr) {
     QLOG_TRACE_IN();
 
-    NSqlQuery sql(global.db);
+    NSqlQuery sql(db);
     if (!searchStr.startsWith("-")) {
         // in" title
         searchStr.remove(0, 8);    // remove 8 chars of "intitle:"
-        setupTitleSelectionQuery(sql, searchStr, 0, false);
+        setupTitleSelectionQuery(sql, searchStr);
+        keep(sql);
     } else {
         // NOT "in" title
         searchStr.remove(0, 9); // remove 9 chars of "!intitle:"
-        setupTitleSelectionQuery(sql, searchStr, 0, true);
+        setupTitleSelectionQuery(sql, searchStr);
+        remove(sql);
     }
-    sql.exec();
     sql.finish();
 }
 
@@ -1095,26 +1592,99 @@ void FilterEngine::filterSearchStringCoordinatesAll(QString string, int key) {
         if (string == "")
             string = "0";
         // Filter out the records
-        NSqlQuery sql(global.db);
-        sql.prepare("Delete from filter where lid not in (select lid from datastore where key=:key and data >= :data)");
+        NSqlQuery sql(db);
+        sql.prepare("select lid from datastore where key=:key and data >= :data");
         sql.bindValue(":key", key);
         sql.bindValue(":data", string.toDouble());
-        sql.exec();
+        keep(sql);
         sql.finish();
     } else {
         if (string == "")
             string = "0";
         // Filter out the records
-        NSqlQuery sql(global.db);
-        sql.prepare("Delete from filter where lid in (select lid from datastore where key=:key and data <= :data)");
+        NSqlQuery sql(db);
+        sql.prepare("select lid from datastore where key=:key and data <= :data");
         sql.bindValue(":key", key);
         sql.bindValue(":data", string.toDouble());
-        sql.exec();
+        remove(sql);
         sql.finish();
     }
 }
 
 
+// Prepare the statement finding the notes near a point ("near:" terms,
+// latitude,longitude,km) or inside a box ("box:" terms, the latitude &
+// longitude of two opposite corners).  The NoteLocations R*Tree returns
+// the notes in the bounding box, their Notes rows are then checked
+// exactly.  Distances are worked out on a flat projection around the
+// point, which is close enough for the radius of a search.  With
+// "outside" set the statement returns every other note instead.
+// Returns false if the value can't be read.
+bool FilterEngine::prepareLocation(NSqlQuery &sql, QString value, bool near, bool outside) {
+    SearchArea area;
+    if (!area.parse(value, near))
+        return false;
+
+    QString candidates;
+    if (RowStore::hasLocationIndex())
+        candidates = "NoteLocations l join Notes n on n.lid=l.lid where l.minLatitude<=:north and l.maxLatitude>=:south "
+                     "and l.minLongitude<=:east and l.maxLongitude>=:west";
+    else
+        candidates = "Notes n where n.latitude<=:north and n.latitude>=:south "
+                     "and n.longitude<=:east and n.longitude>=:west";
+
+    QString select;
+    if (near)
+        select = "select lid from (select n.lid, (n.latitude-:latitude)*:latitudeKm as y, "
+                 "min(abs(n.longitude-:longitude), 360-abs(n.longitude-:longitude2))*:longitudeKm as x "
+                 "from " + candidates + ") where x*x+y*y<=:radius";
+    else
+        select = "select n.lid from " + candidates + " and n.latitude>=:south2 and n.latitude<=:north2 "
+                 "and n.longitude>=:west2 and n.longitude<=:east2";
+    if (outside)
+        select = "select lid from Notes where lid not in (" + select + ")";
+    sql.prepare(select);
+
+    if (near) {
+        sql.bindValue(":latitude", area.latitude);
+        sql.bindValue(":latitudeKm", KM_PER_DEGREE_LATITUDE);
+        sql.bindValue(":longitude", area.longitude);
+        sql.bindValue(":longitude2", area.longitude);
+        sql.bindValue(":longitudeKm", area.longitudeKm);
+        sql.bindValue(":radius", area.km * area.km);
+    } else {
+        sql.bindValue(":south2", area.south);
+        sql.bindValue(":north2", area.north);
+        sql.bindValue(":west2", area.west);
+        sql.bindValue(":east2", area.east);
+    }
+    sql.bindValue(":south", area.south);
+    sql.bindValue(":north", area.north);
+    sql.bindValue(":west", area.west);
+    sql.bindValue(":east", area.east);
+    return true;
+}
+
+
+// filter based upon the note location ("near:" or "box:").  This is for the
+// "all" filter and not the "any".
+void FilterEngine::filterSearchStringLocationAll(QString string, bool near) {
+    QLOG_TRACE_IN();
+    bool negative = string.startsWith("-");
+    int separator = string.indexOf(":")+1;
+    NSqlQuery sql(db);
+    if (!prepareLocation(sql, string.mid(separator), near, false)) {
+        QLOG_WARN() << "Invalid location search: " << string;
+        return;
+    }
+    if (negative)
+        remove(sql);
+    else
+        keep(sql);
+    sql.finish();
+}
+
+
 // filter based upon the note author the user specified.  This is for the "all"
 // filter and not the "any".
 void FilterEngine::filterSearchStringAuthorAll(QString string) {
@@ -1128,29 +1698,29 @@ void FilterEngine::filterSearchStringAuthorAll(QString string) {
         if (string == "")
             string = "*";
         // Filter out the records
-        NSqlQuery sql(global.db);
+        NSqlQuery sql(db);
         if (string.contains("*")) {
             string = string.replace("*", "%");
-            sql.prepare("Delete from filter where lid in (select lid from datastore where key=:key and data like :data)");
+            sql.prepare("select lid from datastore where key=:key and data like :data");
         } else
-            sql.prepare("Delete from filter where lid in (select lid from datastore where key=:key and data=:data)");
+            sql.prepare("select lid from datastore where key=:key and data=:data");
         sql.bindValue(":key", NOTE_ATTRIBUTE_AUTHOR);
         sql.bindValue(":data", string);
-        sql.exec();
+        remove(sql);
         sql.finish();
     } else {
         if (string == "")
             string = "*";
         // Filter out the records
-        NSqlQuery sql(global.db);
+        NSqlQuery sql(db);
         if (string.contains("*")) {
             string = string.replace("*", "%");
-            sql.prepare("Delete from filter where lid not in (select lid from datastore where key=:key and data like :data)");
+            sql.prepare("select lid from datastore where key=:key and data like :data");
         } else
-            sql.prepare("Delete from filter where lid not in (select lid from datastore where key=:key and data=:data)");
+            sql.prepare("select lid from datastore where key=:key and data=:data");
         sql.bindValue(":key", NOTE_ATTRIBUTE_AUTHOR);
         sql.bindValue(":data", string.toDouble());
-        sql.exec();
+        keep(sql);
         sql.finish();
     }
 }
@@ -1171,29 +1741,29 @@ void FilterEngine::filterSearchStringSourceAll(QString string) {
         if (string == "")
             string = "*";
         // Filter out the records
-        NSqlQuery sql(global.db);
+        NSqlQuery sql(db);
         if (string.contains("*")) {
             string = string.replace("*", "%");
-            sql.prepare("Delete from filter where lid in (select lid from datastore where key=:key and data like :data)");
+            sql.prepare("select lid from datastore where key=:key and data like :data");
         } else
-            sql.prepare("Delete from filter where lid in (select lid from datastore where key=:key and data=:data)");
+            sql.prepare("select lid from datastore where key=:key and data=:data");
         sql.bindValue(":key", NOTE_ATTRIBUTE_SOURCE);
         sql.bindValue(":data", string);
-        sql.exec();
+        remove(sql);
         sql.finish();
     } else {
         if (string == "")
             string = "*";
         // Filter out the records
-        NSqlQuery sql(global.db);
+        NSqlQuery sql(db);
         if (string.contains("*")) {
             string = string.replace("*", "%");
-            sql.prepare("Delete from filter where lid not in (select lid from datastore where key=:key and data like :data)");
+            sql.prepare("select lid from datastore where key=:key and data like :data");
         } else
-            sql.prepare("Delete from filter where lid not in (select lid from datastore where key=:key and data=:data)");
+            sql.prepare("select lid from datastore where key=:key and data=:data");
         sql.bindValue(":key", NOTE_ATTRIBUTE_SOURCE);
         sql.bindValue(":data", string.toDouble());
-        sql.exec();
+        keep(sql);
         sql.finish();
     }
 }
@@ -1214,29 +1784,29 @@ void FilterEngine::filterSearchStringContentClassAll(QString string) {
         if (string == "")
             string = "*";
         // Filter out the records
-        NSqlQuery sql(global.db);
+        NSqlQuery sql(db);
         if (string.contains("*")) {
             string = string.replace("*", "%");
-            sql.prepare("Delete from filter where lid in (select lid from datastore where key=:key and data like :data)");
+            sql.prepare("select lid from datastore where key=:key and data like :data");
         } else
-            sql.prepare("Delete from filter where lid in (select lid from datastore where key=:key and data=:data)");
+            sql.prepare("select lid from datastore where key=:key and data=:data");
         sql.bindValue(":key", NOTE_ATTRIBUTE_CONTENT_CLASS);
         sql.bindValue(":data", string);
-        sql.exec();
+        remove(sql);
         sql.finish();
     } else {
         if (string == "")
             string = "*";
         // Filter out the records
-        NSqlQuery sql(global.db);
+        NSqlQuery sql(db);
         if (string.contains("*")) {
             string = string.replace("*", "%");
-            sql.prepare("Delete from filter where lid not in (select lid from datastore where key=:key and data like :data)");
+            sql.prepare("select lid from datastore where key=:key and data like :data");
         } else
-            sql.prepare("Delete from filter where lid not in (select lid from datastore where key=:key and data=:data)");
+            sql.prepare("select lid from datastore where key=:key and data=:data");
         sql.bindValue(":key", NOTE_ATTRIBUTE_CONTENT_CLASS);
         sql.bindValue(":data", string.toDouble());
-        sql.exec();
+        keep(sql);
         sql.finish();
     }
 }
@@ -1255,29 +1825,29 @@ void FilterEngine::filterSearchStringPlaceNameAll(QString string) {
         if (string == "")
             string = "*";
         // Filter out the records
-        NSqlQuery sql(global.db);
+        NSqlQuery sql(db);
         if (string.contains("*")) {
             string = string.replace("*", "%");
-            sql.prepare("Delete from filter where lid in (select lid from datastore where key=:key and data like :data)");
+            sql.prepare("select lid from datastore where key=:key and data like :data");
         } else
-            sql.prepare("Delete from filter where lid in (select lid from datastore where key=:key and data=:data)");
+            sql.prepare("select lid from datastore where key=:key and data=:data");
         sql.bindValue(":key", NOTE_ATTRIBUTE_PLACE_NAME);
         sql.bindValue(":data", string);
-        sql.exec();
+        remove(sql);
         sql.finish();
     } else {
         if (string == "")
             string = "*";
         // Filter out the records
-        NSqlQuery sql(global.db);
+        NSqlQuery sql(db);
         if (string.contains("*")) {
             string = string.replace("*", "%");
-            sql.prepare("Delete from filter where lid not in (select lid from datastore where key=:key and data like :data)");
+            sql.prepare("select lid from datastore where key=:key and data like :data");
         } else
-            sql.prepare("Delete from filter where lid not in (select lid from datastore where key=:key and data=:data)");
+            sql.prepare("select lid from datastore where key=:key and data=:data");
         sql.bindValue(":key", NOTE_ATTRIBUTE_PLACE_NAME);
         sql.bindValue(":data", string.toDouble());
-        sql.exec();
+        keep(sql);
         sql.finish();
     }
 }
@@ -1298,29 +1868,29 @@ void FilterEngine::filterSearchStringSourceApplicationAll(QString string) {
         if (string == "")
             string = "*";
         // Filter out the records
-        NSqlQuery sql(global.db);
+        NSqlQuery sql(db);
         if (string.contains("*")) {
             string = string.replace("*", "%");
-            sql.prepare("Delete from filter where lid in (select lid from datastore where key=:key and data like :data)");
+            sql.prepare("select lid from datastore where key=:key and data like :data");
         } else
-            sql.prepare("Delete from filter where lid in (select lid from datastore where key=:key and data=:data)");
+            sql.prepare("select lid from datastore where key=:key and data=:data");
         sql.bindValue(":key", NOTE_ATTRIBUTE_SOURCE_APPLICATION);
         sql.bindValue(":data", string);
-        sql.exec();
+        remove(sql);
         sql.finish();
     } else {
         if (string == "")
             string = "*";
         // Filter out the records
-        NSqlQuery sql(global.db);
+        NSqlQuery sql(db);
         if (string.contains("*")) {
             string = string.replace("*", "%");
-            sql.prepare("Delete from filter where lid not in (select lid from datastore where key=:key and data like :data)");
+            sql.prepare("select lid from datastore where key=:key and data like :data");
         } else
-            sql.prepare("Delete from filter where lid not in (select lid from datastore where key=:key and data=:data)");
+            sql.prepare("select lid from datastore where key=:key and data=:data");
         sql.bindValue(":key", NOTE_ATTRIBUTE_SOURCE_APPLICATION);
         sql.bindValue(":data", string.toDouble());
-        sql.exec();
+        keep(sql);
         sql.finish();
     }
 }
@@ -1338,32 +1908,32 @@ void FilterEngine::filterSearchStringResourceAll(QString string) {
         if (string == "")
             string = "*";
         // Filter out the records
-        NSqlQuery sql(global.db);
+        NSqlQuery sql(db);
         string = string.replace("*", "%");
         if (not string.contains("%"))
-            sql.prepare("Delete from filter where lid not in (select data from datastore where key=:notelidkey and lid in (select lid from DataStore where key=:mimekey and data=:data))");
+            sql.prepare("select data from datastore where key=:notelidkey and lid in (select lid from DataStore where key=:mimekey and data=:data)");
         else
-            sql.prepare("Delete from filter where lid not in (select data from datastore where key=:notelidkey and lid in (select lid from DataStore where key=:mimekey and data like :data))");
+            sql.prepare("select data from datastore where key=:notelidkey and lid in (select lid from DataStore where key=:mimekey and data like :data)");
         sql.bindValue(":notelidkey", RESOURCE_NOTE_LID);
         sql.bindValue(":mimekey", RESOURCE_MIME);
         sql.bindValue(":data", string);
-        sql.exec();
+        keep(sql);
         sql.finish();
     } else {
         string.remove(0,10);
         if (string == "")
             string = "*";
         // Filter out the records
-        NSqlQuery sql(global.db);
+        NSqlQuery sql(db);
         string = string.replace("*", "%");
         if (not string.contains("%"))
-            sql.prepare("Delete from filter where lid in (select data from datastore where key=:notelidkey and lid in (select lid from DataStore where key=:mimekey and data like :data))");
+            sql.prepare("select data from datastore where key=:notelidkey and lid in (select lid from DataStore where key=:mimekey and data like :data)");
         else
-            sql.prepare("Delete from filter where lid in (select data from datastore where key=:notelidkey and lid in (select lid from DataStore where key=:mimekey and data=:data))");
+            sql.prepare("select data from datastore where key=:notelidkey and lid in (select lid from DataStore where key=:mimekey and data=:data)");
         sql.bindValue(":notelidkey", RESOURCE_NOTE_LID);
         sql.bindValue(":mimekey", RESOURCE_MIME);
         sql.bindValue(":data", string);
-        sql.exec();
+        remove(sql);
         sql.finish();
     }
 }
@@ -1379,32 +1949,32 @@ void FilterEngine::filterSearchStringResourceRecognitionTypeAll(QString string)
         if (string == "")
             string = "*";
         // Filter out the records
-        NSqlQuery sql(global.db);
+        NSqlQuery sql(db);
         string = string.replace("*", "%");
         if (not string.contains("%"))
-            sql.prepare("Delete from filter where lid not in (select data from datastore where key=:notelidkey and lid in (select lid from DataStore where key=:mimekey and data=:data))");
+            sql.prepare("select data from datastore where key=:notelidkey and lid in (select lid from DataStore where key=:mimekey and data=:data)");
         else
-            sql.prepare("Delete from filter where lid not in (select data from datastore where key=:notelidkey and lid in (select lid from DataStore where key=:mimekey and data like :data))");
+            sql.prepare("select data from datastore where key=:notelidkey and lid in (select lid from DataStore where key=:mimekey and data like :data)");
         sql.bindValue(":notelidkey", RESOURCE_NOTE_LID);
         sql.bindValue(":mimekey", RESOURCE_RECO_TYPE);
         sql.bindValue(":data", string);
-        sql.exec();
+        keep(sql);
         sql.finish();
     } else {
         string.remove(0,10);
         if (string == "")
             string = "*";
         // Filter out the records
-        NSqlQuery sql(global.db);
+        NSqlQuery sql(db);
         string = string.replace("*", "%");
         if (not string.contains("%"))
-            sql.prepare("Delete from filter where lid in (select data from datastore where key=:notelidkey and lid in (select lid from DataStore where key=:mimekey and data like :data))");
+            sql.prepare("select data from datastore where key=:notelidkey and lid in (select lid from DataStore where key=:mimekey and data like :data)");
         else
-            sql.prepare("Delete from filter where lid in (select data from datastore where key=:notelidkey and lid in (select lid from DataStore where key=:mimekey and data=:data))");
+            sql.prepare("select data from datastore where key=:notelidkey and lid in (select lid from DataStore where key=:mimekey and data=:data)");
         sql.bindValue(":notelidkey", RESOURCE_NOTE_LID);
         sql.bindValue(":mimekey", RESOURCE_RECO_TYPE);
         sql.bindValue(":data", string);
-        sql.exec();
+        remove(sql);
         sql.finish();
     }
 }
@@ -1416,7 +1986,7 @@ void FilterEngine::filterSearchStringResourceRecognitionTypeAll(QString string)
 // filter and not the "any".
 void FilterEngine::filterSearchStringTagAll(QString string) {
     QLOG_TRACE_IN();
-    NSqlQuery sql(global.db);
+    NSqlQuery sql(db);
 
     if (!string.startsWith("-")) {
         // positive search
@@ -1425,7 +1995,8 @@ void FilterEngine::filterSearchStringTagAll(QString string) {
             string = "*";
 
         // Filter out the records
-        setupTagSelectionQuery(sql, string, 0, false);
+        setupTagSelectionQuery(sql, string, false);
+        keep(sql);
     } else {
         // negative search
         string.remove(0, 5);
@@ -1433,9 +2004,9 @@ void FilterEngine::filterSearchStringTagAll(QString string) {
             string = "*";
 
         // Filter out the records
-        setupTagSelectionQuery(sql, string, 0, true);
+        setupTagSelectionQuery(sql, string, false);
+        remove(sql);
     }
-    sql.exec();
     sql.finish();
 }
 
@@ -1450,16 +2021,16 @@ void FilterEngine::filterSearchStringNotebookAll(QString string) {
         if (string == "")
             string = "*";
         // Filter out the records
-        NSqlQuery notebookSql(global.db);
+        NSqlQuery notebookSql(db);
         if (not string.contains("*"))
-            notebookSql.prepare("Delete from filter where lid not in (select lid from NoteTable where notebook = :notebook)");
+            notebookSql.prepare("select lid from NoteTable where notebook = :notebook");
         else {
-            notebookSql.prepare("Delete from filter where lid not in (select lid from NoteTable where notebook like :notebook)");
+            notebookSql.prepare("select lid from NoteTable where notebook like :notebook");
             string.replace("*", "%");
         }
 //        notebookSql.bindValue(":type", NOTE_NOTEBOOK_LID);
         notebookSql.bindValue(":notebook", string);
-        notebookSql.exec();
+        keep(notebookSql);
         notebookSql.finish();
 
     } else {
@@ -1467,16 +2038,16 @@ void FilterEngine::filterSearchStringNotebookAll(QString string) {
         if (string == "")
             string = "*";
         // Filter out the records
-        NSqlQuery notebookSql(global.db);
+        NSqlQuery notebookSql(db);
         if (not string.contains("*"))
-            notebookSql.prepare("Delete from filter where lid not in (select lid from NoteTable where notebook <> :notebook)");
+            notebookSql.prepare("select lid from NoteTable where notebook <> :notebook");
         else {
-            notebookSql.prepare("Delete from filter where lid not in (select lid from NoteTable where notebook not like :notebook)");
+            notebookSql.prepare("select lid from NoteTable where notebook not like :notebook");
             string.replace("*", "%");
         }
         //notebookSql.bindValue(":type", NOTE_NOTEBOOK);
         notebookSql.bindValue(":notebook", string);
-        notebookSql.exec();
+        keep(notebookSql);
         notebookSql.finish();
     }
 }
@@ -1492,42 +2063,42 @@ void FilterEngine::filterSearchStringTodoAll(QString string) {
         if (string == "")
             string = "*";
         // Filter out the records
-        NSqlQuery sql(global.db);
+        NSqlQuery sql(db);
         if (string.startsWith("*")) {
-            sql.prepare("Delete from filter where lid not in (select lid from DataStore where key=:key1 or key=:key2)");
+            sql.prepare("select lid from DataStore where key=:key1 or key=:key2");
             sql.bindValue(":key1", NOTE_HAS_TODO_COMPLETED);
             sql.bindValue(":key2", NOTE_HAS_TODO_UNCOMPLETED);
         }
         else if (string.startsWith("true", Qt::CaseInsensitive)) {
-            sql.prepare("Delete from filter where lid not in (select lid from DataStore where key=:key1)");
+            sql.prepare("select lid from DataStore where key=:key1");
             sql.bindValue(":key1", NOTE_HAS_TODO_COMPLETED);
         }
         else if (string.startsWith("false", Qt::CaseInsensitive)) {
-            sql.prepare("Delete from filter where lid not in (select lid from DataStore where key=:key1)");
+            sql.prepare("select lid from DataStore where key=:key1");
             sql.bindValue(":key1", NOTE_HAS_TODO_UNCOMPLETED);
         }
-        sql.exec();
+        keep(sql);
         sql.finish();
     } else {
         string.remove(0,6);
         if (string == "")
             string = "*";
         // Filter out the records
-        NSqlQuery sql(global.db);
+        NSqlQuery sql(db);
         if (string.startsWith("*")) {
-            sql.prepare("Delete from filter where lid in (select lid from DataStore where key=:key1 or key=:key2)");
+            sql.prepare("select lid from DataStore where key=:key1 or key=:key2");
             sql.bindValue(":key1", NOTE_HAS_TODO_COMPLETED);
             sql.bindValue(":key2", NOTE_HAS_TODO_UNCOMPLETED);
         }
         else if (string.startsWith("true", Qt::CaseInsensitive)) {
-            sql.prepare("Delete from filter where lid in (select lid from DataStore where key=:key1)");
+            sql.prepare("select lid from DataStore where key=:key1");
             sql.bindValue(":key1", NOTE_HAS_TODO_COMPLETED);
         }
         else if (string.startsWith("false", Qt::CaseInsensitive)) {
-            sql.prepare("Delete from filter where lid in (select lid from DataStore where key=:key1)");
+            sql.prepare("select lid from DataStore where key=:key1");
             sql.bindValue(":key1", NOTE_HAS_TODO_UNCOMPLETED);
         }
-        sql.exec();
+        remove(sql);
         sql.finish();
     }
 }
@@ -1549,34 +2120,34 @@ void FilterEngine::filterSearchStringReminderOrderAll(QString string) {
         if (string == "")
             string = "*";
         // Filter out the records
-        NSqlQuery sql(global.db);
+        NSqlQuery sql(db);
         if (string.startsWith("*")) {
-            sql.prepare("Delete from filter where lid not in (select lid from DataStore where key=:key1)");
+            sql.prepare("select lid from DataStore where key=:key1");
             sql.bindValue(":key1", NOTE_ATTRIBUTE_REMINDER_ORDER);
         } else {
             int data= string.toInt();
-            sql.prepare("Delete from filter where lid not in (select lid from DataStore where key=:key1 and data=:data)");
+            sql.prepare("select lid from DataStore where key=:key1 and data=:data");
             sql.bindValue(":key1", NOTE_ATTRIBUTE_REMINDER_ORDER);
             sql.bindValue(":data", data);
         }
-        sql.exec();
+        keep(sql);
         sql.finish();
     } else {
         string.remove(0,15);
         if (string == "")
             string = "*";
         // Filter out the records
-        NSqlQuery sql(global.db);
+        NSqlQuery sql(db);
         if (string.startsWith("*")) {
-            sql.prepare("Delete from filter where lid in (select lid from DataStore where key=:key1)");
+            sql.prepare("select lid from DataStore where key=:key1");
             sql.bindValue(":key1", NOTE_ATTRIBUTE_REMINDER_ORDER);
         } else {
-            sql.prepare("Delete from filter where lid in (select lid from DataStore where key=:key1 and data=:data)");
+            sql.prepare("select lid from DataStore where key=:key1 and data=:data");
             int data = string.toInt();
             sql.bindValue(":key1", NOTE_ATTRIBUTE_REMINDER_ORDER);
             sql.bindValue(":data", data);
         }
-        sql.exec();
+        remove(sql);
         sql.finish();
     }
 }
@@ -1590,37 +2161,41 @@ void FilterEngine::filterSearchStringDateAll(QString string) {
     int separator = string.indexOf(":")+1;
     QString tempString = string.mid(separator);
     QDateTime dt = calculateDateTime(tempString);
-    NSqlQuery sql(global.db);
+    NSqlQuery sql(db);
     int key=0;
+    bool negative = string.startsWith("-");
 
     if (string.startsWith("created:", Qt::CaseInsensitive)) {
-        sql.prepare("Delete from filter where lid not in (select lid from DataStore where key=:key and datetime(data/1000)>=(datetime(:data/1000)))");;
+        sql.prepare("select lid from DataStore where key=:key and datetime(data/1000)>=(datetime(:data/1000))");
         key = NOTE_CREATED_DATE;
     }
     else if (string.startsWith("updated:", Qt::CaseInsensitive)) {
-        sql.prepare("Delete from filter where lid not in (select lid from DataStore where key=:key and datetime(data/1000)>=(datetime(:data/1000)))");;
+        sql.prepare("select lid from DataStore where key=:key and datetime(data/1000)>=(datetime(:data/1000))");
         key = NOTE_UPDATED_DATE;
     }
     else if (string.startsWith("subjectdate:", Qt::CaseInsensitive)) {
-        sql.prepare("Delete from filter where lid not in (select lid from DataStore where key=:key and datetime(data/1000)>=(datetime(:data/1000)))");;
+        sql.prepare("select lid from DataStore where key=:key and datetime(data/1000)>=(datetime(:data/1000))");
         key = NOTE_ATTRIBUTE_SUBJECT_DATE;
     }
     else if (string.startsWith("-created:", Qt::CaseInsensitive)) {
-        sql.prepare("Delete from filter where lid in (select lid from DataStore where key=:key and datetime(data/1000)<=(datetime(:data/1000)))");;
+        sql.prepare("select lid from DataStore where key=:key and datetime(data/1000)<=(datetime(:data/1000))");
         key = NOTE_CREATED_DATE;
     }
     else if (string.startsWith("-updated:", Qt::CaseInsensitive)) {
-        sql.prepare("Delete from filter where lid in (select lid from DataStore where key=:key and datetime(data/1000)<=(datetime(:data/1000)))");;
+        sql.prepare("select lid from DataStore where key=:key and datetime(data/1000)<=(datetime(:data/1000))");
         key = NOTE_UPDATED_DATE;
     }
     else if (string.startsWith("-subjectdate:", Qt::CaseInsensitive)) {
-        sql.prepare("Delete from filter where lid in (select lid from DataStore where key=:key and datetime(data/1000)<=(datetime(:data/1000)))");;
+        sql.prepare("select lid from DataStore where key=:key and datetime(data/1000)<=(datetime(:data/1000))");
         key = NOTE_ATTRIBUTE_SUBJECT_DATE;
     }
 
     sql.bindValue(":key", key);
     sql.bindValue(":data", dt.toMSecsSinceEpoch());
-    sql.exec();
+    if (negative)
+        remove(sql);
+    else
+        keep(sql);
     sql.finish();
 }
 
@@ -1716,130 +2291,107 @@ QDateTime FilterEngine::calculateDateTime(QString string) {
 
 // Filter based upon the words the user specified (as opposed to the notebook, tags ...)
 // this is for the "any" filter (the default), not the default of all
-void FilterEngine::filterSearchStringAny(QStringList list) {
+void FilterEngine::filterSearchStringAny(SearchQuery &searchQuery) {
     QLOG_TRACE_IN();
     // Filter out the records
-    NSqlQuery sql(global.db), sqlnegative(global.db);
-    NSqlQuery resSql(global.db), resSqlNegative(global.db);
+    NSqlQuery sql(db), sqlnegative(db);
+    NSqlQuery resSql(db), resSqlNegative(db);
 
-    sql.exec("create table if not exists anylidsfilter (lid int);");
-    sql.exec("delete from anylidsfilter");
+    // Resource matches are mapped to their notes as they are read
+    sql.prepare("select lid from SearchIndex where weight>=:weight and source='text' and content match :word");
+    resSql.prepare("select data from DataStore where key=:key and lid in (select lid from SearchIndex where source='recognition' and weight>=:weight and content match :word)");
 
-    sql.exec("create table if not exists anylidsfilterRes (lid int);");
-    sql.exec("delete from anylidsfilterRes");
+    sqlnegative.prepare("select lid from SearchIndex where lid not in (select lid from searchindex where source='text' and weight>=:weight and content match :word)");
+    resSqlNegative.prepare("select data from DataStore where key=:key and lid in (select lid from SearchIndex where lid not in (select lid from searchindex where source='recognition' and weight>=:weight and content match :word))");
 
-    sql.prepare("insert into anylidsfilter (lid) select lid from SearchIndex where weight>=:weight and source='text' and content match :word");
-    resSql.prepare("insert into anylidsfilterRes (lid) select lid from SearchIndex where source='recognition' and weight>=:weight and content match :word");
+    sql.bindValue(":weight", minimumWeight);
+    sqlnegative.bindValue(":weight", minimumWeight);
 
-    sqlnegative.prepare("insert into anylidsfilter (lid) select lid from SearchIndex where lid not in (select lid from searchindex where source='text' and weight>=:weight and content match :word)");
-    resSqlNegative.prepare("insert into anylidsfilterRes (lid) select lid from SearchIndex where lid not in (select lid from searchindex where source='recognition' and weight>=:weight and content match :word)");
+    resSql.bindValue(":weight", minimumWeight);
+    resSql.bindValue(":key", RESOURCE_NOTE_LID);
+    resSqlNegative.bindValue(":weight", minimumWeight);
+    resSqlNegative.bindValue(":key", RESOURCE_NOTE_LID);
 
-    sql.bindValue(":weight", global.getMinimumRecognitionWeight());
-    sqlnegative.bindValue(":weight", global.getMinimumRecognitionWeight());
+    for (qint32 i=0; i<searchQuery.terms.size(); i++) {
+        const SearchTerm &term = searchQuery.terms[i];
+        QString string = term.text;
+        searchQuery.setCurrentTerm(i);
 
-    resSql.bindValue(":weight", global.getMinimumRecognitionWeight());
-    resSqlNegative.bindValue(":weight", global.getMinimumRecognitionWeight());
-
-    // We start at the second entry because the first is "any:"
-    for (qint32 i=1; i<list.size(); i++) {
-        QString string = list[i];
-        string.remove(QChar('"'));
-
-        // If we have a notebook search request
-        if (string.startsWith("notebook:", Qt::CaseInsensitive) ||
-                string.startsWith("-notebook:", Qt::CaseInsensitive)) {
+        switch (term.field) {
+        case SearchTerm::Notebook:
             filterSearchStringNotebookAny(string);
-        }
-        else if (string.startsWith("todo:", Qt::CaseInsensitive) ||
-                string.startsWith("-todo:", Qt::CaseInsensitive)) {
+            break;
+        case SearchTerm::Todo:
             filterSearchStringTodoAny(string);
-        }
-        else if (string.startsWith("reminderOrder:", Qt::CaseInsensitive) ||
-                string.startsWith("-reminderOrder:", Qt::CaseInsensitive)) {
+            break;
+        case SearchTerm::ReminderOrder:
             filterSearchStringReminderOrderAny(string);
-        }
-        else if (string.startsWith("reminderTime:", Qt::CaseInsensitive) ||
-                string.startsWith("-reminderTime:", Qt::CaseInsensitive)) {
+            break;
+        case SearchTerm::ReminderTime:
             filterSearchStringReminderTimeAny(string);
-        }
-        else if (string.startsWith("reminderDoneTime:", Qt::CaseInsensitive) ||
-                string.startsWith("-reminderDoneTime:", Qt::CaseInsensitive)) {
+            break;
+        case SearchTerm::ReminderDoneTime:
             filterSearchStringReminderDoneTimeAny(string);
-        }
-        else if (string.startsWith("tag:", Qt::CaseInsensitive) ||
-                string.startsWith("-tag:", Qt::CaseInsensitive)) {
+            break;
+        case SearchTerm::Tag:
             filterSearchStringTagAny(string);
-        }
-        else if (string.startsWith("intitle:", Qt::CaseInsensitive) ||
-                string.startsWith("-intitle:", Qt::CaseInsensitive)) {
+            break;
+        case SearchTerm::Title:
             filterSearchStringIntitleAny(string);
-        }
-        else if (string.startsWith("resource:", Qt::CaseInsensitive) ||
-                string.startsWith("-resource:", Qt::CaseInsensitive)) {
+            break;
+        case SearchTerm::Resource:
             filterSearchStringResourceAny(string);
-        }
-        else if (string.startsWith("longitude:", Qt::CaseInsensitive) ||
-                string.startsWith("-longitude:", Qt::CaseInsensitive)) {
+            break;
+        case SearchTerm::Longitude:
             filterSearchStringCoordinatesAny(string, NOTE_ATTRIBUTE_LONGITUDE);
-        }
-        else if (string.startsWith("latitude:", Qt::CaseInsensitive) ||
-                string.startsWith("-latitude:", Qt::CaseInsensitive)) {
+            break;
+        case SearchTerm::Latitude:
             filterSearchStringCoordinatesAny(string, NOTE_ATTRIBUTE_LATITUDE);
-        }
-        else if (string.startsWith("altitude:", Qt::CaseInsensitive) ||
-                string.startsWith("-altitude:", Qt::CaseInsensitive)) {
+            break;
+        case SearchTerm::Altitude:
             filterSearchStringCoordinatesAny(string, NOTE_ATTRIBUTE_ALTITUDE);
-        }
-        else if (string.startsWith("author:", Qt::CaseInsensitive) ||
-                string.startsWith("-author:", Qt::CaseInsensitive)) {
+            break;
+        case SearchTerm::Near:
+            filterSearchStringLocationAny(string, true);
+            break;
+        case SearchTerm::Area:
+            filterSearchStringLocationAny(string, false);
+            break;
+        case SearchTerm::Author:
             filterSearchStringAuthorAny(string);
-        }
-        else if (string.startsWith("source:", Qt::CaseInsensitive) ||
-                string.startsWith("-source:", Qt::CaseInsensitive)) {
+            break;
+        case SearchTerm::Source:
             filterSearchStringSourceAny(string);
-        }
-        else if (string.startsWith("sourceapplication:", Qt::CaseInsensitive) ||
-                string.startsWith("-sourceapplication:", Qt::CaseInsensitive)) {
+            break;
+        case SearchTerm::SourceApplication:
             filterSearchStringSourceApplicationAny(string);
-        }
-        else if (string.startsWith("contentclass:", Qt::CaseInsensitive) ||
-                string.startsWith("-contentclass:", Qt::CaseInsensitive)) {
+            break;
+        case SearchTerm::ContentClass:
             filterSearchStringContentClassAny(string);
-        }
-        else if (string.startsWith("recotype:", Qt::CaseInsensitive) ||
-                string.startsWith("-recotype:", Qt::CaseInsensitive)) {
+            break;
+        case SearchTerm::RecognitionType:
             filterSearchStringResourceRecognitionTypeAny(string);
-        }
-        else if (string.startsWith("created:", Qt::CaseInsensitive) ||
-                string.startsWith("-created:", Qt::CaseInsensitive) ||
-                string.startsWith("updated:", Qt::CaseInsensitive) ||
-                string.startsWith("-updated:", Qt::CaseInsensitive) ||
-                string.startsWith("subjectDate:", Qt::CaseInsensitive) ||
-                string.startsWith("-subjectdate", Qt::CaseInsensitive)) {
+            break;
+        case SearchTerm::Date:
             filterSearchStringDateAny(string);
-        }
-        else { // Filter not found
+            break;
+        default: // Filter not found
             if (string.startsWith("-")) {
                 string = string.remove(0,1);
-                sqlnegative.bindValue(":word", string.trimmed()+"*");
-                sqlnegative.exec();
-                resSqlNegative.bindValue(":word", string.trimmed()+"*");
-                resSqlNegative.exec();
+                sqlnegative.bindValue(":word", FullTextIndex::matchQuery(string.trimmed(), true));
+                include(sqlnegative);
+                resSqlNegative.bindValue(":word", FullTextIndex::matchQuery(string.trimmed(), true));
+                include(resSqlNegative);
             } else {
-                sql.bindValue(":word", string.trimmed()+"*");
-                sql.exec();
-                resSql.bindValue(":word", string.trimmed()+"*");
-                resSql.exec();
+                sql.bindValue(":word", FullTextIndex::matchQuery(string.trimmed(), true));
+                include(sql);
+                resSql.bindValue(":word", FullTextIndex::matchQuery(string.trimmed(), true));
+                include(resSql);
+                rankContent(FullTextIndex::matchQuery(string.trimmed(), true));
             }
+            break;
         }
     }
-
-    // At this point we have two tables. One has resource LIDs and the other note LIDs.  We need to
-    // map the resource LIDs to note LIDs for the filter;
-    sql.prepare("insert into anylidsfilter (lid) select a.data from datastore a where a.key=:key and lid in (select lid from anylidsfilterRes)");
-    sql.bindValue(":key", RESOURCE_NOTE_LID);
-    sql.exec();
-    sql.exec("delete from filter where lid not in (select lid from anylidsfilter)");
     sql.finish();
 }
 
@@ -1855,30 +2407,30 @@ void FilterEngine::filterSearchStringNotebookAny(QString string) {
         if (string == "")
             string = "*";
         // Filter out the records
-        NSqlQuery notebookSql(global.db);
+        NSqlQuery notebookSql(db);
         if (not string.contains("*"))
-            notebookSql.prepare("insert into anylidsfilter (lid) select lid from NoteTable where notebook=:notebook");
+            notebookSql.prepare("select lid from NoteTable where notebook=:notebook");
         else {
-            notebookSql.prepare("insert into anylidsfilter (lid) select lid from NoteTable where notebook like :notebook");
+            notebookSql.prepare("select lid from NoteTable where notebook like :notebook");
             string.replace("*", "%");
         }
         notebookSql.bindValue(":notebook", string);
-        notebookSql.exec();
+        include(notebookSql);
         notebookSql.finish();
     } else {
         string.remove(0,10);
         if (string == "")
             string = "*";
         // Filter out the records
-        NSqlQuery notebookSql(global.db);
+        NSqlQuery notebookSql(db);
         if (not string.contains("*"))
-            notebookSql.prepare("insert into anylidsfilter (lid) select lid from NoteTable where notebook <> :notebook");
+            notebookSql.prepare("select lid from NoteTable where notebook <> :notebook");
         else {
-            notebookSql.prepare("insert into anylidsfilter (lid) select lid from NoteTable where notebook not like :notebook");
+            notebookSql.prepare("select lid from NoteTable where notebook not like :notebook");
             string.replace("*", "%");
         }
         notebookSql.bindValue(":notebook", string);
-        notebookSql.exec();
+        include(notebookSql);
         notebookSql.finish();
     }
 }
@@ -1895,42 +2447,42 @@ void FilterEngine::filterSearchStringTodoAny(QString string) {
         if (string == "")
             string = "*";
         // Filter out the records
-        NSqlQuery sql(global.db);
+        NSqlQuery sql(db);
         if (string.startsWith("*")) {
-            sql.prepare("insert into anylidsfilter (lid) select lid from DataStore where key=:key1 or key=:key2");
+            sql.prepare("select lid from DataStore where key=:key1 or key=:key2");
             sql.bindValue(":key1", NOTE_HAS_TODO_COMPLETED);
             sql.bindValue(":key2", NOTE_HAS_TODO_UNCOMPLETED);
         }
         if (string.startsWith("true", Qt::CaseInsensitive)) {
-            sql.prepare("insert into anylidsfilter (lid) select lid from DataStore where key=:key1");
+            sql.prepare("select lid from DataStore where key=:key1");
             sql.bindValue(":key1", NOTE_HAS_TODO_COMPLETED);
         }
         if (string.startsWith("false", Qt::CaseInsensitive)) {
-            sql.prepare("insert into anylidsfilter (lid) select lid from DataStore where key=:key1");
+            sql.prepare("select lid from DataStore where key=:key1");
             sql.bindValue(":key1", NOTE_HAS_TODO_UNCOMPLETED);
         }
-        sql.exec();
+        include(sql);
         sql.finish();
     } else {
         string.remove(0,6);
         if (string == "")
             string = "*";
         // Filter out the records
-        NSqlQuery sql(global.db);
+        NSqlQuery sql(db);
         if (string.startsWith("*")) {
-            sql.prepare("insert into anylidsfilter (lid) select lid from DataStore where key<>:key1 or key<>:key2");
+            sql.prepare("select lid from DataStore where key<>:key1 or key<>:key2");
             sql.bindValue(":key1", NOTE_HAS_TODO_COMPLETED);
             sql.bindValue(":key2", NOTE_HAS_TODO_UNCOMPLETED);
         }
         if (string.startsWith("true", Qt::CaseInsensitive)) {
-            sql.prepare("insert into anylidsfilter (lid) select lid from DataStore where key=:key1");
+            sql.prepare("select lid from DataStore where key=:key1");
             sql.bindValue(":key1", NOTE_HAS_TODO_UNCOMPLETED);
         }
         if (string.startsWith("false", Qt::CaseInsensitive)) {
-            sql.prepare("insert into anylidsfilter (lid) select lid from DataStore where key=:key1");
+            sql.prepare("select lid from DataStore where key=:key1");
             sql.bindValue(":key1", NOTE_HAS_TODO_COMPLETED);
         }
-        sql.exec();
+        include(sql);
         sql.finish();
     }
 }
@@ -1949,34 +2501,34 @@ void FilterEngine::filterSearchStringReminderOrderAny(QString string) {
         if (string == "")
             string = "*";
         // Filter out the records
-        NSqlQuery sql(global.db);
+        NSqlQuery sql(db);
         if (string.startsWith("*")) {
-            sql.prepare("insert into anylidsfilter (lid) select lid from DataStore where key=:key1");
+            sql.prepare("select lid from DataStore where key=:key1");
             sql.bindValue(":key1", NOTE_ATTRIBUTE_REMINDER_ORDER);
         } else {
             int data=string.toInt();
-            sql.prepare("insert into anylidsfilter (lid) select lid from DataStore where key=:key1 and data=:data");
+            sql.prepare("select lid from DataStore where key=:key1 and data=:data");
             sql.bindValue(":key1", NOTE_ATTRIBUTE_REMINDER_ORDER);
             sql.bindValue(":data", data);
         }
-        sql.exec();
+        include(sql);
         sql.finish();
     } else {
         string.remove(0,15);
         if (string == "")
             string = "*";
         // Filter out the records
-        NSqlQuery sql(global.db);
+        NSqlQuery sql(db);
         if (string.startsWith("*")) {
-            sql.prepare("insert into anylidsfilter (lid) select distinct lid from DataStore where lid not in (select lid from DataStore where key = :key)");
+            sql.prepare("select distinct lid from DataStore where lid not in (select lid from DataStore where key = :key)");
             sql.bindValue(":key", NOTE_ATTRIBUTE_REMINDER_ORDER);
         } else {
             int data = string.toInt();
-            sql.prepare("insert into anylidsfilter (lid) select distinct lid from DataStore where lid not in (select lid from DataStore where key = :key and data=:data)");
+            sql.prepare("select distinct lid from DataStore where lid not in (select lid from DataStore where key = :key and data=:data)");
             sql.bindValue(":key", NOTE_ATTRIBUTE_REMINDER_ORDER);
             sql.bindValue(":data", data);
         }
-        sql.exec();
+        include(sql);
         sql.finish();
     }
 }
@@ -1992,36 +2544,33 @@ void FilterEngine::filterSearchStringTagAny(QString string) {
         string.remove(0,4);
         if (string == "")
             string = "*";
-        // Filter out the records
-        NSqlQuery tagSql(global.db);
+        // Filter out the records.  Names match case insensitively, as they
+        // did when they were compared against DataStore.data.
+        NSqlQuery tagSql(db);
         if (not string.contains("*"))
-            tagSql.prepare("insert into anylidsfilter (lid) select lid from datastore where key=:notetagkey and data in (select lid from DataStore where data=:tagname and key=:tagnamekey)");
+            tagSql.prepare("select noteLid from NoteTags where tagLid in (select lid from Tags where name=:tagname collate nocase)");
         else {
-            tagSql.prepare("insert into anylidsfilter (lid) select lid from datastore where key=:notetagkey and data in (select lid from DataStore where data like :tagname and key=:tagnamekey)");
+            tagSql.prepare("select noteLid from NoteTags where tagLid in (select lid from Tags where name like :tagname)");
             string = string.replace("*", "%");
         }
         tagSql.bindValue(":tagname", string);
-        tagSql.bindValue(":tagnamekey", TAG_NAME);
-        tagSql.bindValue(":notetagkey", NOTE_TAG_LID);
 
-        tagSql.exec();
+        include(tagSql);
         tagSql.finish();
     } else {
         string.remove(0,5);
         if (string == "")
             string = "*";
         // Filter out the records
-        NSqlQuery tagSql(global.db);
+        NSqlQuery tagSql(db);
         if (not string.contains("*"))
-            tagSql.prepare("insert into anylidsfilter (lid) select lid from datastore where lid not in (select lid from datastore where key=:notetagkey and data in (select lid from DataStore where data=:tagname and key=:tagnamekey))");
+            tagSql.prepare("select lid from Notes where lid not in (select noteLid from NoteTags where tagLid in (select lid from Tags where name=:tagname collate nocase))");
         else {
-            tagSql.prepare("insert into anylidsfilter (lid) select lid from datastore where lid not in (select lid from datastore where key=:notetagkey and data in (select lid from DataStore where data like :tagname and key=:tagnamekey))");
+            tagSql.prepare("select lid from Notes where lid not in (select noteLid from NoteTags where tagLid in (select lid from Tags where name like :tagname))");
             string = string.replace("*", "%");
         }
         tagSql.bindValue(":tagname", string);
-        tagSql.bindValue(":tagnamekey", TAG_NAME);
-        tagSql.bindValue(":notetagkey", NOTE_TAG_LID);
-        tagSql.exec();
+        include(tagSql);
         tagSql.finish();
     }
 }
@@ -2038,15 +2587,15 @@ void FilterEngine::filterSearchStringIntitleAny(QString string) {
         if (string == "")
             string = "*";
         // Filter out the records
-        NSqlQuery tagSql(global.db);
+        NSqlQuery tagSql(db);
         string = string.replace("*", "%");
         if (not string.contains("%"))
             string = QString("%") +string +QString("%");
-        tagSql.prepare("insert into anylidsfilter (lid) select lid from datastore where key=:key and data like :title");
+        tagSql.prepare("select lid from datastore where key=:key and data like :title");
         tagSql.bindValue(":key", NOTE_TITLE);
         tagSql.bindValue(":title", string);
 
-        tagSql.exec();
+        include(tagSql);
         tagSql.finish();
     } else {
         int pos = string.indexOf(":")+1;
@@ -2054,15 +2603,15 @@ void FilterEngine::filterSearchStringIntitleAny(QString string) {
         if (string == "")
             string = "*";
         // Filter out the records
-        NSqlQuery tagSql(global.db);
+        NSqlQuery tagSql(db);
         string = string.replace("*", "%");
         if (not string.contains("%"))
             string = QString("%") +string +QString("%");
-        tagSql.prepare("insert into anylidsfilter (lid) select lid from datastore where lid not in (select lid from datastore where key=:key and data like :title)");
+        tagSql.prepare("select lid from datastore where lid not in (select lid from datastore where key=:key and data like :title)");
         tagSql.bindValue(":key", NOTE_TITLE);
         tagSql.bindValue(":title", string);
 
-        tagSql.exec();
+        include(tagSql);
         tagSql.finish();
     }
 }
@@ -2079,16 +2628,16 @@ void FilterEngine::filterSearchStringResourceAny(QString string) {
         if (string == "")
             string = "*";
         // Filter out the records
-        NSqlQuery sql(global.db);
+        NSqlQuery sql(db);
         string = string.replace("*", "%");
         if (not string.contains("%"))
-            sql.prepare("insert into anylidsfilter (lid) select data from datastore where key=:notelidkey and lid in (select lid from DataStore where key=:mimekey and data=:data)");
+            sql.prepare("select data from datastore where key=:notelidkey and lid in (select lid from DataStore where key=:mimekey and data=:data)");
         else
-            sql.prepare("insert into anylidsfilter (lid) select data from datastore where key=:notelidkey and lid in (select lid from DataStore where key=:mimekey and data like :data)");
+            sql.prepare("select data from datastore where key=:notelidkey and lid in (select lid from DataStore where key=:mimekey and data like :data)");
         sql.bindValue(":notelidkey", RESOURCE_NOTE_LID);
         sql.bindValue(":mimekey", RESOURCE_MIME);
         sql.bindValue(":data", string);
-        sql.exec();
+        include(sql);
         QLOG_DEBUG() << sql.lastError();
         sql.finish();
     } else {
@@ -2096,16 +2645,16 @@ void FilterEngine::filterSearchStringResourceAny(QString string) {
         if (string == "")
             string = "*";
         // Filter out the records
-        NSqlQuery sql(global.db);
+        NSqlQuery sql(db);
         string = string.replace("*", "%");
         if (not string.contains("%"))
-            sql.prepare("insert into anylidsfilter (lid) select lid from datastore where lid not in (select data from datastore where key=:notelid and lid in (select lid from DataStore where data=:data and key = :mimekey))");
+            sql.prepare("select lid from datastore where lid not in (select data from datastore where key=:notelid and lid in (select lid from DataStore where data=:data and key = :mimekey))");
         else
-            sql.prepare("insert into anylidsfilter (lid) select lid from datastore where lid not in (select data from datastore where key=:notelid and lid not in (select lid from DataStore where data=:data and key like :mimekey))");
+            sql.prepare("select lid from datastore where lid not in (select data from datastore where key=:notelid and lid not in (select lid from DataStore where data=:data and key like :mimekey))");
         sql.bindValue(":notelid", RESOURCE_NOTE_LID);
         sql.bindValue(":mimekey", RESOURCE_MIME);
         sql.bindValue(":data", string);
-        sql.exec();
+        include(sql);
         QLOG_DEBUG() << sql.lastError();
         sql.finish();
     }
@@ -2127,21 +2676,21 @@ void FilterEngine::filterSearchStringCoordinatesAny(QString string, int key) {
         if (string == "")
             string = "0";
         // Filter out the records
-        NSqlQuery sql(global.db);
-        sql.prepare("insert into anylidsfilter (lid) select lid from datastore where key=:key and data >= :data");
+        NSqlQuery sql(db);
+        sql.prepare("select lid from datastore where key=:key and data >= :data");
         sql.bindValue(":key", key);
         sql.bindValue(":data", string.toDouble());
-        sql.exec();
+        include(sql);
         sql.finish();
     } else {
         if (string == "")
             string = "0";
         // Filter out the records
-        NSqlQuery sql(global.db);
-        sql.prepare("insert into anylidsfilter (lid) select lid from datastore where key=:key and data <= :data");
+        NSqlQuery sql(db);
+        sql.prepare("select lid from datastore where key=:key and data <= :data");
         sql.bindValue(":key", key);
         sql.bindValue(":data", string.toDouble());
-        sql.exec();
+        include(sql);
         sql.finish();
     }
 }
@@ -2149,6 +2698,22 @@ void FilterEngine::filterSearchStringCoordinatesAny(QString string, int key) {
 
 
 
+// filter based upon the note location ("near:" or "box:").  This is for the
+// "any" filter and not the default.
+void FilterEngine::filterSearchStringLocationAny(QString string, bool near) {
+    QLOG_TRACE_IN();
+    bool negative = string.startsWith("-");
+    int separator = string.indexOf(":")+1;
+    NSqlQuery sql(db);
+    if (!prepareLocation(sql, string.mid(separator), near, negative)) {
+        QLOG_WARN() << "Invalid location search: " << string;
+        return;
+    }
+    include(sql);
+    sql.finish();
+}
+
+
 // filter based upon the note author the user specified.  This is for the "any"
 // filter and not the default
 void FilterEngine::filterSearchStringAuthorAny(QString string) {
@@ -2162,29 +2727,29 @@ void FilterEngine::filterSearchStringAuthorAny(QString string) {
         if (string == "")
             string = "*";
         // Filter out the records
-        NSqlQuery sql(global.db);
+        NSqlQuery sql(db);
         if (string.contains("*")) {
             string = string.replace("*", "%");
-            sql.prepare("insert into anylidsfilter (lid) select lid from datastore where key=:key and data like :data");
+            sql.prepare("select lid from datastore where key=:key and data like :data");
         } else
-            sql.prepare("insert into anylidsfilter (lid) select lid from datastore where key=:key and data = :data");
+            sql.prepare("select lid from datastore where key=:key and data = :data");
         sql.bindValue(":key", NOTE_ATTRIBUTE_AUTHOR);
         sql.bindValue(":data", string);
-        sql.exec();
+        include(sql);
         sql.finish();
     } else {
         if (string == "")
             string = "*";
         // Filter out the records
-        NSqlQuery sql(global.db);
+        NSqlQuery sql(db);
         if (string.contains("*")) {
             string = string.replace("*", "%");
-            sql.prepare("insert into anylidsfilter (lid) select lid from datastore where lid not in (select lid from datastore where key=:key and data like :data)");
+            sql.prepare("select lid from datastore where lid not in (select lid from datastore where key=:key and data like :data)");
         } else
-            sql.prepare("insert into anylidsfilter (lid) select lid from datastore where lid not in (select lid from datastore where key=:key and data = :data)");
+            sql.prepare("select lid from datastore where lid not in (select lid from datastore where key=:key and data = :data)");
         sql.bindValue(":key", NOTE_ATTRIBUTE_AUTHOR);
         sql.bindValue(":data", string.toDouble());
-        sql.exec();
+        include(sql);
         sql.finish();
     }
 }
@@ -2197,37 +2762,37 @@ void FilterEngine::filterSearchStringDateAny(QString string) {
     int separator = string.indexOf(":")+1;
     QString tempString = string.mid(separator);
     QDateTime dt = calculateDateTime(tempString);
-    NSqlQuery sql(global.db);
+    NSqlQuery sql(db);
     int key=0;
 
     if (string.startsWith("created:", Qt::CaseInsensitive)) {
-        sql.prepare("insert into anylidsfilter (lid) select lid from DataStore where key=:key and datetime(data/1000)>=(datetime(:data/1000))");
+        sql.prepare("select lid from DataStore where key=:key and datetime(data/1000)>=(datetime(:data/1000))");
         key = NOTE_CREATED_DATE;
     }
     else if (string.startsWith("updated:", Qt::CaseInsensitive)) {
-        sql.prepare("insert into anylidsfilter (lid) select lid from DataStore where key=:key and datetime(data/1000)>=(datetime(:data/1000))");
+        sql.prepare("select lid from DataStore where key=:key and datetime(data/1000)>=(datetime(:data/1000))");
         key = NOTE_UPDATED_DATE;
     }
     else if (string.startsWith("subjectdate:", Qt::CaseInsensitive)) {
-        sql.prepare("insert into anylidsfilter (lid) select lid from DataStore where key=:key and datetime(data/1000)>=(datetime(:data/1000))");
+        sql.prepare("select lid from DataStore where key=:key and datetime(data/1000)>=(datetime(:data/1000))");
         key = NOTE_ATTRIBUTE_SUBJECT_DATE;
     }
     else if (string.startsWith("-created:", Qt::CaseInsensitive)) {
-        sql.prepare("insert into anylidsfilter (lid) select lid from DataStore where key=:key and datetime(data/1000)<=(datetime(:data/1000))");
+        sql.prepare("select lid from DataStore where key=:key and datetime(data/1000)<=(datetime(:data/1000))");
         key = NOTE_CREATED_DATE;
     }
     else if (string.startsWith("-updated:", Qt::CaseInsensitive)) {
-        sql.prepare("insert into anylidsfilter (lid) select lid from DataStore where key=:key and datetime(data/1000)<=(datetime(:data/1000))");
+        sql.prepare("select lid from DataStore where key=:key and datetime(data/1000)<=(datetime(:data/1000))");
         key = NOTE_UPDATED_DATE;
     }
     else if (string.startsWith("-subjectdate:", Qt::CaseInsensitive)) {
-        sql.prepare("insert into anylidsfilter (lid) select lid from DataStore where key=:key and datetime(data/1000)<=(datetime(:data/1000))");
+        sql.prepare("select lid from DataStore where key=:key and datetime(data/1000)<=(datetime(:data/1000))");
         key = NOTE_ATTRIBUTE_SUBJECT_DATE;
     }
 
     sql.bindValue(":key", key);
     sql.bindValue(":data", dt.toMSecsSinceEpoch());
-    sql.exec();
+    include(sql);
     sql.finish();
 }
 
@@ -2249,28 +2814,28 @@ void FilterEngine::filterSearchStringSourceAny(QString string) {
         if (string == "")
             string = "*";
         // Filter out the records
-        NSqlQuery sql(global.db);
+        NSqlQuery sql(db);
         if (string.contains("*")) {
             string = string.replace("*", "%");
-            sql.prepare("insert into anylidsfilter (lid) select lid from datastore where key=:key and data like :data");
+            sql.prepare("select lid from datastore where key=:key and data like :data");
         } else
-            sql.prepare("insert into anylidsfilter (lid) select lid from datastore where key=:key and data=:data");
+            sql.prepare("select lid from datastore where key=:key and data=:data");
         sql.bindValue(":key", NOTE_ATTRIBUTE_SOURCE);
         sql.bindValue(":data", string);
-        sql.exec();
+        include(sql);
     } else {
         if (string == "")
             string = "*";
         // Filter out the records
-        NSqlQuery sql(global.db);
+        NSqlQuery sql(db);
         if (string.contains("*")) {
             string = string.replace("*", "%");
-            sql.prepare("insert into anylidsfilter (lid) select lid from datastore where lid not in (select lid from datastore where key=:key and data like :data)");
+            sql.prepare("select lid from datastore where lid not in (select lid from datastore where key=:key and data like :data)");
         } else
-            sql.prepare("insert into anylidsfilter (lid) select lid from datastore where lid not in (select lid from datastore where key=:key and data=:data)");
+            sql.prepare("select lid from datastore where lid not in (select lid from datastore where key=:key and data=:data)");
         sql.bindValue(":key", NOTE_ATTRIBUTE_SOURCE);
         sql.bindValue(":data", string.toDouble());
-        sql.exec();
+        include(sql);
         sql.finish();
     }
 }
@@ -2291,29 +2856,29 @@ void FilterEngine::filterSearchStringSourceApplicationAny(QString string) {
         if (string == "")
             string = "*";
         // Filter out the records
-        NSqlQuery sql(global.db);
+        NSqlQuery sql(db);
         if (string.contains("*")) {
             string = string.replace("*", "%");
-            sql.prepare("insert into anylidsfilter (lid) select lid from datastore where key=:key and data like :data");
+            sql.prepare("select lid from datastore where key=:key and data like :data");
         } else
-            sql.prepare("insert into anylidsfilter (lid) select lid from datastore where key=:key and data=:data");
+            sql.prepare("select lid from datastore where key=:key and data=:data");
         sql.bindValue(":key", NOTE_ATTRIBUTE_SOURCE_APPLICATION);
         sql.bindValue(":data", string);
-        sql.exec();
+        include(sql);
         sql.finish();
     } else {
         if (string == "")
             string = "*";
         // Filter out the records
-        NSqlQuery sql(global.db);
+        NSqlQuery sql(db);
         if (string.contains("*")) {
             string = string.replace("*", "%");
-            sql.prepare("insert into anylidsfilter (lid) select lid from datastore where lid not in (select lid from datastore where key=:key and data like :data)");
+            sql.prepare("select lid from datastore where lid not in (select lid from datastore where key=:key and data like :data)");
         } else
-            sql.prepare("insert into anylidsfilter (lid) select lid from datastore where lid not in (select lid from datastore where key=:key and data=:data)");
+            sql.prepare("select lid from datastore where lid not in (select lid from datastore where key=:key and data=:data)");
         sql.bindValue(":key", NOTE_ATTRIBUTE_SOURCE_APPLICATION);
         sql.bindValue(":data", string.toDouble());
-        sql.exec();
+        include(sql);
         sql.finish();
     }
 }
@@ -2335,29 +2900,29 @@ void FilterEngine::filterSearchStringContentClassAny(QString string) {
         if (string == "")
             string = "*";
         // Filter out the records
-        NSqlQuery sql(global.db);
+        NSqlQuery sql(db);
         if (string.contains("*")) {
             string = string.replace("*", "%");
-            sql.prepare("insert into anylidsfilter (lid) select lid from datastore where key=:key and data like :data");
+            sql.prepare("select lid from datastore where key=:key and data like :data");
         } else
-            sql.prepare("insert into anylidsfilter (lid) select lid from datastore where key=:key and data=:data");
+            sql.prepare("select lid from datastore where key=:key and data=:data");
         sql.bindValue(":key", NOTE_ATTRIBUTE_CONTENT_CLASS);
         sql.bindValue(":data", string);
-        sql.exec();
+        include(sql);
         sql.finish();
     } else {
         if (string == "")
             string = "*";
         // Filter out the records
-        NSqlQuery sql(global.db);
+        NSqlQuery sql(db);
         if (string.contains("*")) {
             string = string.replace("*", "%");
-            sql.prepare("insert into anylidsfilter (lid) select lid from datastore where lid not in (select lid from datastore where key=:key and data like :data)");
+            sql.prepare("select lid from datastore where lid not in (select lid from datastore where key=:key and data like :data)");
         } else
-            sql.prepare("insert into anylidsfilter (lid) select lid from datastore where lid not in (select lid from datastore where key=:key and data=:data)");
+            sql.prepare("select lid from datastore where lid not in (select lid from datastore where key=:key and data=:data)");
         sql.bindValue(":key", NOTE_ATTRIBUTE_CONTENT_CLASS);
         sql.bindValue(":data", string.toDouble());
-        sql.exec();
+        include(sql);
         sql.finish();
     }
 }
@@ -2377,29 +2942,29 @@ void FilterEngine::filterSearchStringResourceRecognitionTypeAny(QString string)
         if (string == "")
             string = "*";
         // Filter out the records
-        NSqlQuery sql(global.db);
+        NSqlQuery sql(db);
         if (string.contains("*")) {
             string = string.replace("*", "%");
-            sql.prepare("insert into anylidsfilter (lid) select lid from datastore where key=:key and data like :data");
+            sql.prepare("select lid from datastore where key=:key and data like :data");
         } else
-            sql.prepare("insert into anylidsfilter (lid) select lid from datastore where key=:key and data=:data");
+            sql.prepare("select lid from datastore where key=:key and data=:data");
         sql.bindValue(":key", RESOURCE_RECO_TYPE);
         sql.bindValue(":data", string);
-        sql.exec();
+        include(sql);
         sql.finish();
     } else {
         if (string == "")
             string = "*";
         // Filter out the records
-        NSqlQuery sql(global.db);
+        NSqlQuery sql(db);
         if (string.contains("*")) {
             string = string.replace("*", "%");
-            sql.prepare("insert into anylidsfilter (lid) select lid from datastore where lid not in (select lid from datastore where key=:key and data like :data)");
+            sql.prepare("select lid from datastore where lid not in (select lid from datastore where key=:key and data like :data)");
         } else
-            sql.prepare("insert into anylidsfilter (lid) select lid from datastore where lid not in (select lid from datastore where key=:key and data=:data)");
+            sql.prepare("select lid from datastore where lid not in (select lid from datastore where key=:key and data=:data)");
         sql.bindValue(":key", RESOURCE_RECO_TYPE);
         sql.bindValue(":data", string.toDouble());
-        sql.exec();
+        include(sql);
         sql.finish();
     }
 }
@@ -2407,95 +2972,224 @@ void FilterEngine::filterSearchStringResourceRecognitionTypeAny(QString string)
 
 
 // Check if a resource contains a specific search string.  Used in highlighting PDFs & attachments
-// This function is used in two different ways.  If the *returnHits pointer is nullptr, it searches
-// for the first match in a PDF and exits with true/false if a match is found.  If the pointer is
-// not null, it will return a list of all of the searchString terms that are found.  This is useful
-// in knowing what to highlight in a PDF.
+// This function is used in two different ways.  If the *returnHits pointer is nullptr, it only
+// says if anything in the search string was found.  If the pointer is not null, it will return
+// a list of all of the words that were found.  This is useful in knowing what to highlight in a PDF.
 bool FilterEngine::resourceContains(qint32 resourceLid, QString searchString, QStringList *returnHits) {
     QLOG_TRACE_IN();
-
-    searchString = global.normalizeTermForSearchAndIndex(searchString);
-    
-    bool returnValue = false;
     if (returnHits != nullptr)
-        returnHits->empty();
-    NSqlQuery query(global.db);
-    NSqlQuery query2(global.db);
-    query.prepare("select lid from SearchIndex where lid=:resourceLid and weight>=:weight and content match :word");
-    query2.prepare("select lid from SearchIndex where lid=:resourceLid and weight>=:weight and content like :word");
-    QStringList terms;
-    splitSearchTerms(terms, searchString);
-    for (int i=0; i<terms.size(); i++) {
-
-        // ignore special search terms
-        if (!searchString.startsWith("notebook:", Qt::CaseInsensitive) &&
-                !searchString.startsWith("-notebook:", Qt::CaseInsensitive) &&
-                !searchString.startsWith("stack:", Qt::CaseInsensitive) &&
-                !searchString.startsWith("-stack:", Qt::CaseInsensitive) &&
-                !searchString.startsWith("todo:", Qt::CaseInsensitive) &&
-                !searchString.startsWith("-todo:", Qt::CaseInsensitive) &&
-                !searchString.startsWith("tag:", Qt::CaseInsensitive) &&
-                !searchString.startsWith("-tag:", Qt::CaseInsensitive) &&
-                !searchString.startsWith("intitle:", Qt::CaseInsensitive) &&
-                !searchString.startsWith("-intitle:", Qt::CaseInsensitive) &&
-                !searchString.startsWith("resource:", Qt::CaseInsensitive) &&
-                !searchString.startsWith("-resource:", Qt::CaseInsensitive) &&
-                !searchString.startsWith("longitude:", Qt::CaseInsensitive) &&
-                !searchString.startsWith("-longitude:", Qt::CaseInsensitive) &&
-                !searchString.startsWith("latitude:", Qt::CaseInsensitive) &&
-                !searchString.startsWith("-latitude:", Qt::CaseInsensitive) &&
-                !searchString.startsWith("altitude:", Qt::CaseInsensitive) &&
-                !searchString.startsWith("-altitude:", Qt::CaseInsensitive) &&
-                !searchString.startsWith("author:", Qt::CaseInsensitive) &&
-                !searchString.startsWith("-author:", Qt::CaseInsensitive) &&
-                !searchString.startsWith("source:", Qt::CaseInsensitive) &&
-                !searchString.startsWith("-source:", Qt::CaseInsensitive) &&
-                !searchString.startsWith("sourceapplication:", Qt::CaseInsensitive) &&
-                !searchString.startsWith("-sourceapplication:", Qt::CaseInsensitive) &&
-                !searchString.startsWith("contentclass:", Qt::CaseInsensitive) &&
-                !searchString.startsWith("-contentclass:", Qt::CaseInsensitive) &&
-                !searchString.startsWith("recotype:", Qt::CaseInsensitive) &&
-                !searchString.startsWith("-recotype:", Qt::CaseInsensitive) &&
-                !searchString.startsWith("placename:", Qt::CaseInsensitive) &&
-                !searchString.startsWith("-placename:", Qt::CaseInsensitive) &&
-                !searchString.startsWith("created:", Qt::CaseInsensitive) &&
-                !searchString.startsWith("-created:", Qt::CaseInsensitive) &&
-                !searchString.startsWith("updated:", Qt::CaseInsensitive) &&
-                !searchString.startsWith("-updated:", Qt::CaseInsensitive) &&
-                !searchString.startsWith("subjectdate:", Qt::CaseInsensitive) &&
-                !searchString.startsWith("-subjectdate:", Qt::CaseInsensitive)) {
-            QString term = terms[i];
-            if (term.endsWith("*"))
-                term.chop(1);
-            if (term.startsWith("*")) {
-                term = term.mid(1);
-                query2.bindValue(":resourceLid", resourceLid);
-                query2.bindValue(":weight", global.getMinimumRecognitionWeight());
-                query2.bindValue(":word", "%"+term+"%");
-                query2.exec();
-                if (query2.next()) {
-                    returnValue = true;
-                    if (returnHits != nullptr)
-                        returnHits->append(term);
-                    else
-                        return true;
-                }
-            } else {
-                query.bindValue(":resourceLid", resourceLid);
-                query.bindValue(":weight", global.getMinimumRecognitionWeight());
-                query.bindValue(":word", term);
-                query.exec();
-                if (query.next()) {
-                    returnValue = true;
-                    if (returnHits != nullptr)
-                        returnHits->append(term);
-                    else
-                        return true;
-                }
+        returnHits->clear();
+    QList<SearchHit> hits;
+    if (!searchHits(hits, resourceLid, searchString, returnHits != nullptr))
+        return false;
+    if (returnHits != nullptr) {
+        for (int i=0; i<hits.size(); i++)
+            returnHits->append(hits[i].words);
+        returnHits->removeDuplicates();
+    }
+    return true;
+}
+
+
+
+// Find where a search string matches a note & its resources, or a
+// single resource if a resource lid is given.  The full text terms are
+// looked up together in one FTS query, which returns the lids, sources &
+// a snippet of every match.  Only the "like" terms FTS can't do need a
+// query each.  With "withWords" set the words found are returned too,
+// which means reading the whole text of each match.
+bool FilterEngine::searchHits(QList<SearchHit> &hits, qint32 lid, QString searchString, bool withWords) {
+    hits.clear();
+    QStringList match;
+    QStringList patterns;
+    hitTerms(searchString, match, patterns);
+
+    QString lids("(lid=:lid or lid in (select lid from DataStore where key=:key and data=:noteLid))");
+    if (match.size() > 0) {
+        bool fts5 = FullTextIndex::isFts5();
+        QString columns;
+        if (fts5) {
+            columns = "snippet(SearchIndex, 3, char(1), char(2), '...', " SEARCH_HIT_SNIPPET_WORDS ")";
+            if (withWords)
+                columns += ", highlight(SearchIndex, 3, char(1), char(2))";
+        } else {
+            columns = "snippet(SearchIndex, char(1), char(2), '...', 3, " SEARCH_HIT_SNIPPET_WORDS ")";
+            if (withWords)
+                columns += ", offsets(SearchIndex), content";
+        }
+        NSqlQuery sql(db);
+        sql.prepare("select lid, source, " + columns + " from SearchIndex "
+                    "where content match :match and weight>=:weight and " + lids);
+        sql.bindValue(":match", match.join(" OR "));
+        sql.bindValue(":weight", minimumWeight);
+        sql.bindValue(":lid", lid);
+        sql.bindValue(":key", RESOURCE_NOTE_LID);
+        sql.bindValue(":noteLid", lid);
+        if (sql.exec()) {
+            while (sql.next()) {
+                SearchHit hit;
+                hit.lid = sql.value(0).toInt();
+                hit.source = sql.value(1).toString();
+                hit.snippet = sql.value(2).toString();
+                if (withWords && fts5)
+                    hit.words = markedWords(sql.value(3).toString());
+                if (withWords && !fts5)
+                    hit.words = offsetWords(sql.value(3).toString(), sql.value(4).toString());
+                hits.append(hit);
             }
+        } else {
+            QLOG_ERROR() << "Search hit query failed: " << sql.lastError();
         }
+        sql.finish();
+    }
+
+    for (int i=0; i<patterns.size(); i++) {
+        QString pattern = patterns[i];
+        QString word = pattern;
+        word.remove("*");
+        pattern = pattern.replace("_", "/_").replace("*", "%");
+        if (!pattern.startsWith("%"))
+            pattern = "%" + pattern;
+        if (!pattern.endsWith("%"))
+            pattern = pattern + "%";
+        QString like("content like :word escape '/'");
+        bool trigrams = TrigramIndex::isReady();
+        if (trigrams)
+            like = "rowid in (select rowid from SearchTrigram where content like :trigrams) and " + like;
+        NSqlQuery sql(db);
+        sql.prepare("select lid, source from SearchIndex where " + like + " and weight>=:weight and " + lids);
+        sql.bindValue(":word", pattern);
+        if (trigrams)
+            sql.bindValue(":trigrams", QString(pattern).replace("/_", "_"));
+        sql.bindValue(":weight", minimumWeight);
+        sql.bindValue(":lid", lid);
+        sql.bindValue(":key", RESOURCE_NOTE_LID);
+        sql.bindValue(":noteLid", lid);
+        sql.exec();
+        while (sql.next()) {
+            SearchHit hit;
+            hit.lid = sql.value(0).toInt();
+            hit.source = sql.value(1).toString();
+            if (withWords)
+                hit.words.append(word);
+            hits.append(hit);
+        }
+        sql.finish();
     }
-    return returnValue;
+    return hits.size() > 0;
+}
+
+
+// The terms of a search string which match text: the FTS MATCH
+// expressions of the full text terms & the "like" patterns.  Notebook,
+// tag & other special terms & the negative ones don't match any text.
+void FilterEngine::hitTerms(QString searchString, QStringList &match, QStringList &patterns) {
+    searchString = global.normalizeTermForSearchAndIndex(searchString);
+    QStringList words;
+    splitSearchTerms(words, searchString);
+    SearchQuery searchQuery;
+    searchQuery.parse(words, searchString.trimmed().startsWith("any:", Qt::CaseInsensitive));
+    for (int i=0; i<searchQuery.terms.size(); i++) {
+        const SearchTerm &term = searchQuery.terms[i];
+        if (term.negative || term.value.trimmed() == "")
+            continue;
+        if (term.field == SearchTerm::Content)
+            match.append(FullTextIndex::matchQuery(term.value, true));
+        else if (term.field == SearchTerm::ContentPattern)
+            patterns.append(term.value);
+    }
+}
+
+
+// Look up the snippets of every note in the result with one FTS query.
+// A resource's match is filed under its note, but the note's own text
+// is preferred.  "like" terms have no snippet.
+void FilterEngine::searchSnippets(const QString &searchString) {
+    QStringList match;
+    QStringList patterns;
+    hitTerms(searchString, match, patterns);
+    if (match.size() == 0 || resultLids.size() == 0)
+        return;
+
+    QString snippet;
+    if (FullTextIndex::isFts5())
+        snippet = "snippet(SearchIndex, 3, char(1), char(2), '...', " SEARCH_HIT_SNIPPET_WORDS ")";
+    else
+        snippet = "snippet(SearchIndex, char(1), char(2), '...', 3, " SEARCH_HIT_SNIPPET_WORDS ")";
+    NSqlQuery sql(db);
+    sql.prepare("select coalesce((select data from DataStore where DataStore.lid=SearchIndex.lid and key=:key), lid), "
+                "lid, " + snippet + " from SearchIndex where content match :match and weight>=:weight");
+    sql.bindValue(":key", RESOURCE_NOTE_LID);
+    sql.bindValue(":match", match.join(" OR "));
+    sql.bindValue(":weight", minimumWeight);
+    if (!sql.exec()) {
+        if (!isCancelled())
+            QLOG_ERROR() << "Search snippet query failed: " << sql.lastError();
+        sql.finish();
+        return;
+    }
+    QSet<qint32> ownText;
+    while (sql.next()) {
+        qint32 noteLid = sql.value(0).toInt();
+        if (!resultLids.contains(noteLid) || ownText.contains(noteLid))
+            continue;
+        QString text = sql.value(2).toString().simplified();
+        if (text == "")
+            continue;
+        if (sql.value(1).toInt() == noteLid)
+            ownText.insert(noteLid);
+        else if (snippets.contains(noteLid))
+            continue;
+        snippets.insert(noteLid, text);
+    }
+    sql.finish();
+}
+
+
+// The snippet of a single note, the note's own text preferred to an
+// attachment's.
+QString FilterEngine::noteSnippet(qint32 lid, const QString &searchString) {
+    QList<SearchHit> hits;
+    searchHits(hits, lid, searchString, false);
+    QString text;
+    for (int i=0; i<hits.size(); i++) {
+        if (hits[i].snippet == "")
+            continue;
+        if (text == "" || hits[i].lid == lid)
+            text = hits[i].snippet.simplified();
+        if (hits[i].lid == lid)
+            break;
+    }
+    return text;
+}
+
+
+// The words between the markers of FTS5's highlight()
+QStringList FilterEngine::markedWords(const QString &text) {
+    QStringList words;
+    int start = text.indexOf(SEARCH_HIT_START);
+    while (start >= 0) {
+        int end = text.indexOf(SEARCH_HIT_END, start);
+        if (end < 0)
+            break;
+        words.append(text.mid(start+1, end-start-1));
+        start = text.indexOf(SEARCH_HIT_START, end);
+    }
+    words.removeDuplicates();
+    return words;
+}
+
+
+// The words FTS4's offsets() points at.  It returns four numbers for
+// each match: column, query term, byte offset & size in bytes.
+QStringList FilterEngine::offsetWords(const QString &offsets, const QString &content) {
+    QStringList words;
+    QStringList numbers = offsets.split(" ", QString::SkipEmptyParts);
+    QByteArray text = content.toUtf8();
+    for (int i=0; i+3<numbers.size(); i=i+4)
+        words.append(QString::fromUtf8(text.mid(numbers[i+2].toInt(), numbers[i+3].toInt())));
+    words.removeDuplicates();
+    return words;
 }
 
 
@@ -2507,18 +3201,18 @@ void FilterEngine::filterSearchStringReminderTimeAll(QString string) {
     int separator = string.indexOf(":")+1;
     QString tempString = string.mid(separator);
     QDateTime dt = calculateDateTime(tempString);
-    NSqlQuery sql(global.db);
+    NSqlQuery sql(db);
     int key= NOTE_ATTRIBUTE_REMINDER_TIME;
 
     if (string.startsWith("-", Qt::CaseInsensitive)) {
-        sql.prepare("Delete from filter where lid not in (select lid from DataStore where key=:key and datetime(data/1000)<(datetime(:data/1000)))");;
+        sql.prepare("select lid from DataStore where key=:key and datetime(data/1000)<(datetime(:data/1000))");
     } else {
-        sql.prepare("Delete from filter where lid not in (select lid from DataStore where key=:key and datetime(data/1000)>=(datetime(:data/1000)))");;
+        sql.prepare("select lid from DataStore where key=:key and datetime(data/1000)>=(datetime(:data/1000))");
     }
 
     sql.bindValue(":key", key);
     sql.bindValue(":data", dt.toMSecsSinceEpoch());
-    sql.exec();
+    keep(sql);
     sql.finish();
     QLOG_TRACE_OUT();
 }
@@ -2530,17 +3224,17 @@ void FilterEngine::filterSearchStringReminderTimeAny(QString string) {
     int separator = string.indexOf(":")+1;
     QString tempString = string.mid(separator);
     QDateTime dt = calculateDateTime(tempString);
-    NSqlQuery sql(global.db);
+    NSqlQuery sql(db);
     int key = NOTE_ATTRIBUTE_REMINDER_TIME;
 
     if (string.startsWith("-reminderDoneTime:", Qt::CaseInsensitive)) {
-        sql.prepare("insert into anylidsfilter (lid) select lid from DataStore where key=:key and datetime(data/1000)<(datetime(:data/1000))");
+        sql.prepare("select lid from DataStore where key=:key and datetime(data/1000)<(datetime(:data/1000))");
     } else {
-        sql.prepare("insert into anylidsfilter (lid) select lid from DataStore where key=:key and datetime(data/1000)>=(datetime(:data/1000))");
+        sql.prepare("select lid from DataStore where key=:key and datetime(data/1000)>=(datetime(:data/1000))");
     }
     sql.bindValue(":key", key);
     sql.bindValue(":data", dt.toMSecsSinceEpoch());
-    sql.exec();
+    include(sql);
     sql.finish();
 }
 
@@ -2552,18 +3246,18 @@ void FilterEngine::filterSearchStringReminderDoneTimeAll(QString string) {
     int separator = string.indexOf(":")+1;
     QString tempString = string.mid(separator);
     QDateTime dt = calculateDateTime(tempString);
-    NSqlQuery sql(global.db);
+    NSqlQuery sql(db);
     int key = NOTE_ATTRIBUTE_REMINDER_DONE_TIME;
 
     if (string.startsWith("-", Qt::CaseInsensitive)) {
-        sql.prepare("Delete from filter where lid not in (select lid from DataStore where key=:key and datetime(data/1000)<(datetime(:data/1000)))");
+        sql.prepare("select lid from DataStore where key=:key and datetime(data/1000)<(datetime(:data/1000))");
     } else {
-        sql.prepare("Delete from filter where lid not in (select lid from DataStore where key=:key and datetime(data/1000)>=(datetime(:data/1000)))");
+        sql.prepare("select lid from DataStore where key=:key and datetime(data/1000)>=(datetime(:data/1000))");
     }
 
     sql.bindValue(":key", key);
     sql.bindValue(":data", dt.toMSecsSinceEpoch());
-    sql.exec();
+    keep(sql);
     sql.finish();
     QLOG_TRACE_OUT();
 }
@@ -2575,17 +3269,17 @@ void FilterEngine::filterSearchStringReminderDoneTimeAny(QString string) {
     int separator = string.indexOf(":")+1;
     QString tempString = string.mid(separator);
     QDateTime dt = calculateDateTime(tempString);
-    NSqlQuery sql(global.db);
+    NSqlQuery sql(db);
     int key = NOTE_ATTRIBUTE_REMINDER_DONE_TIME;
 
     if (string.startsWith("-reminderDoneTime:", Qt::CaseInsensitive)) {
-        sql.prepare("insert into anylidsfilter (lid) select lid from DataStore where key=:key and datetime(data/1000)<(datetime(:data/1000))");
+        sql.prepare("select lid from DataStore where key=:key and datetime(data/1000)<(datetime(:data/1000))");
     } else {
-        sql.prepare("insert into anylidsfilter (lid) select lid from DataStore where key=:key and datetime(data/1000)>=(datetime(:data/1000))");
+        sql.prepare("select lid from DataStore where key=:key and datetime(data/1000)>=(datetime(:data/1000))");
     }
     sql.bindValue(":key", key);
     sql.bindValue(":data", dt.toMSecsSinceEpoch());
-    sql.exec();
+    include(sql);
     sql.finish();
     QLOG_TRACE_OUT();
 }
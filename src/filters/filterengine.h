@@ -21,12 +21,68 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #define FILTERENGINE_H
 
 #include <QObject>
+#include <QHash>
+#include <QAtomicInt>
 #include "filtercriteria.h"
+#include "searchquery.h"
+#include "src/sql/nsqlquery.h"
+#include "src/utilities/lidbitmap.h"
+
+class DatabaseConnection;
+
+// Markers around the words found in a SearchHit snippet
+#define SEARCH_HIT_START QChar(1)
+#define SEARCH_HIT_END QChar(2)
+#define SEARCH_HIT_SNIPPET_WORDS "12"
+
+//***********************************************************
+// A note or resource a search string matched, with the text
+// around the match.
+//***********************************************************
+class SearchHit
+{
+public:
+    qint32 lid;                // Note or resource
+    QString source;            // SearchIndex source (note text, recognition, ...)
+    QString snippet;           // Words around the match, the words found are marked (empty for "like" terms)
+    QStringList words;         // The words found
+};
 
 class FilterEngine : public QObject
 {
     Q_OBJECT
 private:
+    LidBitmap resultLids;              // Notes which pass every criterion so far
+    LidBitmap anyMatches;              // Notes matching at least one "any:" term
+    QHash<qint32, int> relevance;      // Search relevance of the matching notes
+    QHash<qint32, QString> snippets;   // Search snippets of the matching notes
+    SearchQuery *activeQuery;          // Search string being compiled, statements are only recorded
+    qint32 singleLid;                  // Only this note is checked (-1 for all notes)
+    DatabaseConnection *db;            // Connection the statements run on
+    qint32 minimumWeight;              // Search settings, read when the engine is created
+    bool tagSelectionOr;
+    const QAtomicInt *latestGeneration;  // Newest search requested (nullptr if it can't be cancelled)
+    qint32 generation;                 // This search
+    qint64 sequence;                   // Change log sequence number the lid sets are cached for (-1: not cached)
+    bool materializing;                // Building a materialized search, don't use the stored results
+
+    explicit FilterEngine(const FilterEngine *other);  // Same connection, settings & generation
+    bool isCancelled();
+    static QStringList markedWords(const QString &text);
+    static QStringList offsetWords(const QString &offsets, const QString &content);
+    void hitTerms(QString searchString, QStringList &match, QStringList &patterns);
+    void searchSnippets(const QString &searchString);
+    QString noteSnippet(qint32 lid, const QString &searchString);
+
+    bool select(NSqlQuery &sql, LidBitmap &lids, bool cache);
+    bool selectSingle(NSqlQuery &sql, LidBitmap &lids);
+    void keep(NSqlQuery &sql, bool cache=false);
+    void remove(NSqlQuery &sql, bool cache=false);
+    void include(NSqlQuery &sql);
+    void boost(NSqlQuery &sql, int value);
+    void rank(NSqlQuery &sql);
+    void rankContent(QString word);
+    void evaluate(FilterCriteria *criteria);
     void filterFavorite(FilterCriteria *criteria);
     void filterNotebook(FilterCriteria *criteria);
     void filterIndividualNotebook(QString &guid);
@@ -35,7 +91,12 @@ private:
     void filterTrash(FilterCriteria *criteria);
     void filterAttributes(FilterCriteria *criteria);
     void filterSearchString(FilterCriteria *criteria);
-    void filterSearchStringAll(QStringList list);
+    bool filterMaterialized(QString searchString);
+    void matchSearchString(QString searchString, LidBitmap &lids, qint32 lid);
+    void filterSearchStringAll(SearchQuery &searchQuery);
+    void runSearchQuery(SearchQuery &searchQuery);
+    void explainSearchQuery(const SearchQuery &searchQuery);
+    void prepareContentLike(NSqlQuery &sql, QString pattern, bool escaped);
     void splitSearchTerms(QStringList &list, QString search);
     void filterSearchStringNotebookAll(QString string);
     //    void filterSearchTodoAll(QStringList list);
@@ -49,6 +110,7 @@ private:
     void filterSearchStringIntitleAll(QString searchStr);
     void filterSearchStringResourceAll(QString string);
     void filterSearchStringCoordinatesAll(QString string, int key);
+    void filterSearchStringLocationAll(QString string, bool near);
     void filterSearchStringAuthorAll(QString string);
     void filterSearchStringSourceAll(QString string);
     void filterSearchStringSourceApplicationAll(QString string);
@@ -58,7 +120,7 @@ private:
     QDateTime calculateDateTime(QString string);
     void filterSearchStringDateAll(QString string);
 
-    void filterSearchStringAny(QStringList list);
+    void filterSearchStringAny(SearchQuery &searchQuery);
     void filterSearchStringNotebookAny(QString string);
     void filterSearchStringTodoAny(QString string);
     void filterSearchStringReminderOrderAny(QString string);
@@ -66,6 +128,8 @@ private:
     void filterSearchStringIntitleAny(QString string);
     void filterSearchStringResourceAny(QString string);
     void filterSearchStringCoordinatesAny(QString string, int key);
+    void filterSearchStringLocationAny(QString string, bool near);
+    bool prepareLocation(NSqlQuery &sql, QString value, bool near, bool outside);
     void filterSearchStringAuthorAny(QString string);
     void filterSearchStringDateAny(QString string);
     void filterSearchStringSourceAny(QString string);
@@ -77,7 +141,19 @@ private:
 public:
     explicit FilterEngine(QObject *parent = 0);
     void filter(FilterCriteria *newCriteria = nullptr, QList<qint32> *results = nullptr);
+    bool search(FilterCriteria *criteria, bool cache);   // Work out the matching notes without showing them
+    static void apply(const LidBitmap &lids, const QHash<qint32, int> &relevance,
+                      const QHash<qint32, QString> &snippets, const QString &searchString);  // Show a result in the note list
+    static QString getShownSnippet(qint32 lid);          // Search snippet of a note in the note list (GUI thread)
+    void setDatabase(DatabaseConnection *db);            // Run the statements on another connection
+    void setGeneration(const QAtomicInt *latest, qint32 generation);  // Make the search cancellable
+    const LidBitmap &getResults() { return resultLids; }
+    const QHash<qint32, int> &getRelevance() { return relevance; }
+    const QHash<qint32, QString> &getSnippets() { return snippets; }
     bool resourceContains(qint32 resourceLid, QString searchString, QStringList *returnHits);
+    bool searchHits(QList<SearchHit> &hits, qint32 lid, QString searchString, bool withWords);  // Where a search matches a note & its resources
+    bool matches(qint32 lid, FilterCriteria *criteria = nullptr);    // Does one note pass the criteria?
+    bool refilter(qint32 lid);         // Recheck a changed note & patch the note list's filter
     
 signals:
     
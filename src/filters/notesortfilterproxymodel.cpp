@@ -48,6 +48,14 @@ bool NoteSortFilterProxyModel::filterAcceptsRow(qint32 source_row, const QModelI
 }
 
 
+// Hide a note which left the filter.  Its row stays in the source
+// model until the next refresh.
+void NoteSortFilterProxyModel::removeLid(qint32 lid) {
+    lidMap->remove(lid);
+    invalidateFilter();
+}
+
+
 // obsolete/unused
 
 bool NoteSortFilterProxyModel::lessThan(const QModelIndex &left, const QModelIndex &right) const {
@@ -33,6 +33,7 @@ public:
     bool filterAcceptsRow(qint32 source_row, const QModelIndex &source_parent) const;
     //void sort(int column, Qt::SortOrder order);
     bool lessThan(const QModelIndex &left, const QModelIndex &right) const;
+    void removeLid(qint32 lid);        // Hide a note's row without reloading the model
     QMap<qint32, qint32> *lidMap;
 
 signals:
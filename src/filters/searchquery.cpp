@@ -0,0 +1,389 @@
+/*********************************************************************************
+NixNote - An open-source client for the Evernote service.
+Copyright (C) 2013 Randy Baumgarte
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+***********************************************************************************/
+
+
+#include "searchquery.h"
+
+#include <QRegularExpression>
+#include <QtMath>
+#include <algorithm>
+
+// Notes assumed to be in the database before ANALYZE has counted them
+#define SEARCH_DEFAULT_NOTE_COUNT 10000
+
+// Prefixes of the terms which search a specific field.  Each can also
+// be negated with a leading "-".
+static const struct {
+    const char *prefix;
+    SearchTerm::Field field;
+    bool any;                  // Also understood in an "any:" search
+} termPrefixes[] = {
+    { "notebook:",          SearchTerm::Notebook,          true  },
+    { "stack:",             SearchTerm::Stack,             false },
+    { "todo:",              SearchTerm::Todo,              true  },
+    { "reminderOrder:",     SearchTerm::ReminderOrder,     true  },
+    { "reminderTime:",      SearchTerm::ReminderTime,      true  },
+    { "reminderDoneTime:",  SearchTerm::ReminderDoneTime,  true  },
+    { "tag:",               SearchTerm::Tag,               true  },
+    { "intitle:",           SearchTerm::Title,             true  },
+    { "resource:",          SearchTerm::Resource,          true  },
+    { "longitude:",         SearchTerm::Longitude,         true  },
+    { "latitude:",          SearchTerm::Latitude,          true  },
+    { "altitude:",          SearchTerm::Altitude,          true  },
+    { "near:",              SearchTerm::Near,              true  },
+    { "box:",               SearchTerm::Area,              true  },
+    { "author:",            SearchTerm::Author,            true  },
+    { "source:",            SearchTerm::Source,            true  },
+    { "sourceapplication:", SearchTerm::SourceApplication, true  },
+    { "contentclass:",      SearchTerm::ContentClass,      true  },
+    { "recotype:",          SearchTerm::RecognitionType,   true  },
+    { "placename:",         SearchTerm::PlaceName,         false },
+    { "created:",           SearchTerm::Date,              true  },
+    { "updated:",           SearchTerm::Date,              true  },
+    { "subjectdate:",       SearchTerm::Date,              true  }
+};
+
+
+SearchTerm::SearchTerm() {
+    field = Content;
+    negative = false;
+}
+
+
+// Record a row of sqlite_stat1.  The figures are followed by optional
+// keywords, which we don't need.
+void SearchStatistics::add(const QString &index, const QString &stat) {
+    QList<qint64> figures;
+    QStringList words = stat.split(" ", QString::SkipEmptyParts);
+    for (int i=0; i<words.size(); i++) {
+        bool ok;
+        qint64 figure = words[i].toLongLong(&ok);
+        if (!ok)
+            break;
+        figures.append(figure);
+    }
+    indexes.insert(index, figures);
+}
+
+
+// A figure of an index.  Column 0 is the number of rows, column n the
+// average number of rows sharing a value of the first n columns.
+qint64 SearchStatistics::value(const QString &index, int column, qint64 fallback) const {
+    QList<qint64> figures = indexes.value(index);
+    if (column < 0 || column >= figures.size() || figures[column] <= 0)
+        return fallback;
+    return figures[column];
+}
+
+
+// Number of notes
+qint64 SearchStatistics::noteCount() const {
+    return value("Notes_Guid", 0, value("Notes_Notebook_Lid", 0, SEARCH_DEFAULT_NOTE_COUNT));
+}
+
+
+// Estimated number of notes a term matches.  Notebook & tag terms use
+// the average number of notes per notebook or tag & attribute terms
+// the average number of DataStore rows per key.  Nothing tells us how
+// selective words, titles & locations are, so they get a fixed share
+// of the notes.  Patterns FTS can't answer are taken to match the most.
+qint64 SearchTerm::cost(const SearchStatistics &statistics) const {
+    qint64 notes = statistics.noteCount();
+    qint64 perNotebook = statistics.value("Notes_Notebook_Lid", 1, notes/10+1);
+    switch (field) {
+    case Notebook:
+        return perNotebook;
+    case Stack:
+        return qMin(notes, perNotebook*3);
+    case Tag:
+        return statistics.value("NoteTags_Tag_Lid", 1, notes/10+1);
+    case Near:
+    case Area:
+        return notes/20+1;
+    case Content:
+        return notes/10+1;
+    case Title:
+        return notes/4+1;
+    case ContentPattern:
+        return notes/2+1;
+    default:
+        return qMin(notes, statistics.value("DataStore_Key", 1, notes/5+1));
+    }
+}
+
+
+SearchArea::SearchArea() {
+    near = false;
+    latitude = 0;
+    longitude = 0;
+    km = 0;
+    longitudeKm = 0;
+    south = 0;
+    north = 0;
+    west = 0;
+    east = 0;
+}
+
+
+// Read the value of a "near:" or "box:" term & work out its bounding box
+bool SearchArea::parse(const QString &value, bool near) {
+    this->near = near;
+    QStringList parts = value.split(",");
+    QList<double> numbers;
+    for (int i=0; i<parts.size(); i++) {
+        bool ok;
+        numbers.append(parts[i].trimmed().toDouble(&ok));
+        if (!ok)
+            return false;
+    }
+    if (numbers.size() != (near ? 3 : 4))
+        return false;
+
+    if (!near) {
+        south = qMin(numbers[0], numbers[2]);
+        north = qMax(numbers[0], numbers[2]);
+        west = qMin(numbers[1], numbers[3]);
+        east = qMax(numbers[1], numbers[3]);
+        return true;
+    }
+
+    latitude = numbers[0];
+    longitude = numbers[1];
+    km = qAbs(numbers[2]);
+    double latitudeDelta = km / KM_PER_DEGREE_LATITUDE;
+    longitudeKm = KM_PER_DEGREE_LONGITUDE * qCos(qDegreesToRadians(latitude));
+    south = latitude - latitudeDelta;
+    north = latitude + latitudeDelta;
+    west = -180;
+    east = 180;
+    if (longitudeKm > 0.001 && km / longitudeKm < 180 &&
+            longitude - km / longitudeKm >= -180 && longitude + km / longitudeKm <= 180) {
+        west = longitude - km / longitudeKm;
+        east = longitude + km / longitudeKm;
+    }
+    return true;
+}
+
+
+SearchPredicate::SearchPredicate() {
+    type = Intersect;
+    cost = 0;
+    boost = 0;
+    term = -1;
+}
+
+
+SearchQuery::SearchQuery() {
+    any = false;
+    currentTerm = -1;
+}
+
+
+// Build the terms from the tokenized search string.  The first word
+// of an "any:" search is the "any:" itself.
+void SearchQuery::parse(const QStringList &words, bool any) {
+    this->any = any;
+    terms.clear();
+    predicates.clear();
+    boosts.clear();
+
+    int count = sizeof(termPrefixes) / sizeof(termPrefixes[0]);
+    for (qint32 i = any ? 1 : 0; i < words.size(); i++) {
+        SearchTerm term;
+        term.text = words[i];
+        term.text.remove(QChar('"'));
+        QString string = term.text;
+        if (string.startsWith("-"))
+            string = string.mid(1);
+
+        bool found = false;
+        for (int j = 0; j < count && !found; j++) {
+            if ((any && !termPrefixes[j].any) ||
+                    !string.startsWith(termPrefixes[j].prefix, Qt::CaseInsensitive))
+                continue;
+            term.field = termPrefixes[j].field;
+            term.negative = term.text.startsWith("-");
+            term.value = string.mid(QString(termPrefixes[j].prefix).length());
+            found = true;
+        }
+        if (!found) {
+            term.value = string;
+            if (!any && term.text.startsWith("-*")) {
+                term.field = SearchTerm::ContentPattern;
+                term.negative = true;
+            } else if (!any && (term.text.indexOf("_") >= 0 || term.text.indexOf("-") >= 0
+                                || term.text.startsWith("*"))) {
+                // Hyphen & underscore words are searched as typed
+                term.field = SearchTerm::ContentPattern;
+                term.value = term.text;
+            } else {
+                term.field = SearchTerm::Content;
+                term.negative = term.text.startsWith("-");
+            }
+        }
+        terms.append(term);
+    }
+}
+
+
+// Predicates added from now on come from this term
+void SearchQuery::setCurrentTerm(qint32 index) {
+    currentTerm = index;
+}
+
+
+// Record the statement a query has prepared & bound instead of running it
+void SearchQuery::add(SearchPredicate::Type type, const QSqlQuery &sql, int boost) {
+    SearchPredicate predicate;
+    predicate.type = type;
+    predicate.sql = sql.lastQuery();
+    predicate.values = sql.boundValues();
+    predicate.boost = boost;
+    predicate.term = currentTerm;
+
+    if (type == SearchPredicate::Boost || type == SearchPredicate::Rank)
+        boosts.append(predicate);
+    else
+        predicates.append(predicate);
+}
+
+
+// The predicates of one type, the one expected to match the fewest notes
+// first.  Of two equally expensive terms the longer one is taken to be
+// more selective.
+QList<SearchPredicate> SearchQuery::ordered(SearchPredicate::Type type) const {
+    QList<SearchPredicate> list;
+    for (int i=0; i<predicates.size(); i++) {
+        if (predicates[i].type != type)
+            continue;
+        SearchPredicate predicate = predicates[i];
+        if (predicate.term >= 0 && predicate.term < terms.size())
+            predicate.cost = terms[predicate.term].cost(statistics);
+        list.append(predicate);
+    }
+    const QList<SearchTerm> &t = terms;
+    std::stable_sort(list.begin(), list.end(),
+                     [&t](const SearchPredicate &a, const SearchPredicate &b) {
+        if (a.cost != b.cost)
+            return a.cost < b.cost;
+        int lengthA = a.term >= 0 && a.term < t.size() ? t[a.term].value.length() : 0;
+        int lengthB = b.term >= 0 && b.term < t.size() ? t[b.term].value.length() : 0;
+        return lengthA > lengthB;
+    });
+    return list;
+}
+
+
+// The order the predicates are combined in.  Intersections narrow the
+// result down first, then the "any:" union, & the exceptions run last.
+QList<SearchPredicate> SearchQuery::plan() const {
+    QList<SearchPredicate> list = ordered(SearchPredicate::Intersect);
+    list.append(ordered(SearchPredicate::Union));
+    list.append(ordered(SearchPredicate::Except));
+    return list;
+}
+
+
+// Add a predicate's statement as a CTE & return its name.  Its
+// placeholders are renamed so they are unique in the combined statement.
+QString SearchQuery::addStatement(QStringList &ctes, const SearchPredicate &predicate, qint32 number) {
+    QString name = "s" + QString::number(number);
+    QString statement = predicate.sql;
+    statement.replace(QRegularExpression(":([A-Za-z_][A-Za-z0-9_]*)"), ":" + name + "_\\1");
+
+    QMapIterator<QString, QVariant> i(predicate.values);
+    while (i.hasNext()) {
+        i.next();
+        QString placeholder = i.key();
+        if (placeholder.startsWith(":"))
+            placeholder = placeholder.mid(1);
+        compiledValues.insert(":" + name + "_" + placeholder, i.value());
+    }
+
+    ctes.append(name + "(lid) as (" + statement + ")");
+    return name;
+}
+
+
+// Chain the predicates into a single statement.  Every step keeps the
+// notes of the step before it which its statement returns (or doesn't,
+// for a negative term).  False is returned if there is nothing to run.
+bool SearchQuery::compile() {
+    compiledSql = "";
+    compiledValues.clear();
+    if (predicates.isEmpty() && !any)
+        return false;
+
+    QStringList ctes;
+    QString previous;          // The step the next one narrows down
+    qint32 number = 0;
+    QList<SearchPredicate> list = ordered(SearchPredicate::Intersect);
+    QStringList positive;
+    for (int i=0; i<list.size(); i++)
+        positive.append(addStatement(ctes, list[i], number++));
+
+    if (any) {
+        QStringList alternatives;
+        list = ordered(SearchPredicate::Union);
+        for (int i=0; i<list.size(); i++)
+            alternatives.append("select lid from " + addStatement(ctes, list[i], number++));
+        if (alternatives.isEmpty())
+            alternatives.append("select lid from NoteTable where 0");
+        ctes.append("anyterm(lid) as (" + alternatives.join(" union ") + ")");
+        positive.append("anyterm");
+    }
+
+    for (int i=0; i<positive.size(); i++) {
+        QString step = "p" + QString::number(i);
+        QString cte = step + "(lid) as (select lid from " + positive[i];
+        if (!previous.isEmpty())
+            cte += " where lid in (select lid from " + previous + ")";
+        ctes.append(cte + ")");
+        previous = step;
+    }
+
+    // Only negative terms, so start with every note
+    if (previous.isEmpty())
+        previous = "NoteTable";
+    list = ordered(SearchPredicate::Except);
+    for (int i=0; i<list.size(); i++) {
+        QString statement = addStatement(ctes, list[i], number++);
+        QString step = "n" + QString::number(i);
+        ctes.append(step + "(lid) as (select lid from " + previous +
+                    " where lid not in (select lid from " + statement + "))");
+        previous = step;
+    }
+
+    if (!ctes.isEmpty())
+        compiledSql = "with " + ctes.join(", ") + " ";
+    compiledSql += "select lid from " + previous;
+    return true;
+}
+
+
+// The statement compile() built
+QString SearchQuery::getSql() const {
+    return compiledSql;
+}
+
+
+// The values to bind to the compiled statement, by placeholder
+QMap<QString, QVariant> SearchQuery::getValues() const {
+    return compiledValues;
+}
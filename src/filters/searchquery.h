@@ -0,0 +1,192 @@
+/*********************************************************************************
+NixNote - An open-source client for the Evernote service.
+Copyright (C) 2013 Randy Baumgarte
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+***********************************************************************************/
+
+
+#ifndef SEARCHQUERY_H
+#define SEARCHQUERY_H
+
+#include <QString>
+#include <QStringList>
+#include <QList>
+#include <QHash>
+#include <QMap>
+#include <QVariant>
+#include <QSqlQuery>
+
+//***********************************************************
+// A search string parsed into its terms (the syntax tree of
+// the search).  The filter engine evaluates the terms, but
+// while a SearchQuery is active each term only adds the
+// "select lid" statement it would have run as a predicate.
+// compile() then orders the predicates, the one expected to
+// match the fewest notes first, and chains them into one
+// statement where each step only looks at the notes the
+// step before it kept:
+//
+//   with s0(lid) as (...), p0(lid) as (select lid from s0),
+//        s1(lid) as (...), p1(lid) as (select lid from s1
+//            where lid in (select lid from p0)),
+//        s2(lid) as (...), n0(lid) as (select lid from p1
+//            where lid not in (select lid from s2)) ...
+//   select lid from n0
+//
+// SQLite pushes the "lid in" of a step down into its
+// statement, so a later term only has to look at the notes
+// which are still left instead of at every note.  "any:"
+// terms are combined with union into one step of their own.
+// Relevance boosts & ranks are kept aside & run once the
+// result is known.
+//
+// How many notes a term matches is estimated from the
+// figures ANALYZE leaves in sqlite_stat1 (see
+// SearchStatistics).  Without them fixed guesses are used.
+//***********************************************************
+
+// Figures from sqlite_stat1.  For each index: the number of rows,
+// then the average number of rows for each value of the first column,
+// of the first two columns, ...
+class SearchStatistics
+{
+private:
+    QHash<QString, QList<qint64> > indexes;
+
+public:
+    void add(const QString &index, const QString &stat);    // Record a sqlite_stat1 row
+    qint64 value(const QString &index, int column, qint64 fallback) const;  // A figure, or the fallback if we don't have it
+    qint64 noteCount() const;                                // Number of notes
+};
+
+
+class SearchTerm
+{
+public:
+    enum Field {
+        Content,               // Full text (FTS) search
+        ContentPattern,        // "like" search FTS can't do (*word, under_score, hy-phen)
+        Notebook,
+        Stack,
+        Todo,
+        ReminderOrder,
+        ReminderTime,
+        ReminderDoneTime,
+        Tag,
+        Title,
+        Resource,
+        Longitude,
+        Latitude,
+        Altitude,
+        Near,                  // near:latitude,longitude,km
+        Area,                  // box:latitude,longitude,latitude,longitude
+        Author,
+        Source,
+        SourceApplication,
+        ContentClass,
+        PlaceName,
+        RecognitionType,
+        Date
+    };
+
+    Field field;
+    bool negative;             // Term starts with "-"
+    QString text;              // The term as typed (prefix included)
+    QString value;             // The term without its prefix
+
+    SearchTerm();
+    qint64 cost(const SearchStatistics &statistics) const;  // Estimated number of notes the term matches
+};
+
+
+// Kilometres per degree of latitude, & of longitude at the equator
+#define KM_PER_DEGREE_LATITUDE 110.574
+#define KM_PER_DEGREE_LONGITUDE 111.320
+
+//***********************************************************
+// The area a "near:" term (latitude,longitude,km) or a
+// "box:" term (the latitude & longitude of two opposite
+// corners) covers, with the bounding box which holds it.
+// Near the poles or across the date line the box of a
+// "near:" area spans every longitude.
+//***********************************************************
+class SearchArea
+{
+public:
+    bool near;
+    double latitude;           // Centre of a "near:" area
+    double longitude;
+    double km;                 // Radius of a "near:" area
+    double longitudeKm;        // Kilometres per degree of longitude at the centre
+    double south;              // Bounding box
+    double north;
+    double west;
+    double east;
+
+    SearchArea();
+    bool parse(const QString &value, bool near);    // Read the term's value, false if it can't be read
+};
+
+
+class SearchPredicate
+{
+public:
+    enum Type {
+        Intersect,             // Keep the notes the statement returns
+        Except,                // Drop the notes the statement returns
+        Union,                 // "any:" - the notes match if any union statement returns them
+        Boost,                 // Raise the relevance of the notes the statement returns
+        Rank                   // Add the score the statement returns (lid, score) to the relevance
+    };
+
+    Type type;
+    QString sql;
+    QMap<QString, QVariant> values;    // Bound values by placeholder
+    qint64 cost;
+    int boost;
+    qint32 term;               // Index of the term which added it (-1 for none)
+
+    SearchPredicate();
+};
+
+
+class SearchQuery
+{
+private:
+    qint32 currentTerm;
+    QString compiledSql;
+    QMap<QString, QVariant> compiledValues;
+    QList<SearchPredicate> ordered(SearchPredicate::Type type) const;
+    QString addStatement(QStringList &ctes, const SearchPredicate &predicate, qint32 number);
+
+public:
+    bool any;                          // "any:" search
+    QList<SearchTerm> terms;
+    QList<SearchPredicate> predicates;
+    QList<SearchPredicate> boosts;
+    SearchStatistics statistics;       // Used to estimate the cost of the terms
+
+    SearchQuery();
+    void parse(const QStringList &words, bool any); // Build the terms from the tokenized search
+    void setCurrentTerm(qint32 index);              // Predicates added from now on belong to this term
+    void add(SearchPredicate::Type type, const QSqlQuery &sql, int boost=0);  // Record a statement as a predicate
+    QList<SearchPredicate> plan() const;            // The predicates in the order they are evaluated
+    bool compile();                                 // Build the single statement for the plan
+    QString getSql() const;                         // The compiled statement
+    QMap<QString, QVariant> getValues() const;      // Values to bind to the compiled statement
+};
+
+#endif // SEARCHQUERY_H
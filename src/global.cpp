@@ -39,6 +39,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #endif  // End Windows Check
 
 #include "src/sql/usertable.h"
+#include "src/sql/contentcompressor.h"
 
 //******************************************
 //* Global settings used by the program
@@ -83,6 +84,10 @@ Global::Global() {
     this->forceWebFonts = false;
     this->indexPDFLocally = true;
     this->indexRunner = nullptr;
+    this->dbWriter = nullptr;
+    this->dbMaintenance = nullptr;
+    this->searchRunner = nullptr;
+    this->filterApplied = false;
     this->isFullscreen = false;
     this->indexNoteCountPause = -1;
     this->maxIndexInterval = 500;
@@ -192,6 +197,7 @@ void Global::setup(StartupConfig startupConfig, bool guiAvailable) {
     indexNoteCountPause = 100;
     isFullscreen = false;
     indexPDFLocally = getIndexPDFLocally();
+    ContentCompressor::setEnabled(getCompressNoteContent());
     
     forceSearchLowerCase = readSettingForceSearchLowerCase();
     forceSearchWithoutDiacritics = readSettingForceSearchWithoutDiacritics();
@@ -1222,6 +1228,176 @@ void Global::setDatabaseVersion(int value) {
 }
 
 
+// How many notes should a bulk write (sync, import) commit at once?
+int Global::getWriteBatchSize() {
+    settings->beginGroup(INI_GROUP_DATABASE);
+    int value = settings->value("writeBatchSize", 500).toInt();
+    settings->endGroup();
+    return value;
+}
+
+
+// Save the number of notes a bulk write commits at once
+void Global::setWriteBatchSize(int value) {
+    settings->beginGroup(INI_GROUP_DATABASE);
+    settings->setValue("writeBatchSize", value);
+    settings->endGroup();
+}
+
+
+// How many prepared statements should each connection keep?
+int Global::getStatementCacheSize() {
+    settings->beginGroup(INI_GROUP_DATABASE);
+    int value = settings->value("statementCacheSize", 100).toInt();
+    settings->endGroup();
+    return value;
+}
+
+
+// Save the number of prepared statements each connection keeps
+void Global::setStatementCacheSize(int value) {
+    settings->beginGroup(INI_GROUP_DATABASE);
+    settings->setValue("statementCacheSize", value);
+    settings->endGroup();
+}
+
+
+// Page cache (memory budget) for each connection in KiB
+int Global::getDatabaseCacheSize() {
+    settings->beginGroup(INI_GROUP_DATABASE);
+    int value = settings->value("cacheSize", 16384).toInt();
+    settings->endGroup();
+    return value;
+}
+
+
+// Save the page cache size
+void Global::setDatabaseCacheSize(int value) {
+    settings->beginGroup(INI_GROUP_DATABASE);
+    settings->setValue("cacheSize", value);
+    settings->endGroup();
+}
+
+
+// Memory mapped I/O for each connection in MiB
+int Global::getDatabaseMmapSize() {
+    settings->beginGroup(INI_GROUP_DATABASE);
+    int value = settings->value("mmapSize", 256).toInt();
+    settings->endGroup();
+    return value;
+}
+
+
+// Save the memory map size
+void Global::setDatabaseMmapSize(int value) {
+    settings->beginGroup(INI_GROUP_DATABASE);
+    settings->setValue("mmapSize", value);
+    settings->endGroup();
+}
+
+
+// How many lids are reserved each time the lid counter is updated?
+int Global::getLidBlockSize() {
+    settings->beginGroup(INI_GROUP_DATABASE);
+    int value = settings->value("lidBlockSize", 1024).toInt();
+    settings->endGroup();
+    return value;
+}
+
+
+// Save the lid block size
+void Global::setLidBlockSize(int value) {
+    settings->beginGroup(INI_GROUP_DATABASE);
+    settings->setValue("lidBlockSize", value);
+    settings->endGroup();
+}
+
+
+// How many change log entries are kept when the log is compacted?
+int Global::getChangeLogSize() {
+    settings->beginGroup(INI_GROUP_DATABASE);
+    int value = settings->value("changeLogSize", 100000).toInt();
+    settings->endGroup();
+    return value;
+}
+
+
+// Save the change log size
+void Global::setChangeLogSize(int value) {
+    settings->beginGroup(INI_GROUP_DATABASE);
+    settings->setValue("changeLogSize", value);
+    settings->endGroup();
+}
+
+
+// Is note content stored compressed?
+bool Global::getCompressNoteContent() {
+    settings->beginGroup(INI_GROUP_DATABASE);
+    bool value = settings->value("compressNoteContent", true).toBool();
+    settings->endGroup();
+    return value;
+}
+
+
+// Save the note content compression setting
+void Global::setCompressNoteContent(bool value) {
+    settings->beginGroup(INI_GROUP_DATABASE);
+    settings->setValue("compressNoteContent", value);
+    settings->endGroup();
+}
+
+
+// How many hours between database maintenance runs?
+int Global::getMaintenanceInterval() {
+    settings->beginGroup(INI_GROUP_DATABASE);
+    int value = settings->value("maintenanceInterval", 24).toInt();
+    settings->endGroup();
+    return value;
+}
+
+
+// Save the maintenance interval
+void Global::setMaintenanceInterval(int value) {
+    settings->beginGroup(INI_GROUP_DATABASE);
+    settings->setValue("maintenanceInterval", value);
+    settings->endGroup();
+}
+
+
+// How many seconds must the user be idle before maintenance runs?
+int Global::getMaintenanceIdleTime() {
+    settings->beginGroup(INI_GROUP_DATABASE);
+    int value = settings->value("maintenanceIdleTime", 120).toInt();
+    settings->endGroup();
+    return value;
+}
+
+
+// Save the maintenance idle time
+void Global::setMaintenanceIdleTime(int value) {
+    settings->beginGroup(INI_GROUP_DATABASE);
+    settings->setValue("maintenanceIdleTime", value);
+    settings->endGroup();
+}
+
+
+// How long (in ms) may one maintenance slice hold the database writer?
+int Global::getMaintenanceSliceTime() {
+    settings->beginGroup(INI_GROUP_DATABASE);
+    int value = settings->value("maintenanceSliceTime", 250).toInt();
+    settings->endGroup();
+    return value;
+}
+
+
+// Save the maintenance slice time
+void Global::setMaintenanceSliceTime(int value) {
+    settings->beginGroup(INI_GROUP_DATABASE);
+    settings->setValue("maintenanceSliceTime", value);
+    settings->endGroup();
+}
+
+
 // What is doing the system notification?
 QString Global::systemNotifier() {
     settings->beginGroup(INI_GROUP_APPEARANCE);
@@ -1534,4 +1710,21 @@ const QString Global::getSortOrder() const {
 void Global::setSortOrder(const QString &sortOrder) {
     Global::sortOrder = sortOrder;
     saveSettingSortOrder(sortOrder);
-}
\ No newline at end of file
+}
+
+
+// Remember which notes are in the GUI's filter
+void Global::setFilteredLids(const QList<qint32> &lids) {
+    QMutexLocker locker(&filteredLidsLock);
+    filteredLids = lids;
+    filterApplied = true;
+}
+
+
+// Get the notes in the GUI's filter.  Returns false if nothing has
+// been filtered yet.
+bool Global::getFilteredLids(QList<qint32> &lids) {
+    QMutexLocker locker(&filteredLidsLock);
+    lids = filteredLids;
+    return filterApplied;
+}
@@ -33,6 +33,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include <string>
 #include <QSqlDatabase>
 #include <QReadWriteLock>
+#include <QMutex>
 #include <QShortcut>
 #include <QAction>
 #include "src/application.h"
@@ -46,6 +47,9 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include "src/settings/accountsmanager.h"
 #include "src/reminders/remindermanager.h"
 #include "src/sql/databaseconnection.h"
+#include "src/sql/lidmap.h"
+#include "src/sql/connectionpool.h"
+#include "src/sql/lidallocator.h"
 #include "src/threads/indexrunner.h"
 #include "src/utilities/crossmemorymapper.h"
 #include "src/exits/exitpoint.h"
@@ -86,9 +90,12 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 // internal column used for relevance search; value is generated during search
 #define NOTE_TABLE_SEARCH_RELEVANCE_POSITION 26
 
+// internal column with the text around the search match; looked up as the row is shown
+#define NOTE_TABLE_SEARCH_SNIPPET_POSITION 27
+
 
 // count of columns in the table (=> must be last column no. plus 1)
-#define NOTE_TABLE_COLUMN_COUNT 27
+#define NOTE_TABLE_COLUMN_COUNT 28
 
 
 #define MOUSE_MIDDLE_CLICK_NEW_TAB 0
@@ -100,6 +107,9 @@ using namespace std;
 // Forward declare future classes
 class DatabaseConnection;
 class IndexRunner;
+class DatabaseWriter;
+class DatabaseMaintenance;
+class SearchRunner;
 
 #define SET_MESSAGE_TIMEOUT_SHORT 1000
 #define SET_MESSAGE_TIMEOUT_LONGER 15000
@@ -165,6 +175,7 @@ class IndexRunner;
 #define INI_VALUE_SPELLCHECK_LOCALE "spellCheckLocale"
 
 #define INI_GROUP_SEARCH "Search"
+#define INI_GROUP_DATABASE "Database"
 #define INI_GROUP_THUMBNAIL "Thumbnail"
 
 #define INI_GROUP_REMINDERS "Reminders"
@@ -193,6 +204,12 @@ private:
 
     QString sortOrder;
 
+    // Notes in the GUI's current filter.  Other connections copy these
+    // into their own filter table.
+    QMutex filteredLidsLock;
+    QList<qint32> filteredLids;
+    bool filterApplied;
+
 public:
     const QString &getDateFormat() const;
     const QString &getTimeFormat() const;
@@ -304,6 +321,11 @@ public:
     qint32 filterPosition;
 
     QReadWriteLock  *dbLock;                               // Database read/write lock mutex
+    LidMap lidMap;                                         // Process-wide guid <-> lid cache
+    void setFilteredLids(const QList<qint32> &lids);       // Remember the notes in the GUI's filter
+    bool getFilteredLids(QList<qint32> &lids);             // Notes in the GUI's filter (false if none yet)
+    ConnectionPool readPool;                               // Read-only database connections, one per thread
+    LidAllocator lidAllocator;                             // Hands out new lids a block at a time
 
     QHash<qint32, NoteCache*> cache;                         // Note cache  used to keep from needing to re-format the same note for a display
 
@@ -320,6 +342,26 @@ public:
     QFont getGuiFont(QFont f);                                // Get the user's desired GUI font
     int getDatabaseVersion();                                 // What DB version are we using?
     void setDatabaseVersion(int value);                       // Save the current database version
+    int getWriteBatchSize();                                  // Notes per transaction for bulk writes (0 = no batching)
+    void setWriteBatchSize(int value);                        // Save the bulk write commit size
+    int getStatementCacheSize();                              // Prepared statements cached per connection (0 = off)
+    void setStatementCacheSize(int value);                    // Save the statement cache size
+    int getDatabaseCacheSize();                               // Page cache per connection in KiB
+    void setDatabaseCacheSize(int value);                     // Save the page cache size
+    int getDatabaseMmapSize();                                // Memory mapped I/O per connection in MiB (0 = off)
+    void setDatabaseMmapSize(int value);                      // Save the memory map size
+    int getLidBlockSize();                                    // Lids reserved at a time for new objects
+    void setLidBlockSize(int value);                          // Save the lid block size
+    int getChangeLogSize();                                   // Change log entries kept when it is compacted
+    void setChangeLogSize(int value);                         // Save the change log size
+    bool getCompressNoteContent();                            // Store note content compressed?
+    void setCompressNoteContent(bool value);                  // Save the note content compression setting
+    int getMaintenanceInterval();                             // Hours between database maintenance runs (0 = off)
+    void setMaintenanceInterval(int value);                   // Save the maintenance interval
+    int getMaintenanceIdleTime();                             // Seconds the user must be idle before maintenance runs
+    void setMaintenanceIdleTime(int value);                   // Save the maintenance idle time
+    int getMaintenanceSliceTime();                            // Longest a maintenance slice may hold the writer in ms
+    void setMaintenanceSliceTime(int value);                  // Save the maintenance slice time
     bool nonAsciiSortBug;                                     // Workaround for non-ASCII characters in tag name sorting
     ReminderManager *reminderManager;                         // Used to alert the user when a reminder time has expired
 
@@ -416,6 +458,9 @@ public:
     void saveSettingForceSearchLowerCase(bool value) const;
 
     IndexRunner *indexRunner;                                    // Pointer to index thread
+    DatabaseWriter *dbWriter;                                    // Pointer to the database writer thread
+    DatabaseMaintenance *dbMaintenance;                          // Pointer to the idle time database maintenance
+    SearchRunner *searchRunner;                                  // Pointer to the search-as-you-type runner
 
     int minimumThumbnailInterval;                               // Minimum time to scan for thumbnails
     int maximumThumbnailInterval;                               // Maximum time to scan for thumbnails
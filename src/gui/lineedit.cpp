@@ -37,6 +37,10 @@ extern Global global;
 
      connect(this, SIGNAL(returnPressed()), this, SLOT(buildSelection()));
      connect(this, SIGNAL(textChanged(QString)), this, SLOT(textChanged(QString)));
+
+     previewTimer.setSingleShot(true);
+     previewTimer.setInterval(300);
+     connect(&previewTimer, SIGNAL(timeout()), this, SIGNAL(previewRequested()));
  }
 
 
@@ -59,11 +63,26 @@ extern Global global;
      }
 
      filterPosition++;
-     FilterCriteria *newFilter = new FilterCriteria();
+     previewTimer.stop();
+     FilterCriteria *newFilter = buildCriteria();
      global.filterCriteria.push_back(newFilter);
-     FilterCriteria *oldFilter = global.getCurrentCriteria();
      global.filterPosition++;
 
+     emit updateSelectionRequested();
+
+     QLOG_TRACE() << "Leaving LineEdit::buildSelection()";
+ }
+
+
+ //*************************************************************
+ // Build the criteria for the text in the search box, starting
+ // from the current criteria.  It isn't added to the history, so
+ // it can also be used to preview a search while typing.
+ //*************************************************************
+ FilterCriteria *LineEdit::buildCriteria() {
+     FilterCriteria *oldFilter = global.getCurrentCriteria();
+     FilterCriteria *newFilter = new FilterCriteria();
+
      newFilter->setSearchString(text());
      if (!global.getClearNotebookOnSearch() && oldFilter->isNotebookSet())
          newFilter->setNotebook(*oldFilter->getNotebook());
@@ -81,10 +100,7 @@ extern Global global;
      oldFilter->getSelectedNotes(oldLids);
      newFilter->setSelectedNotes(oldLids);
      newFilter->setLid(oldFilter->getLid());
-
-     emit updateSelectionRequested();
-
-     QLOG_TRACE() << "Leaving LineEdit::buildSelection()";
+     return newFilter;
  }
 
 
@@ -111,9 +127,15 @@ extern Global global;
 
 
 
+// Clearing the search box searches at once.  Anything else typed
+// is previewed once the user pauses.
 void LineEdit::textChanged(QString text) {
     if ((text == defaultText || text == "") && savedText != "") {
         buildSelection();
+    } else if (text != defaultText && text.trimmed() != "" && text.trimmed() != savedText) {
+        previewTimer.start();
+    } else {
+        previewTimer.stop();
     }
 }
 
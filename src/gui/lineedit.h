@@ -11,8 +11,10 @@
  #define LINEEDIT_H
 
  #include <QLineEdit>
+ #include <QTimer>
 
  class QToolButton;
+ class FilterCriteria;
 
  class LineEdit : public QLineEdit
  {
@@ -23,12 +25,14 @@
      QString defaultText;
      QString activeColor;
      QString inactiveColor;
+     QTimer previewTimer;              // Waits for a pause in typing before a preview search
 
  public:
      LineEdit(QWidget *parent = 0);
      void updateSelection();
      bool isSet();
      void setFocus(Qt::FocusReason reason);
+     FilterCriteria *buildCriteria();  // Criteria for the text typed, not added to the history
 
  protected:
      virtual void focusInEvent(QFocusEvent *e);
@@ -39,6 +43,7 @@
 
  signals:
      void updateSelectionRequested();
+     void previewRequested();
  };
 
  #endif // LINEEDIT_H
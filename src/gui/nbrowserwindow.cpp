@@ -27,6 +27,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include "src/html/enmlformatter.h"
 #include "src/sql/usertable.h"
 #include "src/sql/resourcetable.h"
+#include "src/sql/blobstore.h"
 #include "src/sql/linkednotebooktable.h"
 #include "src/email/smtpclient.h"
 #include "src/email/mimehtml.h"
@@ -506,7 +507,7 @@ void NBrowserWindow::setContent(qint32 lid) {
         QLOG_DEBUG() << "Note not in cache, lid=" << this->lid;
         NoteFormatter formatter;
         if (criteria->isSearchStringSet())
-            formatter.setHighlightText(criteria->getSearchString());
+            formatter.setHighlightText(criteria->getSearchString(), lid);
 
         formatter.setNote(n, global.pdfPreview);
         //formatter.setHighlight();
@@ -1863,6 +1864,7 @@ void NBrowserWindow::rotateImage(qreal
     QWebSettings::setMaximumPagesInCache(0);
     QWebSettings::setObjectCacheCapacities(0, 0, 0);
     QImage image(global.fileManager.getDbaDirPath() + selectedFileName);
+    BlobStore::detach(global.fileManager.getDbaDirPath() + selectedFileName);
     QMatrix matrix;
     matrix.
             rotate(degrees);
@@ -2268,6 +2270,9 @@ void NBrowserWindow::linkClicked(const QUrl url) {
 #ifdef _WIN32
         fileUrl = fileUrl.replace("\\", "/");
 #endif // End windows check
+        // The attachment may be shared with other notes, so give it its own copy
+        // before an external program can change it.
+        BlobStore::detach(fileUrl);
         global.resourceWatcher->addPath(fileUrl);
         QLOG_DEBUG() << "Opening attachment file (QDesktopServices::openUrl) url=" << fileUrl;
         QDesktopServices::openUrl(fileUrl);
@@ -2461,6 +2466,8 @@ void NBrowserWindow::editLatex(QString incomingLid) {
 
     ConfigStore cs(global.db);
     qint32 newlid = cs.incrementLidCounter();
+    if (newlid < 0)
+        return;
     Resource r;
     NoteTable ntable(global.db);
     ResourceTable rtable(global.db);
@@ -2689,6 +2696,8 @@ qint32 NBrowserWindow::createResource(Resource &r, int sequence, QByteArray data
                                       QString filename) {
     ConfigStore cs(global.db);
     qint32 rlid = cs.incrementLidCounter();
+    if (rlid < 0)
+        return -1;
 
     QByteArray hash = QCryptographicHash::hash(data, QCryptographicHash::Md5);
 
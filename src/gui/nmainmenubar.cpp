@@ -482,6 +482,12 @@ void NMainMenuBar::setupToolsMenu() {
     toolsMenu->addAction(reindexDatabaseAction);
     reindexDatabaseAction->setVisible(global.enableIndexing);
 
+    compactDatabaseAction = new QAction(tr("&Compact database"), this);
+    compactDatabaseAction->setToolTip(tr("Give unused space in the database back to the disk"));
+    setupShortcut(compactDatabaseAction, QString("Tools_Database_Compact"));
+    connect(compactDatabaseAction, SIGNAL(triggered()), parent, SLOT(compactDatabase()));
+    toolsMenu->addAction(compactDatabaseAction);
+
     databaseStatusDialogAction = new QAction(tr("&Database status"), this);
     databaseStatusDialogAction->setToolTip(tr("Database Status"));
     setupShortcut(databaseStatusDialogAction, QString("Tools_Database_Status"));
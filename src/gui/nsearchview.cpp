@@ -22,6 +22,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include "nsearchviewitem.h"
 #include "src/dialog/savedsearchproperties.h"
 #include "src/sql/searchtable.h"
+#include "src/sql/materializedsearch.h"
 #include "src/gui/treewidgeteditor.h"
 #include "src/gui/widgetpanel.h"
 #include "src/sql/nsqlquery.h"
@@ -90,6 +91,9 @@ NSearchView::NSearchView(QWidget *parent) :
     renameAction = context.addAction(tr("Rename"));
     renameAction->setShortcutContext(Qt::WidgetShortcut);
 
+    materializeAction = context.addAction(tr("Keep Results Up To Date"));
+    materializeAction->setCheckable(true);
+
     context.addSeparator();
     propertiesAction = context.addAction(tr("Properties"));
 
@@ -97,6 +101,7 @@ NSearchView::NSearchView(QWidget *parent) :
     connect(deleteAction, SIGNAL(triggered()), this, SLOT(deleteRequested()));
     connect(renameAction, SIGNAL(triggered()), this, SLOT(renameRequested()));
     connect(propertiesAction, SIGNAL(triggered()), this, SLOT(propertiesRequested()));
+    connect(materializeAction, SIGNAL(triggered(bool)), this, SLOT(materializeRequested(bool)));
 
     connect(addShortcut, SIGNAL(activated()), this, SLOT(addRequested()));
     connect(deleteShortcut, SIGNAL(activated()), this, SLOT(deleteRequested()));
@@ -338,10 +343,15 @@ void NSearchView::contextMenuEvent(QContextMenuEvent *event) {
         propertiesAction->setEnabled(false);
         deleteAction->setEnabled(false);
         renameAction->setEnabled(false);
+        materializeAction->setEnabled(false);
+        materializeAction->setChecked(false);
     } else {
         propertiesAction->setEnabled(true);
         deleteAction->setEnabled(true);
         renameAction->setEnabled(true);
+        materializeAction->setEnabled(true);
+        MaterializedSearch materializedSearch(global.db);
+        materializeAction->setChecked(materializedSearch.isMaterialized(items[0]->data(NAME_POSITION, Qt::UserRole).toInt()));
     }
     context.exec(event->globalPos());
 }
@@ -417,6 +427,8 @@ void NSearchView::deleteRequested() {
     }
     SearchTable s(global.db);
     s.deleteSearch(lid);
+    MaterializedSearch materializedSearch(global.db);
+    materializedSearch.setMaterialized(lid, false);
     items[0]->setHidden(true);
     dataStore.remove(lid);
     emit searchDeleted(lid);
@@ -424,6 +436,24 @@ void NSearchView::deleteRequested() {
 
 
 
+//*************************************************************
+// This function is called when a user clicks "keep results
+// up to date" from the popup menu.  The search's results are
+// then stored & only the notes which changed are checked
+// again the next time it is used.
+//*************************************************************
+void NSearchView::materializeRequested(bool materialized) {
+    QList<QTreeWidgetItem*> items = selectedItems();
+    if (items.size() == 0)
+        return;
+
+    qint32 lid = items[0]->data(NAME_POSITION, Qt::UserRole).toInt();
+    MaterializedSearch materializedSearch(global.db);
+    materializedSearch.setMaterialized(lid, materialized);
+}
+
+
+
 //*************************************************************
 // This function is called when a user clicks "rename" from
 // the popup menu.
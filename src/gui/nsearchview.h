@@ -47,6 +47,7 @@ private:
     QAction *propertiesAction;
     QAction *deleteAction;
     QAction *renameAction;
+    QAction *materializeAction;
     //QShortcut *renameShortcut;
     QShortcut *addShortcut;
     QShortcut *deleteShortcut;
@@ -85,6 +86,7 @@ public slots:
     void propertiesRequested();
     void deleteRequested();
     void renameRequested();
+    void materializeRequested(bool materialized);
     void mouseMoveEvent(QMouseEvent *event);
 };
 #endif // NSEARCHVIEW_H
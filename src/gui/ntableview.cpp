@@ -157,6 +157,8 @@ NTableView::NTableView(QWidget *parent) :
         tableViewHeader->thumbnailAction->setChecked(true);
     if (!isColumnHidden(NOTE_TABLE_SEARCH_RELEVANCE_POSITION))
         tableViewHeader->relevanceAction->setChecked(true);
+    if (!isColumnHidden(NOTE_TABLE_SEARCH_SNIPPET_POSITION))
+        tableViewHeader->snippetAction->setChecked(true);
     if (!isColumnHidden(NOTE_TABLE_TAGS_POSITION))
         tableViewHeader->tagsAction->setChecked(true);
     if (!isColumnHidden(NOTE_TABLE_REMINDER_TIME_POSITION))
@@ -196,6 +198,7 @@ NTableView::NTableView(QWidget *parent) :
     this->model()->setHeaderData(NOTE_TABLE_SIZE_POSITION, Qt::Horizontal, QObject::tr("Size"));
     this->model()->setHeaderData(NOTE_TABLE_THUMBNAIL_POSITION, Qt::Horizontal, QObject::tr("Thumbnail"));
     this->model()->setHeaderData(NOTE_TABLE_SEARCH_RELEVANCE_POSITION, Qt::Horizontal, QObject::tr("Relevance"));
+    this->model()->setHeaderData(NOTE_TABLE_SEARCH_SNIPPET_POSITION, Qt::Horizontal, QObject::tr("Snippet"));
     this->model()->setHeaderData(NOTE_TABLE_PINNED_POSITION, Qt::Horizontal, QObject::tr("Pinned"));
 
     contextMenu = new QMenu(this);
@@ -491,14 +494,10 @@ void NTableView::refreshData() {
         priorLidOrder.append(idx.data().toInt());
     }
 
-    NSqlQuery sql(global.db);
-    sql.exec("select lid from filter");
+    QList<qint32> filterLids = global.db->getFilterLids().toList();
     proxy->lidMap->clear();
-    while (sql.next()) {
-        qint32 lid = sql.value(0).toInt();
-        proxy->lidMap->insert(lid, 0);
-    }
-    sql.finish();
+    for (int i=0; i<filterLids.size(); i++)
+        proxy->lidMap->insert(filterLids[i], 0);
     QLOG_DEBUG() << "Valid LIDs retrieved.  Refreshing selection";
     model()->select();
     while (model()->canFetchMore())
@@ -519,6 +518,46 @@ void NTableView::refreshData() {
 }
 
 
+// A note was saved, retagged or moved.  Only that note is checked
+// against the filter.  If it stays in the list just its row is reread,
+// if it left the list its row is hidden.  Only a note which enters the
+// list needs the model to be reloaded.
+void NTableView::refreshNote(qint32 lid) {
+    FilterEngine engine;
+    if (!engine.refilter(lid)) {
+        refreshRow(lid);
+        return;
+    }
+    if (proxy->lidMap->contains(lid))
+        proxy->removeLid(lid);
+    else
+        refreshData();
+}
+
+
+// Reread one note's row & update the cells which changed
+void NTableView::refreshRow(qint32 lid) {
+    if (!proxy->lidMap->contains(lid))
+        return;
+    NSqlQuery sql(global.db);
+    sql.prepare("select * from NoteTableV where lid=:lid");
+    sql.bindValue(":lid", lid);
+    if (!sql.exec() || !sql.next()) {
+        sql.finish();
+        return;
+    }
+    QSqlRecord record = sql.record();
+    sql.finish();
+
+    int rowLocation = proxy->lidMap->value(lid);
+    for (int i = 0; i < record.count() && i < model()->columnCount(); i++) {
+        QModelIndex modelIndex = model()->index(rowLocation, i);
+        if (model()->sourceData(modelIndex, Qt::DisplayRole) != record.value(i))
+            refreshCell(lid, i, record.value(i));
+    }
+}
+
+
 // The note list changed, so we need to reselect any valid notes.
 void NTableView::refreshSelection() {
 
@@ -653,16 +692,11 @@ void NTableView::restoreSelectedNotes() {
         return;
 
     NoteTable ntable(global.db);
-    NSqlQuery sql(global.db);
-    //transaction.exec("begin");
-    sql.prepare("Delete from filter where lid=:lid");
     for (int i = 0; i < lids.size(); i++) {
         ntable.restoreNote(lids[i], true);
-        sql.bindValue(":lid", lids[i]);
-        sql.exec();
+        global.db->updateFilterLid(lids[i], false, 0);
         global.cache.remove(lids[i]);
     }
-    sql.finish();
 
     emit(notesRestored(lids));
 }
@@ -698,19 +732,14 @@ void NTableView::deleteSelectedNotes() {
     }
 
     NoteTable ntable(global.db);
-    NSqlQuery sql(global.db);
-    sql.prepare("Delete from filter where lid=:lid");
     for (int i = 0; i < lids.size(); i++) {
         ntable.deleteNote(lids[i], true);
         if (expunged)
             ntable.expunge(lids[i]);
-        sql.bindValue(":lid", lids[i]);
-        sql.exec();
+        global.db->updateFilterLid(lids[i], false, 0);
         delete global.cache[lids[i]];
         global.cache.remove(lids[i]);
     }
-    //transaction.exec("commit");
-    sql.finish();
     emit(notesDeleted(lids, expunged));
 }
 
@@ -1017,6 +1046,9 @@ void NTableView::saveColumnsVisible() {
     value = isColumnHidden(NOTE_TABLE_SEARCH_RELEVANCE_POSITION);
     global.settings->setValue("relevance", value);
 
+    value = isColumnHidden(NOTE_TABLE_SEARCH_SNIPPET_POSITION);
+    global.settings->setValue("snippet", value);
+
     value = isColumnHidden(NOTE_TABLE_SOURCE_APPLICATION_POSITION);
     global.settings->setValue("sourceApplication", value);
 
@@ -1127,6 +1159,10 @@ void NTableView::setColumnsVisible() {
     tableViewHeader->relevanceAction->setChecked(!value);
     setColumnHidden(NOTE_TABLE_SEARCH_RELEVANCE_POSITION, value);
 
+    value = global.settings->value("snippet", true).toBool();
+    tableViewHeader->snippetAction->setChecked(!value);
+    setColumnHidden(NOTE_TABLE_SEARCH_SNIPPET_POSITION, value);
+
     value = global.settings->value("reminderTime", true).toBool();
     tableViewHeader->reminderTimeAction->setChecked(!value);
     setColumnHidden(NOTE_TABLE_REMINDER_TIME_POSITION, value);
@@ -1218,6 +1254,10 @@ void NTableView::repositionColumns() {
     to = global.getColumnPosition("noteTableRelevancePosition");
     if (to >= 0) horizontalHeader()->moveSection(from, to);
 
+    from = horizontalHeader()->visualIndex(NOTE_TABLE_SEARCH_SNIPPET_POSITION);
+    to = global.getColumnPosition("noteTableSnippetPosition");
+    if (to >= 0) horizontalHeader()->moveSection(from, to);
+
     from = horizontalHeader()->visualIndex(NOTE_TABLE_SOURCE_APPLICATION_POSITION);
     to = global.getColumnPosition("noteTableSourceApplicationPosition");
     if (to >= 0) horizontalHeader()->moveSection(from, to);
@@ -1324,6 +1364,9 @@ void NTableView::resizeColumns() {
     width = global.getColumnWidth("noteTableRelevancePosition");
     if (width > 0) setColumnWidth(NOTE_TABLE_SEARCH_RELEVANCE_POSITION, width);
 
+    width = global.getColumnWidth("noteTableSnippetPosition");
+    if (width > 0) setColumnWidth(NOTE_TABLE_SEARCH_SNIPPET_POSITION, width);
+
     width = global.getColumnWidth("noteTableReminderTimePosition");
     if (width > 0) setColumnWidth(NOTE_TABLE_REMINDER_TIME_POSITION, width);
 
@@ -135,6 +135,8 @@ public slots:
 
     void refreshData();
     void refreshCell(qint32 lid, int cell, QVariant data);
+    void refreshNote(qint32 lid);
+    void refreshRow(qint32 lid);
 
     void dragMoveEvent(QDragMoveEvent *event);
     void dragEnterEvent(QDragEnterEvent *event);
@@ -148,6 +148,11 @@ NTableViewHeader::NTableViewHeader(Qt::Orientation orientation, QWidget *parent)
     relevanceAction->setCheckable(true);
     addAction(relevanceAction);
 
+    snippetAction = new QAction(this);
+    snippetAction->setText(tr("Search Snippet"));
+    snippetAction->setCheckable(true);
+    addAction(snippetAction);
+
 
     this->setMouseTracking(true);
 
@@ -166,6 +171,7 @@ NTableViewHeader::NTableViewHeader(Qt::Orientation orientation, QWidget *parent)
     connect(sizeAction, SIGNAL(toggled(bool)), this, SLOT(sizeChecked(bool)));
     connect(thumbnailAction, SIGNAL(toggled(bool)), this, SLOT(thumbnailChecked(bool)));
     connect(relevanceAction, SIGNAL(toggled(bool)), this, SLOT(relevanceChecked(bool)));
+    connect(snippetAction, SIGNAL(toggled(bool)), this, SLOT(snippetChecked(bool)));
     connect(latitudeAction, SIGNAL(toggled(bool)), this, SLOT(latitudeChecked(bool)));
     connect(longitudeAction, SIGNAL(toggled(bool)), this, SLOT(longitudeChecked(bool)));
     connect(altitudeAction, SIGNAL(toggled(bool)), this, SLOT(altitudeChecked(bool)));
@@ -294,6 +300,10 @@ void NTableViewHeader::relevanceChecked(bool checked) {
     emit (setColumnVisible(NOTE_TABLE_SEARCH_RELEVANCE_POSITION, checked));
     checkActions();
 }
+void NTableViewHeader::snippetChecked(bool checked) {
+    emit (setColumnVisible(NOTE_TABLE_SEARCH_SNIPPET_POSITION, checked));
+    checkActions();
+}
 void NTableViewHeader::reminderTimeChecked(bool checked) {
     emit (setColumnVisible(NOTE_TABLE_REMINDER_TIME_POSITION, checked));
     checkActions();
@@ -73,6 +73,18 @@ NTagView::NTagView(QWidget *parent) :
     this->setMinimumHeight(1);
     this->addTopLevelItem(root);
     this->rebuildTagTreeNeeded = true;
+
+    // Only reload the tags when the change log says a tag changed (or it
+    // lost track & we can't tell).
+    tagsChanged = true;
+    changeSubscription = global.db->subscribe([this](const QList<ChangeLogEntry> &changes, bool complete) {
+        if (!complete)
+            tagsChanged = true;
+        for (int i=0; i<changes.size(); i++) {
+            if (changes[i].type == CHANGE_ENTITY_TAG)
+                tagsChanged = true;
+        }
+    });
     this->loadData();
     setVerticalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
     setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
@@ -143,6 +155,7 @@ NTagView::NTagView(QWidget *parent) :
 
 // Destructor
 NTagView::~NTagView() {
+    global.db->unsubscribe(changeSubscription);
     delete root;
 }
 
@@ -239,6 +252,10 @@ void NTagView::mousePressEvent(QMouseEvent *event)
 
 // Load up the data from the database
 void NTagView::loadData() {
+    global.db->publishChanges();
+    if (!tagsChanged)
+        return;
+    tagsChanged = false;
 
     // Empty out the old data store
     QList<qint32> keys = dataStore.keys();
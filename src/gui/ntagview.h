@@ -48,6 +48,8 @@ private:
     qint32 accountFilter;
     QImage *expandedImage;
     QImage *collapsedImage;
+    qint32 changeSubscription;      // Our change log subscription
+    bool tagsChanged;               // Has a tag changed since the last loadData()?
 
 private slots:
     int calculateHeightRec(QTreeWidgetItem * item);
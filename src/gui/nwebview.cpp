@@ -31,6 +31,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 //#include "./libencrypt/encrypt.h"
 #include "../dialog/endecryptdialog.h"
 #include "src/sql/resourcetable.h"
+#include "src/sql/blobstore.h"
 
 extern Global global;
 
@@ -556,8 +557,7 @@ void NWebView::downloadRequested(QNetworkRequest req) {
             if (fd.selectedFiles().size() == 0)
                 return;
             QString newname = fd.selectedFiles()[0];
-            QFile::remove(urlString);
-            QFile::copy(oldname, newname);
+            BlobStore::copyOut(oldname, newname);
             return;
         }
 
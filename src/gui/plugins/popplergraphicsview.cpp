@@ -19,6 +19,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 
 #include "popplergraphicsview.h"
 #include "src/global.h"
+#include "src/sql/blobstore.h"
 #include <QDesktopServices>
 #include <QGraphicsView>
 #include <QUrl>
@@ -39,6 +40,7 @@ PopplerGraphicsView::PopplerGraphicsView(QGraphicsScene *&scene) :
 
 void PopplerGraphicsView::mousePressEvent(QMouseEvent * e) {
    Q_UNUSED(e);  // suppress unused variable warning
+   BlobStore::detach(filename);     // The viewer may save changes into the file
    QDesktopServices::openUrl(QUrl(filename));
    QGraphicsView(parent);
 }
@@ -28,6 +28,8 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include "src/sql/notebooktable.h"
 #include "src/sql/sharednotebooktable.h"
 #include "src/sql/linkednotebooktable.h"
+#include "src/sql/connectionpool.h"
+#include "src/sql/blobstore.h"
 #include "src/global.h"
 #include "src/filters/filtercriteria.h"
 #include "src/filters/filterengine.h"
@@ -147,7 +149,8 @@ QByteArray NoteFormatter::rebuildNoteHTML() {
     formatError = false;
     readOnly = false;
 
-    ResourceTable resTable(global.db);
+    ReadConnection reader;
+    ResourceTable resTable(reader.db);
     if (!haveGuid) {
         formatError = true;
         readOnly = true;
@@ -180,7 +183,7 @@ QByteArray NoteFormatter::rebuildNoteHTML() {
     content.append("</html>");
 
     if (!formatError && !readOnly) {
-        NotebookTable ntable(global.db);
+        NotebookTable ntable(reader.db);
         if (note.notebookGuid.isSet()) {
             qint32 notebookLid = ntable.getLid(note.notebookGuid);
             if (ntable.isReadOnly(notebookLid)) {
@@ -339,11 +342,12 @@ void NoteFormatter::modifyTags(QWebPage &doc) {
   text in a note, it highlights the text in an image. */
 QString NoteFormatter::addImageHighlight(qint32 resLid, QString imgfile) {
     QLOG_TRACE_IN();
-    if (highlightWords.size() == 0)
+    if (highlightWords.size() == 0 || !highlightResources.contains(resLid))
         return "";
 
     // Get the image resource recognition data.  This tells where to highlight the image
-    ResourceTable resTable(global.db);
+    ReadConnection reader;
+    ResourceTable resTable(reader.db);
     Resource recoResource;
     resTable.getResourceRecognition(recoResource, resLid);
     Data recognition;
@@ -585,7 +589,8 @@ void NoteFormatter::modifyApplicationTags(QWebElement &enmedia, QString &hash, Q
         return;
     }
 
-    ResourceTable resTable(global.db);
+    ReadConnection reader;
+    ResourceTable resTable(reader.db);
     QString contextFileName;
     QLOG_DEBUG() << "htmlfmt: fetching for note: " << note.guid << " hash: " << hash;
     qint32 resLid = resTable.getLidByHashHex(note.guid, hash);
@@ -601,9 +606,12 @@ void NoteFormatter::modifyApplicationTags(QWebElement &enmedia, QString &hash, Q
         }
 
         // Check that we don't have a locked PDF.  If we do, then disable PDF previews.
+        // PDFs are read straight from the blob store when we have the body there.
+        QString pdfFile;
         if (mimetype == "application/pdf") {
-            QString file = global.fileManager.getDbaDirPath() + QString::number(resLid) + ".pdf";
-            Poppler::Document *doc = Poppler::Document::load(file);
+            BlobStore blobs(reader.db);
+            pdfFile = blobs.getResourcePath(resLid, ".pdf", QByteArray::fromHex(hash.toLatin1()));
+            Poppler::Document *doc = Poppler::Document::load(pdfFile);
             if (doc != nullptr && doc->isLocked()) {
                 pdfPreview = false;
             }
@@ -619,7 +627,7 @@ void NoteFormatter::modifyApplicationTags(QWebElement &enmedia, QString &hash, Q
         if (mimetype == "application/pdf" && pdfPreview && thumbnail) {
             QString printImageFile =
                     global.fileManager.getTmpDirPath() + QString::number(resLid) + QString("-print.jpg");
-            QString file = global.fileManager.getDbaDirPath() + QString::number(resLid) + ".pdf";
+            QString file = pdfFile;
             Poppler::Document *doc;
             doc = Poppler::Document::load(file);
             if (doc == nullptr)
@@ -698,13 +706,8 @@ void NoteFormatter::modifyApplicationTags(QWebElement &enmedia, QString &hash, Q
 QString NoteFormatter::findIcon(qint32 lid, Resource r, QString fileExt) {
     QLOG_TRACE_IN();
 
-    FilterCriteria *criteria = global.getCurrentCriteria();
     // First get the icon for this type of file
-    resourceHighlight = false;
-    if (criteria->isSearchStringSet() && criteria->getSearchString() != "") {
-        FilterEngine engine;
-        resourceHighlight = engine.resourceContains(lid, criteria->getSearchString(), nullptr);
-    }
+    resourceHighlight = highlightResources.contains(lid);
 
     QString fileName = global.fileManager.getDbaDirPath() + QString::number(lid) + fileExt;
     QIcon icon;
@@ -802,7 +805,8 @@ void NoteFormatter::modifyTodoTags(QWebElement &todo) {
 bool NoteFormatter::buildInkNote(QWebElement &docElem, QString &hash) {
     QLOG_TRACE_IN();
 
-    ResourceTable resTable(global.db);
+    ReadConnection reader;
+    ResourceTable resTable(reader.db);
     qint32 resLid = resTable.getLidByHashHex(note.guid, hash);
     if (resLid <= 0)
         return false;
@@ -835,12 +839,23 @@ void NoteFormatter::modifyPdfTags(qint32 resLid, QWebElement &enmedia) {
 }
 
 
-void NoteFormatter::setHighlightText(QString text) {
+// Set the search string to highlight.  The note's resources it is
+// found in are looked up here with one query, rather than searching
+// each one as it is formatted.
+void NoteFormatter::setHighlightText(QString text, qint32 noteLid) {
     QLOG_TRACE_IN();
     QStringList temp = text.split(" ");
     for (int i = 0; i < temp.size(); i++) {
         if (temp[i].trimmed() != "")
             highlightWords.append(temp[i]);
     }
+
+    FilterEngine engine;
+    QList<SearchHit> hits;
+    engine.searchHits(hits, noteLid, text, false);
+    for (int i = 0; i < hits.size(); i++) {
+        if (hits[i].lid != noteLid)
+            highlightResources.insert(hits[i].lid);
+    }
     QLOG_TRACE_OUT();
 }
@@ -29,6 +29,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include <QString>
 #include <QMap>
 #include <QHash>
+#include <QSet>
 #include <QVector>
 #include <QtXml>
 #include "src/qevercloud/QEverCloud/headers/QEverCloud.h"
@@ -48,6 +49,7 @@ private:
     bool pdfPreview;
     QList<QTemporaryFile *> tempFiles;
     QStringList highlightWords;
+    QSet<qint32> highlightResources;    // Resources the search string was found in
     bool noteHistory;
     bool formatError;
 
@@ -94,7 +96,7 @@ public:
 
     bool buildInkNote(QWebElement &docElem, QString &hash);
 
-    void setHighlightText(QString text);
+    void setHighlightText(QString text, qint32 noteLid);
 
 
 signals:
@@ -30,6 +30,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include <iostream>
 #include <QMessageBox>
 #include <QSharedMemory>
+#include <QElapsedTimer>
 
 // Windows Check
 #ifndef _WIN32
@@ -106,6 +107,8 @@ void sighup_handler(int sig) {
 //* Main entry point to the program.
 //*********************************************************************
 int main(int argc, char *argv[]) {
+    QElapsedTimer startupTimer;
+    startupTimer.start();
     w = NULL;
     bool guiAvailable = true;
 
@@ -329,6 +332,7 @@ int main(int argc, char *argv[]) {
         w->hide();
     if (global.startMinimized)
         w->showMinimized();
+    QLOG_INFO() << "Startup complete in " << startupTimer.elapsed() << "ms";
 
     // show message, if there is any configured
     w->showAnnouncementMessage();
@@ -21,6 +21,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include "src/logger/qslog.h"
 #include "src/global.h"
 #include "src/sql/nsqlquery.h"
+#include "src/filters/filterengine.h"
 
 #include <QString>
 #include <QSqlDatabase>
@@ -46,7 +47,10 @@ NoteModel::NoteModel(QObject *parent)
     if (!sql.next())
         this->createNoteTable();
 
-    sql.exec("Select * from sqlite_master where type='view' and name='NoteTableV';");
+    // The view reads the connection's TEMP filter table, so it is
+    // temporary too.
+    global.db->createFilterTable();
+    sql.exec("Select * from sqlite_temp_master where type='view' and name='NoteTableV';");
     if (!sql.next())
         this->createNoteTableV();
 
@@ -135,11 +139,11 @@ void NoteModel::createNoteTable() {
 void NoteModel::createNoteTableV() {
     QLOG_DEBUG() << "Creating table NoteTableV";
     NSqlQuery sql(global.db);
-    sql.exec("create view NoteTableV as select lid,dateCreated,dateUpdated,title,notebookLid,notebook,tags,author,"
+    sql.exec("create temp view NoteTableV as select lid,dateCreated,dateUpdated,title,notebookLid,notebook,tags,author,"
                  "dateSubject,dateDeleted,source,sourceUrl,sourceApplication,latitude,longitude,altitude,"
                  "hasEncryption,hasTodo,isDirty,size,reminderOrder,reminderTime,reminderDoneTime,"
-                 "isPinned,titleColor,thumbnail,(select f.relevance from filter f where f.lid=n.lid) as relevance "
-                 "from NoteTable n");
+                 "isPinned,titleColor,thumbnail,(select f.relevance from filter f where f.lid=n.lid) as relevance,"
+                 "null as snippet from NoteTable n");
     sql.finish();
 }
 
@@ -194,6 +198,15 @@ QVariant NoteModel::data(const QModelIndex &index, int role) const {
             return (isDirty ? QString("▲") : QString("")) + QString(" ") + title;
         }
     }
+    if (column == NOTE_TABLE_SEARCH_SNIPPET_POSITION && (role == Qt::DisplayRole || role == Qt::ToolTipRole)) {
+        qint32 lid = index.sibling(row, NOTE_TABLE_LID_POSITION).data(Qt::DisplayRole).toInt();
+        QString text = FilterEngine::getShownSnippet(lid);
+        if (role == Qt::DisplayRole)
+            return text.remove(SEARCH_HIT_START).remove(SEARCH_HIT_END);
+        if (text == "")
+            return QVariant();
+        return text.toHtmlEscaped().replace(SEARCH_HIT_START, "<b>").replace(SEARCH_HIT_END, "</b>");
+    }
     if ((role == Qt::FontRole) && (column == NOTE_TABLE_TITLE_POSITION)) {
         int relevance = index.sibling(row, NOTE_TABLE_SEARCH_RELEVANCE_POSITION).data(Qt::DisplayRole).toInt();
         if (relevance > 0) {
@@ -230,4 +243,3 @@ bool NoteModel::select() {
     QLOG_DEBUG() << "Performing NoteModel select " << selectStatement();
     return QSqlTableModel::select();
 }
-
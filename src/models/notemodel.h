@@ -26,7 +26,6 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 class NoteModel : public QSqlTableModel
 {
     Q_OBJECT
-private:
 public:
     explicit NoteModel(QObject *parent = 0);
     ~NoteModel();
@@ -36,6 +35,7 @@ public:
     // NoteTable - data table with note data
     void createNoteTable();
     // NoteTableV - view based on NoteTable used to get "relevance" column from "filter" table
+    // and an empty "snippet" column filled in by data()
     void createNoteTableV();
 
     Qt::ItemFlags flags(const QModelIndex &index) const;
@@ -23,6 +23,8 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include "src/watcher/filewatcher.h"
 #include "src/dialog/accountdialog.h"
 #include "src/dialog/preferences/preferencesdialog.h"
+#include "src/sql/fulltextindex.h"
+#include "src/sql/trigramindex.h"
 #include "src/sql/resourcetable.h"
 #include "src/sql/nsqlquery.h"
 #include "src/filters/filtercriteria.h"
@@ -137,11 +139,14 @@ NixNote::NixNote(QWidget *parent) : QMainWindow(parent) {
 
     connect(&syncThread, SIGNAL(started()), this, SLOT(syncThreadStarted()));
     connect(&counterThread, SIGNAL(started()), this, SLOT(counterThreadStarted()));
+    connect(&searchThread, SIGNAL(started()), this, SLOT(searchThreadStarted()));
+    connect(&searchThread, SIGNAL(finished()), &searchRunner, SLOT(close()), Qt::DirectConnection);
     connect(&indexThread, SIGNAL(started()), this, SLOT(indexThreadStarted()));
 
     counterThread.start(QThread::LowestPriority);
     syncThread.start(QThread::LowPriority);
     indexThread.start(QThread::LowestPriority);
+    searchThread.start(QThread::LowPriority);
     this->thread()->setPriority(QThread::HighestPriority);
 
     heartbeatTimer.setInterval(1000);
@@ -153,6 +158,16 @@ NixNote::NixNote(QWidget *parent) : QMainWindow(parent) {
 
     db = new DatabaseConnection(NN_DB_CONNECTION_NAME);  // Startup the database
 
+    // Background writes go through a single writer connection
+    dbWriter.start(QThread::LowPriority);
+    global.dbWriter = &dbWriter;
+    NoteTable::compressOldContentInBackground();
+    FullTextIndex::migrateInBackground();
+    TrigramIndex::buildInBackground();
+    global.dbMaintenance = &dbMaintenance;
+    dbMaintenance.start();
+    global.searchRunner = &searchRunner;
+
     // Setup the sync thread
     QLOG_DEBUG() << "Setting up counter thread";
     connect(this, SIGNAL(updateCounts()), &counterRunner, SLOT(countAll()));
@@ -186,6 +201,8 @@ NixNote::NixNote(QWidget *parent) : QMainWindow(parent) {
     connect(attributeTree, SIGNAL(updateSelectionRequested()), this, SLOT(updateSelectionCriteria()));
     connect(trashTree, SIGNAL(updateSelectionRequested()), this, SLOT(updateSelectionCriteria()));
     connect(searchText, SIGNAL(updateSelectionRequested()), this, SLOT(updateSelectionCriteria()));
+    connect(searchText, SIGNAL(previewRequested()), this, SLOT(previewSearch()));
+    connect(&searchRunner, SIGNAL(searchComplete(qint32)), this, SLOT(searchComplete(qint32)));
     connect(global.resourceWatcher, SIGNAL(fileChanged(QString)), this, SLOT(resourceExternallyUpdated(QString)));
 
     hammer = new Thumbnailer(global.db);
@@ -254,9 +271,12 @@ NixNote::~NixNote() {
     syncThread.quit();
     indexThread.quit();
     counterThread.quit();
+    searchThread.quit();
     while (!syncThread.isFinished());
     while (!indexThread.isFinished());
     while (!counterThread.isFinished());
+    while (!searchThread.isFinished());
+    dbWriter.stop();
 
     // Cleanup any temporary files
     if (global.purgeTemporaryFilesOnShutdown) {
@@ -609,7 +629,7 @@ void NixNote::setupGui() {
     connect(&syncRunner, SIGNAL(syncComplete()), this, SLOT(notifySyncComplete()));
 
     // connect so we refresh the note list and counts whenever a note has changed
-    connect(tabWindow, SIGNAL(noteUpdated(qint32)), noteTableView, SLOT(refreshData()));
+    connect(tabWindow, SIGNAL(noteUpdated(qint32)), noteTableView, SLOT(refreshNote(qint32)));
     connect(tabWindow, SIGNAL(noteUpdated(qint32)), &counterRunner, SLOT(countNotebooks()));
     connect(tabWindow, SIGNAL(noteUpdated(qint32)), &counterRunner, SLOT(countTags()));
     connect(tabWindow, SIGNAL(noteTagsUpdated(QString, qint32, QStringList)), noteTableView,
@@ -920,6 +940,10 @@ void NixNote::counterThreadStarted() {
     counterRunner.moveToThread(&counterThread);
 }
 
+void NixNote::searchThreadStarted() {
+    searchRunner.moveToThread(&searchThread);
+}
+
 
 //***************************************************************
 //* Signal received when the syncRunner thread has started
@@ -1299,6 +1323,8 @@ void NixNote::saveOnExit() {
     QLOG_DEBUG() << "saveOnExit: Closing threads";
     indexThread.quit();
     counterThread.quit();
+    dbWriter.stop();
+    global.readPool.close();
 
     QLOG_DEBUG() << "Exiting saveOnExit()";
 }
@@ -1404,6 +1430,8 @@ void NixNote::saveNoteColumnPositions() {
     global.setColumnPosition("noteTableThumbnailPosition", position);
     position = noteTableView->horizontalHeader()->visualIndex(NOTE_TABLE_SEARCH_RELEVANCE_POSITION);
     global.setColumnPosition("noteTableRelevancePosition", position);
+    position = noteTableView->horizontalHeader()->visualIndex(NOTE_TABLE_SEARCH_SNIPPET_POSITION);
+    global.setColumnPosition("noteTableSnippetPosition", position);
 }
 
 
@@ -1460,6 +1488,8 @@ void NixNote::saveNoteColumnWidths() {
     global.setColumnWidth("noteTableThumbnailPosition", width);
     width = noteTableView->columnWidth(NOTE_TABLE_SEARCH_RELEVANCE_POSITION);
     global.setColumnWidth("noteTableRelevancePosition", width);
+    width = noteTableView->columnWidth(NOTE_TABLE_SEARCH_SNIPPET_POSITION);
+    global.setColumnWidth("noteTableSnippetPosition", width);
 }
 
 
@@ -1699,6 +1729,7 @@ void NixNote::updateSelectionCriteria(bool afterSync) {
         global.cache.remove(keys[i]);
     }
 
+    searchRunner.cancel();
     FilterEngine filterEngine;
     filterEngine.filter();
 
@@ -1762,6 +1793,35 @@ void NixNote::updateSelectionCriteria(bool afterSync) {
 }
 
 
+//******************************************************************
+//* The user paused typing in the search box.  Search for what
+//* has been typed so far on the search thread.  The result is
+//* shown in the note list but isn't added to the history until
+//* the user presses enter.
+//******************************************************************
+void NixNote::previewSearch() {
+    searchRunner.request(searchText->buildCriteria());
+}
+
+
+//******************************************************************
+//* A search started by previewSearch() is done.  Show it if
+//* nothing newer has been requested since.
+//******************************************************************
+void NixNote::searchComplete(qint32 generation) {
+    LidBitmap lids;
+    QHash<qint32, int> relevance;
+    QHash<qint32, QString> snippets;
+    QString searchString;
+    if (!searchRunner.takeResult(generation, lids, relevance, snippets, searchString))
+        return;
+    FilterEngine::apply(lids, relevance, snippets, searchString);
+    noteTableView->refreshData();
+    noteTableView->scrollToTop();
+    searchRunner.shown();
+}
+
+
 //******************************************************************
 //* Check if the notebook selected is read-only.  With
 //* read-only notes the editor and a lot of actions are disabled.
@@ -3190,6 +3250,20 @@ void NixNote::reindexDatabase() {
 }
 
 
+// Compact the database.  This rewrites the whole file, so it is only
+// done when the user asks.
+void NixNote::compactDatabase() {
+    int response = QMessageBox::question(this, tr("Compact Database"),
+                                         tr("Compacting rewrites the whole database and may take a while.  Continue?"),
+                                         QMessageBox::Yes | QMessageBox::No, QMessageBox::No);
+    if (response != QMessageBox::Yes)
+        return;
+
+    global.dbMaintenance->vacuumNow();
+    setMessage(tr("The database will be compacted in the background."));
+}
+
+
 // Open/Close selected notebooks
 void NixNote::openCloseNotebooks() {
     CloseNotebookDialog dialog;
@@ -3260,14 +3334,10 @@ void NixNote::deleteCurrentNote() {
     }
 
     NoteTable ntable(global.db);
-    NSqlQuery sql(global.db);
-    sql.prepare("Delete from filter where lid=:lid");
     ntable.deleteNote(lid, true);
     if (expunged)
         ntable.expunge(lid);
-    sql.bindValue(":lid", lid);
-    sql.exec();
-    sql.finish();
+    global.db->updateFilterLid(lid, false, 0);
     delete global.cache[lid];
     global.cache.remove(lid);
     QList<qint32> lids;
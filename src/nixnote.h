@@ -49,6 +49,9 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include "src/gui/ntrashtree.h"
 #include "src/dialog/accountdialog.h"
 #include "src/threads/counterrunner.h"
+#include "src/threads/databasewriter.h"
+#include "src/threads/databasemaintenance.h"
+#include "src/threads/searchrunner.h"
 #include "src/html/thumbnailer.h"
 #include "src/reminders/remindermanager.h"
 
@@ -194,8 +197,12 @@ public:
     QThread syncThread;
     QThread indexThread;
     QThread counterThread;
+    QThread searchThread;
     IndexRunner indexRunner;
     CounterRunner counterRunner;
+    DatabaseWriter dbWriter;
+    DatabaseMaintenance dbMaintenance;
+    SearchRunner searchRunner;
     void closeEvent(QCloseEvent *event);
     //bool notify(QObject* receiver, QEvent* event);
     bool event(QEvent *event);
@@ -277,10 +284,14 @@ public slots:
     void viewNoteListNarrow();
     void resourceExternallyUpdated(QString resource);
     void reindexDatabase();
+    void compactDatabase();
     void noteSynchronized(qint32 lid, bool value);
     void indexThreadStarted();
     void syncThreadStarted();
     void counterThreadStarted();
+    void searchThreadStarted();
+    void previewSearch();
+    void searchComplete(qint32 generation);
     void openCloseNotebooks();
     void deleteCurrentNote();
     bool isOkToDeleteNote(QString msg);
@@ -20,6 +20,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 
 #include "remindermanager.h"
 #include "src/sql/notetable.h"
+#include "src/sql/noteloader.h"
 #include "src/global.h"
 
 extern Global global;
@@ -59,18 +60,15 @@ void ReminderManager::timerPop() {
 
 void ReminderManager::checkReminders() {
     QString msg;
-    NoteTable ntable(global.db);
     QDateTime now = QDateTime::currentDateTime();
+    QList<qint32> dueLids;
     for (int i=reminders.size()-1; i>=0; i--) {
-        Note note;
         ReminderEvent *event;
         event = reminders[i];
         if (event->time > global.getLastReminderTime() ||
                 global.getLastReminderTime() == 0) {
             if (event->time <= now.currentMSecsSinceEpoch()) {
-              ntable.get(note, event->lid, false, false);
-              QString title = note.title;
-              msg = msg+title+"\n";
+              dueLids.append(event->lid);
               delete reminders[i];
               reminders.removeAt(i);
             }
@@ -81,6 +79,14 @@ void ReminderManager::checkReminders() {
             }
         }
     }
+
+    // Load the titles of all the due notes together
+    NoteLoader loader(global.db, dueLids, false, false);
+    Note note;
+    while (loader.next(note)) {
+        QString title = note.title;
+        msg = msg+title+"\n";
+    }
     if (msg.trimmed() != "")
         emit showMessage(tr("Reminders Due"), msg, 10000);
     global.setLastReminderTime(now.currentMSecsSinceEpoch());
@@ -0,0 +1,327 @@
+/*********************************************************************************
+NixNote - An open-source client for the Evernote service.
+Copyright (C) 2013 Randy Baumgarte
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+***********************************************************************************/
+
+#include "blobstore.h"
+#include "src/global.h"
+#include "src/sql/nsqlquery.h"
+#include "src/sql/resourcetable.h"
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QSet>
+#include <climits>
+
+// Windows Check
+#ifndef _WIN32
+#include <unistd.h>
+#endif // End windows check
+
+extern Global global;
+
+// A mapped blob.  The view handed out by map() is built with
+// fromRawData, so every copy a caller makes shares the reference count
+// of the view kept here.  Once the holder's view is the only reference
+// left nobody can see the mapped bytes any more and it can be unmapped.
+class MappedBlob {
+public:
+    QFile *file;
+    QByteArray view;
+
+    MappedBlob(QFile *file, const char *data, int size) {
+        this->file = file;
+        view = QByteArray::fromRawData(data, size);
+    }
+    ~MappedBlob() {
+        view.clear();
+        delete file;   // Unmaps everything mapped through the file
+    }
+    bool inUse() {
+        return view.data_ptr()->ref.isShared();
+    }
+};
+static QHash<QByteArray, MappedBlob*> mappedBlobs;
+static QMutex mappedBlobsMutex;
+
+
+// Unmap blobs nobody holds a view of any more.  The caller must hold
+// mappedBlobsMutex.  Views are only created under the mutex, so a blob
+// which isn't in use here can't gain a new user before it is unmapped.
+static void releaseMappings() {
+    QMutableHashIterator<QByteArray, MappedBlob*> it(mappedBlobs);
+    while (it.hasNext()) {
+        it.next();
+        if (!it.value()->inUse()) {
+            delete it.value();
+            it.remove();
+        }
+    }
+}
+
+
+// Constructor
+BlobStore::BlobStore(DatabaseConnection *db)
+{
+    this->db = db;
+    blobDir = global.fileManager.getDbaDirPath() + QString("blobs") + QDir::separator();
+}
+
+
+// Blobs are spread over 256 directories by the first byte of the hash
+QString BlobStore::getPath(const QByteArray &hash) {
+    QString hex = QString(hash.toHex());
+    return blobDir + hex.left(2) + QDir::separator() + hex;
+}
+
+
+// Do we already have this blob?
+bool BlobStore::contains(const QByteArray &hash) {
+    if (hash.size() == 0)
+        return false;
+    return QFile::exists(getPath(hash));
+}
+
+
+// Write a blob.  The data goes to a temporary file which is flushed to
+// disk & renamed into place, so a crash never leaves a partial blob.
+bool BlobStore::store(const QByteArray &hash, const QByteArray &body) {
+    if (hash.size() == 0)
+        return false;
+    if (contains(hash))
+        return true;
+
+    QString path = getPath(hash);
+    QDir dir;
+    dir.mkpath(QFileInfo(path).absolutePath());
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        QLOG_ERROR() << "Unable to create blob " << path << ": " << file.errorString();
+        return false;
+    }
+    file.write(body);
+    if (!file.commit()) {
+        QLOG_ERROR() << "Unable to write blob " << path << ": " << file.errorString();
+        return false;
+    }
+    QFile::setPermissions(path, QFile::ReadOwner | QFile::ReadGroup | QFile::ReadOther);
+    return true;
+}
+
+
+// Save a resource body.  The blob is only written if we don't have it
+// yet, then dba/<lid><ext> is pointed at it.
+bool BlobStore::addResource(qint32 lid, QString fileExt, Data &data) {
+    QByteArray body;
+    if (data.body.isSet())
+        body = data.body;
+    QByteArray hash;
+    if (data.bodyHash.isSet())
+        hash = data.bodyHash;
+    else
+        hash = QCryptographicHash::hash(body, QCryptographicHash::Md5);
+
+    QString fileName = global.fileManager.getDbaDirPath() + QString::number(lid) + fileExt;
+    if (contains(hash)) {
+        QLOG_DEBUG() << "Resource " << lid << " body already stored, skipping write";
+    } else if (!store(hash, body)) {
+        // Fall back to writing the resource file directly
+        QFile::remove(fileName);
+        QFile file(fileName);
+        if (!file.open(QIODevice::WriteOnly))
+            return false;
+        file.write(body);
+        file.close();
+        return true;
+    }
+    return linkFile(getPath(hash), fileName);
+}
+
+
+// Return the file a resource body should be read from.  The blob if we
+// have it, otherwise the resource's own file.
+QString BlobStore::getResourcePath(qint32 lid, QString fileExt, const QByteArray &hash) {
+    if (contains(hash))
+        return getPath(hash);
+    return global.fileManager.getDbaDirPath() + QString::number(lid) + fileExt;
+}
+
+
+// Map a blob into memory & return a view of it.  Nothing is copied or
+// read until the caller touches the bytes.  A null QByteArray means the
+// blob isn't in the store (or couldn't be mapped) and the caller has to
+// read the resource file itself.
+QByteArray BlobStore::map(const QByteArray &hash) {
+    if (hash.size() == 0)
+        return QByteArray();
+
+    QMutexLocker locker(&mappedBlobsMutex);
+    releaseMappings();
+    if (!mappedBlobs.contains(hash)) {
+        QString path = getPath(hash);
+        if (!QFile::exists(path))
+            return QByteArray();
+        QFile *file = new QFile(path);
+        if (!file->open(QIODevice::ReadOnly) || file->size() > INT_MAX) {
+            delete file;
+            return QByteArray();
+        }
+        if (file->size() == 0) {
+            delete file;
+            return QByteArray("");
+        }
+        int size = file->size();
+        const char *data = reinterpret_cast<const char*>(file->map(0, size));
+        // The mapping stays valid after the file is closed
+        file->close();
+        if (data == nullptr) {
+            QLOG_ERROR() << "Unable to map blob " << path << ": " << file->errorString();
+            delete file;
+            return QByteArray();
+        }
+        mappedBlobs.insert(hash, new MappedBlob(file, data, size));
+    }
+
+    return mappedBlobs.value(hash)->view;
+}
+
+
+// Get a resource body.  Blobs are mapped rather than read.  Resources
+// which aren't in the store (or were edited after they were stored) are
+// read from their own file.
+QByteArray BlobStore::getResourceBody(qint32 lid, QString fileExt, const QByteArray &hash) {
+    QByteArray body = map(hash);
+    if (!body.isNull())
+        return body;
+    QFile file(global.fileManager.getDbaDirPath() + QString::number(lid) + fileExt);
+    if (!file.open(QIODevice::ReadOnly))
+        return QByteArray();
+    body = file.readAll();
+    file.close();
+    return body;
+}
+
+
+// Count the resources which use a blob
+qint32 BlobStore::refCount(const QByteArray &hash) {
+    NSqlQuery query(db);
+    db->lockForRead();
+    query.prepare("Select count(*) from DataStore where key=:key and data=:hash");
+    query.bindValue(":key", RESOURCE_DATA_HASH);
+    query.bindValue(":hash", hash.toHex());
+    query.exec();
+    qint32 count = 0;
+    if (query.next())
+        count = query.value(0).toInt();
+    query.finish();
+    db->unlock();
+    return count;
+}
+
+
+// Remove every blob no resource refers to.  Resource files linked to
+// a removed blob keep their data.  The hashes in use are read with one
+// query rather than one count per blob.
+qint32 BlobStore::purge() {
+    qint32 removed = 0;
+    {
+        QMutexLocker locker(&mappedBlobsMutex);
+        releaseMappings();
+    }
+
+    QSet<QString> used;
+    NSqlQuery query(db);
+    db->lockForRead();
+    query.prepare("Select distinct data from DataStore where key=:key");
+    query.bindValue(":key", RESOURCE_DATA_HASH);
+    if (!query.exec()) {
+        QLOG_ERROR() << "Unable to read resource hashes, not purging blobs: " << query.lastError();
+        query.finish();
+        db->unlock();
+        return 0;
+    }
+    while (query.next())
+        used.insert(query.value(0).toString().toLower());
+    query.finish();
+    db->unlock();
+
+    QDirIterator it(blobDir, QDir::Files, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        QString path = it.next();
+        QString hex = it.fileName().toLower();
+        if (QByteArray::fromHex(hex.toLatin1()).size() > 0 && !used.contains(hex)) {
+            QFile::setPermissions(path, QFile::ReadOwner | QFile::WriteOwner);
+            if (QFile::remove(path))
+                removed++;
+        }
+    }
+    if (removed > 0)
+        QLOG_DEBUG() << "Purged " << removed << " unused resource blobs";
+    return removed;
+}
+
+
+// Make "to" a hard link to "from".  Where that isn't possible the file
+// is copied instead.
+bool BlobStore::linkFile(QString from, QString to) {
+    QFile::remove(to);
+// Windows Check
+#ifndef _WIN32
+    if (::link(QFile::encodeName(from).constData(), QFile::encodeName(to).constData()) == 0)
+        return true;
+#endif // End windows check
+    if (!QFile::copy(from, to))
+        return false;
+    QFile::setPermissions(to, QFile::permissions(to) | QFile::WriteOwner);
+    return true;
+}
+
+
+// Copy a resource file somewhere outside the store.  Resource files may
+// be read-only links to a blob, so the copy is made writable.  An
+// existing file at "to" is replaced.
+bool BlobStore::copyOut(QString file, QString to) {
+    QFile::remove(to);
+    if (!QFile::copy(file, to))
+        return false;
+    QFile::setPermissions(to, QFile::permissions(to) | QFile::WriteOwner);
+    return true;
+}
+
+
+// A resource file which shares its blob can't be edited in place or
+// every other note using the blob would change with it.  Give it a
+// private, writable copy first.
+bool BlobStore::detach(QString file) {
+    QFileInfo info(file);
+    if (!info.exists() || info.isWritable())
+        return true;
+    QString copy = file + QString(".detach");
+    QFile::remove(copy);
+    if (!QFile::copy(file, copy))
+        return false;
+    QFile::setPermissions(copy, QFile::permissions(copy) | QFile::WriteOwner);
+    QFile::remove(file);
+    return QFile::rename(copy, file);
+}
@@ -0,0 +1,86 @@
+/*********************************************************************************
+NixNote - An open-source client for the Evernote service.
+Copyright (C) 2013 Randy Baumgarte
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+***********************************************************************************/
+
+#ifndef BLOBSTORE_H
+#define BLOBSTORE_H
+
+#include <QByteArray>
+#include <QString>
+
+#include "src/sql/databaseconnection.h"
+#include "src/qevercloud/QEverCloud/headers/QEverCloud.h"
+
+using namespace qevercloud;
+
+//***********************************************************
+// Content addressed store for resource bodies.  Each body is
+// written once to dba/blobs/<xx>/<md5 hex> (the same hash
+// Evernote sends in Data.bodyHash) with an fsync'd atomic
+// write.  The dba/<lid><ext> file every resource still has
+// is a hard link to the blob, or a copy where hard links
+// aren't available, so a body attached to many notes is
+// only stored & written once.
+//
+// The reference count of a blob is the number of resources
+// whose RESOURCE_DATA_HASH is the blob's hash.  Blobs nobody
+// refers to any more are removed by purge(), not when the
+// last resource goes away, so a resource which is expunged
+// and re-added by a sync doesn't rewrite its body.
+// DatabaseMaintenance runs it when idle & not syncing.
+//
+// Blobs are read-only.  Anything which edits a resource file
+// in place (or hands it to a program which might) must
+// detach() it first.  Copies made outside the store go
+// through copyOut() so they don't inherit the read-only
+// mode.
+//
+// Because a blob never changes once written, map() can hand
+// out its body as a view of a memory mapped file instead of
+// a copy.  Pages are only read when something touches them
+// and are file backed, so loading a note with large
+// attachments doesn't grow the heap.  A mapping lives as
+// long as some copy of the QByteArray map() returned for it;
+// once the last copy is gone it is unmapped the next time
+// map() or purge() runs.  A blob which is purged while
+// mapped stays readable until then.
+//***********************************************************
+
+class BlobStore
+{
+private:
+    DatabaseConnection *db;
+    QString blobDir;
+
+public:
+    BlobStore(DatabaseConnection *db);
+    QString getPath(const QByteArray &hash);                 // Where the blob for a hash lives
+    bool contains(const QByteArray &hash);                   // Do we have this blob?
+    bool store(const QByteArray &hash, const QByteArray &body);   // Write a blob unless we already have it
+    bool addResource(qint32 lid, QString fileExt, Data &data);    // Store a resource body & link dba/<lid><ext>
+    QString getResourcePath(qint32 lid, QString fileExt, const QByteArray &hash);  // Best file to read a resource from
+    QByteArray map(const QByteArray &hash);                  // Zero copy view of a blob, null if we don't have it
+    QByteArray getResourceBody(qint32 lid, QString fileExt, const QByteArray &hash);  // Read (or map) a resource body
+    qint32 refCount(const QByteArray &hash);                 // Number of resources using a blob
+    qint32 purge();                                          // Remove unreferenced blobs
+    static bool linkFile(QString from, QString to);          // Hard link (or copy) a file
+    static bool detach(QString file);                        // Give a linked file its own copy before editing it
+    static bool copyOut(QString file, QString to);           // Writable copy of a resource file outside the store
+};
+
+#endif // BLOBSTORE_H
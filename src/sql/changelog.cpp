@@ -0,0 +1,245 @@
+/*********************************************************************************
+NixNote - An open-source client for the Evernote service.
+Copyright (C) 2013 Randy Baumgarte
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+***********************************************************************************/
+
+#include "changelog.h"
+#include "src/sql/databaseconnection.h"
+#include "src/sql/nsqlquery.h"
+#include "src/global.h"
+
+extern Global global;
+
+
+// The entity type of a DataStore key, as SQL.  "row" is new or old.
+static QString entityType(QString row) {
+    QString key = row + ".key";
+    return QString("case") +
+            QString(" when %1>=1000 and %1<2000 then %2").arg(key).arg(CHANGE_ENTITY_TAG) +
+            QString(" when %1>=2000 and %1<3000 then %2").arg(key).arg(CHANGE_ENTITY_SEARCH) +
+            QString(" when %1>=3000 and %1<3200 then %2").arg(key).arg(CHANGE_ENTITY_NOTEBOOK) +
+            QString(" when %1>=3200 and %1<3300 then %2").arg(key).arg(CHANGE_ENTITY_LINKEDNOTEBOOK) +
+            QString(" when %1>=3300 and %1<3400 then %2").arg(key).arg(CHANGE_ENTITY_SHAREDNOTEBOOK) +
+            QString(" when %1>=5000 and %1<6000 then %2").arg(key).arg(CHANGE_ENTITY_NOTE) +
+            QString(" when %1>=6000 and %1<7000 then %2").arg(key).arg(CHANGE_ENTITY_RESOURCE) +
+            QString(" else %1 end").arg(CHANGE_ENTITY_OTHER);
+}
+
+
+// The statements the change log triggers run.  A new row for the entity
+// is added with the keys of its old row plus this one, then the old row
+// is dropped.  The keys are kept as ",key,key," so a key can be found
+// with instr() & like.  An "or replace" on a unique index isn't used, as
+// a conflict clause on the statement firing the trigger would override
+// it.  "row" is new or old.
+static QString logChange(QString row) {
+    QString key = row + ".key";
+    return QString("insert into ChangeLog (type, lid, fields) ") +
+            QString("select t, %1.lid, case when instr(f, ','||%2||',')>0 then f else f||%2||',' end ").arg(row).arg(key) +
+            QString("from (select t, coalesce((select fields from ChangeLog where type=t and lid=%1.lid ").arg(row) +
+            QString("order by seq desc limit 1), ',') as f from (select ") + entityType(row) + QString(" as t)); ") +
+            QString("delete from ChangeLog where type=") + entityType(row) +
+            QString(" and lid=%1.lid and seq<last_insert_rowid(); ").arg(row);
+}
+
+
+// Constructor
+ChangeLog::ChangeLog(DatabaseConnection *db)
+{
+    this->db = db;
+}
+
+
+// Create the log table & the triggers which fill it.  This is safe to
+// call every time the database is opened.
+void ChangeLog::createTable() {
+    upgradeTable();
+    NSqlQuery sql(db);
+    db->lockForWrite();
+    if (!sql.exec(QString("Create table if not exists ChangeLog (") +
+                  QString("seq integer primary key autoincrement, type integer, lid integer, fields text)"))) {
+        QLOG_ERROR() << "Creation of ChangeLog table failed: " << sql.lastError();
+    }
+    sql.exec("Create index if not exists ChangeLog_Entity on ChangeLog (type, lid)");
+    sql.finish();
+    db->unlock();
+    createTriggers();
+}
+
+
+// The triggers replace the entity's row on every DataStore change
+void ChangeLog::createTriggers() {
+    NSqlQuery sql(db);
+    db->lockForWrite();
+    sql.exec("Create trigger if not exists ChangeLog_Insert after insert on DataStore begin " +
+             logChange("new") + QString("end"));
+    sql.exec("Create trigger if not exists ChangeLog_Update after update on DataStore begin " +
+             logChange("new") + QString("end"));
+    sql.exec("Create trigger if not exists ChangeLog_Delete after delete on DataStore begin " +
+             logChange("old") + QString("end"));
+    sql.finish();
+    db->unlock();
+}
+
+
+// Older databases logged one row per changed key.  Their rows are merged
+// into one per entity, keeping each entity's newest sequence number, and
+// the sequence numbers carry on from where they were.  Everything before
+// the oldest row left had been compacted away.
+void ChangeLog::upgradeTable() {
+    NSqlQuery sql(db);
+    db->lockForWrite();
+    bool old = false;
+    sql.exec("pragma table_info(ChangeLog)");
+    while (sql.next()) {
+        if (sql.value(1).toString() == "field")
+            old = true;
+    }
+    sql.finish();
+    if (!old) {
+        db->unlock();
+        return;
+    }
+
+    QLOG_DEBUG() << "Merging change log rows by entity";
+    bool ownTransaction = db->conn.transaction();
+    qint64 compacted = 0;
+    sql.exec("Select coalesce((select min(seq)-1 from ChangeLog), (select seq from sqlite_sequence where name='ChangeLog'), 0)");
+    if (sql.next())
+        compacted = sql.value(0).toLongLong();
+    qint64 highest = 0;
+    sql.exec("Select coalesce((select seq from sqlite_sequence where name='ChangeLog'), 0)");
+    if (sql.next())
+        highest = sql.value(0).toLongLong();
+    sql.exec("Drop trigger if exists ChangeLog_Insert");
+    sql.exec("Drop trigger if exists ChangeLog_Update");
+    sql.exec("Drop trigger if exists ChangeLog_Delete");
+    sql.exec("Alter table ChangeLog rename to ChangeLogOld");
+    sql.exec(QString("Create table ChangeLog (") +
+             QString("seq integer primary key autoincrement, type integer, lid integer, fields text)"));
+    sql.exec(QString("Insert into ChangeLog (seq, type, lid, fields) ") +
+             QString("select max(seq), type, lid, ','||group_concat(distinct field)||',' from ChangeLogOld group by type, lid"));
+    sql.exec("Delete from sqlite_sequence where name='ChangeLog'");
+    sql.prepare("Insert into sqlite_sequence (name, seq) values ('ChangeLog', :seq)");
+    sql.bindValue(":seq", highest);
+    sql.exec();
+    sql.exec("Drop table ChangeLogOld");
+    sql.finish();
+    db->unlock();
+
+    ConfigStore cs(db);
+    cs.saveSetting(CONFIG_STORE_CHANGELOG_COMPACTED, QByteArray::number(compacted));
+    if (ownTransaction)
+        db->conn.commit();
+}
+
+
+// Return the newest sequence number
+qint64 ChangeLog::getHighestSequence() {
+    qint64 retval = 0;
+    NSqlQuery sql(db);
+    db->lockForRead();
+    sql.exec("Select max(seq) from ChangeLog");
+    if (sql.next())
+        retval = sql.value(0).toLongLong();
+    sql.finish();
+    db->unlock();
+    return retval;
+}
+
+
+// Return the highest sequence number compact() removed
+qint64 ChangeLog::getCompactedSequence() {
+    ConfigStore cs(db);
+    QByteArray value;
+    if (!cs.getSetting(value, CONFIG_STORE_CHANGELOG_COMPACTED))
+        return 0;
+    return value.toLongLong();
+}
+
+
+// Get the oldest "limit" entities which changed after a sequence number.
+// If there are that many the caller asks again from the newest sequence
+// number it got.  Returns false if some of the changes have already been
+// compacted away.
+bool ChangeLog::getChanges(QList<ChangeLogEntry> &changes, qint64 since, qint32 limit) {
+    changes.clear();
+    bool complete = ChangeSet::isComplete(getCompactedSequence(), since);
+    NSqlQuery sql(db);
+    db->lockForRead();
+    sql.prepare("Select seq, type, lid, fields from ChangeLog where seq>:since order by seq limit :limit");
+    sql.bindValue(":since", since);
+    sql.bindValue(":limit", limit);
+    sql.exec();
+    ChangeSet set;
+    while (sql.next()) {
+        QStringList fields = sql.value(3).toString().split(",", QString::SkipEmptyParts);
+        for (qint32 i=0; i<fields.size(); i++)
+            set.add(sql.value(0).toLongLong(), sql.value(1).toInt(), sql.value(2).toInt(), fields[i].toInt());
+    }
+    changes = set.entries;
+    sql.finish();
+    db->unlock();
+    return complete;
+}
+
+
+// Has any of a list of DataStore keys changed after a sequence number?
+bool ChangeLog::hasChanges(qint64 since, const QList<qint32> &fields) {
+    QStringList keys;
+    for (qint32 i=0; i<fields.size(); i++)
+        keys.append(QString("fields like '%,") + QString::number(fields[i]) + QString(",%'"));
+    if (keys.size() == 0)
+        return false;
+    NSqlQuery sql(db);
+    db->lockForRead();
+    sql.prepare("Select seq from ChangeLog where seq>:since and (" + keys.join(" or ") + ") limit 1");
+    sql.bindValue(":since", since);
+    sql.exec();
+    bool retval = sql.next();
+    sql.finish();
+    db->unlock();
+    return retval;
+}
+
+
+// Keep only the newest entries & remember the last sequence number
+// removed.  Returns the number removed.
+qint32 ChangeLog::compact(qint32 keep) {
+    NSqlQuery sql(db);
+    db->lockForWrite();
+    qint32 removed = 0;
+    sql.prepare("Select seq from ChangeLog order by seq desc limit 1 offset :keep");
+    sql.bindValue(":keep", keep);
+    if (sql.exec() && sql.next()) {
+        qint64 upto = sql.value(0).toLongLong();
+        sql.prepare("Delete from ChangeLog where seq<=:upto");
+        sql.bindValue(":upto", upto);
+        sql.exec();
+        removed = sql.numRowsAffected();
+        sql.finish();
+        db->unlock();
+        ConfigStore cs(db);
+        cs.saveSetting(CONFIG_STORE_CHANGELOG_COMPACTED, QByteArray::number(upto));
+    } else {
+        sql.finish();
+        db->unlock();
+    }
+    if (removed > 0)
+        QLOG_DEBUG() << "Compacted " << removed << " change log entries";
+    return removed;
+}
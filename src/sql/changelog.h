@@ -0,0 +1,87 @@
+/*********************************************************************************
+NixNote - An open-source client for the Evernote service.
+Copyright (C) 2013 Randy Baumgarte
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+***********************************************************************************/
+
+#ifndef CHANGELOG_H
+#define CHANGELOG_H
+
+#include <QList>
+#include <QString>
+#include <functional>
+
+#include "src/sql/changeset.h"
+
+class DatabaseConnection;
+
+// Kinds of entity a change can be about.  Taken from the DataStore key.
+#define CHANGE_ENTITY_OTHER              0
+#define CHANGE_ENTITY_TAG                1
+#define CHANGE_ENTITY_SEARCH             2
+#define CHANGE_ENTITY_NOTEBOOK           3
+#define CHANGE_ENTITY_LINKEDNOTEBOOK     4
+#define CHANGE_ENTITY_SHAREDNOTEBOOK     5
+#define CHANGE_ENTITY_NOTE               6
+#define CHANGE_ENTITY_RESOURCE           7
+
+// Entries read by getChanges() at a time
+#define CHANGE_LOG_PAGE 1000
+
+//***********************************************************
+// Log of changes to the DataStore, one row per entity.
+// Triggers on the DataStore replace the entity's row (type,
+// lid & the keys that changed) with one under a new sequence
+// number on every insert, update & delete, so an entry is
+// always committed or rolled back together with the change
+// it describes.  Sequence numbers only ever grow.  Adding a
+// note of 20 keys leaves one row, not 20.
+//
+// Consumers remember the last sequence number they handled
+// and ask for what changed since, instead of rescanning.
+// The keys of a row build up until it is compacted away, so
+// a consumer may be told about keys which changed before its
+// sequence number; never too few.
+//
+// compact() throws away all but the newest entries & keeps
+// the highest sequence number it removed.  A consumer whose
+// sequence number is older than that gets told its view is
+// incomplete & must rescan.  The DatabaseWriter compacts
+// whenever enough new changes were logged.
+//***********************************************************
+
+// Called with the changes since the last call.  If complete is false,
+// older changes were compacted away & the consumer should rescan.
+typedef std::function<void(const QList<ChangeLogEntry> &changes, bool complete)> ChangeListener;
+
+class ChangeLog
+{
+private:
+    DatabaseConnection *db;
+    void upgradeTable();                                 // Merge an old one row per key log into one row per entity
+    void createTriggers();
+
+public:
+    ChangeLog(DatabaseConnection *db);                   // Constructor
+    void createTable();                                  // Create the log & the DataStore triggers
+    qint64 getHighestSequence();                         // Newest sequence number (0 if none)
+    qint64 getCompactedSequence();                       // Highest sequence number compacted away (0 if none)
+    bool getChanges(QList<ChangeLogEntry> &changes, qint64 since, qint32 limit=CHANGE_LOG_PAGE);  // Oldest changes after a sequence number, one entry per entity
+    bool hasChanges(qint64 since, const QList<qint32> &fields);     // Did any of these keys change after a sequence number?
+    qint32 compact(qint32 keep);                         // Remove all but the newest entries
+};
+
+#endif // CHANGELOG_H
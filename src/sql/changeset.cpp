@@ -0,0 +1,48 @@
+/*********************************************************************************
+NixNote - An open-source client for the Evernote service.
+Copyright (C) 2013 Randy Baumgarte
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+***********************************************************************************/
+
+
+#include "changeset.h"
+
+
+// Merge a changed key into the entry of its entity.  Keys are added
+// oldest first, so the entry ends up with the newest sequence number.
+void ChangeSet::add(qint64 sequence, qint32 type, qint32 lid, qint32 field) {
+    QPair<qint32, qint32> entity(type, lid);
+    if (!entities.contains(entity)) {
+        ChangeLogEntry entry;
+        entry.type = type;
+        entry.lid = lid;
+        entities.insert(entity, entries.size());
+        entries.append(entry);
+    }
+    ChangeLogEntry &entry = entries[entities.value(entity)];
+    entry.sequence = sequence;
+    if (!entry.fields.contains(field))
+        entry.fields.append(field);
+}
+
+
+// Is every change after "since" still in the log?  "compacted" is the
+// highest sequence number compact() removed (0 if none).  Sequence
+// numbers have gaps, as an entity's old row goes when it changes again,
+// so only the compaction boundary tells what is missing.
+bool ChangeSet::isComplete(qint64 compacted, qint64 since) {
+    return since >= compacted;
+}
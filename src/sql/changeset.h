@@ -0,0 +1,57 @@
+/*********************************************************************************
+NixNote - An open-source client for the Evernote service.
+Copyright (C) 2013 Randy Baumgarte
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+***********************************************************************************/
+
+
+#ifndef CHANGESET_H
+#define CHANGESET_H
+
+#include <QHash>
+#include <QList>
+#include <QPair>
+
+//***********************************************************
+// The change log rows read by ChangeLog::getChanges(),
+// merged into one entry per entity.  Also holds the rule
+// getChanges() uses to tell whether compact() removed
+// entries a consumer needs.  Kept apart from ChangeLog as
+// it needs no database.
+//***********************************************************
+
+class ChangeLogEntry
+{
+public:
+    qint64 sequence;                // Newest sequence number for this entity
+    qint32 type;                    // CHANGE_ENTITY_*
+    qint32 lid;                     // Entity that changed
+    QList<qint32> fields;           // DataStore keys that changed
+};
+
+class ChangeSet
+{
+private:
+    QHash<QPair<qint32, qint32>, qint32> entities;      // (type, lid) -> index in entries
+
+public:
+    QList<ChangeLogEntry> entries;  // In the order the entities first changed
+
+    void add(qint64 sequence, qint32 type, qint32 lid, qint32 field);  // Merge a changed key in (oldest first)
+    static bool isComplete(qint64 compacted, qint64 since);            // Are all changes after "since" still logged?
+};
+
+#endif // CHANGESET_H
@@ -97,40 +97,11 @@ void ConfigStore::initTable() {
 
 //*******************************************************************
 // Every time we add a new object, we call this to get its unique
-// local ID.  This number never changes
+// local ID.  This number never changes.  Lids come out of blocks
+// reserved by the global LidAllocator.  -1 if no lid could be had.
 //*******************************************************************
 qint32 ConfigStore::incrementLidCounter() {
-    db->lockForWrite();
-
-    NSqlQuery sql(db);
-    // Prepare the SQL statement & fetch the row
-    sql.prepare("Select value from ConfigStore where key=:key");
-    sql.bindValue(":key", CONFIG_STORE_LID);
-    if (!sql.exec()) {
-        QLOG_ERROR() << "Fetch of ConfigStore LID counter statement failed: " << sql.lastError();
-    }
-    if (!sql.next()) {
-        QLOG_ERROR() << "Fetch from ConfigStore failure: LID NOT FOUND!!!";
-    } else {
-        // Now that we have the next lid, increment the number & save it
-        qint32 sequence = QVariant(sql.value(0)).toInt();
-        sequence++;
-        db->lockForWrite();
-        sql.prepare("Update ConfigStore set value=:lid where key=:key;");
-        sql.bindValue(":lid",sequence);
-        sql.bindValue(":key", CONFIG_STORE_LID);
-        if (!sql.exec()) {
-            QLOG_ERROR() << "Error updating sequence number: " << sql.lastError();
-        }
-        sql.finish();
-        db->unlock();
-
-        // Return the next lid to the caller
-        return sequence;
-    }
-    sql.finish();
-    db->unlock();
-    return -1;
+    return global.lidAllocator.next(db);
 }
 
 
@@ -30,9 +30,15 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 //*************************************
 
 // Define key types
-#define CONFIG_STORE_LID 0   // This is the highest number object in the database
+#define CONFIG_STORE_LID 0   // Highest lid reserved by the LidAllocator
 #define CONFIG_STORE_WINDOW_GEOMETRY 1 // The window geometry between runs
 #define CONFIG_STORE_WINDOW_STATE 2 // The window state between runs
+#define CONFIG_STORE_ROWSTORE_MIGRATION 3 // Last lid copied into the row store by the upgrade
+#define CONFIG_STORE_CONTENT_COMPRESSION 4 // Last note lid checked by the background content compression
+#define CONFIG_STORE_LAST_MAINTENANCE 5 // When the idle time database maintenance last finished
+#define CONFIG_STORE_TRIGRAM_INDEX 6 // Last SearchIndex row copied into the trigram index
+#define CONFIG_STORE_FTS5_MIGRATION 7 // Last SearchIndex row copied into the FTS5 table
+#define CONFIG_STORE_CHANGELOG_COMPACTED 8 // Highest change log sequence number compacted away
 
 class DatabaseConnection;
 
@@ -51,7 +57,7 @@ public:
 
     // DB Write Functions
     void createTable();               // SQL to create the table
-    qint32 incrementLidCounter();     // Get the next LID number
+    qint32 incrementLidCounter();     // Get the next LID number, -1 on failure
     void saveSetting(int key, QByteArray);        // Save a setting
 };
 
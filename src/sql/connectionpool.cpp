@@ -0,0 +1,114 @@
+/*********************************************************************************
+NixNote - An open-source client for the Evernote service.
+Copyright (C) 2013 Randy Baumgarte
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+***********************************************************************************/
+
+#include "connectionpool.h"
+#include "src/global.h"
+#include "src/sql/databaseconnection.h"
+
+#include <QThread>
+
+extern Global global;
+
+
+// Constructor.  Nothing is opened until a thread reads.
+ConnectionPool::ConnectionPool()
+{
+    opened = 0;
+    pooled = 0;
+}
+
+
+// Open a new read-only connection with a name of its own
+DatabaseConnection *ConnectionPool::open() {
+    qint32 number = opened.fetchAndAddRelaxed(1) + 1;
+    QLOG_DEBUG() << "Opening read connection " << number << " for thread " << QThread::currentThread();
+    return new DatabaseConnection("reader-" + QString::number(number), true);
+}
+
+
+// Return this thread's read-only connection, opening it on first use.
+// Once READ_POOL_SIZE threads hold one, the caller gets a connection of
+// its own (pooled is false) & gives it back with release(), unless it
+// must keep its connection.
+DatabaseConnection *ConnectionPool::acquire(bool &pooled, bool keep) {
+    pooled = true;
+    if (connections.hasLocalData())
+        return connections.localData()->db;
+    if (this->pooled.fetchAndAddRelaxed(1) >= READ_POOL_SIZE && !keep) {
+        this->pooled.fetchAndAddRelaxed(-1);
+        pooled = false;
+        return open();
+    }
+    DatabaseConnection *db = open();
+    connections.setLocalData(new PooledConnection(db, this));
+    return db;
+}
+
+
+// Close a connection acquire() didn't keep for its thread
+void ConnectionPool::release(DatabaseConnection *db) {
+    QString name = db->getConnectionName();
+    delete db;
+    QSqlDatabase::removeDatabase(name);
+}
+
+
+// A thread's connection was closed, so another thread may keep one
+void ConnectionPool::released() {
+    pooled.fetchAndAddRelaxed(-1);
+}
+
+
+// Close this thread's connection.  Other threads' connections are closed
+// when they finish; the GUI thread calls this before the program exits.
+void ConnectionPool::close() {
+    if (connections.hasLocalData())
+        connections.setLocalData(nullptr);
+}
+
+
+
+// Constructor
+PooledConnection::PooledConnection(DatabaseConnection *db, ConnectionPool *pool)
+{
+    this->db = db;
+    this->pool = pool;
+}
+
+
+// Destructor.  Run by QThreadStorage when the thread finishes.
+PooledConnection::~PooledConnection() {
+    pool->release(db);
+    pool->released();
+}
+
+
+
+// Use this thread's connection
+ReadConnection::ReadConnection(bool keep)
+{
+    db = global.readPool.acquire(pooled, keep);
+}
+
+
+// Destructor.  Close the connection if it isn't this thread's.
+ReadConnection::~ReadConnection() {
+    if (!pooled)
+        global.readPool.release(db);
+}
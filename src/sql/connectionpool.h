@@ -0,0 +1,96 @@
+/*********************************************************************************
+NixNote - An open-source client for the Evernote service.
+Copyright (C) 2013 Randy Baumgarte
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+***********************************************************************************/
+
+#ifndef CONNECTIONPOOL_H
+#define CONNECTIONPOOL_H
+
+#include <QAtomicInt>
+#include <QThreadStorage>
+
+class DatabaseConnection;
+class ConnectionPool;
+
+#define READ_POOL_SIZE 4            // Threads which keep a read connection open
+
+//***********************************************************
+// Read-only database connections, one per thread.  Readers
+// (counters, the note formatter, ...) use the connection of
+// the thread they run on instead of opening one of their
+// own.  Qt only lets a connection be used by the thread
+// which opened it, so a thread's connection is opened the
+// first time it reads & closed (and removed from Qt's list
+// of connections) when the thread finishes.  Nothing ever
+// waits for a connection, so the GUI thread can't block
+// here.
+//
+// Each open connection costs up to its page cache (the
+// "databaseCacheSize" setting) in memory.  Its memory map
+// ("databaseMmapSize") is only address space: the mapped
+// pages are the OS's file cache, shared by every connection.
+// So only the first READ_POOL_SIZE threads keep their
+// connection.  Other threads get a connection of their own
+// for as long as their ReadConnection exists, unless they
+// ask to keep it (change log subscribers, which need the
+// same connection from one read to the next).
+//
+// Use ReadConnection to get this thread's connection:
+//     ReadConnection reader;
+//     NoteTable noteTable(reader.db);
+//***********************************************************
+
+class PooledConnection
+{
+public:
+    DatabaseConnection *db;
+    ConnectionPool *pool;
+    PooledConnection(DatabaseConnection *db, ConnectionPool *pool);
+    ~PooledConnection();                        // Close & remove the connection
+};
+
+
+class ConnectionPool
+{
+private:
+    QThreadStorage<PooledConnection*> connections;     // Deleted when their thread finishes
+    QAtomicInt opened;                                  // Connections opened so far, for their names
+    QAtomicInt pooled;                                  // Threads which hold a connection now
+    DatabaseConnection *open();                         // Open a new read connection
+
+public:
+    ConnectionPool();
+    DatabaseConnection *acquire(bool &pooled, bool keep);  // This thread's connection, or one to release() when done
+    void release(DatabaseConnection *db);       // Close a connection which wasn't pooled
+    void released();                            // A pooled connection was closed
+    void close();                               // Close this thread's connection
+};
+
+
+class ReadConnection
+{
+private:
+    bool pooled;
+
+public:
+    DatabaseConnection *db;
+    ReadConnection(bool keep=false);            // keep: always pool this thread's connection
+    ~ReadConnection();
+    Q_DISABLE_COPY(ReadConnection)
+};
+
+#endif // CONNECTIONPOOL_H
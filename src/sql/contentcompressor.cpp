@@ -0,0 +1,70 @@
+/*********************************************************************************
+NixNote - An open-source client for the Evernote service.
+Copyright (C) 2013 Randy Baumgarte
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+***********************************************************************************/
+
+#include "contentcompressor.h"
+#include "src/logger/qslog.h"
+
+// Content smaller than this isn't worth compressing
+#define CONTENT_COMPRESSION_MINIMUM 256
+
+// The "compressNoteContent" setting, read once at startup
+QAtomicInt ContentCompressor::enabled(1);
+
+
+// Turn compression on or off.  Global::setup() sets this from the
+// settings so compress(), which also runs on the writer thread, never
+// has to read QSettings.
+void ContentCompressor::setEnabled(bool value) {
+    enabled.store(value ? 1 : 0);
+}
+
+
+// Is compression on?
+bool ContentCompressor::isEnabled() {
+    return enabled.load() != 0;
+}
+
+
+// Compress note content.  If compression is off, the content is small
+// or it doesn't get any smaller, the content is returned unchanged.
+QByteArray ContentCompressor::compress(const QByteArray &content) {
+    if (!isEnabled() || content.size() < CONTENT_COMPRESSION_MINIMUM)
+        return content;
+    QByteArray compressed = qCompress(content);
+    if (compressed.size() + int(sizeof(CONTENT_COMPRESSION_MAGIC)) >= content.size())
+        return content;
+    return QByteArray(CONTENT_COMPRESSION_MAGIC) + compressed;
+}
+
+
+// Undo compress()
+QByteArray ContentCompressor::uncompress(const QByteArray &data) {
+    if (!isCompressed(data))
+        return data;
+    QByteArray content = qUncompress(data.mid(int(sizeof(CONTENT_COMPRESSION_MAGIC))-1));
+    if (content.isEmpty())
+        QLOG_ERROR() << "Unable to uncompress note content";
+    return content;
+}
+
+
+// Is this value compressed?
+bool ContentCompressor::isCompressed(const QByteArray &data) {
+    return data.startsWith(CONTENT_COMPRESSION_MAGIC);
+}
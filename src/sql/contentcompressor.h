@@ -0,0 +1,59 @@
+/*********************************************************************************
+NixNote - An open-source client for the Evernote service.
+Copyright (C) 2013 Randy Baumgarte
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+***********************************************************************************/
+
+#ifndef CONTENTCOMPRESSOR_H
+#define CONTENTCOMPRESSOR_H
+
+#include <QAtomicInt>
+#include <QByteArray>
+
+// Compressed note content starts with this, followed by qCompress() data
+#define CONTENT_COMPRESSION_MAGIC "NNZ1"
+
+//***********************************************************
+// Note content (NOTE_CONTENT) is mostly verbose ENML, so it
+// is stored zlib compressed when the "compressNoteContent"
+// setting is on.  Compressed values start with a magic
+// header.  ENML always starts with "<", so values without
+// the header are plain content from before compression (or
+// too small to be worth compressing) & are read as they are.
+//
+// NOTE_CONTENT_LENGTH is still the uncompressed length.
+// Rows written before compression was turned on are
+// converted in the background by the database writer (see
+// NoteTable::compressOldContent()).
+//
+// The setting is read once at startup & kept here, so the
+// compressor doesn't need the database or the settings.
+//***********************************************************
+
+class ContentCompressor
+{
+private:
+    static QAtomicInt enabled;
+
+public:
+    static void setEnabled(bool value);                      // Turn compression on or off
+    static bool isEnabled();                                 // Is compression on?
+    static QByteArray compress(const QByteArray &content);   // Compress content for the database (if worthwhile)
+    static QByteArray uncompress(const QByteArray &data);    // Get content back.  Plain content is returned as is.
+    static bool isCompressed(const QByteArray &data);        // Does a value have the magic header?
+};
+
+#endif // CONTENTCOMPRESSOR_H
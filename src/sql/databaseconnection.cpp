@@ -23,6 +23,14 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include "src/sql/nsqlquery.h"
 #include "resourcetable.h"
 #include "src/sql/databaseupgrade.h"
+#include "src/sql/rowstore.h"
+#include "src/sql/writebatch.h"
+#include "src/sql/statementcache.h"
+#include "src/sql/fulltextindex.h"
+#include "src/sql/trigramindex.h"
+#include "src/sql/materializedsearch.h"
+
+#include <QElapsedTimer>
 
 
 extern Global global;
@@ -30,32 +38,58 @@ extern Global global;
 //* This class is used to connect to the
 //* database.
 //*****************************************
-DatabaseConnection::DatabaseConnection(QString connection)
+DatabaseConnection::DatabaseConnection(QString connection, bool readOnly)
 {
+    QElapsedTimer timer;
+    timer.start();
     dbLocked = Unlocked;
+    filterTableCreated = false;
+    failedStatements = 0;
+    nextListenerId = 0;
+    publishedSequence = -1;
+    this->readOnly = readOnly;
+    writeBatch = nullptr;
+    statementCache = new StatementCache(global.getStatementCacheSize());
     this->connection = connection;
     QLOG_DEBUG() << "SQL drivers available: " << QSqlDatabase::drivers();
     QLOG_TRACE() << "Adding database SQLITE";
     conn = QSqlDatabase::addDatabase("QSQLITE", connection);
     QLOG_TRACE() << "Setting DB name";
     conn.setDatabaseName(global.fileManager.getDbDirPath(NN_NIXNOTE_DATABASE_NAME));
+    if (readOnly)
+        conn.setConnectOptions("QSQLITE_OPEN_READONLY");
     QLOG_TRACE() << "Opening database";
     if (!conn.open()) {
         QLOG_FATAL() << "Error opening database: " << conn.lastError();
         exit(16);
     }
 
+    // Read-only connections are handed out by the connection pool.  The
+    // tables already exist, so there is nothing else to set up.
+    if (readOnly) {
+        configStore = nullptr;
+        dataStore = nullptr;
+        applyPragmas();
+        QLOG_DEBUG() << "Database connection " << connection << " opened in " << timer.elapsed() << "ms";
+        return;
+    }
+
     if (connection == NN_DB_CONNECTION_NAME)
         global.db = this;
     QLOG_TRACE() << "Preparing tables";
+    // New databases give free pages back with an incremental vacuum (see
+    // DatabaseMaintenance).  Existing ones switch over when the user compacts
+    // the database.
+    NSqlQuery vacuumMode(this);
+    vacuumMode.exec("pragma auto_vacuum=incremental");
+    vacuumMode.finish();
+
     // Start preparing the tables
     configStore = new ConfigStore(this);
     dataStore = new DataStore(this);
 
     NSqlQuery tempTable(this);
-//    tempTable.exec("pragma cache_size=8096");
-//    tempTable.exec("pragma page_size=8096");
-    tempTable.exec("pragma busy_timeout=50000");
+    applyPragmas();
     tempTable.exec("pragma journal_mode=wal");
 
 //    tempTable.exec("pragma SQLITE_THREADSAFE=2");
@@ -66,6 +100,30 @@ DatabaseConnection::DatabaseConnection(QString connection)
             QLOG_DEBUG() << tempTable.value(0).toString();
         }
 
+        // Covering index for guid -> lid lookups.  Older databases don't have
+        // it, or have the earlier one which indexed every value.
+        tempTable.exec("drop index if exists DataStore_Key_Data");
+        dataStore->createLookupIndex();
+
+        // The filter table & the note list view used to be shared by every
+        // connection.  They are now temporary & belong to the connection
+        // that filters (see createFilterTable()).
+        tempTable.exec("drop view if exists main.NoteTableV");
+        tempTable.exec("drop table if exists main.filter");
+
+        RowStore rowStore(this);
+        rowStore.createTables();
+
+        ChangeLog changeLog(this);
+        changeLog.createTable();
+        changeLog.compact(global.getChangeLogSize());
+
+        FullTextIndex::checkTable(this);
+        TrigramIndex::createTable(this);
+
+        MaterializedSearch materializedSearch(this);
+        materializedSearch.createTable();
+
         int value = global.getDatabaseVersion();
         if (value < 2){
             QLOG_DEBUG() << "*****************";
@@ -73,7 +131,27 @@ DatabaseConnection::DatabaseConnection(QString connection)
             DatabaseUpgrade dbu;
             dbu.fixSql();
         }
-        global.setDatabaseVersion(2);
+        if (value < 3) {
+            QLOG_DEBUG() << "Building row store";
+            DatabaseUpgrade dbu;
+            dbu.buildRowStore();
+        }
+        if (value < 4) {
+            QLOG_DEBUG() << "Building note tag table";
+            DatabaseUpgrade dbu;
+            dbu.buildNoteTags();
+        }
+        if (value < 5) {
+            QLOG_DEBUG() << "Building note location index";
+            DatabaseUpgrade dbu;
+            dbu.buildNoteLocations();
+        }
+        if (value < 7) {
+            QLOG_DEBUG() << "Removing data copied into the row store";
+            DatabaseUpgrade dbu;
+            dbu.dropCopiedData();
+        }
+        global.setDatabaseVersion(7);
 
         // Get username to use for default notes.  This needs to be done after
         // the database is started because we set it by default to the usertable
@@ -82,25 +160,17 @@ DatabaseConnection::DatabaseConnection(QString connection)
 
     }
 
-    QLOG_TRACE() << "Re-creating filter table";
-    tempTable.exec("drop table if exists filter");
-    tempTable.exec("create table filter (lid integer, relevance integer)");
-    // index could be useful as we do joins on table display
-    // may also slow down search
-    // so maybe reevaluate this
-    tempTable.exec("create index Filter_Lid_Index on filter (lid)");
-
-    QLOG_TRACE() << "Adding to filter table";
-    tempTable.exec("insert into filter (lid,relevance) select distinct lid,0 from NoteTable");
-    QLOG_TRACE() << "Addition complete";
     tempTable.finish();
-
+    QLOG_DEBUG() << "Database connection " << connection << " opened in " << timer.elapsed() << "ms";
 
 }
 
 
 // Destructor.  Close the database & delete the memory used by the variables.
 DatabaseConnection::~DatabaseConnection() {
+    QLOG_DEBUG() << "Statement cache for " << connection << ": " << statementCache->hits()
+                 << " hits, " << statementCache->misses() << " misses";
+    delete statementCache;
     conn.close();
     delete configStore;
     delete dataStore;
@@ -143,3 +213,214 @@ QString DatabaseConnection::getConnectionName() {
 }
 
 
+// Create this connection's filter table.  It is a TEMP table so every
+// connection that filters has its own, and it is only built the first
+// time a connection needs it.  It starts out holding every note.
+void DatabaseConnection::createFilterTable() {
+    if (filterTableCreated)
+        return;
+    filterTableCreated = true;
+
+    QLOG_TRACE() << "Creating filter table for " << connection;
+    NSqlQuery sql(this);
+    sql.exec("create temp table if not exists filter (lid integer, relevance integer)");
+    // index could be useful as we do joins on table display
+    // may also slow down search
+    // so maybe reevaluate this
+    sql.exec("create index if not exists temp.Filter_Lid_Index on filter (lid)");
+    sql.exec("insert into filter (lid,relevance) select distinct lid,0 from NoteTable");
+    filterLids.clear();
+    filterRelevance.clear();
+    sql.exec("select lid from filter");
+    while (sql.next())
+        filterLids.add(sql.value(0).toInt());
+    sql.finish();
+}
+
+
+// Replace the contents of this connection's filter table.  Used by
+// connections which count against a filter built somewhere else.
+void DatabaseConnection::loadFilterTable(const QList<qint32> &lids) {
+    updateFilterTable(LidBitmap::fromList(lids), QHash<qint32, int>());
+}
+
+
+// Bring the filter table in line with a new set of lids.  Only rows
+// which are added, removed or get a new relevance are written.  If
+// most of the table changes it is simply rebuilt.
+void DatabaseConnection::updateFilterTable(const LidBitmap &lids, const QHash<qint32, int> &relevance) {
+    createFilterTable();
+    LidBitmap removed = filterLids;
+    removed -= lids;
+    LidBitmap added = lids;
+    added -= filterLids;
+
+    // A write batch may already have a transaction open, which is only
+    // committed if this started it
+    NSqlQuery sql(this);
+    bool ownTransaction = conn.transaction();
+    if (removed.size() + added.size() > lids.size()) {
+        sql.exec("delete from filter");
+        added = lids;
+    } else {
+        QList<qint32> removedLids = removed.toList();
+        sql.prepare("delete from filter where lid=:lid");
+        for (int i=0; i<removedLids.size(); i++) {
+            sql.bindValue(":lid", removedLids[i]);
+            sql.exec();
+        }
+
+        // Rows which stay but whose relevance changed
+        QSet<qint32> changed = QSet<qint32>::fromList(relevance.keys());
+        changed.unite(QSet<qint32>::fromList(filterRelevance.keys()));
+        sql.prepare("update filter set relevance=:relevance where lid=:lid");
+        QSet<qint32>::const_iterator i;
+        for (i=changed.constBegin(); i!=changed.constEnd(); ++i) {
+            if (!lids.contains(*i) || added.contains(*i))
+                continue;
+            if (relevance.value(*i, 0) != filterRelevance.value(*i, 0)) {
+                sql.bindValue(":relevance", relevance.value(*i, 0));
+                sql.bindValue(":lid", *i);
+                sql.exec();
+            }
+        }
+    }
+
+    QList<qint32> addedLids = added.toList();
+    sql.prepare("insert into filter (lid,relevance) values (:lid, :relevance)");
+    for (int i=0; i<addedLids.size(); i++) {
+        sql.bindValue(":lid", addedLids[i]);
+        sql.bindValue(":relevance", relevance.value(addedLids[i], 0));
+        sql.exec();
+    }
+    sql.finish();
+    if (ownTransaction)
+        conn.commit();
+
+    filterLids = lids;
+    filterRelevance.clear();
+    QHash<qint32, int>::const_iterator r;
+    for (r=relevance.constBegin(); r!=relevance.constEnd(); ++r) {
+        if (r.value() != 0 && lids.contains(r.key()))
+            filterRelevance.insert(r.key(), r.value());
+    }
+}
+
+
+// Add, drop or re-rank a single note in the filter table.  Returns
+// true if the note was added or dropped.
+bool DatabaseConnection::updateFilterLid(qint32 lid, bool include, int relevance) {
+    createFilterTable();
+    bool present = filterLids.contains(lid);
+    NSqlQuery sql(this);
+    if (!include) {
+        if (!present)
+            return false;
+        sql.prepare("delete from filter where lid=:lid");
+        sql.bindValue(":lid", lid);
+        sql.exec();
+        sql.finish();
+        filterLids.remove(lid);
+        filterRelevance.remove(lid);
+        return true;
+    }
+
+    if (!present) {
+        sql.prepare("insert into filter (lid,relevance) values (:lid, :relevance)");
+        filterLids.add(lid);
+    } else if (filterRelevance.value(lid, 0) != relevance) {
+        sql.prepare("update filter set relevance=:relevance where lid=:lid");
+    } else {
+        return false;
+    }
+    sql.bindValue(":lid", lid);
+    sql.bindValue(":relevance", relevance);
+    sql.exec();
+    sql.finish();
+    if (relevance != 0)
+        filterRelevance.insert(lid, relevance);
+    else
+        filterRelevance.remove(lid);
+    return !present;
+}
+
+
+// The lids in this connection's filter table.  Only this class writes
+// the table, so the copy we keep is always current.
+const LidBitmap &DatabaseConnection::getFilterLids() {
+    createFilterTable();
+    return filterLids;
+}
+
+
+// Was this connection opened read-only?
+bool DatabaseConnection::isReadOnly() {
+    return readOnly;
+}
+
+
+// Apply the pragma profile from the settings.  The cache size is
+// given to SQLite in KiB (a negative value), mmap in bytes.
+void DatabaseConnection::applyPragmas() {
+    NSqlQuery query(this);
+    query.exec("pragma busy_timeout=50000");
+    query.exec("pragma cache_size=-" + QString::number(global.getDatabaseCacheSize()));
+    query.exec("pragma mmap_size=" + QString::number(qint64(global.getDatabaseMmapSize()) * 1024 * 1024));
+    query.exec("pragma temp_store=memory");
+}
+
+
+
+// Return the statement used to insert DataStore records.  While a write
+// batch is active this is the batch's prepared insert so it is reused
+// across rows.  Otherwise the caller's query is prepared & returned.
+NSqlQuery &DatabaseConnection::dataStoreInsert(NSqlQuery &query) {
+    if (writeBatch != nullptr)
+        return *writeBatch->insertQuery();
+    query.prepare("Insert into DataStore (lid, key, data) values (:lid, :key, :data)");
+    return query;
+}
+
+
+// Subscribe to the change log.  The listener is called from
+// publishChanges() on this connection's thread with everything logged
+// since the previous call.
+qint32 DatabaseConnection::subscribe(ChangeListener listener) {
+    if (publishedSequence < 0) {
+        ChangeLog changeLog(this);
+        publishedSequence = changeLog.getHighestSequence();
+    }
+    nextListenerId++;
+    listeners.insert(nextListenerId, listener);
+    return nextListenerId;
+}
+
+
+// Stop a change log subscription
+void DatabaseConnection::unsubscribe(qint32 id) {
+    listeners.remove(id);
+}
+
+
+// Read the changes logged (by any connection) since the last call and
+// hand them to the subscribers, a page at a time.
+void DatabaseConnection::publishChanges() {
+    if (listeners.size() == 0)
+        return;
+    ChangeLog changeLog(this);
+    QList<ChangeLogEntry> changes;
+    do {
+        bool complete = changeLog.getChanges(changes, publishedSequence, CHANGE_LOG_PAGE);
+        if (changes.size() == 0 && complete)
+            return;
+        if (!complete)
+            publishedSequence = changeLog.getCompactedSequence();
+        for (qint32 i=0; i<changes.size(); i++) {
+            if (changes[i].sequence > publishedSequence)
+                publishedSequence = changes[i].sequence;
+        }
+        QList<ChangeListener> current = listeners.values();
+        for (qint32 i=0; i<current.size(); i++)
+            current[i](changes, complete);
+    } while (changes.size() >= CHANGE_LOG_PAGE);
+}
@@ -23,6 +23,8 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include "src/global.h"
 #include "datastore.h"
 #include "configstore.h"
+#include "changelog.h"
+#include "src/utilities/lidbitmap.h"
 
 #include <QtSql>
 
@@ -35,6 +37,9 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 class NoteTable;
 class ConfigStore;
 class DataStore;
+class NSqlQuery;
+class WriteBatch;
+class StatementCache;
 
 // Define the class used to access the table
 class DatabaseConnection
@@ -45,6 +50,8 @@ public:
     QSqlDatabase conn;              // The actual database connection
     ConfigStore *configStore;       // Table used to store program settings
     DataStore *dataStore;           // Table that contains the note data
+    WriteBatch *writeBatch;         // Active bulk write batch (if any)
+    StatementCache *statementCache; // Prepared statements reused by NSqlQuery
     enum LockMethod {
         Unlocked = 0,
         Read = 1,
@@ -52,16 +59,38 @@ public:
     };
 
 
-    DatabaseConnection(QString connection);           // Generic constructor
+    DatabaseConnection(QString connection, bool readOnly=false);  // Generic constructor
     ~DatabaseConnection();          // Destructor
     void lockForRead();
     void lockForWrite();
     void unlock();
     QString getConnectionName();
+    bool isReadOnly();
+    // The TEMP filter table is only ever written through these, so the
+    // lids kept in filterLids always match it.  Other code may read the
+    // table in its queries but must not change it.
+    void createFilterTable();                       // Build this connection's TEMP filter table if needed
+    void loadFilterTable(const QList<qint32> &lids);  // Replace the filter table contents
+    void updateFilterTable(const LidBitmap &lids, const QHash<qint32, int> &relevance);  // Change only the filter rows which differ
+    bool updateFilterLid(qint32 lid, bool include, int relevance);  // Add, drop or re-rank one note in the filter
+    const LidBitmap &getFilterLids();                // Lids in the filter table
+    NSqlQuery &dataStoreInsert(NSqlQuery &query);   // DataStore insert, reused while a write batch is active
+    qint32 subscribe(ChangeListener listener);      // Get told about changes in the change log
+    void unsubscribe(qint32 id);                    // Stop a subscription
+    void publishChanges();                          // Give subscribers the changes logged since the last call
+    qint32 failedStatements;                        // NSqlQuery statements which failed on this connection
 
 private:
     LockMethod dbLocked;
     QString connection;
+    bool readOnly;
+    bool filterTableCreated;
+    LidBitmap filterLids;                           // Lids in the filter table
+    QHash<qint32, int> filterRelevance;             // Relevance of the filter rows (when not 0)
+    QHash<qint32, ChangeListener> listeners;        // Change log subscribers by id
+    qint32 nextListenerId;
+    qint64 publishedSequence;                       // Last change log entry given to subscribers
+    void applyPragmas();
 };
 
 #endif // DATABASECONNECTION_H
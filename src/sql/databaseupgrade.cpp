@@ -8,6 +8,8 @@
 #include "src/sql/linkednotebooktable.h"
 #include "src/sql/sharednotebooktable.h"
 #include "src/sql/nsqlquery.h"
+#include "src/sql/rowstore.h"
+#include "src/sql/configstore.h"
 #include "src/global.h"
 
 
@@ -81,3 +83,62 @@ void DatabaseUpgrade::fixSql(bool toQt5) {
         trueQuery.exec();
     }
 }
+
+
+
+// Copy the existing DataStore records into the typed row store.  This is
+// done in batches of lids, each in its own transaction.  The last lid copied
+// is saved after every batch so an interrupted upgrade resumes where it
+// stopped rather than starting over.
+void DatabaseUpgrade::buildRowStore() {
+    const qint32 batchSize = 1000;
+    RowStore rowStore(global.db);
+    ConfigStore cs(global.db);
+
+    qint32 startLid = 0;
+    QByteArray value;
+    if (cs.getSetting(value, CONFIG_STORE_ROWSTORE_MIGRATION))
+        startLid = value.toInt();
+
+    qint32 highestLid = rowStore.getHighestLid();
+    QLOG_DEBUG() << "Building row store from lid " << startLid << " to " << highestLid;
+    while (startLid < highestLid) {
+        qint32 endLid = startLid + batchSize;
+        global.db->conn.transaction();
+        rowStore.refreshAll(startLid+1, endLid);
+        cs.saveSetting(CONFIG_STORE_ROWSTORE_MIGRATION, QByteArray::number(endLid));
+        global.db->conn.commit();
+        startLid = endLid;
+    }
+}
+
+
+
+// Fill the NoteTags join table from the existing note tag records.
+void DatabaseUpgrade::buildNoteTags() {
+    RowStore rowStore(global.db);
+    global.db->conn.transaction();
+    rowStore.refreshNoteTags(0, rowStore.getHighestLid());
+    global.db->conn.commit();
+}
+
+
+
+// Fill the NoteLocations R*Tree from the existing note rows.
+void DatabaseUpgrade::buildNoteLocations() {
+    RowStore rowStore(global.db);
+    global.db->conn.transaction();
+    rowStore.refreshNoteLocations(0, rowStore.getHighestLid());
+    global.db->conn.commit();
+}
+
+
+
+// Remove the note content, tags & resource data bodies older databases
+// copied into the typed tables
+void DatabaseUpgrade::dropCopiedData() {
+    RowStore rowStore(global.db);
+    global.db->conn.transaction();
+    rowStore.dropCopiedData();
+    global.db->conn.commit();
+}
@@ -9,6 +9,10 @@ class DatabaseUpgrade : public QObject
 public:
     explicit DatabaseUpgrade(QObject *parent = 0);
     void fixSql(bool toQt5=true);
+    void buildRowStore();
+    void buildNoteTags();
+    void buildNoteLocations();
+    void dropCopiedData();
 
 signals:
 
@@ -26,8 +26,12 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include "searchtable.h"
 #include "tagtable.h"
 #include "notebooktable.h"
+#include "notetable.h"
+#include "resourcetable.h"
+#include "linkednotebooktable.h"
 #include "src/global.h"
 #include "src/sql/nsqlquery.h"
+#include "src/sql/fulltextindex.h"
 
 extern Global global;
 
@@ -48,7 +52,6 @@ DataStore::DataStore(DatabaseConnection *db)
       this->createTable();
   }
   this->setTable("DataStore");
-  this->select();
   this->setEditStrategy(QSqlTableModel::OnFieldChange);
   sql.finish();
   db->unlock();
@@ -88,10 +91,8 @@ void DataStore::createTable() {
         QLOG_ERROR() << "Creation of NotebookModel table failed: " << sql.lastError();
     }
 
-    if (!sql.exec("Create virtual table SearchIndex using fts4 (lid int, weight int, source text, content text)")) {
-        QLOG_ERROR() << "Creation of SearchIndex table failed: " << sql.lastError();
-    }
     sql.finish();
+    FullTextIndex::createTable(db);
     db->unlock();
     Notebook notebook;
     NotebookTable table(db);
@@ -102,3 +103,31 @@ void DataStore::createTable() {
     table.add(0,notebook,true,false);
 }
 
+
+
+
+// Covering index for the keys which are looked up by value: guids, names
+// and the lids of parent records.  It is a partial index so the note
+// content & other large values are not copied into it.  SQLite only
+// uses it when the query's key is one of these.
+void DataStore::createLookupIndex() {
+    QList<int> keys;
+    keys << NOTE_GUID << NOTE_NOTEBOOK_LID
+         << RESOURCE_GUID << RESOURCE_NOTE_LID << RESOURCE_DATA_HASH
+         << TAG_GUID << TAG_NAME << TAG_PARENT_LID
+         << NOTEBOOK_GUID << NOTEBOOK_NAME << NOTEBOOK_STACK
+         << LINKEDNOTEBOOK_GUID
+         << SEARCH_GUID << SEARCH_NAME << SEARCH_QUERY;
+    QStringList terms;
+    for (int i=0; i<keys.size(); i++)
+        terms.append(QString("key=%1").arg(keys[i]));
+
+    NSqlQuery sql(db);
+    db->lockForWrite();
+    if (!sql.exec("CREATE INDEX if not exists DataStore_Lookup on DataStore (key, data, lid) where " +
+                  terms.join(" or "))) {
+        QLOG_ERROR() << "Creation of DataStore_Lookup index failed: " << sql.lastError();
+    }
+    sql.finish();
+    db->unlock();
+}
@@ -49,6 +49,7 @@ private:
 
 public:
     explicit DataStore(DatabaseConnection *db);
+    void createLookupIndex();          // Index the keys which are looked up by value
 
 signals:
 
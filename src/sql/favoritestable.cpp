@@ -222,6 +222,10 @@ qint32 FavoritesTable::add(const FavoritesRecord &record) {
         lid = cs.incrementLidCounter();
     else
         expunge(lid);
+    if (lid < 0) {
+        db->unlock();
+        return -1;
+    }
     qint32 tempLid = getLidByTarget(record.target);
     if (tempLid>0)
         expunge(tempLid);
@@ -34,6 +34,8 @@ qint32 FileWatcherTable::addEntry(qint32 lid, QString baseDir, FileWatcher::Scan
     if (lid == 0) {
         ConfigStore cs(global.db);
         lid = cs.incrementLidCounter();
+        if (lid < 0)
+            return -1;
     }
     db->lockForWrite();
     NSqlQuery sql(db);
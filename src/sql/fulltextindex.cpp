@@ -0,0 +1,259 @@
+/*********************************************************************************
+NixNote - An open-source client for the Evernote service.
+Copyright (C) 2013 Randy Baumgarte
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+***********************************************************************************/
+
+#include "fulltextindex.h"
+#include "src/global.h"
+#include "src/sql/configstore.h"
+#include "src/sql/nsqlquery.h"
+#include "src/sql/trigramindex.h"
+#include "src/threads/databasewriter.h"
+
+extern Global global;
+
+#define SEARCH_INDEX_FTS5 "(lid unindexed, weight unindexed, source unindexed, content)"
+#define SEARCH_INDEX_FTS4 "(lid int, weight int, source text, content text)"
+
+QAtomicInt FullTextIndex::fts5(0);
+QAtomicInteger<qint64> FullTextIndex::position(-1);
+
+
+// Create the search index of a new database.  FTS5 if SQLite has it.
+void FullTextIndex::createTable(DatabaseConnection *db) {
+    NSqlQuery sql(db);
+    if (sql.exec("Create virtual table SearchIndex using fts5 " SEARCH_INDEX_FTS5)) {
+        sql.finish();
+        return;
+    }
+    QLOG_INFO() << "FTS5 not available.  Using FTS4 for the search index: " << sql.lastError();
+    if (!sql.exec("Create virtual table SearchIndex using fts4 " SEARCH_INDEX_FTS4)) {
+        QLOG_ERROR() << "Creation of SearchIndex table failed: " << sql.lastError();
+    }
+    sql.finish();
+}
+
+
+// Look at the SearchIndex table.  An FTS4 one is copied into an FTS5 table,
+// so create that (if it isn't there from an earlier run) & pick up how far
+// the copy got.
+void FullTextIndex::checkTable(DatabaseConnection *db) {
+    NSqlQuery sql(db);
+    db->lockForWrite();
+    sql.exec("Select sql from sqlite_master where name='SearchIndex'");
+    QString definition;
+    if (sql.next())
+        definition = sql.value(0).toString();
+    fts5 = definition.contains("fts5", Qt::CaseInsensitive) ? 1 : 0;
+    position = -1;
+    if (isFts5()) {
+        sql.exec("Drop table if exists SearchIndexNew");
+        sql.finish();
+        db->unlock();
+        return;
+    }
+
+    if (!sql.exec("Create virtual table if not exists SearchIndexNew using fts5 " SEARCH_INDEX_FTS5)) {
+        QLOG_INFO() << "FTS5 not available.  Keeping the FTS4 search index: " << sql.lastError();
+        sql.finish();
+        db->unlock();
+        return;
+    }
+    sql.finish();
+    db->unlock();
+
+    ConfigStore cs(db);
+    QByteArray value;
+    if (cs.getSetting(value, CONFIG_STORE_FTS5_MIGRATION))
+        position = value.toLongLong();
+    else
+        position = 0;
+    QLOG_DEBUG() << "Search index moving to FTS5 from row " << position.load();
+}
+
+
+// Is SearchIndex an FTS5 table?
+bool FullTextIndex::isFts5() {
+    return fts5.load() != 0;
+}
+
+
+// Copy the row the connection just inserted into SearchIndex.  FTS4 hands
+// out max(rowid)+1, so a new row only lands inside the copied range when
+// the copied rows at the top were deleted.  Rows above the position are
+// left for migrate().
+void FullTextIndex::added(DatabaseConnection *db) {
+    if (position.load() < 0)
+        return;
+    NSqlQuery sql(db);
+    sql.prepare("Insert into SearchIndexNew (rowid, lid, weight, source, content) "
+                "select rowid, lid, weight, source, content from SearchIndex "
+                "where rowid=last_insert_rowid() and rowid<=:position");
+    sql.bindValue(":position", position.load());
+    if (!sql.exec())
+        QLOG_ERROR() << "Error adding to the FTS5 search index: " << sql.lastError();
+    sql.finish();
+}
+
+
+// Take a lid's rows out of the part of the FTS5 table already copied
+void FullTextIndex::removed(DatabaseConnection *db, qint32 lid) {
+    if (position.load() < 0)
+        return;
+    NSqlQuery sql(db);
+    sql.prepare("Delete from SearchIndexNew where lid=:lid and rowid<=:position");
+    sql.bindValue(":lid", lid);
+    sql.bindValue(":position", position.load());
+    if (!sql.exec())
+        QLOG_ERROR() << "Error removing from the FTS5 search index: " << sql.lastError();
+    sql.finish();
+}
+
+
+// Take a lid's rows from one source out of the FTS5 table
+void FullTextIndex::removed(DatabaseConnection *db, qint32 lid, QString source) {
+    if (position.load() < 0)
+        return;
+    NSqlQuery sql(db);
+    sql.prepare("Delete from SearchIndexNew where lid=:lid and source=:source and rowid<=:position");
+    sql.bindValue(":lid", lid);
+    sql.bindValue(":source", source);
+    sql.bindValue(":position", position.load());
+    if (!sql.exec())
+        QLOG_ERROR() << "Error removing from the FTS5 search index: " << sql.lastError();
+    sql.finish();
+}
+
+
+// Build the MATCH expression for a term.  FTS5 only takes letters & digits
+// in a bare word, so the term is quoted there.  FTS4 quotes phrases only.
+QString FullTextIndex::matchQuery(QString term, bool prefix) {
+    if (term.endsWith("*"))
+        term.chop(1);
+    if (isFts5()) {
+        term = "\"" + term.replace("\"", "\"\"") + "\"";
+        if (prefix)
+            term = term + " *";
+        return term;
+    }
+    if (prefix)
+        term = term + "*";
+    if (term.contains(" "))
+        term = "\"" + term + "\"";
+    return term;
+}
+
+
+// Copy the next batch of SearchIndex rows into the FTS5 table.  Progress
+// is saved in the ConfigStore so an interrupted copy carries on where it
+// stopped.  When there is nothing left to copy the tables are swapped.
+// Returns the number of rows copied.
+qint32 FullTextIndex::migrate(DatabaseConnection *db, qint32 limit) {
+    qint64 after = position.load();
+    if (after < 0)
+        return 0;
+
+    NSqlQuery sql(db);
+    db->lockForWrite();
+    sql.prepare("Select count(*), max(rowid) from (Select rowid from SearchIndex "
+                "where rowid>:after order by rowid limit :limit)");
+    sql.bindValue(":after", after);
+    sql.bindValue(":limit", limit);
+    qint32 count = 0;
+    qint64 upto = after;
+    if (sql.exec() && sql.next()) {
+        count = sql.value(0).toInt();
+        upto = sql.value(1).toLongLong();
+    }
+    if (count == 0) {
+        sql.finish();
+        db->unlock();
+        swap(db);
+        return 0;
+    }
+
+    sql.prepare("Insert into SearchIndexNew (rowid, lid, weight, source, content) "
+                "select rowid, lid, weight, source, content from SearchIndex where rowid>:after and rowid<=:upto");
+    sql.bindValue(":after", after);
+    sql.bindValue(":upto", upto);
+    if (!sql.exec()) {
+        QLOG_ERROR() << "Error copying the search index to FTS5: " << sql.lastError();
+        sql.finish();
+        db->unlock();
+        position = -1;
+        return 0;
+    }
+    sql.finish();
+    db->unlock();
+
+    position = upto;
+    ConfigStore cs(db);
+    cs.saveSetting(CONFIG_STORE_FTS5_MIGRATION, QByteArray::number(upto));
+    return count;
+}
+
+
+// Replace SearchIndex with the FTS5 copy.  added() & removed() have kept
+// the copied rows up to date, so only rows above the position (inserted
+// after the last batch) are copied before the rename.  Everything happens
+// under a savepoint, so a failure leaves the FTS4 table as it was.
+bool FullTextIndex::swap(DatabaseConnection *db) {
+    NSqlQuery sql(db);
+    db->lockForWrite();
+    sql.exec("Savepoint fts5swap");
+    sql.prepare("Insert into SearchIndexNew (rowid, lid, weight, source, content) "
+                "select rowid, lid, weight, source, content from SearchIndex where rowid>:position");
+    sql.bindValue(":position", position.load());
+    bool ok = sql.exec();
+    ok = ok && sql.exec("Drop table if exists SearchTrigram");
+    ok = ok && sql.exec("Drop table SearchIndex");
+    ok = ok && sql.exec("Alter table SearchIndexNew rename to SearchIndex");
+    if (!ok) {
+        QLOG_ERROR() << "Unable to replace the search index with FTS5: " << sql.lastError();
+        sql.exec("Rollback to fts5swap");
+        sql.exec("Release fts5swap");
+        sql.finish();
+        db->unlock();
+        position = -1;
+        return false;
+    }
+    sql.exec("Release fts5swap");
+    sql.finish();
+    db->unlock();
+
+    fts5 = 1;
+    position = -1;
+    ConfigStore cs(db);
+    cs.saveSetting(CONFIG_STORE_FTS5_MIGRATION, QByteArray::number(0));
+    TrigramIndex::reset(db);
+    TrigramIndex::buildInBackground();
+    QLOG_INFO() << "Search index moved to FTS5";
+    return true;
+}
+
+
+// Queue a copy batch on the database writer.  Each batch queues the next
+// one until the tables have been swapped.
+void FullTextIndex::migrateInBackground() {
+    if (global.dbWriter == nullptr || position.load() < 0)
+        return;
+    global.dbWriter->enqueue([](DatabaseConnection *db) {
+        migrate(db, 500);
+        if (position.load() >= 0 && !global.dbWriter->isStopping())
+            migrateInBackground();
+    });
+}
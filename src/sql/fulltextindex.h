@@ -0,0 +1,66 @@
+/*********************************************************************************
+NixNote - An open-source client for the Evernote service.
+Copyright (C) 2013 Randy Baumgarte
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+***********************************************************************************/
+
+#ifndef FULLTEXTINDEX_H
+#define FULLTEXTINDEX_H
+
+#include <QAtomicInt>
+#include <QAtomicInteger>
+#include <QString>
+
+class DatabaseConnection;
+
+//***********************************************************
+// SearchIndex used to be an FTS4 table.  New databases get
+// an FTS5 table, which has smaller segments, a faster MATCH
+// & bm25() to rank the notes by how well they match.
+//
+// Older databases are moved over in the background.  The
+// database writer copies the rows in rowid order into
+// SearchIndexNew, keeping their rowids.  Every change to
+// SearchIndex is mirrored into the rows already copied
+// with added() & removed(), so once the copy has caught up
+// the swap only copies whatever arrived above its position,
+// replaces SearchIndex with the copy & starts the trigram
+// index over.  Until then searches use FTS4.
+//
+// If SQLite was built without FTS5, SearchIndex stays FTS4
+// & the notes aren't ranked.
+//***********************************************************
+
+class FullTextIndex
+{
+private:
+    static QAtomicInt fts5;                          // Is SearchIndex an FTS5 table?
+    static QAtomicInteger<qint64> position;          // Last rowid copied into SearchIndexNew (-1 if not moving)
+    static bool swap(DatabaseConnection *db);        // Replace SearchIndex with the copy
+
+public:
+    static void createTable(DatabaseConnection *db); // Create SearchIndex in a new database
+    static void checkTable(DatabaseConnection *db);  // See which SearchIndex there is & start moving an FTS4 one
+    static bool isFts5();                            // Can SearchIndex be queried with FTS5 syntax & bm25()?
+    static void added(DatabaseConnection *db);       // Mirror the SearchIndex row just inserted
+    static void removed(DatabaseConnection *db, qint32 lid);  // Mirror deleting a lid's SearchIndex rows
+    static void removed(DatabaseConnection *db, qint32 lid, QString source);
+    static QString matchQuery(QString term, bool prefix);  // MATCH expression finding a term (or words starting with it)
+    static qint32 migrate(DatabaseConnection *db, qint32 limit);  // Copy a batch of rows into the FTS5 table
+    static void migrateInBackground();               // Queue the move to FTS5 on the writer
+};
+
+#endif // FULLTEXTINDEX_H
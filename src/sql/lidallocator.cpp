@@ -0,0 +1,108 @@
+/*********************************************************************************
+NixNote - An open-source client for the Evernote service.
+Copyright (C) 2013 Randy Baumgarte
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+***********************************************************************************/
+
+#include "lidallocator.h"
+#include "src/sql/configstore.h"
+#include "src/sql/databaseconnection.h"
+#include "src/sql/nsqlquery.h"
+#include "src/global.h"
+
+#define LID_RESERVE_ATTEMPTS 3
+
+extern Global global;
+
+
+// Constructor
+LidAllocator::LidAllocator()
+{
+    nextLid = 0;
+    lastLid = -1;
+}
+
+
+// Get the next lid, reserving a new block when the current one is used
+// up.  The mutex isn't held while the counter is updated, so a thread
+// waiting on SQLite never holds up threads with lids left to hand out.
+// -1 if no block could be reserved.
+qint32 LidAllocator::next(DatabaseConnection *db) {
+    QMutexLocker locker(&mutex);
+    for (qint32 i=0; i<LID_RESERVE_ATTEMPTS && nextLid > lastLid; i++) {
+        qint32 floor = lastLid;
+        qint32 blockSize = global.getLidBlockSize();
+        if (blockSize < 1)
+            blockSize = 1;
+        locker.unlock();
+        qint32 last = reserve(db, floor, blockSize);
+        locker.relock();
+
+        if (last < 0)
+            continue;
+        if (nextLid <= lastLid)             // Another thread reserved meanwhile.  Ours is left as a gap.
+            break;
+        if (last - blockSize + 1 <= lastLid)  // Overlaps a block reserved meanwhile, so try again above it
+            continue;
+        lastLid = last;
+        nextLid = last - blockSize + 1;
+        QLOG_DEBUG() << "Reserved lids " << nextLid << " to " << lastLid;
+    }
+    if (nextLid > lastLid) {
+        QLOG_ERROR() << "Unable to reserve a block of lids";
+        return -1;
+    }
+    return nextLid++;
+}
+
+
+// Move the ConfigStore counter past its old value, "floor" & every lid in
+// the DataStore by a block & return the new value, the last lid of the
+// block.  -1 on failure.
+qint32 LidAllocator::reserve(DatabaseConnection *db, qint32 floor, qint32 blockSize) {
+    bool ownTransaction = db->conn.transaction();
+    NSqlQuery sql(db);
+    qint32 last = -1;
+    sql.prepare("Insert or ignore into ConfigStore (key, value) values (:key, 0)");
+    sql.bindValue(":key", CONFIG_STORE_LID);
+    bool updated = sql.exec();
+    if (updated) {
+        sql.prepare(QString("Update ConfigStore set value=max(value, :floor, ") +
+                    QString("coalesce((select max(lid) from DataStore),0))+:blockSize where key=:key"));
+        sql.bindValue(":floor", floor);
+        sql.bindValue(":blockSize", blockSize);
+        sql.bindValue(":key", CONFIG_STORE_LID);
+        updated = sql.exec();
+    }
+    if (!updated)
+        QLOG_ERROR() << "Error reserving lids: " << sql.lastError();
+    if (updated) {
+        sql.prepare("Select value from ConfigStore where key=:key");
+        sql.bindValue(":key", CONFIG_STORE_LID);
+        if (sql.exec() && sql.next())
+            last = sql.value(0).toInt();
+    }
+    sql.finish();
+    if (ownTransaction) {
+        if (last >= 0 && !db->conn.commit()) {
+            QLOG_ERROR() << "Error committing the lid counter: " << db->conn.lastError();
+            last = -1;
+        }
+        if (last < 0)
+            db->conn.rollback();
+    }
+    return last;
+}
@@ -0,0 +1,63 @@
+/*********************************************************************************
+NixNote - An open-source client for the Evernote service.
+Copyright (C) 2013 Randy Baumgarte
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+***********************************************************************************/
+
+#ifndef LIDALLOCATOR_H
+#define LIDALLOCATOR_H
+
+#include <QMutex>
+
+class DatabaseConnection;
+
+//***********************************************************
+// Hands out local IDs (lids) for new notes, resources, tags,
+// notebooks, ...  Rather than updating a counter for every
+// lid, a block of lids (the "lidBlockSize" setting) is
+// reserved with one update of the ConfigStore counter and
+// handed out from memory.  Any thread may ask for a lid.
+//
+// The counter is moved on the caller's own connection: in a
+// short transaction of its own, or inside the caller's
+// transaction when one is open (sync, imports, write
+// batches).  A second connection couldn't get the write lock
+// the caller's transaction already holds.
+//
+// If the caller's transaction is rolled back, so is the
+// counter, but the lids already handed out aren't reused:
+// every reservation starts past the last lid reserved in
+// memory & the highest lid in the DataStore.  Threads
+// reserve independently, and a block which overlaps one
+// another thread reserved meanwhile is reserved again.
+// A reservation which fails returns an error to the caller
+// instead of a lid.
+//***********************************************************
+
+class LidAllocator
+{
+private:
+    QMutex mutex;
+    qint32 nextLid;                             // Next lid to hand out
+    qint32 lastLid;                             // Last lid of the reserved block
+    qint32 reserve(DatabaseConnection *db, qint32 floor, qint32 blockSize);  // Reserve a block, returns its last lid
+
+public:
+    LidAllocator();
+    qint32 next(DatabaseConnection *db);        // Get a new lid, -1 on failure
+};
+
+#endif // LIDALLOCATOR_H
@@ -0,0 +1,90 @@
+/*********************************************************************************
+NixNote - An open-source client for the Evernote service.
+Copyright (C) 2013 Randy Baumgarte
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+***********************************************************************************/
+
+#include "lidmap.h"
+
+
+// Constructor
+LidMap::LidMap()
+{
+}
+
+
+// Return the lid for a guid, or 0 if it isn't cached
+qint32 LidMap::getLid(qint32 key, const QString &guid) {
+    QReadLocker locker(&lock);
+    return lids.value(key).value(guid, 0);
+}
+
+
+// Return the guid for a lid if it is cached
+bool LidMap::getGuid(qint32 key, qint32 lid, QString &guid) {
+    QReadLocker locker(&lock);
+    QHash<qint32, QPair<qint32, QString> >::const_iterator i = guids.constFind(lid);
+    if (i == guids.constEnd() || i.value().first != key)
+        return false;
+    guid = i.value().second;
+    return true;
+}
+
+
+// Remember a guid/lid pair.  Any old pair for the lid or the guid is
+// replaced.
+void LidMap::insert(qint32 key, const QString &guid, qint32 lid) {
+    if (lid <= 0 || guid == "")
+        return;
+    QWriteLocker locker(&lock);
+    if (guids.contains(lid)) {
+        QPair<qint32, QString> old = guids.value(lid);
+        lids[old.first].remove(old.second);
+    }
+    qint32 oldLid = lids[key].value(guid, 0);
+    if (oldLid != 0 && oldLid != lid)
+        guids.remove(oldLid);
+    lids[key].insert(guid, lid);
+    guids.insert(lid, QPair<qint32, QString>(key, guid));
+}
+
+
+// Forget the pair for a lid
+void LidMap::remove(qint32 lid) {
+    QWriteLocker locker(&lock);
+    if (!guids.contains(lid))
+        return;
+    QPair<qint32, QString> old = guids.take(lid);
+    lids[old.first].remove(old.second);
+}
+
+
+// Forget every pair for one kind of object
+void LidMap::clear(qint32 key) {
+    QWriteLocker locker(&lock);
+    QHash<QString, qint32> keyLids = lids.take(key);
+    QHash<QString, qint32>::const_iterator i;
+    for (i = keyLids.constBegin(); i != keyLids.constEnd(); ++i)
+        guids.remove(i.value());
+}
+
+
+// Forget everything
+void LidMap::clear() {
+    QWriteLocker locker(&lock);
+    lids.clear();
+    guids.clear();
+}
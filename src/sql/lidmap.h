@@ -0,0 +1,57 @@
+/*********************************************************************************
+NixNote - An open-source client for the Evernote service.
+Copyright (C) 2013 Randy Baumgarte
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+***********************************************************************************/
+
+#ifndef LIDMAP_H
+#define LIDMAP_H
+
+#include <QHash>
+#include <QPair>
+#include <QString>
+#include <QReadWriteLock>
+
+//***********************************************************
+// Process-wide cache of GUID <-> LID pairs.  Each pair is
+// remembered under the DataStore key which holds the GUID
+// (NOTE_GUID, RESOURCE_GUID, TAG_GUID & NOTEBOOK_GUID) so
+// the same GUID can't resolve to the wrong kind of object.
+//
+// Entries are added the first time a lookup reaches the
+// database and are dropped when a record's GUID changes or
+// the record is expunged or re-synchronized.  Only hits are
+// cached; an unknown GUID always goes to the database.
+//***********************************************************
+
+class LidMap
+{
+private:
+    QReadWriteLock lock;
+    QHash<qint32, QHash<QString, qint32> > lids;     // key -> (guid -> lid)
+    QHash<qint32, QPair<qint32, QString> > guids;    // lid -> (key, guid)
+
+public:
+    LidMap();
+    qint32 getLid(qint32 key, const QString &guid);             // Return a cached lid or 0
+    bool getGuid(qint32 key, qint32 lid, QString &guid);        // Return a cached guid
+    void insert(qint32 key, const QString &guid, qint32 lid);   // Remember a guid/lid pair
+    void remove(qint32 lid);                                    // Forget a lid
+    void clear(qint32 key);                                     // Forget every pair for a key
+    void clear();                                               // Forget everything
+};
+
+#endif // LIDMAP_H
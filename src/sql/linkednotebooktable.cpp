@@ -24,6 +24,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include "src/sql/notebooktable.h"
 #include "src/sql/sharednotebooktable.h"
 #include "src/sql/nsqlquery.h"
+#include "src/sql/rowstore.h"
 #include "src/global.h"
 
 
@@ -97,6 +98,8 @@ qint32 LinkedNotebookTable::sync(qint32 lid, LinkedNotebook &notebook) {
         if (lid == 0) {
             ConfigStore cs(db);
             lid = cs.incrementLidCounter();
+            if (lid < 0)
+                return -1;
             NotebookTable ntable(db);
 
             // Build the dummy notebook entry
@@ -161,6 +164,8 @@ qint32 LinkedNotebookTable::add(qint32 l, LinkedNotebook &t, bool isDirty) {
     if (lid == 0) {
         lid = cs.incrementLidCounter();
     }
+    if (lid < 0)
+        return -1;
 
     NSqlQuery query(db);
     NSqlQuery query2(db);
@@ -276,6 +281,9 @@ qint32 LinkedNotebookTable::add(qint32 l, LinkedNotebook &t, bool isDirty) {
 
     query.finish();
     db->unlock();
+
+    RowStore rowStore(db);
+    rowStore.refreshNotebook(lid);
     return lid;
 }
 
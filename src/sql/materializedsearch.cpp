@@ -0,0 +1,213 @@
+/*********************************************************************************
+NixNote - An open-source client for the Evernote service.
+Copyright (C) 2013 Randy Baumgarte
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+***********************************************************************************/
+
+#include "materializedsearch.h"
+#include "src/sql/databaseconnection.h"
+#include "src/sql/nsqlquery.h"
+#include "src/sql/searchtable.h"
+#include "src/global.h"
+
+extern Global global;
+
+
+// Constructor
+MaterializedSearch::MaterializedSearch(DatabaseConnection *db)
+{
+    this->db = db;
+}
+
+
+// Create the tables.  This is safe to call every time the database is
+// opened.  Results of saved searches which were deleted are dropped.
+void MaterializedSearch::createTable() {
+    NSqlQuery sql(db);
+    db->lockForWrite();
+    if (!sql.exec(QString("Create table if not exists MaterializedSearches (") +
+                  QString("searchLid integer primary key, settings text, sequence integer)"))) {
+        QLOG_ERROR() << "Creation of MaterializedSearches table failed: " << sql.lastError();
+    }
+    if (!sql.exec(QString("Create table if not exists MaterializedSearchResults (") +
+                  QString("searchLid integer, noteLid integer, primary key (searchLid, noteLid)) without rowid"))) {
+        QLOG_ERROR() << "Creation of MaterializedSearchResults table failed: " << sql.lastError();
+    }
+    sql.prepare("Delete from MaterializedSearches where searchLid not in "
+                "(select lid from DataStore where key=:key)");
+    sql.bindValue(":key", SEARCH_QUERY);
+    sql.exec();
+    sql.exec("Delete from MaterializedSearchResults where searchLid not in "
+             "(select searchLid from MaterializedSearches)");
+    sql.finish();
+    db->unlock();
+}
+
+
+// Are the results of this saved search kept?
+bool MaterializedSearch::isMaterialized(qint32 searchLid) {
+    bool retval = false;
+    NSqlQuery sql(db);
+    db->lockForRead();
+    sql.prepare("Select searchLid from MaterializedSearches where searchLid=:searchLid");
+    sql.bindValue(":searchLid", searchLid);
+    sql.exec();
+    if (sql.next())
+        retval = true;
+    sql.finish();
+    db->unlock();
+    return retval;
+}
+
+
+// Start or stop keeping the results of a saved search.  A new one has
+// no settings, so its results are built the first time it is used.
+void MaterializedSearch::setMaterialized(qint32 searchLid, bool materialized) {
+    NSqlQuery sql(db);
+    db->lockForWrite();
+    if (materialized) {
+        sql.prepare("Insert or ignore into MaterializedSearches (searchLid, settings, sequence) "
+                    "values (:searchLid, '', -1)");
+        sql.bindValue(":searchLid", searchLid);
+        if (!sql.exec())
+            QLOG_ERROR() << "Error materializing search: " << sql.lastError();
+    } else {
+        sql.prepare("Delete from MaterializedSearches where searchLid=:searchLid");
+        sql.bindValue(":searchLid", searchLid);
+        sql.exec();
+        sql.prepare("Delete from MaterializedSearchResults where searchLid=:searchLid");
+        sql.bindValue(":searchLid", searchLid);
+        sql.exec();
+    }
+    sql.finish();
+    db->unlock();
+}
+
+
+// Look for a materialized saved search with this query.  The query is
+// matched against the saved search itself, so a search which was edited
+// is found under its new query (with settings which no longer match).
+bool MaterializedSearch::find(QString query, qint32 &searchLid, QString &key, qint64 &sequence) {
+    bool retval = false;
+    NSqlQuery sql(db);
+    db->lockForRead();
+    sql.prepare("Select m.searchLid, m.settings, m.sequence from MaterializedSearches m "
+                "join DataStore d on d.lid=m.searchLid where d.key=:key and d.data=:query");
+    sql.bindValue(":key", SEARCH_QUERY);
+    sql.bindValue(":query", query);
+    sql.exec();
+    if (sql.next()) {
+        searchLid = sql.value(0).toInt();
+        key = sql.value(1).toString();
+        sequence = sql.value(2).toLongLong();
+        retval = true;
+    }
+    sql.finish();
+    db->unlock();
+    return retval;
+}
+
+
+// Get the stored notes of a search
+void MaterializedSearch::getResults(qint32 searchLid, LidBitmap &lids) {
+    lids.clear();
+    NSqlQuery sql(db);
+    db->lockForRead();
+    sql.prepare("Select noteLid from MaterializedSearchResults where searchLid=:searchLid");
+    sql.bindValue(":searchLid", searchLid);
+    sql.exec();
+    while (sql.next())
+        lids.add(sql.value(0).toInt());
+    sql.finish();
+    db->unlock();
+}
+
+
+// Replace the stored notes of a search after it was evaluated in full
+bool MaterializedSearch::setResults(qint32 searchLid, QString key, qint64 sequence, const LidBitmap &lids) {
+    db->lockForWrite();
+    bool ownTransaction = db->conn.transaction();
+    NSqlQuery sql(db);
+    sql.prepare("Delete from MaterializedSearchResults where searchLid=:searchLid");
+    sql.bindValue(":searchLid", searchLid);
+    bool ok = sql.exec();
+
+    sql.prepare("Insert into MaterializedSearchResults (searchLid, noteLid) values (:searchLid, :noteLid)");
+    QList<qint32> noteLids = lids.toList();
+    for (int i=0; ok && i<noteLids.size(); i++) {
+        sql.bindValue(":searchLid", searchLid);
+        sql.bindValue(":noteLid", noteLids[i]);
+        ok = sql.exec();
+    }
+
+    sql.prepare("Update MaterializedSearches set settings=:settings, sequence=:sequence where searchLid=:searchLid");
+    sql.bindValue(":settings", key);
+    sql.bindValue(":sequence", sequence);
+    sql.bindValue(":searchLid", searchLid);
+    ok = ok && sql.exec();
+    if (!ok)
+        QLOG_ERROR() << "Error storing search results: " << sql.lastError();
+    sql.finish();
+    if (ownTransaction) {
+        if (ok)
+            db->conn.commit();
+        else
+            db->conn.rollback();
+    }
+    db->unlock();
+    return ok;
+}
+
+
+// Add & remove the notes which started or stopped matching a search
+bool MaterializedSearch::updateResults(qint32 searchLid, qint64 sequence, const LidBitmap &added, const LidBitmap &removed) {
+    db->lockForWrite();
+    bool ownTransaction = db->conn.transaction();
+    NSqlQuery sql(db);
+    bool ok = true;
+
+    sql.prepare("Insert or ignore into MaterializedSearchResults (searchLid, noteLid) values (:searchLid, :noteLid)");
+    QList<qint32> noteLids = added.toList();
+    for (int i=0; ok && i<noteLids.size(); i++) {
+        sql.bindValue(":searchLid", searchLid);
+        sql.bindValue(":noteLid", noteLids[i]);
+        ok = sql.exec();
+    }
+
+    sql.prepare("Delete from MaterializedSearchResults where searchLid=:searchLid and noteLid=:noteLid");
+    noteLids = removed.toList();
+    for (int i=0; ok && i<noteLids.size(); i++) {
+        sql.bindValue(":searchLid", searchLid);
+        sql.bindValue(":noteLid", noteLids[i]);
+        ok = sql.exec();
+    }
+
+    sql.prepare("Update MaterializedSearches set sequence=:sequence where searchLid=:searchLid");
+    sql.bindValue(":sequence", sequence);
+    sql.bindValue(":searchLid", searchLid);
+    ok = ok && sql.exec();
+    if (!ok)
+        QLOG_ERROR() << "Error updating search results: " << sql.lastError();
+    sql.finish();
+    if (ownTransaction) {
+        if (ok)
+            db->conn.commit();
+        else
+            db->conn.rollback();
+    }
+    db->unlock();
+    return ok;
+}
@@ -0,0 +1,58 @@
+/*********************************************************************************
+NixNote - An open-source client for the Evernote service.
+Copyright (C) 2013 Randy Baumgarte
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+***********************************************************************************/
+
+#ifndef MATERIALIZEDSEARCH_H
+#define MATERIALIZEDSEARCH_H
+
+#include <QString>
+#include "src/utilities/lidbitmap.h"
+
+class DatabaseConnection;
+
+//***********************************************************
+// Stored results of the saved searches the user asked to
+// keep up to date.  MaterializedSearches has a row for each
+// such search, with the search settings its results were
+// built with & the change log sequence number they are
+// current to.  MaterializedSearchResults holds one
+// (searchLid, noteLid) row per matching note.
+//
+// The results are what the query matches on its own; the
+// notebook, tag & trash selections are still applied on
+// top.  The FilterEngine brings them up to date, only
+// rechecking the notes changed since the stored sequence.
+//***********************************************************
+
+class MaterializedSearch
+{
+private:
+    DatabaseConnection *db;
+
+public:
+    MaterializedSearch(DatabaseConnection *db);          // Constructor
+    void createTable();                                  // Create the tables & drop rows of deleted searches
+    bool isMaterialized(qint32 searchLid);               // Are this search's results kept?
+    void setMaterialized(qint32 searchLid, bool materialized);  // Start or stop keeping a search's results
+    bool find(QString query, qint32 &searchLid, QString &key, qint64 &sequence);  // Materialized search with this query
+    void getResults(qint32 searchLid, LidBitmap &lids);  // Stored matching notes
+    bool setResults(qint32 searchLid, QString key, qint64 sequence, const LidBitmap &lids);  // Replace the stored notes
+    bool updateResults(qint32 searchLid, qint64 sequence, const LidBitmap &added, const LidBitmap &removed);  // Patch the stored notes
+};
+
+#endif // MATERIALIZEDSEARCH_H
@@ -24,6 +24,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include "src/sql/sharednotebooktable.h"
 #include "src/sql/linkednotebooktable.h"
 #include "src/sql/nsqlquery.h"
+#include "src/sql/rowstore.h"
 #include "src/sql/usertable.h"
 #include "src/global.h"
 
@@ -35,6 +36,8 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include <QtSql>
 #include <QString>
 
+extern Global global;
+
 // Default constructor
 NotebookTable::NotebookTable(DatabaseConnection *db)
 {
@@ -82,6 +85,7 @@ qint32 NotebookTable::findByName(QString &name) {
 // Given a notebook's lid, we give it a new guid.  This can happen
 // the first time a record is synchronized
 void NotebookTable::updateGuid(qint32 lid, Guid &guid) {
+    global.lidMap.remove(lid);
     NSqlQuery query(db);
     db->lockForWrite();
     query.prepare("Update DataStore set data=:data where key=:key and lid=:lid");
@@ -91,6 +95,9 @@ void NotebookTable::updateGuid(qint32 lid, Guid &guid) {
     query.exec();
     query.finish();
     db->unlock();
+
+    RowStore rowStore(db);
+    rowStore.refreshNotebook(lid);
 }
 
 
@@ -118,6 +125,7 @@ qint32 NotebookTable::sync(qint32 lid, Notebook &notebook) {
         NSqlQuery query(db);
         NoteTable noteTable(db);
         noteTable.updateNotebookName(lid, notebook.name);
+        global.lidMap.remove(lid);
 
         // Delete the old record
         db->lockForWrite();
@@ -129,6 +137,8 @@ qint32 NotebookTable::sync(qint32 lid, Notebook &notebook) {
     } else {
         ConfigStore cs(db);
         lid = cs.incrementLidCounter();
+        if (lid < 0)
+            return -1;
     }
 
     return add(lid, notebook, false);
@@ -139,9 +149,11 @@ qint32 NotebookTable::sync(qint32 lid, Notebook &notebook) {
 
 // Given a notebook's GUID, we return the LID
 qint32 NotebookTable::getLid(QString guid) {
+    qint32 retval = global.lidMap.getLid(NOTEBOOK_GUID, guid);
+    if (retval > 0)
+        return retval;
 
     NSqlQuery query(db);
-    qint32 retval = 0;
     db->lockForRead();
     query.prepare("Select lid from DataStore where key=:key and data=:data");
     query.bindValue(":data", guid);
@@ -149,6 +161,7 @@ qint32 NotebookTable::getLid(QString guid) {
     query.exec();
     if (query.next()) {
         retval = query.value(0).toInt();
+        global.lidMap.insert(NOTEBOOK_GUID, guid, retval);
     } else {
         query.prepare("Select lid from DataStore where key=:key and data=:data");
         query.bindValue(":data", guid);
@@ -175,6 +188,8 @@ qint32 NotebookTable::addStub(QString guid) {
     NSqlQuery query(db);
     ConfigStore cs(db);
     qint32 lid = cs.incrementLidCounter();
+    if (lid < 0)
+        return -1;
     db->lockForWrite();
     query.prepare("Insert into DataStore (lid, key, data) values (:lid, :key, :data)");
     query.bindValue(":lid", lid);
@@ -183,6 +198,9 @@ qint32 NotebookTable::addStub(QString guid) {
     query.exec();
     query.finish();
     db->unlock();
+
+    RowStore rowStore(db);
+    rowStore.refreshNotebook(lid);
     return lid;
 }
 
@@ -199,6 +217,10 @@ qint32 NotebookTable::add(qint32 l, Notebook &t, bool isDirty, bool isLocal) {
     qint32 lid = l;
     if (lid == 0) {
         lid = cs.incrementLidCounter();
+        if (lid < 0) {
+            db->unlock();
+            return -1;
+        }
     } else {
         LinkedNotebookTable ltable(db);
         LinkedNotebook lbook;
@@ -246,6 +268,7 @@ qint32 NotebookTable::add(qint32 l, Notebook &t, bool isDirty, bool isLocal) {
         dq.prepare("delete from datastore where key=:key");
         dq.bindValue(":key", NOTEBOOK_IS_DEFAULT);
         dq.exec();
+        dq.exec("update Notebooks set isDefault=null");
 
         bool defaultNotebook = t.defaultNotebook;
         if (defaultNotebook) {
@@ -342,6 +365,9 @@ qint32 NotebookTable::add(qint32 l, Notebook &t, bool isDirty, bool isLocal) {
 
     NoteTable noteTable(db);
     noteTable.updateNotebookName(lid, t.name);
+
+    RowStore rowStore(db);
+    rowStore.refreshNotebook(lid);
     return lid;
 }
 
@@ -350,70 +376,58 @@ qint32 NotebookTable::add(qint32 l, Notebook &t, bool isDirty, bool isLocal) {
 bool NotebookTable::get(Notebook &notebook, qint32 lid) {
     NSqlQuery query(db);
     db->lockForRead();
-    query.prepare("Select key, data from DataStore where lid=:lid");
+    query.prepare(QString("Select guid, updateSequenceNumber, stack, name, isDefault, serviceCreated, ") +
+                  QString("serviceUpdated, published, publishingUri, publishingOrder, publishingAscending, ") +
+                  QString("publishingDescription from Notebooks where lid=:lid"));
     query.bindValue(":lid", lid);
     query.exec();
     Publishing publishing;
     if (query.size() == 0)
         return false;
-    while (query.next()) {
-        qint32 key = query.value(0).toInt();
-        switch (key) {
-        case (NOTEBOOK_GUID):
-            notebook.guid = query.value(1).toString();
-            break;
-        case (NOTEBOOK_UPDATE_SEQUENCE_NUMBER):
+    if (query.next()) {
+        if (!query.value(0).isNull())
+            notebook.guid = query.value(0).toString();
+        if (!query.value(1).isNull())
             notebook.updateSequenceNum = query.value(1).toInt();
-            break;
-        case (NOTEBOOK_STACK):
-            notebook.stack = query.value(1).toString();
-            break;
-        case (NOTEBOOK_NAME):
-            notebook.name = query.value(1).toString();
-            break;
-        case (NOTEBOOK_IS_DEFAULT):
-            notebook.defaultNotebook = query.value(1).toBool();
-            break;
-        case (NOTEBOOK_SERVICE_CREATED):
-            notebook.serviceCreated = query.value(1).toLongLong();
-            break;
-        case (NOTEBOOK_SERVICE_UPDATED):
-            notebook.serviceUpdated = query.value(1).toLongLong();
-            break;
-        case (NOTEBOOK_PUBLISHED):
-            notebook.published = query.value(1).toBool();
-            break;
-        case (NOTEBOOK_PUBLISHING_URI):
-            if (notebook.publishing.isSet())
-                publishing = notebook.publishing;
-            publishing.uri = query.value(1).toString();
-            notebook.publishing = publishing;
-            break;
-        case (NOTEBOOK_PUBLISHING_ORDER): {
-            qint32 value = query.value(1).toInt();
-            if (notebook.publishing.isSet())
-                publishing = notebook.publishing;
+        if (!query.value(2).isNull())
+            notebook.stack = query.value(2).toString();
+        if (!query.value(3).isNull())
+            notebook.name = query.value(3).toString();
+        if (!query.value(4).isNull())
+            notebook.defaultNotebook = query.value(4).toBool();
+        if (!query.value(5).isNull())
+            notebook.serviceCreated = query.value(5).toLongLong();
+        if (!query.value(6).isNull())
+            notebook.serviceUpdated = query.value(6).toLongLong();
+        if (!query.value(7).isNull())
+            notebook.published = query.value(7).toBool();
+
+        bool hasPublishing = false;
+        if (notebook.publishing.isSet())
+            publishing = notebook.publishing;
+        if (!query.value(8).isNull()) {
+            publishing.uri = query.value(8).toString();
+            hasPublishing = true;
+        }
+        if (!query.value(9).isNull()) {
+            qint32 value = query.value(9).toInt();
             publishing.order = NoteSortOrder::CREATED;
             if (value == NoteSortOrder::UPDATED) publishing.order = NoteSortOrder::UPDATED;
             if (value == NoteSortOrder::RELEVANCE) publishing.order = NoteSortOrder::RELEVANCE;
             if (value == NoteSortOrder::UPDATE_SEQUENCE_NUMBER) publishing.order = NoteSortOrder::UPDATE_SEQUENCE_NUMBER;
             if (value == NoteSortOrder::TITLE) publishing.order = NoteSortOrder::TITLE;
-            notebook.publishing = publishing;
-            break;
+            hasPublishing = true;
         }
-        case (NOTEBOOK_PUBLISHING_ASCENDING):
-            if (notebook.publishing.isSet())
-                publishing = notebook.publishing;
-            publishing.ascending = query.value(1).toBool();
-            notebook.publishing = publishing;
-            break;
-        case (NOTEBOOK_PUBLISHING_DESCRIPTION):
-            if (notebook.publishing.isSet())
-                publishing = notebook.publishing;
-            publishing.publicDescription = query.value(1).toString();
-            notebook.publishing = publishing;
-            break;
+        if (!query.value(10).isNull()) {
+            publishing.ascending = query.value(10).toBool();
+            hasPublishing = true;
         }
+        if (!query.value(11).isNull()) {
+            publishing.publicDescription = query.value(11).toString();
+            hasPublishing = true;
+        }
+        if (hasPublishing)
+            notebook.publishing = publishing;
     }
     query.finish();
     db->unlock();
@@ -592,6 +606,9 @@ qint32 NotebookTable::getStack(QList<qint32> &retval, QString &stack){
 
 // Get the guid for a particular lid
 bool NotebookTable::getGuid(QString &retval, qint32 lid){
+    if (global.lidMap.getGuid(NOTEBOOK_GUID, lid, retval))
+        return true;
+
     NSqlQuery query(db);
     db->lockForRead();
     query.prepare("select data from DataStore where key=:key and lid=:lid");
@@ -600,6 +617,7 @@ bool NotebookTable::getGuid(QString &retval, qint32 lid){
     query.exec();
     while (query.next()) {
         retval = query.value(0).toString();
+        global.lidMap.insert(NOTEBOOK_GUID, retval, lid);
         query.finish();
         db->unlock();
         return true;
@@ -731,6 +749,7 @@ bool NotebookTable::update(Notebook &notebook, bool isDirty) {
 
 // Erase a notebook
 void NotebookTable::expunge(qint32 lid) {
+    global.lidMap.remove(lid);
     NSqlQuery query(db);
     db->lockForWrite();
     query.prepare("delete from DataStore where lid=:lid and key>=3000 and key<3200");
@@ -738,6 +757,9 @@ void NotebookTable::expunge(qint32 lid) {
     query.exec();
     query.finish();
     db->unlock();
+
+    RowStore rowStore(db);
+    rowStore.refreshNotebook(lid);
 }
 
 
@@ -769,8 +791,11 @@ void NotebookTable::renameStack(QString oldName, QString newName) {
     query.finish();
     db->unlock();
 
-    for (qint32 i=0; i<lids.size(); i++)
+    RowStore rowStore(db);
+    for (qint32 i=0; i<lids.size(); i++) {
+        rowStore.refreshNotebook(lids[i]);
         setDirty(lids[i], true);
+    }
 }
 
 
@@ -856,6 +881,9 @@ void NotebookTable::removeFromStack(qint32 lid) {
     query.exec();
     query.finish();
     db->unlock();
+
+    RowStore rowStore(db);
+    rowStore.refreshNotebook(lid);
 }
 
 
@@ -1032,6 +1060,9 @@ void NotebookTable::setUpdateSequenceNumber(qint32 lid, qint32 usn) {
     query.exec();
     query.finish();
     db->unlock();
+
+    RowStore rowStore(db);
+    rowStore.refreshNotebook(lid);
 }
 
 // Linked notebooks are not uploaded, so we reset the dirty flags in case
@@ -1178,6 +1209,11 @@ void NotebookTable::merge(qint32 source, qint32 target) {
     query.exec();
     QLOG_DEBUG() << query.lastError();
 
+    query.prepare("Update Notes set notebookLid=:newLid where notebookLid=:oldLid");
+    query.bindValue(":newLid", target);
+    query.bindValue(":oldLid", source);
+    query.exec();
+
     query.finish();
     db->unlock();
 }
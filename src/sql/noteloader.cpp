@@ -0,0 +1,76 @@
+/*********************************************************************************
+NixNote - An open-source client for the Evernote service.
+Copyright (C) 2013 Randy Baumgarte
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+***********************************************************************************/
+
+#include "noteloader.h"
+#include "src/sql/notetable.h"
+#include "src/global.h"
+
+extern Global global;
+
+
+// Constructor
+NoteLoader::NoteLoader(DatabaseConnection *db, const QList<qint32> &lids, bool loadResources, bool loadBinary,
+                       qint32 batchSize)
+{
+    this->db = db;
+    this->lids = lids;
+    this->loadResources = loadResources;
+    this->loadBinary = loadBinary;
+    this->batchSize = batchSize > 0 ? batchSize : 1;
+    // Attachment bodies can be any size, so never hold more than one
+    // note's worth of them at a time.
+    if (loadBinary)
+        this->batchSize = 1;
+    position = 0;
+    currentLid = 0;
+}
+
+
+// Read the next batch of notes.  Lids which no longer exist are skipped
+// so a batch can come back smaller than we asked for, or even empty.
+bool NoteLoader::loadBatch() {
+    while (batchLids.size() == 0 && position < lids.size()) {
+        QList<qint32> wanted = lids.mid(position, batchSize);
+        position = position + wanted.size();
+
+        NoteTable noteTable(db);
+        noteTable.getNotes(batch, wanted, loadResources, loadBinary);
+        for (qint32 i=0; i<wanted.size(); i++) {
+            if (batch.contains(wanted[i]))
+                batchLids.append(wanted[i]);
+        }
+    }
+    return batchLids.size() > 0;
+}
+
+
+// Get the next note
+bool NoteLoader::next(Note &note) {
+    if (batchLids.size() == 0 && !loadBatch())
+        return false;
+    currentLid = batchLids.takeFirst();
+    note = batch.take(currentLid);
+    return true;
+}
+
+
+// The lid of the last note returned
+qint32 NoteLoader::lid() {
+    return currentLid;
+}
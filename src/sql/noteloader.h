@@ -0,0 +1,69 @@
+/*********************************************************************************
+NixNote - An open-source client for the Evernote service.
+Copyright (C) 2013 Randy Baumgarte
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+***********************************************************************************/
+
+#ifndef NOTELOADER_H
+#define NOTELOADER_H
+
+#include <QHash>
+#include <QList>
+
+#include "src/sql/databaseconnection.h"
+#include "src/qevercloud/QEverCloud/headers/QEverCloud.h"
+
+using namespace qevercloud;
+
+//***********************************************************
+// Loads a list of notes a batch at a time.  Each batch is
+// read with NoteTable::getNotes(), which costs the same few
+// queries no matter how many notes, tags & resources are in
+// it, instead of the dozens NoteTable::get() used to cost
+// per note.  Only one batch is held in memory, so callers
+// can walk a large list of notes without loading them all.
+// When resource bodies are loaded too a batch is a single
+// note, so only one note's attachments are in memory.
+//
+//     NoteLoader loader(db, lids, true, true);
+//     Note note;
+//     while (loader.next(note)) {
+//         ...
+//     }
+//***********************************************************
+
+class NoteLoader
+{
+private:
+    DatabaseConnection *db;
+    QList<qint32> lids;                    // Every note to load
+    QHash<qint32, Note> batch;             // Notes loaded but not yet returned
+    QList<qint32> batchLids;               // The lids in batch, in the order they are returned
+    qint32 position;                       // Index of the next lid to load
+    qint32 batchSize;
+    bool loadResources;
+    bool loadBinary;
+    qint32 currentLid;
+    bool loadBatch();                      // Read the next batch of notes
+
+public:
+    NoteLoader(DatabaseConnection *db, const QList<qint32> &lids, bool loadResources, bool loadBinary,
+               qint32 batchSize=64);       // Constructor
+    bool next(Note &note);                 // Get the next note.  False when there are no more.
+    qint32 lid();                          // The lid of the note last returned by next()
+};
+
+#endif // NOTELOADER_H
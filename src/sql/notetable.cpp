@@ -24,6 +24,10 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include "linkednotebooktable.h"
 #include "src/sql/nsqlquery.h"
 #include "tagtable.h"
+#include "rowstore.h"
+#include "blobstore.h"
+#include "contentcompressor.h"
+#include "src/threads/databasewriter.h"
 #include "src/global.h"
 #include "src/utilities/noteindexer.h"
 #include "src/utilities/NixnoteStringUtils.h"
@@ -34,6 +38,15 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 
 extern Global global;
 
+// Columns read by mapNote(), in the order it expects them
+static const QString noteColumns = QString("n.lid, n.guid, n.title, ") +
+        QString("(select c.data from DataStore c where c.lid=n.lid and c.key=%1), ").arg(NOTE_CONTENT) +
+        QString("n.contentHash, n.contentLength, ") +
+        QString("n.updateSequenceNumber, n.created, n.updated, n.deleted, n.active, n.notebookLid, ") +
+        QString("b.guid, n.subjectDate, n.latitude, n.longitude, n.altitude, n.author, ") +
+        QString("n.source, n.sourceUrl, n.sourceApplication, n.shareDate, n.placeName, ") +
+        QString("n.contentClass, n.reminderOrder, n.reminderTime, n.reminderDoneTime");
+
 // Default constructor
 NoteTable::NoteTable(DatabaseConnection *db)
 {
@@ -47,6 +60,7 @@ NoteTable::NoteTable(DatabaseConnection *db)
 void NoteTable::updateGuid(qint32 lid, Guid &guid) {
     QLOG_TRACE() << "Entering NoteTable::updateNoteGuid()";
 
+    global.lidMap.remove(lid);
     NSqlQuery query(db);
     db->lockForWrite();
     query.prepare("Update DataStore set data=:data where key=:key and lid=:lid");
@@ -56,6 +70,9 @@ void NoteTable::updateGuid(qint32 lid, Guid &guid) {
     query.exec();
     db->unlock();
 
+    RowStore rowStore(db);
+    rowStore.refreshNote(lid);
+
     QLOG_TRACE() << "Leaving NoteTable::updateNoteGuid()";
 }
 
@@ -76,6 +93,7 @@ void NoteTable::sync(qint32 lid, const Note &note, qint32 account) {
    // QLOG_TRACE() << "Entering NoteTable::sync()";
 
     if (lid > 0) {
+        global.lidMap.remove(lid);
         NSqlQuery query(db);
 
         // Delete the old record
@@ -89,6 +107,8 @@ void NoteTable::sync(qint32 lid, const Note &note, qint32 account) {
     } else {
         ConfigStore cs(db);
         lid = cs.incrementLidCounter();
+        if (lid < 0)
+            return;
     }
 
     add(lid, note, false, account);
@@ -102,6 +122,9 @@ void NoteTable::sync(qint32 lid, const Note &note, qint32 account) {
 
 // Given a note's GUID, we return the LID
 qint32 NoteTable::getLid(QString guid) {
+    qint32 retval = global.lidMap.getLid(NOTE_GUID, guid);
+    if (retval > 0)
+        return retval;
 
     NSqlQuery query(db);
     db->lockForRead();
@@ -109,9 +132,10 @@ qint32 NoteTable::getLid(QString guid) {
     query.bindValue(":key", NOTE_GUID);
     query.bindValue(":data", guid);
     query.exec();
-    qint32 retval = 0;
-    if (query.next())
+    if (query.next()) {
         retval = query.value(0).toInt();
+        global.lidMap.insert(NOTE_GUID, guid, retval);
+    }
     query.finish();
     db->unlock();
     return retval;
@@ -120,16 +144,20 @@ qint32 NoteTable::getLid(QString guid) {
 
 // Given a note's lid, return the guid
 QString NoteTable::getGuid(qint32 lid) {
+    QString retval = "";
+    if (global.lidMap.getGuid(NOTE_GUID, lid, retval))
+        return retval;
 
     NSqlQuery query(db);
-    QString retval = "";
     db->lockForRead();
     query.prepare("Select data from DataStore where key=:key and lid=:lid");
     query.bindValue(":key", NOTE_GUID);
     query.bindValue(":lid", lid);
     query.exec();
-    if (query.next())
+    if (query.next()) {
         retval = query.value(0).toString();
+        global.lidMap.insert(NOTE_GUID, retval, lid);
+    }
     query.finish();
     db->unlock();
     return retval;
@@ -159,13 +187,17 @@ qint32 NoteTable::add(qint32 l, const Note &t, bool isDirty, qint32 account) {
 
     ResourceTable resTable(db);
     ConfigStore cs(db);
-    NSqlQuery query(db);
+    NSqlQuery insertQuery(db);
+    NSqlQuery &query = db->dataStoreInsert(insertQuery);
     qint32 lid = l;
     qint32 notebookLid = account;
 
-    query.prepare("Insert into DataStore (lid, key, data) values (:lid, :key, :data)");
     if (lid <= 0) {
         lid = cs.incrementLidCounter();
+        if (lid < 0) {
+            db->unlock();
+            return -1;
+        }
     }
 
     QLOG_DEBUG() << "Adding note; lid=" << lid << ", title=" << (t.title.isSet() ? t.title : "title is empty");
@@ -211,7 +243,7 @@ qint32 NoteTable::add(qint32 l, const Note &t, bool isDirty, qint32 account) {
         QLOG_DEBUG_FILE("incoming.enml", content);
 
 
-        query.bindValue(":data", b);
+        query.bindValue(":data", ContentCompressor::compress(b));
         query.exec();
     }
 
@@ -296,6 +328,10 @@ qint32 NoteTable::add(qint32 l, const Note &t, bool isDirty, qint32 account) {
         // If not found, we insert one to avoid problems.  We'll probably get the real data later
         if (notebookLid <= 0) {
             notebookLid = cs.incrementLidCounter();
+            if (notebookLid < 0) {
+                db->unlock();
+                return -1;
+            }
             Notebook notebook;
             notebook.guid = t.notebookGuid;
             notebook.name = "<Missing Notebook>";
@@ -317,6 +353,8 @@ qint32 NoteTable::add(qint32 l, const Note &t, bool isDirty, qint32 account) {
             newTag.guid = tagGuids[i];
             newTag.name = "";
             tagLid = cs.incrementLidCounter();
+            if (tagLid < 0)
+                continue;
             tagTable.add(tagLid, newTag, false, 0);
         }
 
@@ -345,6 +383,8 @@ qint32 NoteTable::add(qint32 l, const Note &t, bool isDirty, qint32 account) {
 
         if (resLid == 0)
             resLid = cs.incrementLidCounter();
+        if (resLid < 0)
+            continue;
         resTable.add(resLid, r, isDirty, lid);
 
         if (r.mime.isSet()) {
@@ -492,6 +532,9 @@ qint32 NoteTable::add(qint32 l, const Note &t, bool isDirty, qint32 account) {
     query.finish();
     db->unlock();
 
+    RowStore rowStore(db);
+    rowStore.refreshNote(lid);
+
     updateNoteList(lid, t, isDirty, account);
 
     // Experimental index helper
@@ -521,6 +564,10 @@ qint32 NoteTable::addStub(QString noteGuid) {
 
     if (lid <= 0)
         lid = cs.incrementLidCounter();
+    if (lid < 0) {
+        db->unlock();
+        return -1;
+    }
 
     query.prepare("Insert into DataStore (lid, key, data) values (:lid, :key, :data)");
     query.bindValue(":lid", lid);
@@ -529,6 +576,9 @@ qint32 NoteTable::addStub(QString noteGuid) {
     query.exec();
     query.finish();
     db->unlock();
+
+    RowStore rowStore(db);
+    rowStore.refreshNote(lid);
     return lid;
 }
 
@@ -773,151 +823,170 @@ bool NoteTable::updateNotebookName(qint32 lid, QString name) {
 
 // Return a note structure given the LID
 bool NoteTable::get(Note &note, qint32 lid, bool loadResources, bool loadBinary) {
+    QList<qint32> lids;
+    lids.append(lid);
+    QHash<qint32, Note> notes;
+    getNotes(notes, lids, loadResources, loadBinary);
+    if (!notes.contains(lid))
+        return false;
+    note = notes.value(lid);
+    return note.guid.isSet();
+}
+
+
+
+// Load a set of notes.  The rows, tags & resources of every note are
+// each read with a single query, so the cost doesn't grow with the
+// number of tags & resources on a note.  Notes are returned by lid;
+// lids which don't exist are left out.
+void NoteTable::getNotes(QHash<qint32, Note> &notes, const QList<qint32> &lids, bool loadResources, bool loadBinary) {
+    notes.clear();
+    if (lids.size() == 0)
+        return;
 
     NSqlQuery query(db);
     db->lockForRead();
-    query.prepare("Select key, data from DataStore where lid=:lid");
-    query.bindValue(":lid", lid);
-    NoteAttributes na;
-    QList<QString> tagGuids;
-    QList<QString> tagNames;
-    if (note.attributes.isSet()) {
-        na = note.attributes;
+    query.prepare("Select " + noteColumns + " from Notes n left join Notebooks b on b.lid=n.notebookLid where n.lid in (" +
+                  NSqlQuery::lidList(lids.size()) + ")");
+    query.bindLids(lids);
+    query.exec();
+    QList<qint32> found;
+    while (query.next()) {
+        Note note;
+        mapNote(query, note);
+        notes.insert(query.value(0).toInt(), note);
+        found.append(query.value(0).toInt());
     }
+
+    // The tags come from the DataStore so they keep the order they were saved in
+    query.prepare("Select d.lid, t.guid, t.name from DataStore d join Tags t on t.lid=d.data where d.key=:key and d.lid in (" +
+                  NSqlQuery::lidList(found.size()) + ") order by d.lid, d.rowid");
+    query.bindValue(":key", NOTE_TAG_LID);
+    query.bindLids(found);
     query.exec();
+    QHash<qint32, QStringList> tagGuids;
+    QHash<qint32, QStringList> tagNames;
     while (query.next()) {
-        qint32 key = query.value(0).toInt();
-        switch (key) {
-            case (NOTE_GUID):
-                note.guid = query.value(1).toString();
-                break;
-            case (NOTE_UPDATE_SEQUENCE_NUMBER):
-                note.updateSequenceNum = query.value(1).toInt();
-                break;
-            case (NOTE_ACTIVE):
-                note.active = query.value(1).toBool();
-                break;
-            case (NOTE_DELETED_DATE):
-                note.active = query.value(1).toLongLong();
-                break;
-            case (NOTE_ATTRIBUTE_SOURCE_URL):
-                na.sourceURL = query.value(1).toString();
-                note.attributes = na;
-                break;
-            case (NOTE_ATTRIBUTE_SOURCE_APPLICATION):
-                na.sourceApplication = query.value(1).toString();
-                note.attributes = na;
-                break;
-            case (NOTE_CONTENT_LENGTH):
-                note.contentLength = query.value(1).toLongLong();
-                break;
-            case (NOTE_ATTRIBUTE_LONGITUDE):
-                na.longitude = query.value(1).toFloat();
-                note.attributes = na;
-                break;
-            case (NOTE_TITLE):
-                note.title = query.value(1).toString();
-                break;
-            case (NOTE_ATTRIBUTE_SOURCE):
-                na.source = query.value(1).toString();
-                note.attributes = na;
-                break;
-            case (NOTE_ATTRIBUTE_ALTITUDE):
-                na.altitude = query.value(1).toFloat();
-                note.attributes = na;
-                break;
-            case (NOTE_NOTEBOOK_LID): {
-                qint32 notebookLid = query.value(1).toInt();
-                NotebookTable ntable(db);
-                QString notebookGuid;
-                ntable.getGuid(notebookGuid, notebookLid);
-                note.notebookGuid = notebookGuid;
-                break;
-            }
-            case (NOTE_UPDATED_DATE):
-                note.updated = query.value(1).toLongLong();
-                break;
-            case (NOTE_CREATED_DATE):
-                note.created = query.value(1).toLongLong();
-                break;
-            case (NOTE_ATTRIBUTE_SUBJECT_DATE):
-                na.subjectDate = query.value(1).toLongLong();
-                note.attributes = na;
-                break;
-            case (NOTE_ATTRIBUTE_LATITUDE):
-                na.latitude = query.value(1).toFloat();
-                note.attributes = na;
-                break;
-            case (NOTE_CONTENT):
-                note.content = query.value(1).toByteArray().data();
-
-                // Sometimes Evernote doesn't send the XML tag with UTF8 encoding. This forces it.
-                if (global.forceUTF8 && !note.content->startsWith("<?xml"))
-                    note.content = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n" + note.content;
-                break;
-            case (NOTE_CONTENT_HASH):
-                note.contentHash = query.value(1).toByteArray();
-                break;
-            case (NOTE_ATTRIBUTE_AUTHOR):
-                na.author = query.value(1).toString();
-                note.attributes = na;
-                break;
-            case (NOTE_ISDIRTY):
-                break;
-            case (NOTE_ATTRIBUTE_SHARE_DATE) :
-                na.shareDate = query.value(1).toLongLong();
-                note.attributes = na;
-                break;
-            case (NOTE_ATTRIBUTE_PLACE_NAME) :
-                na.placeName = query.value(1).toString();
-                note.attributes = na;
-                break;
-            case (NOTE_ATTRIBUTE_CONTENT_CLASS) :
-                na.contentClass = query.value(1).toString();
-                note.attributes = na;
-                break;
-            case (NOTE_ATTRIBUTE_REMINDER_ORDER) :
-                na.reminderOrder = query.value(1).toLongLong();
-                note.attributes = na;
-                break;
-            case (NOTE_ATTRIBUTE_REMINDER_DONE_TIME) :
-                na.reminderDoneTime = query.value(1).toLongLong();
-                note.attributes = na;
-                break;
-            case (NOTE_ATTRIBUTE_REMINDER_TIME) :
-                na.reminderTime = query.value(1).toLongLong();
-                note.attributes = na;
-                break;
-            case (NOTE_TAG_LID) :
-                TagTable tagTable(db);
-                qint32 tagLid = query.value(1).toInt();
-                Tag tag;
-                tagTable.get(tag, tagLid);
-                if (tag.guid.isSet())
-                    tagGuids.append(tag.guid);
-                if (tag.name.isSet())
-                    tagNames.append(tag.name);
-                break;
-        }
+        qint32 noteLid = query.value(0).toInt();
+        if (!query.value(1).isNull())
+            tagGuids[noteLid].append(query.value(1).toString());
+        if (!query.value(2).isNull())
+            tagNames[noteLid].append(query.value(2).toString());
     }
     query.finish();
-
-    // pass always - https://github.com/d1vanov/quentier/issues/266
-    // if (tagGuids.size() > 0) {
-    note.tagGuids = tagGuids;
-    note.tagNames = tagNames;
-    // }
+    db->unlock();
 
     ResourceTable resTable(db);
     QLOG_TRACE() << "Fetching Resources? " << loadResources << " With binary? " << loadBinary;
-
-    QList<Resource> resources;
-    resTable.getAllResources(resources, lid, loadResources, loadBinary);
-    note.resources = resources;
+    QHash<qint32, QList<Resource> > resources;
+    resTable.getAllResources(resources, found, loadResources, loadBinary);
     QLOG_TRACE() << "Fetched resources";
 
-    db->unlock();
-    return note.guid.isSet();
+    for (qint32 i=0; i<found.size(); i++) {
+        Note &note = notes[found[i]];
+        // pass always - https://github.com/d1vanov/quentier/issues/266
+        note.tagGuids = tagGuids.value(found[i]);
+        note.tagNames = tagNames.value(found[i]);
+        note.resources = resources.value(found[i]);
+    }
+}
+
+
+
+// Save a note's map data.  The query must be positioned on a row
+// selected with the noteColumns list.  A null column means the
+// value was never set for this note.
+void NoteTable::mapNote(NSqlQuery &query, Note &note) {
+    NoteAttributes na;
+    if (note.attributes.isSet()) {
+        na = note.attributes;
+    }
+    if (!query.value(1).isNull())
+        note.guid = query.value(1).toString();
+    if (!query.value(2).isNull())
+        note.title = query.value(2).toString();
+    if (!query.value(3).isNull()) {
+        note.content = ContentCompressor::uncompress(query.value(3).toByteArray()).data();
+
+        // Sometimes Evernote doesn't send the XML tag with UTF8 encoding. This forces it.
+        if (global.forceUTF8 && !note.content->startsWith("<?xml"))
+            note.content = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n" + note.content;
+    }
+    if (!query.value(4).isNull())
+        note.contentHash = query.value(4).toByteArray();
+    if (!query.value(5).isNull())
+        note.contentLength = query.value(5).toLongLong();
+    if (!query.value(6).isNull())
+        note.updateSequenceNum = query.value(6).toInt();
+    if (!query.value(7).isNull())
+        note.created = query.value(7).toLongLong();
+    if (!query.value(8).isNull())
+        note.updated = query.value(8).toLongLong();
+    if (!query.value(9).isNull())
+        note.deleted = query.value(9).toLongLong();
+    if (!query.value(10).isNull())
+        note.active = query.value(10).toBool();
+    if (!query.value(11).isNull())
+        note.notebookGuid = query.value(12).toString();
+    bool hasAttributes = false;
+    if (!query.value(13).isNull()) {
+        na.subjectDate = query.value(13).toLongLong();
+        hasAttributes = true;
+    }
+    if (!query.value(14).isNull()) {
+        na.latitude = query.value(14).toFloat();
+        hasAttributes = true;
+    }
+    if (!query.value(15).isNull()) {
+        na.longitude = query.value(15).toFloat();
+        hasAttributes = true;
+    }
+    if (!query.value(16).isNull()) {
+        na.altitude = query.value(16).toFloat();
+        hasAttributes = true;
+    }
+    if (!query.value(17).isNull()) {
+        na.author = query.value(17).toString();
+        hasAttributes = true;
+    }
+    if (!query.value(18).isNull()) {
+        na.source = query.value(18).toString();
+        hasAttributes = true;
+    }
+    if (!query.value(19).isNull()) {
+        na.sourceURL = query.value(19).toString();
+        hasAttributes = true;
+    }
+    if (!query.value(20).isNull()) {
+        na.sourceApplication = query.value(20).toString();
+        hasAttributes = true;
+    }
+    if (!query.value(21).isNull()) {
+        na.shareDate = query.value(21).toLongLong();
+        hasAttributes = true;
+    }
+    if (!query.value(22).isNull()) {
+        na.placeName = query.value(22).toString();
+        hasAttributes = true;
+    }
+    if (!query.value(23).isNull()) {
+        na.contentClass = query.value(23).toString();
+        hasAttributes = true;
+    }
+    if (!query.value(24).isNull()) {
+        na.reminderOrder = query.value(24).toLongLong();
+        hasAttributes = true;
+    }
+    if (!query.value(25).isNull()) {
+        na.reminderTime = query.value(25).toLongLong();
+        hasAttributes = true;
+    }
+    if (!query.value(26).isNull()) {
+        na.reminderDoneTime = query.value(26).toLongLong();
+        hasAttributes = true;
+    }
+    if (hasAttributes)
+        note.attributes = na;
 }
 
 
@@ -1023,8 +1092,7 @@ bool NoteTable::exists(string guid) {
 qint32 NoteTable::findNotesByTag(QList<qint32> &values, qint32 tagLid) {
     NSqlQuery query(db);
     db->lockForRead();
-    query.prepare("Select lid from DataStore where key=:key and data=:tagLid");
-    query.bindValue(":key", NOTE_TAG_LID);
+    query.prepare("Select noteLid from NoteTags where tagLid=:tagLid");
     query.bindValue(":tagLid", tagLid);
     query.exec();
     while (query.next()) {
@@ -1089,9 +1157,8 @@ qint32 NoteTable::getNotesWithTag(QList<qint32> &retval, QString tag) {
     NSqlQuery query(db);
     TagTable tagTable(db);
     qint32 tagLid = tagTable.getLid(tag);
-    query.prepare("Select lid data from DataStore where data=:tag and key=:key");
+    query.prepare("Select noteLid from NoteTags where tagLid=:tag");
     query.bindValue(":tag", tagLid);
-    query.bindValue(":key", NOTE_TAG_LID);
     query.exec();
     while(query.next()) {
         retval.append(query.value(0).toInt());
@@ -1203,6 +1270,9 @@ void NoteTable::updateNotebook(qint32 noteLid, qint32 notebookLid, bool setAsDir
         query.finish();
         db->unlock();
     }
+
+    RowStore rowStore(db);
+    rowStore.refreshNote(noteLid);
 }
 
 
@@ -1235,6 +1305,9 @@ void NoteTable::updateUrl(qint32 noteLid, QString url, bool setAsDirty=false) {
     query.exec();
     query.finish();
     db->unlock();
+
+    RowStore rowStore(db);
+    rowStore.refreshNote(noteLid);
 }
 
 
@@ -1260,6 +1333,9 @@ void NoteTable::updateTitle(qint32 noteLid, QString title, bool setAsDirty=false
     query.exec();
     query.finish();
     db->unlock();
+
+    RowStore rowStore(db);
+    rowStore.refreshNote(noteLid);
 }
 
 
@@ -1292,6 +1368,9 @@ void NoteTable::updateAuthor(qint32 noteLid, QString author, bool setAsDirty=fal
     query.exec();
     query.finish();
     db->unlock();
+
+    RowStore rowStore(db);
+    rowStore.refreshNote(noteLid);
 }
 
 
@@ -1356,6 +1435,9 @@ void NoteTable::updateDate(qint32 lid, Timestamp ts, qint32 key, bool isDirty =
     query.exec();
     query.finish();
     db->unlock();
+
+    RowStore rowStore(db);
+    rowStore.refreshNote(lid);
 }
 
 
@@ -1373,6 +1455,9 @@ void NoteTable::removeTag(qint32 lid, qint32 tag, bool isDirty = false) {
     if (isDirty) {
         setDirty(lid, isDirty, false);
     }
+
+    RowStore rowStore(db);
+    rowStore.refreshNote(lid);
     rebuildNoteListTags(lid);
 }
 
@@ -1386,7 +1471,7 @@ void NoteTable::addTag(qint32 lid, qint32 tag, bool isDirty = false) {
     query.prepare("delete from DataStore where lid=:lid and key=:key and data=:tag");
     query.bindValue(":lid", lid);
     query.bindValue(":key",NOTE_TAG_LID);
-    query.bindValue(":tag:", tag);
+    query.bindValue(":tag", tag);
     query.exec();
 
     query.prepare("insert into DataStore (lid, key, data) values (:lid, :key, :data)");
@@ -1400,6 +1485,9 @@ void NoteTable::addTag(qint32 lid, qint32 tag, bool isDirty = false) {
     if (isDirty) {
         setDirty(lid, isDirty, false);
     }
+
+    RowStore rowStore(db);
+    rowStore.refreshNote(lid);
     rebuildNoteListTags(lid);
 }
 
@@ -1408,10 +1496,9 @@ bool NoteTable::hasTag(qint32 noteLid, qint32 tagLid) {
     NSqlQuery query(db);
     db->lockForRead();
     bool retval = false;
-    query.prepare("select lid from DataStore where lid=:lid and key=:key and data=:tag");
+    query.prepare("select noteLid from NoteTags where noteLid=:lid and tagLid=:tag");
     query.bindValue(":lid", noteLid);
-    query.bindValue(":key",NOTE_TAG_LID);
-    query.bindValue(":tag:", tagLid);
+    query.bindValue(":tag", tagLid);
     query.exec();
     if (query.next())
         retval =  true;
@@ -1424,19 +1511,13 @@ bool NoteTable::hasTag(qint32 noteLid, qint32 tagLid) {
 void NoteTable::rebuildNoteListTags(qint32 lid) {
     // update the note list
     QStringList tagNames;
-    TagTable tagTable(db);
     NSqlQuery query(db);
     db->lockForWrite();
-    query.prepare("select data from DataStore where lid=:lid and key=:key");
+    query.prepare("select t.name from NoteTags n join Tags t on t.lid=n.tagLid where n.noteLid=:lid and t.name is not null");
     query.bindValue(":lid", lid);
-    query.bindValue(":key", NOTE_TAG_LID);
     query.exec();
     while (query.next()) {
-        qint32 tagLid = query.value(0).toInt();
-        Tag t;
-        tagTable.get(t, tagLid);
-        if (t.name.isSet())
-            tagNames.append(t.name);
+        tagNames.append(query.value(0).toString());
     }
     qSort(tagNames.begin(), tagNames.end(), caseInsensitiveLessThan);
     QString tagCol;
@@ -1497,6 +1578,11 @@ void NoteTable::setDirty(qint32 lid, bool dirty, bool setDateUpdated) {
         query.bindValue(":lid", lid);
         query.bindValue(":value", dt);
         query.exec();
+
+        query.prepare("Update Notes set updated=:value where lid=:lid");
+        query.bindValue(":lid", lid);
+        query.bindValue(":value", dt);
+        query.exec();
     }
 
     // If it is already set to the value, then we don't
@@ -1599,6 +1685,9 @@ void NoteTable::deleteNote(qint32 lid, bool isDirty=true) {
     }
     query.finish();
     db->unlock();
+
+    RowStore rowStore(db);
+    rowStore.refreshNote(lid);
 }
 
 
@@ -1646,6 +1735,9 @@ void NoteTable::restoreNote(qint32 lid, bool isDirty=true) {
     }
     query.finish();
     db->unlock();
+
+    RowStore rowStore(db);
+    rowStore.refreshNote(lid);
 }
 
 
@@ -1688,6 +1780,7 @@ void NoteTable::expunge(qint32 lid) {
         resTable.expunge(resources[i].guid);
     }
 
+    global.lidMap.remove(lid);
     NSqlQuery query(db);
     db->lockForWrite();
     query.prepare("delete from DataStore where lid=:lid");
@@ -1698,6 +1791,9 @@ void NoteTable::expunge(qint32 lid) {
     query.exec();
     query.finish();
     db->unlock();
+
+    RowStore rowStore(db);
+    rowStore.refreshNote(lid);
 }
 
 
@@ -1832,7 +1928,7 @@ void NoteTable::updateNoteContent(qint32 lid, QString content, bool isDirty) {
     NSqlQuery query(db);
 
     query.prepare("update datastore set data=:content where lid=:lid and key=:key");
-    query.bindValue(":content", content);
+    query.bindValue(":content", ContentCompressor::compress(content.toUtf8()));
     query.bindValue(":lid", lid);
     query.bindValue(":key", NOTE_CONTENT);
     query.exec();
@@ -1911,6 +2007,10 @@ void NoteTable::updateNoteContent(qint32 lid, QString content, bool isDirty) {
     query.bindValue(":key", NOTE_INDEX_NEEDED);
     query.exec();
     query.finish();
+
+    RowStore rowStore(db);
+    rowStore.refreshNote(lid);
+
     if (global.enableIndexing) {
         query.prepare("insert into datastore (lid, key, data) values (:lid, :key, 1)");
         query.bindValue(":lid", lid);
@@ -1994,6 +2094,8 @@ qint32 NoteTable::duplicateNote(qint32 oldLid, bool keepCreatedDate) {
 
     ConfigStore cs(db);
     qint32 newLid = cs.incrementLidCounter();
+    if (newLid < 0)
+        return -1;
     db->lockForWrite();
 
     NSqlQuery query(db);
@@ -2035,11 +2137,14 @@ qint32 NoteTable::duplicateNote(qint32 oldLid, bool keepCreatedDate) {
     }
 
     // Update all the resources
+    RowStore rowStore(db);
     ResourceTable resTable(db);
     QList<qint32> lids;
     resTable.getResourceList(lids, oldLid);
     for (int i=0; i<lids.size(); i++) {
         qint32 newResLid = cs.incrementLidCounter();
+        if (newResLid < 0)
+            continue;
 
         query.prepare("insert into datastore (lid, key,data) select :newLid, key, data from datastore where lid=:oldLid");
         query.bindValue(":newLid", newResLid);
@@ -2063,23 +2168,25 @@ qint32 NoteTable::duplicateNote(qint32 oldLid, bool keepCreatedDate) {
         query.bindValue(":lid", newResLid);
         query.bindValue(":key", RESOURCE_NOTE_LID);
         query.exec();
+        rowStore.refreshResource(newResLid);
 
         QStringList filter;
         QDir resDir(global.fileManager.getDbaDirPath());
         filter << QString::number(lids[i])+".*";
         QStringList files = resDir.entryList(filter);
         for (int j=0; j<files.size(); j++) {
-            QFile file(global.fileManager.getDbaDirPath()+files[j]);
+            // The copy shares the original body, so link it rather than copy it.
             int pos = files[j].indexOf(".");
             QString type = files[j].mid(pos);
-            file.open(QIODevice::ReadOnly);
-            file.copy(global.fileManager.getDbaDirPath()+
+            BlobStore::linkFile(global.fileManager.getDbaDirPath()+files[j],
+                      global.fileManager.getDbaDirPath()+
                       QString::number(newResLid) +type);
-            file.close();
         }
     }
     query.finish();
     db->unlock();
+
+    rowStore.refreshNote(newLid);
     return newLid;
 }
 
@@ -2161,6 +2268,9 @@ void NoteTable::setUpdateSequenceNumber(qint32 lid, qint32 usn) {
     query.exec();
     query.finish();
     db->unlock();
+
+    RowStore rowStore(db);
+    rowStore.refreshNote(lid);
 }
 
 
@@ -2174,7 +2284,7 @@ void NoteTable::updateEnmediaHash(qint32 lid, QByteArray oldHash, QByteArray new
     query.bindValue(":key", NOTE_CONTENT);
     query.exec();
     if (query.next()) {
-        content = query.value(0).toString();
+        content = QString::fromUtf8(ContentCompressor::uncompress(query.value(0).toByteArray()));
 
         // Start going through & looking for the old hash
         int pos = content.indexOf("<en-note");
@@ -2254,6 +2364,9 @@ void NoteTable::resetGeography(qint32 lid, bool isDirty) {
 
     if (isDirty)
         this->setDirty(lid, isDirty);
+
+    RowStore rowStore(db);
+    rowStore.refreshNote(lid);
 }
 
 
@@ -2287,6 +2400,9 @@ void NoteTable::setGeography(qint32 lid, double longitude, double latitude, doub
 
     if (isDirty)
         this->setDirty(lid, isDirty);
+
+    RowStore rowStore(db);
+    rowStore.refreshNote(lid);
 }
 
 
@@ -2413,6 +2529,9 @@ void NoteTable::setReminderCompleted(qint32 lid, bool completed) {
     }
     query.finish();
     db->unlock();
+
+    RowStore rowStore(db);
+    rowStore.refreshNote(lid);
 }
 
 
@@ -2447,6 +2566,9 @@ void NoteTable::removeReminder(qint32 lid) {
     query.finish();
 
     db->unlock();
+
+    RowStore rowStore(db);
+    rowStore.refreshNote(lid);
 }
 
 
@@ -2661,3 +2783,68 @@ qlonglong NoteTable::getSize(qint32 lid) {
     }
     return returnValue;
 }
+
+
+// Compress the next batch of note content written before compression was
+// turned on.  Progress is saved in the ConfigStore so an interrupted
+// conversion carries on where it stopped.  Returns the number of notes
+// looked at; 0 means there is nothing left to do.
+qint32 NoteTable::compressOldContent(qint32 limit) {
+    ConfigStore cs(db);
+    qint32 afterLid = 0;
+    QByteArray value;
+    if (cs.getSetting(value, CONFIG_STORE_CONTENT_COMPRESSION))
+        afterLid = value.toInt();
+
+    NSqlQuery query(db);
+    db->lockForWrite();
+    query.prepare("Select lid, data from DataStore where key=:key and lid>:afterLid order by lid limit :limit");
+    query.bindValue(":key", NOTE_CONTENT);
+    query.bindValue(":afterLid", afterLid);
+    query.bindValue(":limit", limit);
+    query.exec();
+    QList<qint32> lids;
+    QList<QByteArray> contents;
+    qint32 count = 0;
+    while (query.next()) {
+        count++;
+        afterLid = query.value(0).toInt();
+        QByteArray data = query.value(1).toByteArray();
+        if (ContentCompressor::isCompressed(data))
+            continue;
+        QByteArray compressed = ContentCompressor::compress(data);
+        if (compressed.size() < data.size()) {
+            lids.append(afterLid);
+            contents.append(compressed);
+        }
+    }
+
+    for (qint32 i=0; i<lids.size(); i++) {
+        query.prepare("Update DataStore set data=:data where lid=:lid and key=:key");
+        query.bindValue(":data", contents[i]);
+        query.bindValue(":lid", lids[i]);
+        query.bindValue(":key", NOTE_CONTENT);
+        query.exec();
+    }
+    query.finish();
+    db->unlock();
+
+    if (count > 0)
+        cs.saveSetting(CONFIG_STORE_CONTENT_COMPRESSION, QByteArray::number(afterLid));
+    if (lids.size() > 0)
+        QLOG_DEBUG() << "Compressed content of " << lids.size() << " notes";
+    return count;
+}
+
+
+// Queue a conversion batch on the database writer.  Each batch queues
+// the next one until every note has been looked at.
+void NoteTable::compressOldContentInBackground() {
+    if (global.dbWriter == nullptr || !ContentCompressor::isEnabled())
+        return;
+    global.dbWriter->enqueue([](DatabaseConnection *db) {
+        NoteTable noteTable(db);
+        if (noteTable.compressOldContent(200) > 0 && !global.dbWriter->isStopping())
+            compressOldContentInBackground();
+    });
+}
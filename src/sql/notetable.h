@@ -34,6 +34,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include <QtSql>
 #include <QString>
 #include "src/sql/databaseconnection.h"
+#include "src/sql/nsqlquery.h"
 
 #include "src/qevercloud/QEverCloud/headers/QEverCloud.h"
 using namespace qevercloud;
@@ -106,6 +107,8 @@ public:
     bool get(Note &note, qint32 lid, bool loadResources, bool loadBinary);           // Get a note given a lid
     bool get(Note &note, QString guid, bool loadResources, bool loadBinary);         // get a note given a guid
     bool get(Note &note, string guid,bool loadResources, bool loadBinary);           // get a note given a guid
+    void getNotes(QHash<qint32, Note> &notes, const QList<qint32> &lids, bool loadResources, bool loadBinary);  // Get a set of notes
+    void mapNote(NSqlQuery &query, Note &note);              // Save a note's map data
     bool isDirty(qint32 lid);                                // Check if a note is dirty
     bool isDirty(QString guid);                              // Check if a note is dirty
     bool isDirty(string guid);                               // Check if a note is dirty
@@ -160,6 +163,8 @@ public:
     qint32 duplicateNote(qint32 oldLid, bool keepCreatedDate=false);    // Duplicate an existing note
     void setUpdateSequenceNumber(qint32 lid, qint32 usn);               // set the update sequence number
     void updateNoteContent(qint32 lid, QString content, bool isDirty=true);   // Update the content of a note
+    qint32 compressOldContent(qint32 limit);                 // Compress a batch of content stored before compression
+    static void compressOldContentInBackground();            // Queue compression of old content on the writer
     void updateEnmediaHash(qint32 lid, QByteArray oldHash, QByteArray newHash, bool isDirty=true);      // Update the hash value for a resource in a notte
     bool updateNotebookGuid(QString oldGuid, QString newGuid, QString name);       // Update a notebook's name/guid
     bool updateNoteList(qint32 lid, const Note &t, bool isDirty, qint32 account);  // Update the user viewing list
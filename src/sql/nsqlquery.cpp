@@ -23,6 +23,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include <QSqlError>
 
 #include "src/global.h"
+#include "src/sql/statementcache.h"
 
 // Windows Check
 #ifndef _WIN32
@@ -44,14 +45,13 @@ NSqlQuery::NSqlQuery(DatabaseConnection *db) :
     QSqlQuery(db->conn)
 {
     this->db = db;
-    DEBUG_TRIGGER = 100;
-    INDEX_PAUSE_TRIGGER = 10;
 }
 
 
 // Destructor
 NSqlQuery::~NSqlQuery() {
     this->finish();
+    releaseStatement();
 //    if (db->dbLocked) {
 //        QLOG_DEBUG() << "*** Warning: NSqlQuery Terminating with lock active";
 //        global.stackDump();
@@ -59,6 +59,31 @@ NSqlQuery::~NSqlQuery() {
 }
 
 
+// Prepare a statement.  If the connection has this SQL cached we share
+// its prepared statement instead of having SQLite parse it again.
+bool NSqlQuery::prepare(const QString &query) {
+    releaseStatement();
+    if (db->statementCache->acquire(query, *this)) {
+        cachedSql = query;
+        return true;
+    }
+    if (!QSqlQuery::prepare(query))
+        return false;
+    if (db->statementCache->insert(query, *this))
+        cachedSql = query;
+    return true;
+}
+
+
+// Hand a cached statement back so another query can use it
+void NSqlQuery::releaseStatement() {
+    if (cachedSql == "")
+        return;
+    db->statementCache->release(cachedSql);
+    cachedSql = "";
+}
+
+
 QString getLastExecutedQuery(const QSqlQuery& query)
 {
     QString str = query.lastQuery();
@@ -72,87 +97,50 @@ QString getLastExecutedQuery(const QSqlQuery& query)
 }
 
 
-// Generic exec().  A prepare should have been done already
+// Should a statement which failed be run again?  Only lock timeouts are
+// retried, a few times, and not on the DatabaseWriter's connection.  Sync,
+// imports & GUI edits still write on their own connections, so one of
+// them can wait on another for longer than the busy timeout.  Each retry
+// waits up to the busy timeout again.  Statements which aren't retried
+// are counted as failed on the connection.
+bool NSqlQuery::retryLocked(qint32 attempt, const QString &sql) {
+    if (lastError().number() != DATABASE_LOCKED) {
+        db->failedStatements++;
+        return false;
+    }
+    if (db->getConnectionName() == "dbwriter" || attempt >= DATABASE_LOCK_RETRIES) {
+        QLOG_ERROR() << "DB Locked: " << sql;
+        db->failedStatements++;
+        return false;
+    }
+    QLOG_WARN() << "DB Locked, retry #" << attempt << ": " << sql;
+    return true;
+}
+
+
+// Generic exec().  A prepare should have been done already.
 bool NSqlQuery::exec() {
-    bool indexPauseSave;
-    bool indexRestoreNeeded = false;
     //QLOG_DEBUG() << "Sending SQL:" << getLastExecutedQuery(*this);
-    for (int i=1; i<1000; i++) {
-        bool rc = QSqlQuery::exec();
-        if (rc) {
-            if (indexRestoreNeeded)
-                global.indexRunner->pauseIndexing = indexPauseSave;
+    for (qint32 attempt=1; ; attempt++) {
+        if (QSqlQuery::exec())
             return true;
-        }
-        if (lastError().number() != DATABASE_LOCKED)
+        if (!retryLocked(attempt, getLastExecutedQuery(*this)))
             return false;
-        if (i>DEBUG_TRIGGER) {
-            QLOG_ERROR() << "DB Locked:  Retry #" << i;
-        }
-
-        if (i == INDEX_PAUSE_TRIGGER && this->db->getConnectionName() != "indexrunner") {
-            QLOG_DEBUG() << "Pausing indexrunner due to db lock";
-            indexPauseSave = global.indexRunner->pauseIndexing;
-            indexRestoreNeeded = true;
-            global.indexRunner->pauseIndexing=true;
-        }
-
-
-        // Print stack trace to see what is happening
-        if (i==DEBUG_TRIGGER) {
-            QLOG_DEBUG() << "Dumping stack due to DB lock limit of " << DEBUG_TRIGGER << " being reached.";
-            global.stackDump();
-        }
-
-        QTime dieTime= QTime::currentTime().addSecs(1);
-        while( QTime::currentTime() < dieTime )
-        QCoreApplication::processEvents(QEventLoop::AllEvents, 100);
     }
-    if (indexRestoreNeeded)
-        global.indexRunner->pauseIndexing = indexPauseSave;
-    return false;
 }
 
 
 
 // Execute a SQL statement
 bool NSqlQuery::exec(const QString &query) {
-    bool indexPauseSave;
-    bool indexRestoreNeeded = false;
+    releaseStatement();
     //QLOG_DEBUG() << "Sending SQL:" << query;
-    for (int i=1; i<1000; i++) {
-        bool rc = QSqlQuery::exec(query);
-        if (rc) {
-            if (indexRestoreNeeded)
-                global.indexRunner->pauseIndexing = indexPauseSave;
+    for (qint32 attempt=1; ; attempt++) {
+        if (QSqlQuery::exec(query))
             return true;
-        }
-        if (lastError().number() != DATABASE_LOCKED)
+        if (!retryLocked(attempt, query))
             return false;
-
-        if (i == INDEX_PAUSE_TRIGGER && this->db->getConnectionName() != "indexrunner") {
-            QLOG_DEBUG() << "Pausing indexrunner due to db lock";
-            indexPauseSave = global.indexRunner->pauseIndexing;
-            indexRestoreNeeded = true;
-            global.indexRunner->pauseIndexing=true;
-        }
-
-        if (i>DEBUG_TRIGGER) {
-            QLOG_ERROR() << "DB Locked:  Retry #" << i;
-        }
-
-        // Print stack dump to see what is happening
-        if (i==DEBUG_TRIGGER) {
-            QLOG_DEBUG() << "Dumping stack due to DB lock limit of " << DEBUG_TRIGGER << " being reached.";
-            global.stackDump();
-        }
-        QTime dieTime= QTime::currentTime().addSecs(1);
-        while( QTime::currentTime() < dieTime )
-            QCoreApplication::processEvents(QEventLoop::AllEvents, 100);
     }
-    if (indexRestoreNeeded)
-        global.indexRunner->pauseIndexing = indexPauseSave;
-    return false;
 }
 
 
@@ -174,6 +162,37 @@ bool NSqlQuery::exec(const char *query) {
 
 
 
+// Number of placeholders used for a list of lids.  It is rounded up to a
+// power of two so the statement cache only ever sees a few versions of a
+// statement which selects a set of lids.
+static qint32 lidListSize(qint32 count) {
+    qint32 size = 1;
+    while (size < count)
+        size = size*2;
+    return size;
+}
+
+
+// Build the placeholder list for "where lid in (...)"
+QString NSqlQuery::lidList(qint32 count) {
+    QStringList placeholders;
+    qint32 size = lidListSize(count);
+    for (qint32 i=0; i<size; i++)
+        placeholders.append(QString(":lid%1").arg(i));
+    return placeholders.join(", ");
+}
+
+
+// Bind the lids for a lidList() clause.  Unused placeholders get lid 0,
+// which never exists.
+void NSqlQuery::bindLids(const QList<qint32> &lids) {
+    qint32 size = lidListSize(lids.size());
+    for (qint32 i=0; i<size; i++)
+        bindValue(QString(":lid%1").arg(i), i < lids.size() ? lids[i] : 0);
+}
+
+
+
 #if QT_VERSION < 0x050000
 
 // Override bindValue for SQL fix
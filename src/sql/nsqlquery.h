@@ -19,10 +19,10 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 
 
 //*****************************************
-// This is a version of QSqlQuery.  The
-// main reason to have this is to handle
-// the database being locked and to issue
-// a retry if it fails.
+// This is a version of QSqlQuery.  It
+// reuses prepared statements cached by
+// the connection & retries lock timeouts
+// a few times.
 //*****************************************
 
 #ifndef NSQLQUERY_H
@@ -34,20 +34,25 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 using namespace std;
 
 #define DATABASE_LOCKED 5
+#define DATABASE_LOCK_RETRIES 3        // Times a statement is run before a lock timeout is given up on
 
 class NSqlQuery : public QSqlQuery
 {
 private:
     DatabaseConnection *db;
-    int DEBUG_TRIGGER;
-    int INDEX_PAUSE_TRIGGER;
+    QString cachedSql;                     // SQL of the cached statement we are using (if any)
+    void releaseStatement();               // Give a cached statement back to the connection
+    bool retryLocked(qint32 attempt, const QString &sql);  // Run a statement which timed out on a lock again?
 public:
     explicit NSqlQuery(DatabaseConnection *db);   // Constructor
     ~NSqlQuery();                          // Destructor
+    bool prepare(const QString &query);    // Prepare a statement, reusing a cached one if possible
     bool exec();                           // Execute SQL statement
     bool exec(const QString &query);       // Execute SQL statement
     bool exec(const string query);         // Execute SQL statement
     bool exec(const char *query);          // Execute SQL statement
+    static QString lidList(qint32 count);  // Placeholders for an "in" clause of up to count lids
+    void bindLids(const QList<qint32> &lids);    // Bind the lids for a lidList() clause
 
 #if QT_VERSION < 0x050000
     // Overrides for SQLite fix in Qt 4.8
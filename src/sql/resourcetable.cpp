@@ -21,6 +21,8 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include "resourcetable.h"
 #include "configstore.h"
 #include "notetable.h"
+#include "rowstore.h"
+#include "blobstore.h"
 #include "src/utilities/mimereference.h"
 #include "src/sql/nsqlquery.h"
 #include "src/utilities/noteindexer.h"
@@ -33,6 +35,16 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 using namespace std;
 extern Global global;
 
+// Columns read by mapResource(), in the order it expects them
+static const QString resourceColumns = QString("r.lid, r.guid, n.guid, r.dataHash, r.dataSize, r.mime, r.active, ") +
+        QString("r.height, r.width, r.duration, ") +
+        QString("(select b.data from DataStore b where b.lid=r.lid and b.key=%1), ").arg(RESOURCE_RECOGNITION_BODY) +
+        QString("r.recognitionSize, r.recognitionHash, r.updateSequenceNumber, ") +
+        QString("(select b.data from DataStore b where b.lid=r.lid and b.key=%1), ").arg(RESOURCE_ALTERNATE_BODY) +
+        QString("r.alternateSize, r.alternateHash, r.sourceUrl, ") +
+        QString("r.cameraMake, r.cameraModel, r.altitude, r.longitude, r.latitude, r.recoType, r.attachment, ") +
+        QString("r.fileName, r.clientWillIndex, r.timestamp");
+
 // Default constructor
 ResourceTable::ResourceTable(DatabaseConnection *db) {
     this->db = db;
@@ -44,6 +56,7 @@ ResourceTable::ResourceTable(DatabaseConnection *db) {
 void ResourceTable::updateGuid(qint32 lid, Guid &guid) {
     QLOG_TRACE() << "Entering ResourceTable::updateGuid()";
 
+    global.lidMap.remove(lid);
     db->lockForWrite();
     NSqlQuery query(db);
     query.prepare("Update DataStore set data=:data where key=:key and lid=:lid");
@@ -54,6 +67,9 @@ void ResourceTable::updateGuid(qint32 lid, Guid &guid) {
     query.finish();
     db->unlock();
 
+    RowStore rowStore(db);
+    rowStore.refreshResource(lid);
+
     QLOG_TRACE() << "Leaving ResourceTable::updateGuid()";
 }
 
@@ -73,6 +89,7 @@ void ResourceTable::sync(qint32 lid, Resource &resource) {
     QLOG_TRACE() << "Leaving ResourceTable::sync()";
 
     if (lid > 0) {
+        global.lidMap.remove(lid);
         expunge(lid);
         NSqlQuery query(db);
         // Delete the old record
@@ -86,6 +103,8 @@ void ResourceTable::sync(qint32 lid, Resource &resource) {
     } else {
         ConfigStore cs(db);
         lid = cs.incrementLidCounter();
+        if (lid < 0)
+            return;
     }
 
     add(lid, resource, false);
@@ -101,11 +120,8 @@ qint32 ResourceTable::getLid(QString noteGuid, QString guid) {
     NoteTable n(db);
     db->lockForRead();
     qint32 noteLid = n.getLid(noteGuid);
-    query.prepare(
-            "Select a.lid from DataStore a where a.data=:data and a.key=:key and a.lid = (select distinct b.lid from DataStore b where b.key=:key2 and b.data=:noteLid)");
-    query.bindValue(":data", guid);
-    query.bindValue(":key", RESOURCE_GUID);
-    query.bindValue(":key2", RESOURCE_NOTE_LID);
+    query.prepare("Select lid from Resources where guid=:guid and noteLid=:noteLid");
+    query.bindValue(":guid", guid);
     query.bindValue(":noteLid", noteLid);
     query.exec();
     qint32 retval = 0;
@@ -133,15 +149,20 @@ qint32 ResourceTable::getLid(string resourceGuid) {
 
 // Get the lid for a given resource's guid
 qint32 ResourceTable::getLid(QString resourceGuid) {
+    qint32 retval = global.lidMap.getLid(RESOURCE_GUID, resourceGuid);
+    if (retval > 0)
+        return retval;
+
     NSqlQuery query(db);
     db->lockForRead();
     query.prepare("Select lid from DataStore where key=:key and data=:data");
     query.bindValue(":key", RESOURCE_GUID);
     query.bindValue(":data", resourceGuid);
     query.exec();
-    qint32 retval = 0;
-    if (query.next())
+    if (query.next()) {
         retval = query.value(0).toInt();
+        global.lidMap.insert(RESOURCE_GUID, resourceGuid, retval);
+    }
     query.finish();
     db->unlock();
     return retval;
@@ -150,15 +171,20 @@ qint32 ResourceTable::getLid(QString resourceGuid) {
 
 // Get the guid for a given resource lid
 QString ResourceTable::getGuid(int lid) {
+    QString retval = "";
+    if (global.lidMap.getGuid(RESOURCE_GUID, lid, retval))
+        return retval;
+
     NSqlQuery query(db);
     db->lockForRead();
     query.prepare("Select data from DataStore where key=:key and lid=:lid");
     query.bindValue(":key", RESOURCE_GUID);
     query.bindValue(":lid", lid);
     query.exec();
-    QString retval = "";
-    if (query.next())
+    if (query.next()) {
         retval = query.value(0).toString();
+        global.lidMap.insert(RESOURCE_GUID, retval, lid);
+    }
     query.finish();
     db->unlock();
     return retval;
@@ -170,14 +196,14 @@ bool ResourceTable::get(Resource &resource, qint32 lid, bool withBinary) {
 
     NSqlQuery query(db);
     db->lockForRead();
-    query.prepare("Select key, data from DataStore where lid=:lid");
+    query.prepare("Select " + resourceColumns + " from Resources r left join Notes n on n.lid=r.noteLid where r.lid=:lid");
     query.bindValue(":lid", lid);
     query.exec();
     if (query.size() == 0) {
         db->unlock();
         return false;
     }
-    while (query.next()) {
+    if (query.next()) {
         mapResource(query, resource);
     }
     query.finish();
@@ -194,26 +220,30 @@ bool ResourceTable::get(Resource &resource, qint32 lid, bool withBinary) {
         if (attributes.fileName.isSet())
             filename = attributes.fileName;
         QString fileExt = ref.getExtensionFromMime(mimetype, filename);
-        QFile tfile(global.fileManager.getDbaDirPath() + QString::number(lid) + fileExt);
-        tfile.open(QIODevice::ReadOnly);
-        QByteArray b = tfile.readAll();
         Data d;
         if (resource.data.isSet())
             d = resource.data;
-        d.body = b;
+        QByteArray hash;
+        if (d.bodyHash.isSet())
+            hash = d.bodyHash;
+        // Bodies in the blob store are mapped, not read, so they cost
+        // nothing until somebody actually looks at the bytes.
+        BlobStore blobs(db);
+        d.body = blobs.getResourceBody(lid, fileExt, hash);
         resource.data = d;
-        tfile.close();
     }
 
     return true;
 }
 
 
-// Save a resource's map data.
+// Save a resource's map data.  The query must be positioned on a row
+// selected with the resourceColumns list.  A null column means the
+// value was never set for this resource.
 void ResourceTable::mapResource(NSqlQuery &query, Resource &resource) {
-    NoteTable ntable(db);
     Data d, rd, ad;
     ResourceAttributes attributes;
+    bool hasData = false, hasRecognition = false, hasAlternate = false, hasAttributes = false;
     if (resource.data.isSet())
         d = resource.data;
     if (resource.recognition.isSet())
@@ -222,111 +252,108 @@ void ResourceTable::mapResource(NSqlQuery &query, Resource &resource) {
         ad = resource.alternateData;
     if (resource.attributes.isSet())
         attributes = resource.attributes;
-    qint32 key = query.value(0).toInt();
-    switch (key) {
-        case (RESOURCE_GUID):
-            resource.guid = query.value(1).toString();
-            break;
-        case (RESOURCE_NOTE_LID):
-            resource.noteGuid = ntable.getGuid(query.value(1).toInt());
-            break;
-        case (RESOURCE_DATA_BODY):
-            break;
-        case (RESOURCE_DATA_HASH):
-            d.bodyHash = QByteArray::fromHex(query.value(1).toByteArray());
-            resource.data = d;
-            break;
-        case (RESOURCE_DATA_SIZE):
-            d.size = query.value(1).toInt();
-            resource.data = d;
-            break;
-        case (RESOURCE_MIME):
-            resource.mime = query.value(1).toString();
-            break;
-        case (RESOURCE_ACTIVE):
-            resource.active = query.value(1).toBool();
-            break;
-        case (RESOURCE_HEIGHT):
-            resource.height = query.value(1).toString().toInt();
-            break;
-        case (RESOURCE_WIDTH):
-            resource.width = query.value(1).toString().toInt();
-            break;
-        case (RESOURCE_DURATION):
-            resource.duration = query.value(1).toString().toInt();
-            break;
-        case (RESOURCE_RECOGNITION_BODY):
-            rd.body = query.value(1).toByteArray();
-            resource.recognition = rd;
-            break;
-        case (RESOURCE_RECOGNITION_HASH):
-            rd.bodyHash = query.value(1).toByteArray();
-            resource.recognition = rd;
-            break;
-        case (RESOURCE_RECOGNITION_SIZE):
-            rd.size = query.value(1).toInt();
-            resource.recognition = rd;
-            break;
-        case (RESOURCE_UPDATE_SEQUENCE_NUMBER):
-            resource.duration = query.value(1).toString().toInt();
-            break;
-        case (RESOURCE_ALTERNATE_BODY):
-            ad.body = query.value(1).toByteArray();
-            resource.alternateData = ad;
-            break;
-        case (RESOURCE_ALTERNATE_HASH):
-            ad.bodyHash = query.value(1).toByteArray();
-            resource.alternateData = ad;
-            break;
-        case (RESOURCE_ALTERNATE_SIZE):
-            ad.size = query.value(1).toInt();
-            resource.alternateData = ad;
-            break;
-        case (RESOURCE_SOURCE_URL):
-            attributes.sourceURL = query.value(1).toString();
-            resource.attributes = attributes;
-            break;
-        case (RESOURCE_CAMERA_MAKE):
-            attributes.cameraMake = query.value(1).toString();
-            resource.attributes = attributes;
-            break;
-        case (RESOURCE_CAMERA_MODEL):
-            attributes.cameraModel = query.value(1).toString();
-            resource.attributes = attributes;
-            break;
-        case (RESOURCE_ALTITUDE):
-            attributes.altitude = query.value(1).toString().toDouble();
-            resource.attributes = attributes;
-            break;
-        case (RESOURCE_LONGITUDE):
-            attributes.longitude = query.value(1).toString().toDouble();
-            resource.attributes = attributes;
-            break;
-        case (RESOURCE_LATITUDE):
-            attributes.latitude = query.value(1).toString().toDouble();
-            resource.attributes = attributes;
-            break;
-        case (RESOURCE_RECO_TYPE):
-            attributes.recoType = query.value(1).toString();
-            resource.attributes = attributes;
-            break;
-        case (RESOURCE_ATTACHMENT):
-            attributes.attachment = query.value(1).toBool();
-            resource.attributes = attributes;
-            break;
-        case (RESOURCE_FILENAME):
-            attributes.fileName = query.value(1).toString();
-            resource.attributes = attributes;
-            break;
-        case (RESOURCE_CLIENT_WILL_INDEX):
-            attributes.clientWillIndex = query.value(1).toBool();
-            resource.attributes = attributes;
-            break;
-        case (RESOURCE_TIMESTAMP):
-            attributes.timestamp = query.value(1).toDouble();
-            resource.attributes = attributes;
-            break;
+
+    if (!query.value(1).isNull())
+        resource.guid = query.value(1).toString();
+    if (!query.value(2).isNull())
+        resource.noteGuid = query.value(2).toString();
+    if (!query.value(3).isNull()) {
+        d.bodyHash = QByteArray::fromHex(query.value(3).toByteArray());
+        hasData = true;
     }
+    if (!query.value(4).isNull()) {
+        d.size = query.value(4).toInt();
+        hasData = true;
+    }
+    if (!query.value(5).isNull())
+        resource.mime = query.value(5).toString();
+    if (!query.value(6).isNull())
+        resource.active = query.value(6).toBool();
+    if (!query.value(7).isNull())
+        resource.height = query.value(7).toString().toInt();
+    if (!query.value(8).isNull())
+        resource.width = query.value(8).toString().toInt();
+    if (!query.value(9).isNull())
+        resource.duration = query.value(9).toString().toInt();
+    if (!query.value(10).isNull()) {
+        rd.body = query.value(10).toByteArray();
+        hasRecognition = true;
+    }
+    if (!query.value(11).isNull()) {
+        rd.size = query.value(11).toInt();
+        hasRecognition = true;
+    }
+    if (!query.value(12).isNull()) {
+        rd.bodyHash = query.value(12).toByteArray();
+        hasRecognition = true;
+    }
+    if (!query.value(13).isNull())
+        resource.updateSequenceNum = query.value(13).toString().toInt();
+    if (!query.value(14).isNull()) {
+        ad.body = query.value(14).toByteArray();
+        hasAlternate = true;
+    }
+    if (!query.value(15).isNull()) {
+        ad.size = query.value(15).toInt();
+        hasAlternate = true;
+    }
+    if (!query.value(16).isNull()) {
+        ad.bodyHash = query.value(16).toByteArray();
+        hasAlternate = true;
+    }
+    if (!query.value(17).isNull()) {
+        attributes.sourceURL = query.value(17).toString();
+        hasAttributes = true;
+    }
+    if (!query.value(18).isNull()) {
+        attributes.cameraMake = query.value(18).toString();
+        hasAttributes = true;
+    }
+    if (!query.value(19).isNull()) {
+        attributes.cameraModel = query.value(19).toString();
+        hasAttributes = true;
+    }
+    if (!query.value(20).isNull()) {
+        attributes.altitude = query.value(20).toString().toDouble();
+        hasAttributes = true;
+    }
+    if (!query.value(21).isNull()) {
+        attributes.longitude = query.value(21).toString().toDouble();
+        hasAttributes = true;
+    }
+    if (!query.value(22).isNull()) {
+        attributes.latitude = query.value(22).toString().toDouble();
+        hasAttributes = true;
+    }
+    if (!query.value(23).isNull()) {
+        attributes.recoType = query.value(23).toString();
+        hasAttributes = true;
+    }
+    if (!query.value(24).isNull()) {
+        attributes.attachment = query.value(24).toBool();
+        hasAttributes = true;
+    }
+    if (!query.value(25).isNull()) {
+        attributes.fileName = query.value(25).toString();
+        hasAttributes = true;
+    }
+    if (!query.value(26).isNull()) {
+        attributes.clientWillIndex = query.value(26).toBool();
+        hasAttributes = true;
+    }
+    if (!query.value(27).isNull()) {
+        attributes.timestamp = query.value(27).toDouble();
+        hasAttributes = true;
+    }
+
+    if (hasData)
+        resource.data = d;
+    if (hasRecognition)
+        resource.recognition = rd;
+    if (hasAlternate)
+        resource.alternateData = ad;
+    if (hasAttributes)
+        resource.attributes = attributes;
 }
 
 
@@ -427,10 +454,12 @@ qint32 ResourceTable::add(qint32 l, Resource &t, bool isDirty, int noteLid) {
         lid = cs.incrementLidCounter();
     else
         expunge(lid);
+    if (lid < 0)
+        return -1;
 
-    NSqlQuery query(db);
+    NSqlQuery insertQuery(db);
+    NSqlQuery &query = db->dataStoreInsert(insertQuery);
     db->lockForWrite();
-    query.prepare("Insert into DataStore (lid, key, data) values (:lid, :key, :data)");
 
     if (t.guid.isSet()) {
         QString guid = t.guid;
@@ -495,13 +524,11 @@ qint32 ResourceTable::add(qint32 l, Resource &t, bool isDirty, int noteLid) {
             QString fileExt = ref.getExtensionFromMime(mimetype, filename);
             QLOG_DEBUG() << "Resource mime=" << mimetype << ", fileExt=" << fileExt;
 
-            QString tfileName(global.fileManager.getDbaDirPath() + QString::number(lid) + fileExt);
-            QFile tfile(tfileName);
-            QLOG_DEBUG() << "Adding resource to database tfileName=" << tfileName;
-            tfile.open(QIODevice::WriteOnly);
-            if (d.size > 0)
-                tfile.write(d.body);
-            tfile.close();
+            // The body goes into the blob store.  It is only written if
+            // we don't already have the same content.
+            BlobStore blobs(db);
+            if (!blobs.addResource(lid, fileExt, d))
+                QLOG_ERROR() << "Unable to save resource " << lid << " body";
         }
     }
 
@@ -703,6 +730,9 @@ qint32 ResourceTable::add(qint32 l, Resource &t, bool isDirty, int noteLid) {
     query.finish();
     db->unlock();
 
+    RowStore rowStore(db);
+    rowStore.refreshResource(lid);
+
     NoteIndexer indexer(db);
     indexer.indexResource(lid);
     return lid;
@@ -866,6 +896,7 @@ void ResourceTable::expunge(qint32 lid) {
     if (!this->exists(lid)) {
         return;
     }
+    global.lidMap.remove(lid);
     NSqlQuery query(db);
     db->lockForWrite();
     query.prepare("delete from DataStore where lid=:lid");
@@ -874,6 +905,9 @@ void ResourceTable::expunge(qint32 lid) {
     query.finish();
     db->unlock();
 
+    RowStore rowStore(db);
+    rowStore.refreshResource(lid);
+
     // Delete the physical files (resource)
     QDir myDir(global.fileManager.getDbaDirPath());
     QString num = QString::number(lid);
@@ -935,6 +969,9 @@ void ResourceTable::updateResourceHash(qint32 lid, QByteArray newhash) {
     query.exec();
     query.finish();
     db->unlock();
+
+    RowStore rowStore(db);
+    rowStore.refreshResource(lid);
 }
 
 
@@ -986,6 +1023,9 @@ qint32 ResourceTable::addStub(qint32 resLid, qint32 noteLid) {
     query.exec();
     query.finish();
     db->unlock();
+
+    RowStore rowStore(db);
+    rowStore.refreshResource(resLid);
     return resLid;
 }
 
@@ -1051,6 +1091,9 @@ void ResourceTable::updateNoteLid(qint32 resourceLid, qint32 newNoteLid) {
     query.exec();
     query.finish();
     db->unlock();
+
+    RowStore rowStore(db);
+    rowStore.refreshResource(resourceLid);
 }
 
 
@@ -1073,144 +1116,119 @@ void ResourceTable::getResourceMap(QHash<QString, qint32> &map, QHash<qint32, Re
 // Get a resource's map data
 void
 ResourceTable::getResourceMap(QHash<QString, qint32> &hashMap, QHash<qint32, Resource> &resourceMap, qint32 noteLid) {
-    NoteTable ntable(db);
-    QString noteGuid = ntable.getGuid(noteLid);
     NSqlQuery query(db);
-    qint32 prevLid = -1;
     db->lockForRead();
-    query.prepare(
-            "Select key, data, lid from datastore where lid in (select lid from datastore where key=:key2 and data=:noteLid) order by lid");
-    query.bindValue(":key2", RESOURCE_NOTE_LID);
+    query.prepare("Select " + resourceColumns + " from Resources r left join Notes n on n.lid=r.noteLid where r.noteLid=:noteLid order by r.lid");
     query.bindValue(":noteLid", noteLid);
     query.exec();
     hashMap.clear();
     resourceMap.clear();
-    Resource *r = nullptr;
-    QString hash;
     while (query.next()) {
-        qint32 lid = query.value(2).toInt();
-
-        // Peek at the next record to see if we are at the end
-        // If this is the last result set, we force a save of the
-        // record
-        if (!query.next()) {
-            prevLid = lid;
-            lid = -1;
-        }
-        query.previous();
-
-        // If these don't match, we need to save the current
-        // record we are building.
-        if (prevLid != lid) {
-            if (prevLid > 0) {
-                if (hash != "") {
-                    hashMap.insert(hash, prevLid);
-                    if (r == nullptr)
-                        r = new Resource();
-                    if (!r->noteGuid.isSet()) {
-                        r->noteGuid = noteGuid;
-                    }
-                    resourceMap.insert(prevLid, *r);
-                    delete r;
-                }
-            }
-            r = new Resource();
-            prevLid = lid;
-            hash = "";
-        }
-        qint32 key = query.value(0).toInt();
-        if (key == RESOURCE_DATA_HASH) {
-            hash = query.value(1).toString();
+        qint32 lid = query.value(0).toInt();
+        QString hash = query.value(3).toString();
+        if (hash != "") {
+            Resource r;
+            mapResource(query, r);
+            hashMap.insert(hash, lid);
+            resourceMap.insert(lid, r);
         }
-        mapResource(query, *r);
     }
-    db->unlock();
     query.finish();
-
-    if (r != nullptr)
-        delete r;
+    db->unlock();
 }
 
 
 // Get all resources for a note
 void ResourceTable::getAllResources(QList<Resource> &list, qint32 noteLid, bool fullLoad, bool withBinary) {
     QLOG_DEBUG() << "getAllResources noteLid=" << noteLid << ", fullLoad=" << fullLoad << ", withBinary=" << withBinary;
+    QList<qint32> noteLids;
+    noteLids.append(noteLid);
+    QHash<qint32, QList<Resource> > map;
+    getAllResources(map, noteLids, fullLoad, withBinary);
+    list = map.value(noteLid);
+    QLOG_DEBUG() << "getAllResources: done";
+}
 
 
-    //NoteTable ntable(db);
-    //QString noteGuid = ntable.getGuid(noteLid);
+// Get all resources for a set of notes with a single query.  The
+// resources are returned by the lid of the owning note in lid order.
+void ResourceTable::getAllResources(QHash<qint32, QList<Resource> > &map, const QList<qint32> &noteLids, bool fullLoad, bool withBinary) {
+    map.clear();
+    if (noteLids.size() == 0)
+        return;
+
     NSqlQuery query(db);
     db->lockForRead();
-    QHash<qint32, Resource *> lidMap;
     if (fullLoad) {
-        query.prepare(
-                "Select key, data, lid from datastore where lid in (select lid from datastore where key=:key2 and data=:noteLid) order by lid");
-        query.bindValue(":key2", RESOURCE_NOTE_LID);
-        query.bindValue(":noteLid", noteLid);
+        query.prepare("Select " + resourceColumns + ", r.noteLid from Resources r left join Notes n on n.lid=r.noteLid where r.noteLid in (" +
+                      NSqlQuery::lidList(noteLids.size()) + ") order by r.lid");
     } else {
-        query.prepare(
-                "Select key, data, lid from datastore where key=:key and lid in (select lid from datastore where key=:key2 and data=:noteLid) order by lid");
-        query.bindValue(":key", RESOURCE_GUID);
-        query.bindValue(":key2", RESOURCE_NOTE_LID);
-        query.bindValue(":noteLid", noteLid);
+        query.prepare("Select lid, guid, noteLid from Resources where noteLid in (" +
+                      NSqlQuery::lidList(noteLids.size()) + ") order by lid");
     }
-    Resource *r = nullptr;
+    query.bindLids(noteLids);
     query.exec();
+    qint32 noteLidColumn = query.record().count()-1;
+    QList<qint32> lids, owners;
+    QList<Resource> resources;
     while (query.next()) {
-        qint32 lid = query.value(2).toInt();
-        if (!lidMap.contains(lid)) {
-            r = new Resource();
-            lidMap.insert(lid, r);
-        } else {
-            r = lidMap[lid];
-        }
-        mapResource(query, *r);
+        Resource r;
+        if (fullLoad)
+            mapResource(query, r);
+        else if (!query.value(1).isNull())
+            r.guid = query.value(1).toString();
+        lids.append(query.value(0).toInt());
+        owners.append(query.value(noteLidColumn).toInt());
+        resources.append(r);
     }
     query.finish();
     db->unlock();
 
-    // if we need binary data, read it in.  Then add to the list
-    QHash<qint32, Resource *>::iterator i;
-    list.clear();
-    for (i = lidMap.begin(); i != lidMap.end(); ++i) {
-        if (withBinary && fullLoad) {
-            Resource *r = i.value();
-            qint32 lid = i.key();
-            QString mimetype = r->mime;
-            MimeReference ref;
-            QString filename;
-            ResourceAttributes attributes;
-            if (r->attributes.isSet())
-                attributes = r->attributes;
-            if (attributes.fileName.isSet())
-                filename = attributes.fileName;
-            QString fileExt = ref.getExtensionFromMime(mimetype, filename);
+    // if we need binary data, read it in.  Then add to the map
+    for (qint32 i=0; i<resources.size(); i++) {
+        if (withBinary && fullLoad)
+            readBody(resources[i], lids[i]);
+        map[owners[i]].append(resources[i]);
+    }
+}
+
 
-            QString tfileName(global.fileManager.getDbaDirPath() + QString::number(lid) + fileExt);
-            QFile tfile(tfileName);
-            QLOG_DEBUG() << "getAllResources lid=" << lid << ", fileExt=" << fileExt << ", tfileName=" << tfileName;
-
-            if (!tfile.open(QIODevice::ReadOnly)) {
-                QDir dir(global.fileManager.getDbaDirPath());
-                QStringList filterList;
-                filterList.append(QString::number(lid) + ".*");
-                QStringList list = dir.entryList(filterList, QDir::Files);
-                if (list.size() > 0) {
-                    QString fileName(global.fileManager.getDbaDirPath() + list[0]);
-                    tfile.setFileName(fileName);
-                    QLOG_DEBUG() << "getAllResources fileName=" << fileName;
-                    tfile.open(QIODevice::ReadOnly);
-                }
-            }
-            QByteArray b = tfile.readAll();
-            Data d;
-            if (r->data.isSet())
-                d = r->data;
-            d.body = b;
-            r->data = d;
+// Read a resource's body from disk
+void ResourceTable::readBody(Resource &r, qint32 lid) {
+    QString mimetype = r.mime;
+    MimeReference ref;
+    QString filename;
+    ResourceAttributes attributes;
+    if (r.attributes.isSet())
+        attributes = r.attributes;
+    if (attributes.fileName.isSet())
+        filename = attributes.fileName;
+    QString fileExt = ref.getExtensionFromMime(mimetype, filename);
+
+    QByteArray hash;
+    Data d;
+    if (r.data.isSet())
+        d = r.data;
+    if (d.bodyHash.isSet())
+        hash = d.bodyHash;
+    BlobStore blobs(db);
+    QLOG_DEBUG() << "readBody lid=" << lid << ", fileExt=" << fileExt;
+    QByteArray b = blobs.getResourceBody(lid, fileExt, hash);
+
+    if (b.isNull()) {
+        QDir dir(global.fileManager.getDbaDirPath());
+        QStringList filterList;
+        filterList.append(QString::number(lid) + ".*");
+        QStringList list = dir.entryList(filterList, QDir::Files);
+        if (list.size() > 0) {
+            QString fileName(global.fileManager.getDbaDirPath() + list[0]);
+            QFile tfile(fileName);
+            QLOG_DEBUG() << "readBody fileName=" << fileName;
+            tfile.open(QIODevice::ReadOnly);
+            b = tfile.readAll();
             tfile.close();
         }
-        list.append(*i.value());
     }
-    QLOG_DEBUG() << "getAllResources: done";
+    d.body = b;
+    r.data = d;
 }
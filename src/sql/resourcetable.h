@@ -71,6 +71,7 @@ class ResourceTable
 
 private:
     DatabaseConnection *db;
+    void readBody(Resource &resource, qint32 lid);               // Read a resource body from disk
 public:
     ResourceTable(DatabaseConnection *db);                             // Constructor
 
@@ -102,6 +103,7 @@ public:
     void getResourceMap(QHash<QString, qint32> &map, QHash<qint32, Resource> &resourceMap, string guid);     // Get a resource's MAP data
     void getResourceMap(QHash<QString, qint32> &map, QHash<qint32, Resource> &resourceMap, QString guid);    // Get a resource's MAP data
     void getAllResources(QList<Resource> &list, qint32 noteLid, bool fullLoad, bool withBinary);  // Get all resources for a note
+    void getAllResources(QHash<qint32, QList<Resource> > &map, const QList<qint32> &noteLids, bool fullLoad, bool withBinary);  // Get all resources for a set of notes
 
     // DB Write Functions
     void updateGuid(qint32 lid, Guid &guid);                     // Update a resource's guid
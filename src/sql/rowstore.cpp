@@ -0,0 +1,405 @@
+/*********************************************************************************
+NixNote - An open-source client for the Evernote service.
+Copyright (C) 2013 Randy Baumgarte
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+***********************************************************************************/
+
+#include "rowstore.h"
+#include "src/sql/nsqlquery.h"
+#include "src/sql/notetable.h"
+#include "src/sql/resourcetable.h"
+#include "src/sql/tagtable.h"
+#include "src/sql/notebooktable.h"
+#include "src/global.h"
+
+#include <QElapsedTimer>
+
+extern Global global;
+
+QAtomicInt RowStore::locationIndex(0);
+
+// Bounds stored for a coordinate a note doesn't have
+#define LOCATION_UNSET "1e30"
+
+
+// Columns of the Notes table.  The content & the tags are not copied,
+// they are only kept in the DataStore.
+static const QString noteTableColumns = QString("lid integer primary key, guid text, title text, contentHash blob, ") +
+        QString("contentLength integer, updateSequenceNumber integer, created integer, updated integer, ") +
+        QString("deleted integer, active integer, notebookLid integer, subjectDate integer, ") +
+        QString("latitude real, longitude real, altitude real, author text, source text, sourceUrl text, ") +
+        QString("sourceApplication text, shareDate integer, placeName text, contentClass text, ") +
+        QString("reminderOrder integer, reminderTime integer, reminderDoneTime integer");
+
+// Columns of the Resources table.  The recognition & alternate data
+// bodies are not copied, they are only kept in the DataStore.
+static const QString resourceTableColumns = QString("lid integer primary key, guid text, noteLid integer, ") +
+        QString("dataHash blob, dataSize integer, mime text, active integer, height integer, width integer, ") +
+        QString("duration integer, recognitionSize integer, recognitionHash blob, updateSequenceNumber integer, ") +
+        QString("alternateSize integer, alternateHash blob, sourceUrl text, cameraMake text, cameraModel text, ") +
+        QString("altitude real, longitude real, latitude real, recoType text, attachment integer, ") +
+        QString("fileName text, clientWillIndex integer, timestamp integer");
+
+// Time spent refreshing typed rows, in nanoseconds
+QAtomicInteger<qint64> RowStore::refreshTime(0);
+
+// Pick the value of a single key out of a group of DataStore rows
+static QString pick(int key) {
+    return QString("max(case when key=%1 then data end)").arg(key);
+}
+
+
+// Constructor
+RowStore::RowStore(DatabaseConnection *db)
+{
+    this->db = db;
+}
+
+
+
+// Create the typed tables.  This is safe to call every time
+// the database is opened.
+void RowStore::createTables() {
+    QLOG_TRACE_IN();
+    NSqlQuery sql(db);
+    db->lockForWrite();
+
+    if (!sql.exec("Create table if not exists Notes (" + noteTableColumns + ")")) {
+        QLOG_ERROR() << "Creation of Notes table failed: " << sql.lastError();
+    }
+    sql.exec("CREATE INDEX if not exists Notes_Guid on Notes (guid)");
+    sql.exec("CREATE INDEX if not exists Notes_Notebook_Lid on Notes (notebookLid)");
+
+    if (!sql.exec(QString("Create table if not exists NoteTags (") +
+                  QString("noteLid integer not null, tagLid integer not null, ") +
+                  QString("primary key (noteLid, tagLid)) without rowid"))) {
+        QLOG_ERROR() << "Creation of NoteTags table failed: " << sql.lastError();
+    }
+    sql.exec("CREATE INDEX if not exists NoteTags_Tag_Lid on NoteTags (tagLid, noteLid)");
+
+    if (sql.exec(QString("Create virtual table if not exists NoteLocations using rtree (") +
+                 QString("lid, minLatitude, maxLatitude, minLongitude, maxLongitude, minAltitude, maxAltitude)"))) {
+        locationIndex = 1;
+    } else {
+        QLOG_INFO() << "Location index not available: " << sql.lastError();
+        locationIndex = 0;
+    }
+
+    if (!sql.exec("Create table if not exists Resources (" + resourceTableColumns + ")")) {
+        QLOG_ERROR() << "Creation of Resources table failed: " << sql.lastError();
+    }
+    sql.exec("CREATE INDEX if not exists Resources_Guid on Resources (guid)");
+    sql.exec("CREATE INDEX if not exists Resources_Note_Lid on Resources (noteLid)");
+
+    if (!sql.exec(QString("Create table if not exists Tags (") +
+                  QString("lid integer primary key, guid text, name text, parentLid integer, ") +
+                  QString("updateSequenceNumber integer, account integer)"))) {
+        QLOG_ERROR() << "Creation of Tags table failed: " << sql.lastError();
+    }
+    sql.exec("CREATE INDEX if not exists Tags_Guid on Tags (guid)");
+
+    if (!sql.exec(QString("Create table if not exists Notebooks (") +
+                  QString("lid integer primary key, guid text, name text, stack text, updateSequenceNumber integer, ") +
+                  QString("isDefault integer, serviceCreated integer, serviceUpdated integer, published integer, ") +
+                  QString("publishingUri text, publishingOrder integer, publishingAscending integer, ") +
+                  QString("publishingDescription text)"))) {
+        QLOG_ERROR() << "Creation of Notebooks table failed: " << sql.lastError();
+    }
+    sql.exec("CREATE INDEX if not exists Notebooks_Guid on Notebooks (guid)");
+
+    sql.finish();
+    db->unlock();
+    QLOG_TRACE_OUT();
+}
+
+
+
+// Return the highest lid with any DataStore record.
+qint32 RowStore::getHighestLid() {
+    qint32 retval = 0;
+    NSqlQuery sql(db);
+    db->lockForRead();
+    sql.exec("Select max(lid) from DataStore");
+    if (sql.next())
+        retval = sql.value(0).toInt();
+    sql.finish();
+    db->unlock();
+    return retval;
+}
+
+
+
+// Rebuild the rows of a typed table for a range of lids.  The old rows are
+// removed and any lid which still has a GUID record in the DataStore is
+// re-inserted from a single grouped read of its DataStore records.
+void RowStore::refresh(QString table, QString select, qint32 fromLid, qint32 toLid) {
+    QElapsedTimer timer;
+    timer.start();
+    NSqlQuery sql(db);
+    db->lockForWrite();
+    sql.prepare("Delete from " + table + " where lid>=:fromLid and lid<=:toLid");
+    sql.bindValue(":fromLid", fromLid);
+    sql.bindValue(":toLid", toLid);
+    sql.exec();
+
+    sql.prepare(select);
+    sql.bindValue(":fromLid", fromLid);
+    sql.bindValue(":toLid", toLid);
+    if (!sql.exec()) {
+        QLOG_ERROR() << "Refresh of " << table << " failed: " << sql.lastError();
+    }
+    sql.finish();
+    db->unlock();
+    refreshTime.fetchAndAddRelaxed(timer.nsecsElapsed());
+}
+
+
+
+// Return the time spent refreshing typed rows since the last call, in
+// milliseconds.  Sync logs it to show what keeping the cache costs.
+qint64 RowStore::takeRefreshTime() {
+    return refreshTime.fetchAndStoreRelaxed(0) / 1000000;
+}
+
+
+
+// Older databases kept a copy of the note content & tags in Notes and of
+// the resource recognition & alternate data in Resources.  Copy the other
+// columns to new tables & drop the old ones, their pages are reused by
+// later writes.
+void RowStore::dropCopiedData() {
+    dropColumns("Notes", noteTableColumns);
+    dropColumns("Resources", resourceTableColumns);
+    createTables();
+}
+
+
+
+// Rebuild a typed table with only the columns in its definition, if it
+// has any others.
+void RowStore::dropColumns(QString table, QString definition) {
+    QStringList columns;
+    QStringList definitions = definition.split(",");
+    for (int i=0; i<definitions.size(); i++)
+        columns.append(definitions[i].trimmed().section(' ', 0, 0));
+
+    NSqlQuery sql(db);
+    db->lockForWrite();
+    bool extra = false;
+    sql.exec("pragma table_info(" + table + ")");
+    while (sql.next()) {
+        if (!columns.contains(sql.value(1).toString()))
+            extra = true;
+    }
+    if (!extra) {
+        sql.finish();
+        db->unlock();
+        return;
+    }
+
+    sql.exec("Drop table if exists " + table + "Copy");
+    bool ok = sql.exec("Create table " + table + "Copy (" + definition + ")") &&
+            sql.exec("Insert into " + table + "Copy (" + columns.join(", ") + ") select " + columns.join(", ") + " from " + table) &&
+            sql.exec("Drop table " + table) &&
+            sql.exec("Alter table " + table + "Copy rename to " + table);
+    if (!ok) {
+        QLOG_ERROR() << "Removing copied data from the " << table << " table failed: " << sql.lastError();
+    }
+    sql.finish();
+    db->unlock();
+}
+
+
+
+void RowStore::refreshNote(qint32 lid) {
+    if (lid <= 0)
+        return;
+    refreshNotes(lid, lid);
+}
+
+
+void RowStore::refreshNotes(qint32 fromLid, qint32 toLid) {
+    QString select = QString("Insert into Notes (lid, guid, title, contentHash, contentLength, ") +
+            QString("updateSequenceNumber, created, updated, deleted, active, notebookLid, subjectDate, ") +
+            QString("latitude, longitude, altitude, author, source, sourceUrl, sourceApplication, shareDate, ") +
+            QString("placeName, contentClass, reminderOrder, reminderTime, reminderDoneTime) ") +
+            QString("select d.lid, ") +
+            pick(NOTE_GUID) + ", " + pick(NOTE_TITLE) + ", " +
+            pick(NOTE_CONTENT_HASH) + ", " + pick(NOTE_CONTENT_LENGTH) + ", " +
+            pick(NOTE_UPDATE_SEQUENCE_NUMBER) + ", " + pick(NOTE_CREATED_DATE) + ", " +
+            pick(NOTE_UPDATED_DATE) + ", " + pick(NOTE_DELETED_DATE) + ", " + pick(NOTE_ACTIVE) + ", " +
+            pick(NOTE_NOTEBOOK_LID) + ", " +
+            pick(NOTE_ATTRIBUTE_SUBJECT_DATE) + ", " + pick(NOTE_ATTRIBUTE_LATITUDE) + ", " +
+            pick(NOTE_ATTRIBUTE_LONGITUDE) + ", " + pick(NOTE_ATTRIBUTE_ALTITUDE) + ", " +
+            pick(NOTE_ATTRIBUTE_AUTHOR) + ", " + pick(NOTE_ATTRIBUTE_SOURCE) + ", " +
+            pick(NOTE_ATTRIBUTE_SOURCE_URL) + ", " + pick(NOTE_ATTRIBUTE_SOURCE_APPLICATION) + ", " +
+            pick(NOTE_ATTRIBUTE_SHARE_DATE) + ", " + pick(NOTE_ATTRIBUTE_PLACE_NAME) + ", " +
+            pick(NOTE_ATTRIBUTE_CONTENT_CLASS) + ", " + pick(NOTE_ATTRIBUTE_REMINDER_ORDER) + ", " +
+            pick(NOTE_ATTRIBUTE_REMINDER_TIME) + ", " + pick(NOTE_ATTRIBUTE_REMINDER_DONE_TIME) + " " +
+            QString("from DataStore d where d.lid>=:fromLid and d.lid<=:toLid and d.key>=5000 and d.key<6000 ") +
+            QString("group by d.lid having sum(d.key=%1)>0").arg(NOTE_GUID);
+    refresh("Notes", select, fromLid, toLid);
+    refreshNoteTags(fromLid, toLid);
+    refreshNoteLocations(fromLid, toLid);
+}
+
+
+// Rebuild the note <-> tag rows for a range of notes from their
+// NOTE_TAG_LID records.
+void RowStore::refreshNoteTags(qint32 fromLid, qint32 toLid) {
+    NSqlQuery sql(db);
+    db->lockForWrite();
+    sql.prepare("Delete from NoteTags where noteLid>=:fromLid and noteLid<=:toLid");
+    sql.bindValue(":fromLid", fromLid);
+    sql.bindValue(":toLid", toLid);
+    sql.exec();
+
+    sql.prepare(QString("Insert or ignore into NoteTags (noteLid, tagLid) select lid, data from DataStore ") +
+                QString("where key=:key and lid>=:fromLid and lid<=:toLid"));
+    sql.bindValue(":key", NOTE_TAG_LID);
+    sql.bindValue(":fromLid", fromLid);
+    sql.bindValue(":toLid", toLid);
+    if (!sql.exec()) {
+        QLOG_ERROR() << "Refresh of NoteTags failed: " << sql.lastError();
+    }
+    sql.finish();
+    db->unlock();
+}
+
+
+
+// Rebuild the NoteLocations rows for a range of notes from their Notes
+// rows.  A single note is deleted by lid, as the R*Tree would scan every
+// row for a range.
+void RowStore::refreshNoteLocations(qint32 fromLid, qint32 toLid) {
+    if (!hasLocationIndex())
+        return;
+    NSqlQuery sql(db);
+    db->lockForWrite();
+    if (fromLid == toLid) {
+        sql.prepare("Delete from NoteLocations where lid=:lid");
+        sql.bindValue(":lid", fromLid);
+    } else {
+        sql.prepare("Delete from NoteLocations where lid>=:fromLid and lid<=:toLid");
+        sql.bindValue(":fromLid", fromLid);
+        sql.bindValue(":toLid", toLid);
+    }
+    sql.exec();
+
+    sql.prepare(QString("Insert into NoteLocations (lid, minLatitude, maxLatitude, minLongitude, maxLongitude, ") +
+                QString("minAltitude, maxAltitude) select lid, ") +
+                QString("coalesce(latitude, -" LOCATION_UNSET "), coalesce(latitude, " LOCATION_UNSET "), ") +
+                QString("coalesce(longitude, -" LOCATION_UNSET "), coalesce(longitude, " LOCATION_UNSET "), ") +
+                QString("coalesce(altitude, -" LOCATION_UNSET "), coalesce(altitude, " LOCATION_UNSET ") ") +
+                QString("from Notes where lid>=:fromLid and lid<=:toLid ") +
+                QString("and (latitude is not null or longitude is not null or altitude is not null)"));
+    sql.bindValue(":fromLid", fromLid);
+    sql.bindValue(":toLid", toLid);
+    if (!sql.exec()) {
+        QLOG_ERROR() << "Refresh of NoteLocations failed: " << sql.lastError();
+    }
+    sql.finish();
+    db->unlock();
+}
+
+
+bool RowStore::hasLocationIndex() {
+    return locationIndex.load() != 0;
+}
+
+
+void RowStore::refreshResource(qint32 lid) {
+    if (lid <= 0)
+        return;
+    refreshResources(lid, lid);
+}
+
+
+void RowStore::refreshResources(qint32 fromLid, qint32 toLid) {
+    QString select = QString("Insert into Resources (lid, guid, noteLid, dataHash, dataSize, mime, active, height, ") +
+            QString("width, duration, recognitionSize, recognitionHash, updateSequenceNumber, ") +
+            QString("alternateSize, alternateHash, sourceUrl, cameraMake, cameraModel, altitude, ") +
+            QString("longitude, latitude, recoType, attachment, fileName, clientWillIndex, timestamp) ") +
+            QString("select lid, ") +
+            pick(RESOURCE_GUID) + ", " + pick(RESOURCE_NOTE_LID) + ", " + pick(RESOURCE_DATA_HASH) + ", " +
+            pick(RESOURCE_DATA_SIZE) + ", " + pick(RESOURCE_MIME) + ", " + pick(RESOURCE_ACTIVE) + ", " +
+            pick(RESOURCE_HEIGHT) + ", " + pick(RESOURCE_WIDTH) + ", " + pick(RESOURCE_DURATION) + ", " +
+            pick(RESOURCE_RECOGNITION_SIZE) + ", " +
+            pick(RESOURCE_RECOGNITION_HASH) + ", " + pick(RESOURCE_UPDATE_SEQUENCE_NUMBER) + ", " +
+            pick(RESOURCE_ALTERNATE_SIZE) + ", " +
+            pick(RESOURCE_ALTERNATE_HASH) + ", " + pick(RESOURCE_SOURCE_URL) + ", " +
+            pick(RESOURCE_CAMERA_MAKE) + ", " + pick(RESOURCE_CAMERA_MODEL) + ", " +
+            pick(RESOURCE_ALTITUDE) + ", " + pick(RESOURCE_LONGITUDE) + ", " + pick(RESOURCE_LATITUDE) + ", " +
+            pick(RESOURCE_RECO_TYPE) + ", " + pick(RESOURCE_ATTACHMENT) + ", " + pick(RESOURCE_FILENAME) + ", " +
+            pick(RESOURCE_CLIENT_WILL_INDEX) + ", " + pick(RESOURCE_TIMESTAMP) + " " +
+            QString("from DataStore where lid>=:fromLid and lid<=:toLid and key>=6000 and key<7000 ") +
+            QString("group by lid having sum(key=%1)>0").arg(RESOURCE_GUID);
+    refresh("Resources", select, fromLid, toLid);
+}
+
+
+
+void RowStore::refreshTag(qint32 lid) {
+    if (lid <= 0)
+        return;
+    refreshTags(lid, lid);
+}
+
+
+void RowStore::refreshTags(qint32 fromLid, qint32 toLid) {
+    QString select = QString("Insert into Tags (lid, guid, name, parentLid, updateSequenceNumber, account) ") +
+            QString("select lid, ") +
+            pick(TAG_GUID) + ", " + pick(TAG_NAME) + ", " + pick(TAG_PARENT_LID) + ", " +
+            pick(TAG_UPDATE_SEQUENCE_NUMBER) + ", " + pick(TAG_OWNING_ACCOUNT) + " " +
+            QString("from DataStore where lid>=:fromLid and lid<=:toLid and key>=1000 and key<1100 ") +
+            QString("group by lid having sum(key=%1)>0").arg(TAG_GUID);
+    refresh("Tags", select, fromLid, toLid);
+}
+
+
+
+void RowStore::refreshNotebook(qint32 lid) {
+    if (lid <= 0)
+        return;
+    refreshNotebooks(lid, lid);
+}
+
+
+void RowStore::refreshNotebooks(qint32 fromLid, qint32 toLid) {
+    QString select = QString("Insert into Notebooks (lid, guid, name, stack, updateSequenceNumber, isDefault, ") +
+            QString("serviceCreated, serviceUpdated, published, publishingUri, publishingOrder, ") +
+            QString("publishingAscending, publishingDescription) ") +
+            QString("select lid, ") +
+            pick(NOTEBOOK_GUID) + ", " + pick(NOTEBOOK_NAME) + ", " + pick(NOTEBOOK_STACK) + ", " +
+            pick(NOTEBOOK_UPDATE_SEQUENCE_NUMBER) + ", " + pick(NOTEBOOK_IS_DEFAULT) + ", " +
+            pick(NOTEBOOK_SERVICE_CREATED) + ", " + pick(NOTEBOOK_SERVICE_UPDATED) + ", " +
+            pick(NOTEBOOK_PUBLISHED) + ", " + pick(NOTEBOOK_PUBLISHING_URI) + ", " +
+            pick(NOTEBOOK_PUBLISHING_ORDER) + ", " + pick(NOTEBOOK_PUBLISHING_ASCENDING) + ", " +
+            pick(NOTEBOOK_PUBLISHING_DESCRIPTION) + " " +
+            QString("from DataStore where lid>=:fromLid and lid<=:toLid and key>=3000 and key<3200 ") +
+            QString("group by lid having sum(key=%1)>0").arg(NOTEBOOK_GUID);
+    refresh("Notebooks", select, fromLid, toLid);
+}
+
+
+
+// Rebuild all typed rows for a range of lids.  Used by the database upgrade.
+void RowStore::refreshAll(qint32 fromLid, qint32 toLid) {
+    refreshNotebooks(fromLid, toLid);
+    refreshTags(fromLid, toLid);
+    refreshNotes(fromLid, toLid);
+    refreshResources(fromLid, toLid);
+}
@@ -0,0 +1,85 @@
+/*********************************************************************************
+NixNote - An open-source client for the Evernote service.
+Copyright (C) 2013 Randy Baumgarte
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+***********************************************************************************/
+
+#ifndef ROWSTORE_H
+#define ROWSTORE_H
+
+#include <QString>
+#include <QAtomicInt>
+#include <QAtomicInteger>
+#include "src/sql/databaseconnection.h"
+
+//***********************************************************
+// The row store is a read-side cache of the DataStore.  It
+// keeps one typed row per note, resource, tag & notebook
+// (tables Notes, Resources, Tags and Notebooks), so loading
+// an entity is a single indexed read instead of decoding
+// every DataStore row.  Anything large is left out: the
+// note content, the tags on a note & the recognition and
+// alternate data of a resource are read from the DataStore.
+//
+// NoteTags holds one (noteLid, tagLid) row per tag on a
+// note, indexed both ways, so "notes with this tag" and
+// "has this note a tag" are index lookups.  The order of
+// a note's tags is the DataStore's.
+//
+// NoteLocations is an R*Tree over the latitude, longitude
+// & altitude of every note with a location, so area &
+// distance searches only read the notes inside a box.
+// Missing coordinates span the whole axis.
+//
+// The DataStore stays the record; the typed rows are only
+// derived from it.  Every table class which changes a
+// DataStore record calls refresh*() afterwards, which
+// rebuilds the entity's cached rows from it.
+//***********************************************************
+
+class DatabaseConnection;
+
+class RowStore
+{
+private:
+    DatabaseConnection *db;
+    static QAtomicInt locationIndex;               // Could the R*Tree be created?
+    static QAtomicInteger<qint64> refreshTime;     // Time spent in refresh(), in nanoseconds
+    void refresh(QString table, QString select, qint32 fromLid, qint32 toLid);
+    void dropColumns(QString table, QString definition);  // Rebuild a table with only the defined columns
+
+public:
+    RowStore(DatabaseConnection *db);              // Constructor
+    void createTables();                           // Create the typed tables & their indexes
+    qint32 getHighestLid();                        // Highest lid currently in the DataStore
+
+    void refreshNote(qint32 lid);                  // Rebuild a note row from the DataStore
+    void refreshNotes(qint32 fromLid, qint32 toLid);
+    void refreshNoteTags(qint32 fromLid, qint32 toLid);  // Rebuild the NoteTags rows of a range of notes
+    void refreshNoteLocations(qint32 fromLid, qint32 toLid);  // Rebuild the NoteLocations rows of a range of notes
+    static bool hasLocationIndex();                // Is there a NoteLocations R*Tree?
+    void refreshResource(qint32 lid);              // Rebuild a resource row from the DataStore
+    void refreshResources(qint32 fromLid, qint32 toLid);
+    void refreshTag(qint32 lid);                   // Rebuild a tag row from the DataStore
+    void refreshTags(qint32 fromLid, qint32 toLid);
+    void refreshNotebook(qint32 lid);              // Rebuild a notebook row from the DataStore
+    void refreshNotebooks(qint32 fromLid, qint32 toLid);
+    void refreshAll(qint32 fromLid, qint32 toLid); // Rebuild every typed row in a lid range
+    void dropCopiedData();                         // Remove the columns older databases copied from the DataStore
+    static qint64 takeRefreshTime();               // Time spent refreshing since the last call, in ms
+};
+
+#endif // ROWSTORE_H
@@ -118,6 +118,8 @@ void SearchTable::sync(qint32 lid, SavedSearch &search) {
     } else {
         ConfigStore cs(db);
         lid = cs.incrementLidCounter();
+        if (lid < 0)
+            return;
     }
 
     add(lid, search, false);
@@ -157,6 +159,8 @@ void SearchTable::add(qint32 l, SavedSearch &t, bool isDirty) {
     qint32 lid = l;
     if (lid == 0)
         lid = cs.incrementLidCounter();
+    if (lid < 0)
+        return;
 
     NSqlQuery query(db);
     db->lockForWrite();
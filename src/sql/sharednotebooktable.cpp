@@ -75,6 +75,8 @@ qint32 SharedNotebookTable::sync(qint32 l, SharedNotebook sharedNotebook){
     } else {
        ConfigStore cs(db);
        lid = cs.incrementLidCounter();
+       if (lid < 0)
+           return -1;
     }
 
     return add(lid, sharedNotebook, false);
@@ -90,6 +92,8 @@ qint32 SharedNotebookTable::add(qint32 l, const SharedNotebook &t, bool isDirty)
     qint32 lid = l;
     if (lid == 0)
         lid = cs.incrementLidCounter();
+    if (lid < 0)
+        return -1;
 
     NSqlQuery query(db);
     db->lockForWrite();
@@ -0,0 +1,124 @@
+/*********************************************************************************
+NixNote - An open-source client for the Evernote service.
+Copyright (C) 2013 Randy Baumgarte
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+***********************************************************************************/
+
+#include "statementcache.h"
+
+
+// Constructor
+StatementCache::StatementCache(qint32 maxSize)
+{
+    this->maxSize = maxSize;
+    tick = 0;
+    hitCount = 0;
+    missCount = 0;
+    owner = QThread::currentThread();
+}
+
+
+// Is the cache being used by the thread which owns it?
+bool StatementCache::onOwnerThread() {
+    bool owned = (QThread::currentThread() == owner);
+    Q_ASSERT_X(owned, "StatementCache", "statement cache used outside the thread of its connection");
+    return owned;
+}
+
+
+// Look for an idle statement with this SQL.  If one is found it is
+// reset, marked as in use and copied into the caller's query.
+bool StatementCache::acquire(const QString &sql, QSqlQuery &query) {
+    if (maxSize <= 0 || !onOwnerThread())
+        return false;
+    QHash<QString, Entry>::iterator it = entries.find(sql);
+    if (it == entries.end() || it.value().inUse) {
+        missCount++;
+        return false;
+    }
+    hitCount++;
+    it.value().inUse = true;
+    it.value().lastUsed = ++tick;
+    it.value().query.finish();
+    query = it.value().query;
+    return true;
+}
+
+
+// Remember a statement the caller just prepared.  The caller is still
+// using it, so it stays in use until it is released.  Returns false if
+// the statement wasn't cached because another copy is already lent out.
+bool StatementCache::insert(const QString &sql, const QSqlQuery &query) {
+    if (maxSize <= 0 || !onOwnerThread() || entries.contains(sql))
+        return false;
+    Entry entry;
+    entry.query = query;
+    entry.inUse = true;
+    entry.lastUsed = ++tick;
+    entries.insert(sql, entry);
+    if (entries.size() > maxSize)
+        evict();
+    return true;
+}
+
+
+// The borrower is finished with a statement.  Reset it so it doesn't
+// hold a read lock while it sits in the cache.
+void StatementCache::release(const QString &sql) {
+    if (!onOwnerThread())
+        return;
+    QHash<QString, Entry>::iterator it = entries.find(sql);
+    if (it == entries.end())
+        return;
+    it.value().query.finish();
+    it.value().inUse = false;
+}
+
+
+// Drop the least recently used statement which isn't in use.  If every
+// statement is in use the cache is allowed to grow until one is released.
+void StatementCache::evict() {
+    QHash<QString, Entry>::iterator oldest = entries.end();
+    for (QHash<QString, Entry>::iterator it = entries.begin(); it != entries.end(); ++it) {
+        if (it.value().inUse)
+            continue;
+        if (oldest == entries.end() || it.value().lastUsed < oldest.value().lastUsed)
+            oldest = it;
+    }
+    if (oldest != entries.end())
+        entries.erase(oldest);
+}
+
+
+// Drop everything.  Needed before the connection is closed.
+void StatementCache::clear() {
+    entries.clear();
+}
+
+
+quint64 StatementCache::hits() {
+    return hitCount;
+}
+
+
+quint64 StatementCache::misses() {
+    return missCount;
+}
+
+
+qint32 StatementCache::size() {
+    return entries.size();
+}
@@ -0,0 +1,74 @@
+/*********************************************************************************
+NixNote - An open-source client for the Evernote service.
+Copyright (C) 2013 Randy Baumgarte
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+***********************************************************************************/
+
+#ifndef STATEMENTCACHE_H
+#define STATEMENTCACHE_H
+
+#include <QHash>
+#include <QString>
+#include <QtSql>
+#include <QThread>
+
+//***********************************************************
+// Per-connection cache of prepared statements keyed by
+// their SQL text.  NSqlQuery::prepare() asks the cache for
+// a statement first and only has SQLite parse the SQL when
+// it isn't there.  A cached statement is lent to one query
+// at a time; a second query preparing the same SQL while it
+// is in use gets a private, uncached statement.
+//
+// Statements are reset when they are handed out and when
+// they are returned.  Once the cache holds more than its
+// limit the least recently used idle statement is dropped.
+//
+// The cache isn't locked.  Like the connection it belongs
+// to, it may only be used by the thread which created it.
+// Debug builds assert this; release builds don't cache for
+// any other thread.
+//***********************************************************
+
+class StatementCache
+{
+private:
+    struct Entry {
+        QSqlQuery query;            // Shares the prepared statement with the borrower
+        bool inUse;
+        quint64 lastUsed;
+    };
+    QHash<QString, Entry> entries;
+    qint32 maxSize;
+    quint64 tick;
+    quint64 hitCount;
+    quint64 missCount;
+    QThread *owner;                 // Thread which created the cache
+    void evict();
+    bool onOwnerThread();
+
+public:
+    StatementCache(qint32 maxSize);
+    bool acquire(const QString &sql, QSqlQuery &query);   // Copy a cached statement into query
+    bool insert(const QString &sql, const QSqlQuery &query);  // Cache a newly prepared, in use statement
+    void release(const QString &sql);                     // A borrower is done with a statement
+    void clear();                                         // Drop every statement
+    quint64 hits();                                       // Number of prepares served from the cache
+    quint64 misses();                                     // Number of prepares SQLite had to parse
+    qint32 size();                                        // Number of cached statements
+};
+
+#endif // STATEMENTCACHE_H
@@ -20,6 +20,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include "tagtable.h"
 #include "configstore.h"
 #include "notetable.h"
+#include "rowstore.h"
 #include "src/sql/nsqlquery.h"
 
 #include <QSqlTableModel>
@@ -174,6 +175,7 @@ void TagTable::updateGuid(qint32 lid, Guid &guid) {
     QLOG_TRACE_IN();
     QString oldGuid;
     getGuid(oldGuid, lid);
+    global.lidMap.remove(lid);
 
     NSqlQuery query(db);
     db->lockForWrite();
@@ -184,6 +186,9 @@ void TagTable::updateGuid(qint32 lid, Guid &guid) {
     query.exec();
     query.finish();
     db->unlock();
+
+    RowStore rowStore(db);
+    rowStore.refreshTag(lid);
     QLOG_TRACE_OUT();
 }
 
@@ -204,6 +209,7 @@ qint32 TagTable::sync(Tag &tag, qint32 account) {
 void TagTable::update(Tag &tag, bool dirty=true) {
     qint32 lid = getLid(tag.guid);
     if (lid > 0) {
+        global.lidMap.remove(lid);
         NSqlQuery query(db);
         // Delete the old record
         db->lockForWrite();
@@ -234,6 +240,7 @@ qint32 TagTable::sync(qint32 l, Tag &tag, qint32 account) {
         lid= getLid(tag.name);
 
     if (lid > 0) {
+        global.lidMap.remove(lid);
         NSqlQuery query(db);
         // Delete the old record
         db->lockForWrite();
@@ -245,6 +252,8 @@ qint32 TagTable::sync(qint32 l, Tag &tag, qint32 account) {
     } else {
         ConfigStore cs(db);
         lid = cs.incrementLidCounter();
+        if (lid < 0)
+            return -1;
     }
 
     add(lid, tag, false, account);
@@ -257,15 +266,21 @@ qint32 TagTable::sync(qint32 l, Tag &tag, qint32 account) {
 // Given a tag's GUID, we return the LID
 qint32 TagTable::getLid(QString guid) {
     QLOG_TRACE_IN();
-    qint32 retval = 0;
+    qint32 retval = global.lidMap.getLid(TAG_GUID, guid);
+    if (retval > 0) {
+        QLOG_TRACE_OUT();
+        return retval;
+    }
     NSqlQuery query(db);
     db->lockForRead();
     query.prepare("Select lid from DataStore where key=:key and data=:data");
     query.bindValue(":data", guid);
     query.bindValue(":key", TAG_GUID);
     query.exec();
-    if (query.next())
+    if (query.next()) {
         retval = query.value(0).toInt();
+        global.lidMap.insert(TAG_GUID, guid, retval);
+    }
     query.finish();
     db->unlock();
     QLOG_TRACE_OUT();
@@ -289,6 +304,8 @@ qint32 TagTable::add(qint32 l, Tag &t, bool isDirty, qint32 account) {
     qint32 lid = l;
     if (lid == 0)
         lid = cs.incrementLidCounter();
+    if (lid < 0)
+        return -1;
 
     NSqlQuery query(db);
     db->lockForWrite();
@@ -329,13 +346,16 @@ qint32 TagTable::add(qint32 l, Tag &t, bool isDirty, qint32 account) {
                 tempTag.guid = t.parentGuid;
                 tempTag.name="<no name>";
                 tempTag.updateSequenceNum = 0;
-                add(parentLid, tempTag, false, account);
+                if (parentLid > 0)
+                    add(parentLid, tempTag, false, account);
             }
             db->lockForWrite();
-            query.bindValue(":lid", lid);
-            query.bindValue(":key", TAG_PARENT_LID);
-            query.bindValue(":data", parentLid);
-            query.exec();
+            if (parentLid > 0) {
+                query.bindValue(":lid", lid);
+                query.bindValue(":key", TAG_PARENT_LID);
+                query.bindValue(":data", parentLid);
+                query.exec();
+            }
         }
     }
 
@@ -352,6 +372,9 @@ qint32 TagTable::add(qint32 l, Tag &t, bool isDirty, qint32 account) {
     }
     query.finish();
     db->unlock();
+
+    RowStore rowStore(db);
+    rowStore.refreshTag(lid);
     return lid;
 }
 
@@ -362,7 +385,7 @@ bool TagTable::get(Tag &tag, qint32 lid) {
     QLOG_TRACE_IN();
     NSqlQuery query(db);
     db->lockForRead();
-    query.prepare("Select key, data from DataStore where lid=:lid");
+    query.prepare("Select t.guid, t.updateSequenceNumber, p.guid, t.name from Tags t left join Tags p on p.lid=t.parentLid where t.lid=:lid");
     query.bindValue(":lid", lid);
     query.exec();
     if (query.size() == 0) {
@@ -371,37 +394,15 @@ bool TagTable::get(Tag &tag, qint32 lid) {
         QLOG_TRACE_OUT();
         return false;
     }
-    while (query.next()) {
-        qint32 key = query.value(0).toInt();
-        switch (key) {
-            case TAG_GUID:
-                tag.guid = query.value(1).toString();
-                break;
-            case TAG_UPDATE_SEQUENCE_NUMBER:
-                tag.updateSequenceNum = query.value(1).toInt();
-                break;
-            case TAG_PARENT_LID: {
-                if (query.value(1).toInt() > 0) {
-                        QString parentGuid;
-                        if (getGuid(parentGuid, query.value(1).toInt()))
-                            tag.parentGuid = parentGuid;
-                        break;
-                    }
-                }
-                break;
-            case TAG_NAME:
-                tag.name = query.value(1).toString();
-                break;
-            case TAG_ISDIRTY:
-            case TAG_OWNING_ACCOUNT:
-                // currently just ignore the "dirty flag" and "owning account"
-                // fixes https://github.com/baumgarr/nixnote2/issues/363
-                break;
-
-            default: {
-                QLOG_ERROR() << "Unknown Tag record key: " << key << " lid: " << lid;
-            }
-        }
+    if (query.next()) {
+        if (!query.value(0).isNull())
+            tag.guid = query.value(0).toString();
+        if (!query.value(1).isNull())
+            tag.updateSequenceNum = query.value(1).toInt();
+        if (!query.value(2).isNull())
+            tag.parentGuid = query.value(2).toString();
+        if (!query.value(3).isNull())
+            tag.name = query.value(3).toString();
     }
     query.finish();
     db->unlock();
@@ -527,6 +528,10 @@ bool TagTable::exists(string guid) {
 // Return a tag guid given the LID
 bool TagTable::getGuid(QString &guid, qint32 lid) {
     QLOG_TRACE_IN();
+    if (global.lidMap.getGuid(TAG_GUID, lid, guid)) {
+        QLOG_TRACE_OUT();
+        return true;
+    }
 
     NSqlQuery query(db);
     db->lockForRead();
@@ -536,6 +541,7 @@ bool TagTable::getGuid(QString &guid, qint32 lid) {
     query.exec();
     while (query.next()) {
         guid = query.value(0).toString();
+        global.lidMap.insert(TAG_GUID, guid, lid);
         query.finish();
         db->unlock();
         QLOG_TRACE_OUT();
@@ -613,6 +619,7 @@ void TagTable::deleteTag(qint32 lid) {
 void TagTable::expunge(qint32 lid) {
     QString tagGuid;
     this->getGuid(tagGuid, lid);
+    global.lidMap.remove(lid);
     NSqlQuery query(db);
     db->lockForWrite();
     query.prepare("delete from DataStore where lid=:lid");
@@ -621,6 +628,9 @@ void TagTable::expunge(qint32 lid) {
     query.finish();
     db->unlock();
 
+    RowStore rowStore(db);
+    rowStore.refreshTag(lid);
+
     NoteTable noteTable(db);
     QList<int> notes;
     noteTable.findNotesByTag(notes, tagGuid);
@@ -720,6 +730,9 @@ void TagTable::setUpdateSequenceNumber(qint32 lid, qint32 usn) {
     query.exec();
     query.finish();
     db->unlock();
+
+    RowStore rowStore(db);
+    rowStore.refreshTag(lid);
 }
 
 
@@ -781,6 +794,10 @@ void TagTable::cleanupLinkedTags() {
     query.exec();
     query.finish();
     db->unlock();
+
+    RowStore rowStore(db);
+    rowStore.refreshTags(0, rowStore.getHighestLid());
+    global.lidMap.clear(TAG_GUID);
 }
 
 
@@ -849,4 +866,7 @@ void TagTable::cleanupMissingParents() {
     query.exec();
     query.finish();
     db->unlock();
+
+    RowStore rowStore(db);
+    rowStore.refreshTags(0, rowStore.getHighestLid());
 }
@@ -0,0 +1,181 @@
+/*********************************************************************************
+NixNote - An open-source client for the Evernote service.
+Copyright (C) 2013 Randy Baumgarte
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+***********************************************************************************/
+
+#include "trigramindex.h"
+#include "src/global.h"
+#include "src/sql/configstore.h"
+#include "src/sql/nsqlquery.h"
+#include "src/threads/databasewriter.h"
+
+#include <limits>
+
+extern Global global;
+
+// Position once every existing row has been copied
+#define TRIGRAM_INDEX_COMPLETE std::numeric_limits<qint64>::max()
+
+QAtomicInteger<qint64> TrigramIndex::position(-1);
+
+
+// Create the trigram table & pick up how far the copy of existing rows got.
+// SQLite needs FTS5 & the trigram tokenizer (3.34) for this.  Without them
+// the table isn't created & the pattern searches keep scanning.
+void TrigramIndex::createTable(DatabaseConnection *db) {
+    NSqlQuery sql(db);
+    db->lockForWrite();
+    if (!sql.exec("Create virtual table if not exists SearchTrigram using fts5 "
+                  "(content, content='SearchIndex', tokenize='trigram')")) {
+        QLOG_INFO() << "Trigram index not available: " << sql.lastError();
+        sql.finish();
+        db->unlock();
+        position = -1;
+        return;
+    }
+    sql.finish();
+    db->unlock();
+
+    ConfigStore cs(db);
+    QByteArray value;
+    if (cs.getSetting(value, CONFIG_STORE_TRIGRAM_INDEX))
+        position = value.toLongLong();
+    else
+        position = 0;
+}
+
+
+// Drop the trigram index & start over.  Used when SearchIndex is replaced.
+void TrigramIndex::reset(DatabaseConnection *db) {
+    NSqlQuery sql(db);
+    sql.exec("Drop table if exists SearchTrigram");
+    sql.finish();
+    ConfigStore cs(db);
+    cs.saveSetting(CONFIG_STORE_TRIGRAM_INDEX, QByteArray::number(0));
+    createTable(db);
+}
+
+
+// Can searches use the trigram index?
+bool TrigramIndex::isReady() {
+    return position.load() == TRIGRAM_INDEX_COMPLETE;
+}
+
+
+// Index the row the connection just inserted into SearchIndex.  Rows above
+// the copy position are left for build().
+void TrigramIndex::added(DatabaseConnection *db) {
+    if (position.load() < 0)
+        return;
+    NSqlQuery sql(db);
+    sql.prepare("Insert into SearchTrigram (rowid, content) select rowid, content from SearchIndex "
+                "where rowid=last_insert_rowid() and rowid<=:position");
+    sql.bindValue(":position", position.load());
+    if (!sql.exec())
+        QLOG_ERROR() << "Error adding to the trigram index: " << sql.lastError();
+    sql.finish();
+}
+
+
+// Take a lid's rows out of the trigram index.  An external content table
+// needs the old values to do this, so it has to be called before the
+// SearchIndex rows are deleted.
+void TrigramIndex::removed(DatabaseConnection *db, qint32 lid) {
+    if (position.load() < 0)
+        return;
+    NSqlQuery sql(db);
+    sql.prepare("Insert into SearchTrigram (SearchTrigram, rowid, content) select 'delete', rowid, content "
+                "from SearchIndex where lid=:lid and rowid<=:position");
+    sql.bindValue(":lid", lid);
+    sql.bindValue(":position", position.load());
+    if (!sql.exec())
+        QLOG_ERROR() << "Error removing from the trigram index: " << sql.lastError();
+    sql.finish();
+}
+
+
+// Take a lid's rows from one source out of the trigram index
+void TrigramIndex::removed(DatabaseConnection *db, qint32 lid, QString source) {
+    if (position.load() < 0)
+        return;
+    NSqlQuery sql(db);
+    sql.prepare("Insert into SearchTrigram (SearchTrigram, rowid, content) select 'delete', rowid, content "
+                "from SearchIndex where lid=:lid and source=:source and rowid<=:position");
+    sql.bindValue(":lid", lid);
+    sql.bindValue(":source", source);
+    sql.bindValue(":position", position.load());
+    if (!sql.exec())
+        QLOG_ERROR() << "Error removing from the trigram index: " << sql.lastError();
+    sql.finish();
+}
+
+
+// Copy the next batch of SearchIndex rows into the trigram index.  Progress
+// is saved in the ConfigStore so an interrupted copy carries on where it
+// stopped.  Returns the number of rows copied; 0 means the index is complete.
+qint32 TrigramIndex::build(DatabaseConnection *db, qint32 limit) {
+    qint64 after = position.load();
+    if (after < 0 || after == TRIGRAM_INDEX_COMPLETE)
+        return 0;
+
+    NSqlQuery sql(db);
+    db->lockForWrite();
+    sql.prepare("Select count(*), max(rowid) from (Select rowid from SearchIndex "
+                "where rowid>:after order by rowid limit :limit)");
+    sql.bindValue(":after", after);
+    sql.bindValue(":limit", limit);
+    qint32 count = 0;
+    qint64 upto = after;
+    if (sql.exec() && sql.next()) {
+        count = sql.value(0).toInt();
+        upto = sql.value(1).toLongLong();
+    }
+    if (count > 0) {
+        sql.prepare("Insert into SearchTrigram (rowid, content) select rowid, content from SearchIndex "
+                    "where rowid>:after and rowid<=:upto");
+        sql.bindValue(":after", after);
+        sql.bindValue(":upto", upto);
+        if (!sql.exec()) {
+            QLOG_ERROR() << "Error building the trigram index: " << sql.lastError();
+            sql.finish();
+            db->unlock();
+            return 0;
+        }
+    } else {
+        upto = TRIGRAM_INDEX_COMPLETE;
+        QLOG_DEBUG() << "Trigram index complete";
+    }
+    sql.finish();
+    db->unlock();
+
+    position = upto;
+    ConfigStore cs(db);
+    cs.saveSetting(CONFIG_STORE_TRIGRAM_INDEX, QByteArray::number(upto));
+    return count;
+}
+
+
+// Queue a copy batch on the database writer.  Each batch queues the next
+// one until the index is complete.
+void TrigramIndex::buildInBackground() {
+    if (global.dbWriter == nullptr || position.load() < 0 || isReady())
+        return;
+    global.dbWriter->enqueue([](DatabaseConnection *db) {
+        if (build(db, 500) > 0 && !global.dbWriter->isStopping())
+            buildInBackground();
+    });
+}
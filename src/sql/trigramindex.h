@@ -0,0 +1,64 @@
+/*********************************************************************************
+NixNote - An open-source client for the Evernote service.
+Copyright (C) 2013 Randy Baumgarte
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+***********************************************************************************/
+
+#ifndef TRIGRAMINDEX_H
+#define TRIGRAMINDEX_H
+
+#include <QAtomicInteger>
+#include <QString>
+
+class DatabaseConnection;
+
+//***********************************************************
+// FTS can't find a word by its middle or end, or a term
+// holding "-" or "_", so those searches compare every
+// SearchIndex row against a "like" pattern.
+//
+// SearchTrigram is an FTS5 trigram index over the
+// SearchIndex content (an external content table keyed by
+// SearchIndex's rowid).  SQLite uses it for "like"
+// patterns with at least three characters, so those
+// searches only look at the rows it returns.  Every
+// change to SearchIndex has to be mirrored here with
+// added() or removed().
+//
+// Existing rows are copied in the background by the
+// database writer.  The copy works up in rowid order &
+// rows above its position are left for it, so nothing is
+// added twice.  Until it is done (or if SQLite was built
+// without FTS5) the searches fall back to scanning.
+//***********************************************************
+
+class TrigramIndex
+{
+private:
+    static QAtomicInteger<qint64> position;                   // Last rowid copied.  -1 if the table isn't there.
+
+public:
+    static void createTable(DatabaseConnection *db);          // Create the table if SQLite supports it
+    static void reset(DatabaseConnection *db);               // Drop the index & copy every row again
+    static bool isReady();                                    // Is every SearchIndex row in the trigram index?
+    static void added(DatabaseConnection *db);                // Index the SearchIndex row just inserted
+    static void removed(DatabaseConnection *db, qint32 lid);  // Call before deleting a lid's SearchIndex rows
+    static void removed(DatabaseConnection *db, qint32 lid, QString source);
+    static qint32 build(DatabaseConnection *db, qint32 limit); // Copy a batch of existing rows
+    static void buildInBackground();                          // Queue the copy of existing rows on the writer
+};
+
+#endif // TRIGRAMINDEX_H
@@ -0,0 +1,124 @@
+/*********************************************************************************
+NixNote - An open-source client for the Evernote service.
+Copyright (C) 2013 Randy Baumgarte
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+***********************************************************************************/
+
+#include "writebatch.h"
+#include "src/global.h"
+
+extern Global global;
+
+
+// Constructor.  If another batch is already active on this connection
+// the new one joins it and leaves the transaction handling to it.
+WriteBatch::WriteBatch(DatabaseConnection *db, qint32 commitSize)
+{
+    this->db = db;
+    this->commitSize = commitSize;
+    if (commitSize < 0)
+        this->commitSize = global.getWriteBatchSize();
+    insert = nullptr;
+    pending = 0;
+    written = 0;
+    pendingResources = 0;
+    writtenResources = 0;
+    inTransaction = false;
+    owner = (db->writeBatch == nullptr && this->commitSize > 0);
+    if (owner)
+        db->writeBatch = this;
+    timer.start();
+    begin();
+}
+
+
+// Destructor.  Commit anything left over.
+WriteBatch::~WriteBatch() {
+    commit();
+    if (insert != nullptr) {
+        insert->finish();
+        delete insert;
+    }
+    if (owner)
+        db->writeBatch = nullptr;
+    qint64 elapsed = timer.elapsed();
+    if (written > 0) {
+        QLOG_DEBUG() << "Write batch: " << written << " notes in " << elapsed << "ms ("
+                     << (elapsed > 0 ? written * 1000 / elapsed : written) << " notes/second)";
+    }
+    if (writtenResources > 0) {
+        QLOG_DEBUG() << "Write batch: " << writtenResources << " resources in " << elapsed << "ms ("
+                     << (elapsed > 0 ? writtenResources * 1000 / elapsed : writtenResources) << " resources/second)";
+    }
+}
+
+
+// Start a transaction if one isn't already open
+void WriteBatch::begin() {
+    if (!owner || inTransaction)
+        return;
+    if (!db->conn.transaction()) {
+        QLOG_ERROR() << "Unable to start write batch transaction: " << db->conn.lastError();
+        return;
+    }
+    inTransaction = true;
+}
+
+
+// Return the prepared DataStore insert.  It is prepared once and
+// reused for every row written while the batch is active.
+NSqlQuery *WriteBatch::insertQuery() {
+    if (insert == nullptr) {
+        insert = new NSqlQuery(db);
+        insert->prepare("Insert into DataStore (lid, key, data) values (:lid, :key, :data)");
+    }
+    return insert;
+}
+
+
+// Count a note.  Once the batch holds "commit size" notes it is
+// committed and a new transaction is started for the next ones.
+void WriteBatch::noteWritten() {
+    written++;
+    pending++;
+    if (commitSize > 0 && pending >= commitSize)
+        commit();
+    begin();
+}
+
+
+// Count a resource written by itself (not as part of a note)
+void WriteBatch::resourceWritten() {
+    writtenResources++;
+    pendingResources++;
+    if (commitSize > 0 && pendingResources >= commitSize)
+        commit();
+    begin();
+}
+
+
+// Commit the current transaction
+void WriteBatch::commit() {
+    if (!inTransaction)
+        return;
+    inTransaction = false;
+    if (!db->conn.commit()) {
+        QLOG_ERROR() << "Write batch commit failed: " << db->conn.lastError();
+        db->conn.rollback();
+    }
+    pending = 0;
+    pendingResources = 0;
+}
@@ -0,0 +1,80 @@
+/*********************************************************************************
+NixNote - An open-source client for the Evernote service.
+Copyright (C) 2013 Randy Baumgarte
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+***********************************************************************************/
+
+#ifndef WRITEBATCH_H
+#define WRITEBATCH_H
+
+#include <QElapsedTimer>
+#include <QtSql>
+
+#include "src/sql/databaseconnection.h"
+#include "src/sql/nsqlquery.h"
+
+//***********************************************************
+// A write batch groups bulk inserts (sync, imports, the
+// file watcher) into transactions of "commit size" notes
+// instead of committing every DataStore insert on its own.
+// While a batch is active NoteTable::add & ResourceTable::add
+// reuse the batch's prepared DataStore insert.
+//
+// Usage:
+//     WriteBatch batch(db);
+//     for (...) {
+//         noteTable.add(0, note, false);
+//         batch.noteWritten();
+//     }
+//     batch.commit();      // also done by the destructor
+//
+// A commit size of 0 turns batching off and every insert is
+// committed by itself, the way it was done before batches.
+// Callers which always ran in one transaction (ENEX import)
+// pass WRITE_BATCH_ALL instead, so they keep it.
+//
+// Resources synced on their own are counted separately with
+// resourceWritten(); the batch commits when either count
+// reaches the commit size.
+//***********************************************************
+
+#define WRITE_BATCH_ALL 0x7fffffff     // Commit size for one transaction over everything written
+
+class WriteBatch
+{
+private:
+    DatabaseConnection *db;
+    NSqlQuery *insert;              // Reused DataStore insert
+    qint32 commitSize;              // Notes per transaction
+    qint32 pending;                 // Notes written since the last commit
+    qint32 written;                 // Notes written by this batch
+    qint32 pendingResources;        // Resources written since the last commit
+    qint32 writtenResources;        // Resources written by this batch
+    bool owner;                     // False if another batch was already active
+    bool inTransaction;
+    QElapsedTimer timer;
+    void begin();
+
+public:
+    WriteBatch(DatabaseConnection *db, qint32 commitSize = -1);  // -1 uses the configured size
+    ~WriteBatch();
+    NSqlQuery *insertQuery();       // Prepared DataStore insert for this batch
+    void noteWritten();             // Count a note written by the caller; commits when the batch is full
+    void resourceWritten();         // Count a resource written by itself; commits when the batch is full
+    void commit();                  // Commit anything pending
+};
+
+#endif // WRITEBATCH_H
@@ -22,6 +22,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include "src/sql/notebooktable.h"
 #include "src/sql/nsqlquery.h"
 #include "src/sql/tagtable.h"
+#include "src/sql/connectionpool.h"
 
 #include <QtSql>
 
@@ -37,11 +38,50 @@ void CounterRunner::initialize() {
         return;
     init = true;
     QLOG_DEBUG() << "Starting CounterRunner";
-    db = new DatabaseConnection("counterrunner");
+    // Counts are read through this thread's read-only connection.  The
+    // totals over all notes only change when the change log says a note
+    // moved, was retagged or trashed, or a tag or notebook came or went.
+    // Counts within the filter are redone every time.
+    notebooksChanged = true;
+    tagsChanged = true;
+    trashChanged = true;
+    ReadConnection reader(true);
+    reader.db->subscribe([this](const QList<ChangeLogEntry> &changes, bool complete) {
+        if (!complete) {
+            notebooksChanged = true;
+            tagsChanged = true;
+            trashChanged = true;
+        }
+        for (int i=0; i<changes.size(); i++) {
+            const ChangeLogEntry &change = changes[i];
+            if (change.type == CHANGE_ENTITY_NOTEBOOK)
+                notebooksChanged = true;
+            if (change.type == CHANGE_ENTITY_TAG)
+                tagsChanged = true;
+            if (change.type != CHANGE_ENTITY_NOTE)
+                continue;
+            if (change.fields.contains(NOTE_ACTIVE)) {
+                notebooksChanged = true;
+                tagsChanged = true;
+                trashChanged = true;
+            }
+            if (change.fields.contains(NOTE_NOTEBOOK_LID))
+                notebooksChanged = true;
+            if (change.fields.contains(NOTE_TAG_LID))
+                tagsChanged = true;
+        }
+    });
     QLOG_DEBUG() << "CounterRunner initialization complete.";
 }
 
 
+// Hand the subscription anything logged since the last count
+void CounterRunner::checkChanges() {
+    ReadConnection reader(true);
+    reader.db->publishChanges();
+}
+
+
 void CounterRunner::countAll() {
     if (global.countBehavior == Global::CountNone)
         return;
@@ -61,9 +101,15 @@ void CounterRunner::countTrash() {
     QLOG_TRACE_IN();
     if (!init)
         initialize();
-    NoteTable ntable(db);
-    QList<qint32> lids;
-    emit trashTotals(ntable.getAllDeleted(lids));
+    checkChanges();
+    if (trashChanged) {
+        ReadConnection reader;
+        NoteTable ntable(reader.db);
+        QList<qint32> lids;
+        trashCounts = ntable.getAllDeleted(lids);
+        trashChanged = false;
+    }
+    emit trashTotals(trashCounts);
     QLOG_TRACE_OUT();
 }
 
@@ -77,23 +123,29 @@ void CounterRunner::countNotebooks() {
         initialize();
 
     // First get every possible notebook
-    NotebookTable nTable(db);
+    ReadConnection reader;
+    loadFilter(reader.db);
+    NotebookTable nTable(reader.db);
     QList<qint32> lids;
     nTable.getAll(lids);
 
     // Next, get the totals of everything possible
-    QHash<qint32, qint32> allNotebooks;
-    for (int i=0; i<lids.size(); i++) {
-        allNotebooks.insert(lids.at(i), 0);
-    }
-
-    NSqlQuery query(db);
-    query.exec(" select data, count(data) from datastore where key=5011 and lid not in (select lid from datastore where data=0 and key=5010) group by data;");
-    while (query.next()) {
-        qint32 lid = query.value(0).toInt();
-        qint32 total = query.value(1).toInt();
-        allNotebooks[lid] = total;
+    NSqlQuery query(reader.db);
+    checkChanges();
+    if (notebooksChanged) {
+        notebookTotalCounts.clear();
+        for (int i=0; i<lids.size(); i++) {
+            notebookTotalCounts.insert(lids.at(i), 0);
+        }
+        query.exec(" select data, count(data) from datastore where key=5011 and lid not in (select lid from datastore where data=0 and key=5010) group by data;");
+        while (query.next()) {
+            qint32 lid = query.value(0).toInt();
+            qint32 total = query.value(1).toInt();
+            notebookTotalCounts[lid] = total;
+        }
+        notebooksChanged = false;
     }
+    QHash<qint32, qint32> &allNotebooks = notebookTotalCounts;
 
     query.exec("select notebooklid, count(notebooklid) from notetable where lid in (select lid from filter) and lid not in (select lid from datastore where data=0 and key=5010) group by notebooklid;");
 
@@ -119,28 +171,32 @@ void CounterRunner::countTags() {
     if (!init)
         initialize();
     // First get every possible tag
-    TagTable tTable(db);
+    ReadConnection reader;
+    loadFilter(reader.db);
+    TagTable tTable(reader.db);
     QList<qint32> lids;
     tTable.getAll(lids);
 
     // Next, get the totals of everything possible
-    QHash<qint32, qint32> allTags;
-    for (int i=0; i<lids.size(); i++) {
-        allTags.insert(lids.at(i), 0);
-    }
-
-    NSqlQuery query(db);
-    query.exec(" select data, count(data) from datastore where key=5012 and lid not in (select lid from datastore where data=0 and key=5010) group by data;");
-    while (query.next()) {
-        qint32 lid = query.value(0).toInt();
-        qint32 total = query.value(1).toInt();
-        allTags[lid] = total;
+    NSqlQuery query(reader.db);
+    checkChanges();
+    if (tagsChanged) {
+        tagTotalCounts.clear();
+        for (int i=0; i<lids.size(); i++) {
+            tagTotalCounts.insert(lids.at(i), 0);
+        }
+        query.exec("select nt.tagLid, count(*) from NoteTags nt join Notes n on n.lid=nt.noteLid where coalesce(n.active,1)<>0 group by nt.tagLid");
+        while (query.next()) {
+            qint32 lid = query.value(0).toInt();
+            qint32 total = query.value(1).toInt();
+            tagTotalCounts[lid] = total;
+        }
+        tagsChanged = false;
     }
+    QHash<qint32, qint32> &allTags = tagTotalCounts;
 
     // Start counting
-    query.prepare("select data, count(lid) from datastore where key=:key and lid in (select lid from filter) and lid not in (select lid from datastore where data=0 and key=5010) group by data;");
-    query.bindValue(":key", NOTE_TAG_LID);
-    query.exec();
+    query.exec("select nt.tagLid, count(*) from NoteTags nt join Notes n on n.lid=nt.noteLid where coalesce(n.active,1)<>0 and nt.noteLid in (select lid from filter) group by nt.tagLid");
     while(query.next()) {
         qint32 lid = query.value(0).toInt();
         emit tagTotals(lid, query.value(1).toInt(), allTags[lid]);
@@ -155,3 +211,14 @@ void CounterRunner::countTags() {
     emit(tagCountComplete());
     QLOG_TRACE_OUT();
 }
+
+
+// Copy the GUI's current filter into the reader's TEMP filter table.
+// Until something has been filtered every note counts.
+void CounterRunner::loadFilter(DatabaseConnection *db) {
+    QList<qint32> lids;
+    if (global.getFilteredLids(lids))
+        db->loadFilterTable(lids);
+    else
+        db->createFilterTable();
+}
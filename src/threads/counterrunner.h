@@ -24,6 +24,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include "src/global.h"
 #include <QPair>
 #include <QList>
+#include <QHash>
 #include "src/sql/databaseconnection.h"
 
 extern Global global;
@@ -35,8 +36,14 @@ private:
     QList<QPair<qint32, qint32>*> *notebookCounts;
     QList<QPair<qint32, qint32>*> *tagCounts;
     qint32 trashCounts;
-    DatabaseConnection *db;
+    QHash<qint32, qint32> notebookTotalCounts;   // Notes in each notebook, ignoring the filter
+    QHash<qint32, qint32> tagTotalCounts;        // Notes with each tag, ignoring the filter
+    bool notebooksChanged;                       // Do the totals need counting again?
+    bool tagsChanged;
+    bool trashChanged;
     void initialize();
+    void checkChanges();
+    void loadFilter(DatabaseConnection *db);
     bool init;
 
 public:
@@ -0,0 +1,313 @@
+/*********************************************************************************
+NixNote - An open-source client for the Evernote service.
+Copyright (C) 2013 Randy Baumgarte
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+***********************************************************************************/
+
+#include "databasemaintenance.h"
+#include "databasewriter.h"
+#include "src/global.h"
+#include "src/sql/blobstore.h"
+#include "src/sql/configstore.h"
+#include "src/sql/fulltextindex.h"
+#include "src/sql/nsqlquery.h"
+
+#include <QApplication>
+#include <QEvent>
+
+extern Global global;
+
+// How often we check if the user is idle (ms)
+#define MAINTENANCE_CHECK_INTERVAL 1000
+
+// Pages given back per incremental vacuum call
+#define MAINTENANCE_VACUUM_PAGES 256
+
+// Tables analyzed, one at a time
+static const char *analyzeTables[] = {
+    "DataStore", "Notes", "NoteTags", "Resources", "Tags", "Notebooks", "ChangeLog", nullptr
+};
+
+
+// Constructor
+DatabaseMaintenance::DatabaseMaintenance(QObject *parent) :
+    QObject(parent)
+{
+    idleTime = 0;
+    sliceTime = 0;
+    sliceQueued = false;
+    inProgress = false;
+    step = MAINTENANCE_IDLE;
+    analyzeTable = 0;
+    current = MaintenanceReport();
+    last = MaintenanceReport();
+    connect(&timer, SIGNAL(timeout()), this, SLOT(timerExpired()));
+}
+
+
+// Work out when the next run is due & start watching for idle time.
+// The time of the last run is kept in the database, so a run isn't
+// repeated every time we start.
+void DatabaseMaintenance::start() {
+    int interval = global.getMaintenanceInterval();
+    if (interval <= 0) {
+        QLOG_DEBUG() << "Database maintenance is turned off";
+        return;
+    }
+    idleTime = qint64(global.getMaintenanceIdleTime()) * 1000;
+    sliceTime = global.getMaintenanceSliceTime();
+    ConfigStore cs(global.db);
+    QByteArray value;
+    QDateTime lastRun;
+    if (cs.getSetting(value, CONFIG_STORE_LAST_MAINTENANCE))
+        lastRun = QDateTime::fromString(QString::fromUtf8(value), Qt::ISODate);
+    mutex.lock();
+    if (lastRun.isValid())
+        nextRun = lastRun.addSecs(qint64(interval) * 3600);
+    else
+        nextRun = QDateTime::currentDateTime();
+    mutex.unlock();
+
+    lastActivity.start();
+    qApp->installEventFilter(this);
+    timer.start(MAINTENANCE_CHECK_INTERVAL);
+}
+
+
+// Watch the application's input events so we know when the user is busy
+bool DatabaseMaintenance::eventFilter(QObject *object, QEvent *event) {
+    switch (event->type()) {
+    case QEvent::KeyPress:
+    case QEvent::MouseButtonPress:
+    case QEvent::MouseMove:
+    case QEvent::Wheel:
+    case QEvent::TouchBegin:
+        lastActivity.restart();
+        break;
+    default:
+        break;
+    }
+    return QObject::eventFilter(object, event);
+}
+
+
+// Queue the next slice if a run is due (or in progress), the user is
+// idle & we aren't syncing.
+void DatabaseMaintenance::timerExpired() {
+    if (global.dbWriter == nullptr || global.dbWriter->isStopping() || global.connected)
+        return;
+    if (lastActivity.elapsed() < idleTime)
+        return;
+
+    QMutexLocker locker(&mutex);
+    if (sliceQueued)
+        return;
+    if (step == MAINTENANCE_IDLE) {
+        if (QDateTime::currentDateTime() < nextRun)
+            return;
+        QLOG_DEBUG() << "Starting database maintenance";
+        step = MAINTENANCE_MEASURE;
+        inProgress = true;
+        analyzeTable = 0;
+        current = MaintenanceReport();
+    }
+    sliceQueued = true;
+    global.dbWriter->enqueue([this](DatabaseConnection *db) {
+        runSlice(db);
+    });
+}
+
+
+// Run steps on the writer thread until the slice time is used up.  Only
+// one slice is ever queued, so the step state needs no lock here.
+void DatabaseMaintenance::runSlice(DatabaseConnection *db) {
+    QElapsedTimer slice;
+    slice.start();
+    NSqlQuery query(db);
+
+    while (step != MAINTENANCE_IDLE && slice.elapsed() < sliceTime) {
+        QElapsedTimer stepTimer;
+        stepTimer.start();
+        bool done = true;
+        switch (step) {
+        case MAINTENANCE_MEASURE:
+            measure(db, current.sizeBefore, current.freeBefore, current.segmentsBefore);
+            break;
+        case MAINTENANCE_ANALYZE:
+            done = analyze(db, slice);
+            current.analyzeTime += stepTimer.elapsed();
+            break;
+        case MAINTENANCE_OPTIMIZE:
+            query.exec("pragma optimize");
+            current.analyzeTime += stepTimer.elapsed();
+            break;
+        case MAINTENANCE_FTS:
+            done = mergeSearchIndex(db, slice);
+            current.ftsTime += stepTimer.elapsed();
+            break;
+        case MAINTENANCE_VACUUM:
+            done = vacuum(db, slice);
+            current.vacuumTime += stepTimer.elapsed();
+            break;
+        case MAINTENANCE_BLOBS: {
+            BlobStore blobs(db);
+            blobs.purge();
+            break;
+        }
+        case MAINTENANCE_FINISH: {
+            measure(db, current.sizeAfter, current.freeAfter, current.segmentsAfter);
+            current.finished = QDateTime::currentDateTime();
+            ConfigStore cs(db);
+            cs.saveSetting(CONFIG_STORE_LAST_MAINTENANCE, current.finished.toString(Qt::ISODate).toUtf8());
+            QLOG_INFO() << "Database maintenance finished.  Size " << current.sizeBefore << " -> "
+                        << current.sizeAfter << " bytes, search index segments " << current.segmentsBefore
+                        << " -> " << current.segmentsAfter;
+            break;
+        }
+        }
+        if (!done)
+            break;
+        step = (step == MAINTENANCE_FINISH ? MAINTENANCE_IDLE : step+1);
+    }
+    query.finish();
+
+    QMutexLocker locker(&mutex);
+    sliceQueued = false;
+    if (step == MAINTENANCE_IDLE) {
+        inProgress = false;
+        last = current;
+        nextRun = current.finished.addSecs(qint64(global.getMaintenanceInterval()) * 3600);
+    }
+}
+
+
+// Analyze the tables one at a time.  The analysis limit keeps each
+// one short on large databases (older SQLite versions ignore it).
+bool DatabaseMaintenance::analyze(DatabaseConnection *db, QElapsedTimer &slice) {
+    NSqlQuery query(db);
+    query.exec("pragma analysis_limit=1000");
+    while (analyzeTables[analyzeTable] != nullptr) {
+        if (slice.elapsed() >= sliceTime)
+            return false;
+        query.exec(QString("analyze ") + analyzeTables[analyzeTable]);
+        analyzeTable++;
+    }
+    return true;
+}
+
+
+// Merge search index segments a little at a time.  The index is done
+// when a merge changes less than two rows.
+bool DatabaseMaintenance::mergeSearchIndex(DatabaseConnection *db, QElapsedTimer &slice) {
+    NSqlQuery query(db);
+    while (slice.elapsed() < sliceTime) {
+        query.exec("select total_changes()");
+        qint64 before = query.next() ? query.value(0).toLongLong() : 0;
+        QString merge("insert into SearchIndex(SearchIndex) values('merge=200,8')");
+        if (FullTextIndex::isFts5())
+            merge = "insert into SearchIndex(SearchIndex, rank) values('merge', 200)";
+        if (!query.exec(merge)) {
+            QLOG_ERROR() << "Search index merge failed: " << query.lastError();
+            return true;
+        }
+        query.exec("select total_changes()");
+        qint64 after = query.next() ? query.value(0).toLongLong() : 0;
+        if (after - before < 2)
+            return true;
+    }
+    return false;
+}
+
+
+// Give free pages back to the file system with an incremental vacuum.
+// Databases created before incremental vacuum was turned on are left
+// alone; switching them over takes a full VACUUM, which rewrites the
+// whole file & is only run when the user asks for it (see vacuumNow()).
+bool DatabaseMaintenance::vacuum(DatabaseConnection *db, QElapsedTimer &slice) {
+    NSqlQuery query(db);
+    query.exec("pragma auto_vacuum");
+    int mode = query.next() ? query.value(0).toInt() : 0;
+    if (mode != 2) {
+        QLOG_DEBUG() << "Skipping vacuum, the database doesn't use incremental vacuum";
+        return true;
+    }
+
+    while (slice.elapsed() < sliceTime) {
+        query.exec("pragma freelist_count");
+        if (!query.next() || query.value(0).toLongLong() == 0)
+            return true;
+        // Each step of the pragma frees a page, so read it to the end
+        query.exec("pragma incremental_vacuum(" + QString::number(MAINTENANCE_VACUUM_PAGES) + ")");
+        while (query.next());
+    }
+    return false;
+}
+
+
+// Compact the database with a full VACUUM on the writer, switching it to
+// incremental vacuum on the way so idle time maintenance can keep it
+// compact from then on.  This rewrites the whole file, so it is only run
+// when the user asks.  VACUUM can't run inside a transaction, so the
+// writer's transaction is committed first & a new one started afterwards.
+void DatabaseMaintenance::vacuumNow() {
+    if (global.dbWriter == nullptr)
+        return;
+    global.dbWriter->enqueue([](DatabaseConnection *db) {
+        QElapsedTimer timer;
+        timer.start();
+        NSqlQuery query(db);
+        db->conn.commit();
+        query.exec("pragma auto_vacuum=incremental");
+        if (!query.exec("vacuum"))
+            QLOG_ERROR() << "Database vacuum failed: " << query.lastError();
+        else
+            QLOG_INFO() << "Database compacted in " << timer.elapsed() << " ms";
+        query.finish();
+        db->conn.transaction();
+    });
+}
+
+
+// Database size, free space & number of search index segments
+void DatabaseMaintenance::measure(DatabaseConnection *db, qint64 &size, qint64 &free, qint32 &segments) {
+    NSqlQuery query(db);
+    query.exec("pragma page_size");
+    qint64 pageSize = query.next() ? query.value(0).toLongLong() : 0;
+    query.exec("pragma page_count");
+    size = query.next() ? query.value(0).toLongLong() * pageSize : 0;
+    query.exec("pragma freelist_count");
+    free = query.next() ? query.value(0).toLongLong() * pageSize : 0;
+    if (FullTextIndex::isFts5())
+        query.exec("select count(distinct segid) from SearchIndex_idx");
+    else
+        query.exec("select count(*) from SearchIndex_segdir");
+    segments = query.next() ? query.value(0).toInt() : 0;
+    query.finish();
+}
+
+
+// Figures of the last finished run
+MaintenanceReport DatabaseMaintenance::getReport() {
+    QMutexLocker locker(&mutex);
+    return last;
+}
+
+
+// Is a run in progress?
+bool DatabaseMaintenance::isRunning() {
+    QMutexLocker locker(&mutex);
+    return inProgress;
+}
@@ -0,0 +1,105 @@
+/*********************************************************************************
+NixNote - An open-source client for the Evernote service.
+Copyright (C) 2013 Randy Baumgarte
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+***********************************************************************************/
+
+#ifndef DATABASEMAINTENANCE_H
+#define DATABASEMAINTENANCE_H
+
+#include <QObject>
+#include <QTimer>
+#include <QMutex>
+#include <QDateTime>
+#include <QElapsedTimer>
+
+class DatabaseConnection;
+
+// Maintenance steps, in the order they run
+#define MAINTENANCE_IDLE     0
+#define MAINTENANCE_MEASURE  1
+#define MAINTENANCE_ANALYZE  2
+#define MAINTENANCE_OPTIMIZE 3
+#define MAINTENANCE_FTS      4
+#define MAINTENANCE_VACUUM   5
+#define MAINTENANCE_BLOBS    6
+#define MAINTENANCE_FINISH   7
+
+// Sizes & timings of the last maintenance run
+struct MaintenanceReport {
+    QDateTime finished;                 // When it finished (invalid if it hasn't run)
+    qint64 sizeBefore, sizeAfter;       // Database size in bytes
+    qint64 freeBefore, freeAfter;       // Bytes in free pages
+    qint32 segmentsBefore, segmentsAfter;  // Search index segments
+    qint64 analyzeTime;                 // ms spent on ANALYZE & pragma optimize
+    qint64 ftsTime;                     // ms spent merging the search index
+    qint64 vacuumTime;                  // ms spent vacuuming
+};
+
+
+//***********************************************************
+// Idle time database maintenance.  Once per maintenance
+// interval the tables are analyzed, the search index
+// segments are merged, free pages are given back with an
+// incremental vacuum & resource blobs no resource uses any
+// more are removed.  A full VACUUM is never run on its
+// own; vacuumNow() runs one when the user asks for it.
+//
+// The work is cut into slices of a bounded length which run
+// as jobs on the database writer.  A slice is only queued
+// when the user hasn't touched the keyboard or mouse for a
+// while & no sync is running, so maintenance stops as soon
+// as the user comes back & carries on later.
+//***********************************************************
+
+class DatabaseMaintenance : public QObject
+{
+    Q_OBJECT
+private:
+    QTimer timer;
+    QElapsedTimer lastActivity;         // Time since the user last did something
+    QDateTime nextRun;                  // When the next run is due
+    qint64 idleTime;                    // ms without input before a slice is queued
+    qint64 sliceTime;                   // Longest a slice may run in ms
+    QMutex mutex;                       // Guards everything below
+    bool sliceQueued;                   // A slice is waiting or running on the writer
+    bool inProgress;                    // A run has started & not finished
+    int step;                           // Next step to run
+    int analyzeTable;                   // Next table to analyze
+    MaintenanceReport current;          // Figures of the run in progress
+    MaintenanceReport last;             // Figures of the last finished run
+
+    void runSlice(DatabaseConnection *db);
+    bool analyze(DatabaseConnection *db, QElapsedTimer &slice);
+    bool mergeSearchIndex(DatabaseConnection *db, QElapsedTimer &slice);
+    bool vacuum(DatabaseConnection *db, QElapsedTimer &slice);
+    void measure(DatabaseConnection *db, qint64 &size, qint64 &free, qint32 &segments);
+
+protected:
+    bool eventFilter(QObject *object, QEvent *event);
+
+public:
+    explicit DatabaseMaintenance(QObject *parent = 0);
+    void start();                       // Start watching for idle time
+    MaintenanceReport getReport();      // Figures of the last finished run
+    bool isRunning();                   // Is a run in progress?
+    void vacuumNow();                   // Queue a full VACUUM on the writer
+
+public slots:
+    void timerExpired();
+};
+
+#endif // DATABASEMAINTENANCE_H
@@ -0,0 +1,206 @@
+/*********************************************************************************
+NixNote - An open-source client for the Evernote service.
+Copyright (C) 2013 Randy Baumgarte
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+***********************************************************************************/
+
+#include "databasewriter.h"
+#include "src/global.h"
+#include "src/sql/changelog.h"
+
+#include <QSqlQuery>
+#include <QSqlError>
+
+extern Global global;
+
+
+// Constructor
+DatabaseWriter::DatabaseWriter(QObject *parent) :
+    QThread(parent)
+{
+    db = nullptr;
+    queuedCount = 0;
+    finishedCount = 0;
+    failedCount = 0;
+    keepRunning = true;
+    compactCheckedAt = -1;
+}
+
+
+// Thread main loop.  Wait for jobs, then run everything that is queued
+// inside a single transaction.
+void DatabaseWriter::run() {
+    QLOG_DEBUG() << "Starting DatabaseWriter";
+    db = new DatabaseConnection("dbwriter");
+
+    mutex.lock();
+    while (keepRunning || queue.size() > 0) {
+        if (queue.size() == 0) {
+            jobsQueued.wait(&mutex);
+            continue;
+        }
+        QList<WriteJob> jobs = queue;
+        QList<bool*> reports = results;
+        queue.clear();
+        results.clear();
+        mutex.unlock();
+
+        // The jobs aren't run outside a transaction, where a failure
+        // could leave half of a job written
+        QList<bool> ok;
+        bool started = db->conn.transaction();
+        if (!started)
+            QLOG_ERROR() << "DatabaseWriter unable to start transaction: " << db->conn.lastError();
+        for (int i=0; i<jobs.size(); i++)
+            ok.append(started && runJob(jobs[i]));
+        if (started)
+            compactChangeLog();
+        if (started && !db->conn.commit()) {
+            QLOG_ERROR() << "DatabaseWriter commit failed: " << db->conn.lastError();
+            db->conn.rollback();
+            for (int i=0; i<ok.size(); i++)
+                ok[i] = false;
+        }
+
+        mutex.lock();
+        for (int i=0; i<jobs.size(); i++) {
+            if (!ok[i])
+                failedCount++;
+            if (reports[i] != nullptr)
+                *reports[i] = ok[i];
+        }
+        finishedCount += jobs.size();
+        jobsFinished.wakeAll();
+    }
+    mutex.unlock();
+
+    delete db;
+    db = nullptr;
+    QLOG_DEBUG() << "DatabaseWriter stopped";
+}
+
+
+// Run a job inside a savepoint, which is rolled back if any of the job's
+// statements failed.  A job which ends the transaction itself (VACUUM)
+// has released the savepoint already.
+bool DatabaseWriter::runJob(const WriteJob &job) {
+    QSqlQuery savepoint(db->conn);
+    if (!savepoint.exec("Savepoint writerjob")) {
+        QLOG_ERROR() << "DatabaseWriter unable to start savepoint: " << savepoint.lastError();
+        return false;
+    }
+    qint32 failed = db->failedStatements;
+    job(db);
+    if (db->failedStatements == failed) {
+        savepoint.exec("Release writerjob");
+        return true;
+    }
+    QLOG_ERROR() << "DatabaseWriter job failed, rolling it back";
+    savepoint.exec("Rollback to writerjob");
+    savepoint.exec("Release writerjob");
+    return false;
+}
+
+
+// Compact the change log once a quarter of its size has been logged
+// since the last check.  Finding the newest sequence number is a single
+// index lookup, so this is cheap to ask after every group.
+void DatabaseWriter::compactChangeLog() {
+    ChangeLog changeLog(db);
+    qint64 highest = changeLog.getHighestSequence();
+    qint32 keep = global.getChangeLogSize();
+    if (compactCheckedAt < 0)
+        compactCheckedAt = highest;
+    if (highest - compactCheckedAt < qMax(keep / 4, 1))
+        return;
+    compactCheckedAt = highest;
+    runJob([keep](DatabaseConnection *db) {
+        ChangeLog changeLog(db);
+        changeLog.compact(keep);
+    });
+}
+
+
+// Add a job to the queue.  It is written with the next group commit.
+void DatabaseWriter::enqueue(WriteJob job) {
+    QMutexLocker locker(&mutex);
+    queue.append(job);
+    results.append(nullptr);
+    queuedCount++;
+    jobsQueued.wakeOne();
+}
+
+
+// Add a job to the queue & wait for it to be committed.  If we are
+// called from a job on the writer thread the job is simply run, inside
+// a savepoint of its own.  Without a writer thread nothing would ever
+// run the job, so it is refused.
+bool DatabaseWriter::execute(WriteJob job) {
+    if (QThread::currentThread() == this)
+        return runJob(job);
+    if (!isRunning()) {
+        QLOG_ERROR() << "DatabaseWriter isn't running, write refused";
+        return false;
+    }
+    bool ok = false;
+    QMutexLocker locker(&mutex);
+    queue.append(job);
+    results.append(&ok);
+    queuedCount++;
+    quint64 target = queuedCount;
+    jobsQueued.wakeOne();
+    while (finishedCount < target)
+        jobsFinished.wait(&mutex);
+    return ok;
+}
+
+
+// Wait until every job queued before this call is written.  Returns false
+// if a job failed while we waited, or if jobs are queued but the writer
+// isn't running to write them.
+bool DatabaseWriter::flush() {
+    if (QThread::currentThread() == this)
+        return true;
+    QMutexLocker locker(&mutex);
+    if (!isRunning()) {
+        if (finishedCount < queuedCount)
+            QLOG_ERROR() << "DatabaseWriter isn't running, " << queuedCount - finishedCount << " writes waiting";
+        return finishedCount == queuedCount;
+    }
+    quint64 target = queuedCount;
+    quint64 failed = failedCount;
+    while (finishedCount < target)
+        jobsFinished.wait(&mutex);
+    return failedCount == failed;
+}
+
+
+// Finish writing the queue & stop the thread
+void DatabaseWriter::stop() {
+    mutex.lock();
+    keepRunning = false;
+    jobsQueued.wakeOne();
+    mutex.unlock();
+    wait();
+}
+
+
+// Has stop() been called?  Jobs which queue more work check this so
+// they don't keep the thread alive.
+bool DatabaseWriter::isStopping() {
+    QMutexLocker locker(&mutex);
+    return !keepRunning;
+}
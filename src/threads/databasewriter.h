@@ -0,0 +1,86 @@
+/*********************************************************************************
+NixNote - An open-source client for the Evernote service.
+Copyright (C) 2013 Randy Baumgarte
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+***********************************************************************************/
+
+#ifndef DATABASEWRITER_H
+#define DATABASEWRITER_H
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QList>
+#include <functional>
+
+#include "src/sql/databaseconnection.h"
+
+class DatabaseConnection;
+
+typedef std::function<void(DatabaseConnection *db)> WriteJob;
+
+//***********************************************************
+// The database writer owns a connection of its own and runs
+// queued write jobs on it.  Everything waiting in the queue
+// when the writer wakes up is written in one transaction
+// (a group commit) so background writers no longer compete
+// with each other and with the GUI for the SQLite write lock.
+//
+// enqueue() returns immediately.  execute() waits until the
+// job has been committed.  Jobs run in the order they were
+// queued.
+//
+// Each job runs inside a savepoint.  If a statement of the
+// job fails, only that job is rolled back.  If the commit
+// fails, every job of the group counts as failed.
+//
+// The writer also keeps the change log to its size: once a
+// quarter of the "changeLogSize" setting has been logged
+// (by any connection) since the last check, the log is
+// compacted with the next group.
+//***********************************************************
+
+class DatabaseWriter : public QThread
+{
+    Q_OBJECT
+private:
+    DatabaseConnection *db;
+    QMutex mutex;
+    QWaitCondition jobsQueued;
+    QWaitCondition jobsFinished;
+    QList<WriteJob> queue;
+    QList<bool*> results;           // Where to report each queued job's outcome (or nullptr)
+    quint64 queuedCount;            // Jobs ever queued
+    quint64 finishedCount;          // Jobs ever committed or rolled back
+    quint64 failedCount;            // Jobs ever rolled back
+    bool keepRunning;
+    qint64 compactCheckedAt;        // Change log sequence number when its size was last checked
+    bool runJob(const WriteJob &job);   // Run one job inside its savepoint
+    void compactChangeLog();        // Trim the change log once enough changes were logged
+
+protected:
+    void run();
+
+public:
+    explicit DatabaseWriter(QObject *parent = 0);
+    void enqueue(WriteJob job);     // Queue a job & return
+    bool execute(WriteJob job);     // Queue a job & wait until it is committed.  False if it wasn't.
+    bool flush();                   // Wait until everything queued so far is written.  False if a job failed meanwhile.
+    void stop();                    // Write anything left & end the thread
+    bool isStopping();              // Has stop() been called?
+};
+
+#endif // DATABASEWRITER_H
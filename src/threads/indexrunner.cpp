@@ -19,9 +19,11 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 
 #include "indexrunner.h"
 #include "src/global.h"
+#include "src/sql/fulltextindex.h"
 #include "src/sql/notetable.h"
 #include "src/sql/nsqlquery.h"
 #include "src/sql/resourcetable.h"
+#include "src/sql/trigramindex.h"
 #include <QTextDocument>
 #include <QtXml>
 #if QT_VERSION < 0x050000
@@ -49,6 +51,7 @@ IndexRunner::IndexRunner()
     this->db = nullptr;
     //this->indexTimer = nullptr;
     this->iAmBusy = false;
+    this->indexPending = true;
 }
 
 
@@ -70,6 +73,17 @@ void IndexRunner::initialize() {
     iAmBusy = false;
     QLOG_DEBUG() << "Starting IndexRunner";
     db = new DatabaseConnection("indexrunner");
+
+    // Only look for work when something has been flagged for indexing
+    // (or the change log lost track & we can't tell).
+    db->subscribe([this](const QList<ChangeLogEntry> &changes, bool complete) {
+        if (!complete)
+            indexPending = true;
+        for (int i=0; i<changes.size(); i++) {
+            if (changes[i].fields.contains(NOTE_INDEX_NEEDED) || changes[i].fields.contains(RESOURCE_INDEX_NEEDED))
+                indexPending = true;
+        }
+    });
     //indexTimer = new QTimer();
     //indexTimer->setInterval(global.minIndexInterval);
     //connect(indexTimer, SIGNAL(timeout()), this, SLOT(index()));
@@ -95,6 +109,18 @@ void IndexRunner::index() {
     if (iAmBusy)
         return;
 
+    // Make sure the writer has saved the last batch before we look for more work.
+    // A batch which was rolled back left its "index needed" flags set, so scan again.
+    if (global.dbWriter != nullptr && !global.dbWriter->flush())
+        indexPending = true;
+
+    // Skip the scan if nothing needs indexing since the last full pass.
+    // Passes which stop early set indexPending again in busy().
+    db->publishChanges();
+    if (!indexPending)
+        return;
+    indexPending = false;
+
     //indexTimer->stop();   // Stop the timer because we are already working
     //indexTimer->setInterval(global.minIndexInterval);
 
@@ -123,8 +149,7 @@ void IndexRunner::index() {
             finishedLids.append(lids[i]);
             if (countPause <=0) {
                 flushCache();
-                for (int j=0; j<finishedLids.size(); j++)
-                    noteTable.setIndexNeeded(finishedLids[j], false);
+                notesIndexed(finishedLids);
                 //indexTimer->start();
                 busy(false,false);
                 return;
@@ -132,10 +157,10 @@ void IndexRunner::index() {
             countPause--;
         }
     }
-    if (keepRunning && !pauseIndexing)
+    if (keepRunning && !pauseIndexing) {
        flushCache();
-    for (int j=0; !pauseIndexing && keepRunning && j<finishedLids.size(); j++)
-        noteTable.setIndexNeeded(finishedLids[j], false);
+       notesIndexed(finishedLids);
+    }
 
 
     lids.clear();  // Clear out the list so we can start on resources
@@ -171,9 +196,8 @@ void IndexRunner::index() {
             finishedLids.append(lids[i]);
             if (countPause <=0) {
                 flushCache();
-                for (int j=0; keepRunning && !pauseIndexing && j<finishedLids.size(); j++) {
-                    resourceTable.setIndexNeeded(finishedLids[j], false);
-                }
+                if (keepRunning && !pauseIndexing)
+                    resourcesIndexed(finishedLids);
                 busy(false,false);
                 //indexTimer->start();
                 return;
@@ -186,10 +210,9 @@ void IndexRunner::index() {
         //indexTimer->start();
         return;
     }
-    if (keepRunning && !pauseIndexing)
+    if (keepRunning && !pauseIndexing) {
         flushCache();
-    for (int j=0; keepRunning && !pauseIndexing && j<finishedLids.size(); j++) {
-        resourceTable.setIndexNeeded(finishedLids[j], false);
+        resourcesIndexed(finishedLids);
     }
 
     if (endMsgNeeded) {
@@ -270,24 +293,26 @@ void IndexRunner::indexRecognition(qint32 lid, Resource &r) {
 
     // Add filename or source url to search index
     if (r.attributes.isSet()) {
-        NSqlQuery sql(db);
         ResourceAttributes a = r.attributes;
-        if (a.fileName.isSet()) {
-            sql.prepare("Insert into SearchIndex (lid, weight, source, content) values (:lid, :weight, :source, :content)");
-            sql.bindValue(":lid", lid);
-            sql.bindValue(":weight", 100);
-            sql.bindValue(":source", "recognition");
-            sql.bindValue(":content", QString(a.fileName));
-            sql.exec();
-        }
-        if (a.sourceURL.isSet()) {
-            sql.prepare("Insert into SearchIndex (lid, weight, source, content) values (:lid, :weight, :source, :content)");
-            sql.bindValue(":lid", lid);
-            sql.bindValue(":weight", 100);
-            sql.bindValue(":source", "recognition");
-            sql.bindValue(":content", QString(a.sourceURL));
-            sql.exec();
-        }
+        QStringList names;
+        if (a.fileName.isSet())
+            names.append(QString(a.fileName));
+        if (a.sourceURL.isSet())
+            names.append(QString(a.sourceURL));
+        write([lid, names](DatabaseConnection *db) {
+            NSqlQuery sql(db);
+            for (int i=0; i<names.size(); i++) {
+                sql.prepare("Insert into SearchIndex (lid, weight, source, content) values (:lid, :weight, :source, :content)");
+                sql.bindValue(":lid", lid);
+                sql.bindValue(":weight", 100);
+                sql.bindValue(":source", "recognition");
+                sql.bindValue(":content", names[i]);
+                if (sql.exec()) {
+                    FullTextIndex::added(db);
+                    TrigramIndex::added(db);
+                }
+            }
+        });
     }
 
 
@@ -447,18 +472,20 @@ void IndexRunner::indexAttachment(qint32 lid, Resource &r) {
     if (txtFile.open(QIODevice::ReadOnly)) {
         QString text;
         text = txtFile.readAll();
-        NSqlQuery sql(db);
-        db->lockForWrite();
-        sql.prepare("Insert into SearchIndex (lid, weight, source, content) values (:lid, :weight, 'recognition', :content)");
-        sql.bindValue(":lid", lid);
-        sql.bindValue(":weight", 100);
-
         text = global.normalizeTermForSearchAndIndex(text);
-        sql.bindValue(":content", text);
 
         QLOG_DEBUG() << "Adding note resource to index DB";
-        sql.exec();
-        db->unlock();
+        write([lid, text](DatabaseConnection *db) {
+            NSqlQuery sql(db);
+            sql.prepare("Insert into SearchIndex (lid, weight, source, content) values (:lid, :weight, 'recognition', :content)");
+            sql.bindValue(":lid", lid);
+            sql.bindValue(":weight", 100);
+            sql.bindValue(":content", text);
+            if (sql.exec()) {
+                FullTextIndex::added(db);
+                TrigramIndex::added(db);
+            }
+        });
         txtFile.close();
     }
     QDir dir;
@@ -470,49 +497,47 @@ void IndexRunner::flushCache() {
     if (indexHash->size() <= 0)
         return;
     QDateTime start = QDateTime::currentDateTimeUtc();
-    NSqlQuery sql(db);
-    db->lockForWrite();
-    sql.exec("begin");
+    QList<IndexRecord*> records;
     QHash<qint32, IndexRecord*>::iterator i;
 
-    // Start adding words to the index.  Every 200 sql insertions we do a commit
-    int commitCount = 200;
-
+    // Normalize the content here so the writer only has to do the inserts
     for (i=indexHash->begin(); keepRunning && !pauseIndexing && i!=indexHash->end(); ++i) {
-        qint32 lid = i.key();
         IndexRecord *rec = i.value();
-        qint32 weight = rec->weight;
-        QString source = rec->source;
-        QString content = rec->content;
-        delete rec;
-
-        // Delete any old content
-        sql.prepare("Delete from SearchIndex where lid=:lid and source=:source");
-        sql.bindValue(":lid", lid);
-        sql.bindValue(":source", source);
-        sql.exec();
-
-        // Add the new content.  it is basically a text version of the note with a weight of 100.
-        sql.prepare("Insert into SearchIndex (lid, weight, source, content) values (:lid, :weight, :source, :content)");
-        sql.bindValue(":lid", lid);
-        sql.bindValue(":weight", weight);
-        sql.bindValue(":source", source);
-
-        content = global.normalizeTermForSearchAndIndex(content);
-        sql.bindValue(":content", content);
-
-        sql.exec();
-        commitCount--;
-        if (commitCount <= 0) {
-            sql.exec("commit");
-            commitCount = 200;
-        }
+        rec->content = global.normalizeTermForSearchAndIndex(rec->content);
+        records.append(rec);
+        i.value() = nullptr;
     }
+    for (i=indexHash->begin(); i!=indexHash->end(); ++i)
+        delete i.value();
     indexHash->clear();
-    sql.exec("commit");
 
-    sql.finish();
-    db->unlock();
+    // The writer commits these with whatever else is queued
+    write([records](DatabaseConnection *db) {
+        NSqlQuery sql(db);
+        for (int i=0; i<records.size(); i++) {
+            IndexRecord *rec = records[i];
+
+            // Delete any old content
+            TrigramIndex::removed(db, rec->lid, rec->source);
+            FullTextIndex::removed(db, rec->lid, rec->source);
+            sql.prepare("Delete from SearchIndex where lid=:lid and source=:source");
+            sql.bindValue(":lid", rec->lid);
+            sql.bindValue(":source", rec->source);
+            sql.exec();
+
+            // Add the new content.  it is basically a text version of the note with a weight of 100.
+            sql.prepare("Insert into SearchIndex (lid, weight, source, content) values (:lid, :weight, :source, :content)");
+            sql.bindValue(":lid", rec->lid);
+            sql.bindValue(":weight", rec->weight);
+            sql.bindValue(":source", rec->source);
+            sql.bindValue(":content", rec->content);
+            if (sql.exec()) {
+                FullTextIndex::added(db);
+                TrigramIndex::added(db);
+            }
+            delete rec;
+        }
+    });
     QDateTime finish = QDateTime::currentDateTimeUtc();
 
     QLOG_DEBUG() << "Index Cache Flush Complete: " <<
@@ -521,8 +546,40 @@ void IndexRunner::flushCache() {
 }
 
 
+// Send a write to the database writer.  If there isn't one (command
+// line tools) the write is done on our own connection.
+void IndexRunner::write(WriteJob job) {
+    if (global.dbWriter != nullptr && global.dbWriter->isRunning())
+        global.dbWriter->enqueue(job);
+    else
+        job(db);
+}
+
+
+// Clear the "index needed" flag on notes we've finished
+void IndexRunner::notesIndexed(QList<qint32> lids) {
+    write([lids](DatabaseConnection *db) {
+        NoteTable noteTable(db);
+        for (int i=0; i<lids.size(); i++)
+            noteTable.setIndexNeeded(lids[i], false);
+    });
+}
+
+
+// Clear the "index needed" flag on resources we've finished
+void IndexRunner::resourcesIndexed(QList<qint32> lids) {
+    write([lids](DatabaseConnection *db) {
+        ResourceTable resourceTable(db);
+        for (int i=0; i<lids.size(); i++)
+            resourceTable.setIndexNeeded(lids[i], false);
+    });
+}
+
+
 
 void IndexRunner::busy(bool value, bool finished) {
     iAmBusy=value;
+    if (!value && !finished)
+        indexPending = true;
     emit(this->indexDone(finished));
 }
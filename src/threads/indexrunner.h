@@ -27,6 +27,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include <QHash>
 #include <QVector>
 #include "src/sql/databaseconnection.h"
+#include "src/threads/databasewriter.h"
 
 #include <iostream>
 #include <string>
@@ -70,8 +71,12 @@ private:
     QTextDocument *textDocument;
     DatabaseConnection *db;
     void flushCache();
+    void write(WriteJob job);
+    void notesIndexed(QList<qint32> lids);
+    void resourcesIndexed(QList<qint32> lids);
     void busy(bool value, bool finished);
     bool iAmBusy;
+    bool indexPending;                   // Has anything been flagged for indexing since the last full pass?
 
 public:
     bool enableIndexing;
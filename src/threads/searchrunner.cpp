@@ -0,0 +1,177 @@
+/*********************************************************************************
+NixNote - An open-source client for the Evernote service.
+Copyright (C) 2013 Randy Baumgarte
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+***********************************************************************************/
+
+#include "searchrunner.h"
+#include "src/global.h"
+#include "src/filters/filtercriteria.h"
+#include "src/filters/filterengine.h"
+#include "src/sql/databaseconnection.h"
+
+extern Global global;
+
+
+SearchRunner::SearchRunner(QObject *parent) :
+    QObject(parent)
+{
+    latest = 0;
+    db = nullptr;
+    pendingCriteria = nullptr;
+    pendingEngine = nullptr;
+    pendingGeneration = 0;
+    pendingStart = 0;
+    resultGeneration = -1;
+    resultStart = 0;
+    shownStart = 0;
+    latency.fill(0, SEARCH_LATENCY_BUCKETS);
+    clock.start();
+}
+
+
+SearchRunner::~SearchRunner() {
+    delete pendingCriteria;
+    delete pendingEngine;
+}
+
+
+// Queue a search of the note list (GUI thread).  A request which hasn't
+// started yet is replaced & one which is running gives up.  The engine is
+// created here so it reads the search settings on the GUI thread.
+qint32 SearchRunner::request(FilterCriteria *criteria) {
+    FilterEngine *engine = new FilterEngine();
+    mutex.lock();
+    delete pendingCriteria;
+    delete pendingEngine;
+    pendingCriteria = criteria;
+    pendingEngine = engine;
+    pendingGeneration = latest.fetchAndAddOrdered(1) + 1;
+    pendingStart = clock.elapsed();
+    qint32 generation = pendingGeneration;
+    mutex.unlock();
+    QMetaObject::invokeMethod(this, "run", Qt::QueuedConnection);
+    return generation;
+}
+
+
+// Forget every search requested so far.  Used when the note list is
+// filtered the normal way, so a late result can't replace it.
+void SearchRunner::cancel() {
+    QMutexLocker locker(&mutex);
+    delete pendingCriteria;
+    delete pendingEngine;
+    pendingCriteria = nullptr;
+    pendingEngine = nullptr;
+    latest.fetchAndAddOrdered(1);
+}
+
+
+// Run the newest request.  Every request queues a call, so once the
+// newest one has been taken the calls left over find nothing to do.
+void SearchRunner::run() {
+    mutex.lock();
+    FilterCriteria *criteria = pendingCriteria;
+    FilterEngine *engine = pendingEngine;
+    qint32 generation = pendingGeneration;
+    qint64 start = pendingStart;
+    pendingCriteria = nullptr;
+    pendingEngine = nullptr;
+    mutex.unlock();
+    if (engine == nullptr)
+        return;
+
+    if (db == nullptr)
+        db = new DatabaseConnection("searchrunner", true);
+    engine->setDatabase(db);
+    engine->setGeneration(&latest, generation);
+
+    QElapsedTimer timer;
+    timer.start();
+    engine->search(criteria, true);
+    bool current = (latest.load() == generation);
+    if (current) {
+        QMutexLocker locker(&mutex);
+        resultLids = engine->getResults();
+        resultRelevance = engine->getRelevance();
+        resultSnippets = engine->getSnippets();
+        resultSearch = criteria->getSearchString();
+        resultGeneration = generation;
+        resultStart = start;
+    }
+    QLOG_DEBUG() << "Search " << generation << (current ? " finished in " : " abandoned after ")
+                 << timer.elapsed() << "ms";
+    delete engine;
+    delete criteria;
+    if (current)
+        emit searchComplete(generation);
+}
+
+
+// Get the result of a finished search (GUI thread).  False if a newer
+// search has been requested since.
+bool SearchRunner::takeResult(qint32 generation, LidBitmap &lids, QHash<qint32, int> &relevance,
+                              QHash<qint32, QString> &snippets, QString &searchString) {
+    QMutexLocker locker(&mutex);
+    if (generation != resultGeneration || latest.load() != generation)
+        return false;
+    lids = resultLids;
+    relevance = resultRelevance;
+    snippets = resultSnippets;
+    searchString = resultSearch;
+    shownStart = resultStart;
+    resultGeneration = -1;
+    resultLids.clear();
+    resultRelevance.clear();
+    resultSnippets.clear();
+    return true;
+}
+
+
+// The result taken last is on screen.  Count how long it took.
+void SearchRunner::shown() {
+    qint64 elapsed = clock.elapsed() - shownStart;
+    int bucket = 0;
+    while (bucket < SEARCH_LATENCY_BUCKETS-1 && elapsed >= (qint64(16) << bucket))
+        bucket++;
+    QMutexLocker locker(&mutex);
+    latency[bucket]++;
+}
+
+
+// The latency histogram, e.g. "<16ms: 12  <32ms: 3  >=4096ms: 1".
+// Empty buckets are left out.
+QString SearchRunner::latencyReport() {
+    QMutexLocker locker(&mutex);
+    QStringList buckets;
+    for (int i=0; i<latency.size(); i++) {
+        if (latency[i] == 0)
+            continue;
+        if (i < SEARCH_LATENCY_BUCKETS-1)
+            buckets.append(QString("<%1ms: %2").arg(qint64(16) << i).arg(latency[i]));
+        else
+            buckets.append(QString(">=%1ms: %2").arg(qint64(16) << (i-1)).arg(latency[i]));
+    }
+    return buckets.join("  ");
+}
+
+
+// Close the search connection.  It belongs to the search thread, so this
+// is called there before the thread stops.
+void SearchRunner::close() {
+    delete db;
+    db = nullptr;
+}
@@ -0,0 +1,102 @@
+/*********************************************************************************
+NixNote - An open-source client for the Evernote service.
+Copyright (C) 2013 Randy Baumgarte
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+***********************************************************************************/
+
+#ifndef SEARCHRUNNER_H
+#define SEARCHRUNNER_H
+
+#include <QObject>
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QMutex>
+#include <QVector>
+
+#include "src/utilities/lidbitmap.h"
+
+class DatabaseConnection;
+class FilterCriteria;
+class FilterEngine;
+
+// Number of latency histogram buckets.  Bucket n holds the searches
+// which took less than 2^(n+4) ms, the last one everything slower.
+#define SEARCH_LATENCY_BUCKETS 9
+
+//***********************************************************
+// Runs the note list searches made while typing in the
+// search box on their own thread & read-only connection,
+// so a slow search doesn't hold up the GUI.
+//
+// Every request gets the next generation number.  Only the
+// newest request waiting is started, & a search gives up
+// between statements, & every FILTER_CANCEL_ROWS rows while
+// reading a result, once a newer one has been requested.
+// A statement which hasn't returned its first row yet is
+// allowed to get that far.  The GUI
+// is told when a result is ready & only shows it if it is
+// still the newest.
+//
+// The time from request to result shown is kept in a
+// histogram (see latencyReport()).
+//***********************************************************
+
+class SearchRunner : public QObject
+{
+    Q_OBJECT
+private:
+    QMutex mutex;
+    QAtomicInt latest;                     // Generation of the newest request
+    DatabaseConnection *db;                // Connection of the search thread
+    QElapsedTimer clock;
+
+    // Request waiting to be started
+    FilterCriteria *pendingCriteria;
+    FilterEngine *pendingEngine;
+    qint32 pendingGeneration;
+    qint64 pendingStart;
+
+    // Finished search waiting to be shown
+    LidBitmap resultLids;
+    QHash<qint32, int> resultRelevance;
+    QHash<qint32, QString> resultSnippets;
+    QString resultSearch;
+    qint32 resultGeneration;
+    qint64 resultStart;
+    qint64 shownStart;                     // Start of the result the GUI took last
+
+    QVector<qint32> latency;               // Search latency histogram
+
+public:
+    explicit SearchRunner(QObject *parent = 0);
+    ~SearchRunner();
+    qint32 request(FilterCriteria *criteria);   // Queue a search.  Takes over the criteria.
+    void cancel();                              // Drop every search requested so far
+    bool takeResult(qint32 generation, LidBitmap &lids, QHash<qint32, int> &relevance,
+                    QHash<qint32, QString> &snippets, QString &searchString);  // Get a finished search if it is still current
+    void shown();                               // The result taken last is on screen
+    QString latencyReport();                    // The latency histogram as text
+
+signals:
+    void searchComplete(qint32 generation);
+
+public slots:
+    void run();                                 // Run the newest request (search thread)
+    void close();                               // Close the connection (search thread)
+};
+
+#endif // SEARCHRUNNER_H
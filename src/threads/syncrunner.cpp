@@ -18,6 +18,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 ***********************************************************************************/
 
 #include <QTimer>
+#include <QElapsedTimer>
 
 #include "syncrunner.h"
 #include "src/global.h"
@@ -27,9 +28,13 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include "src/sql/searchtable.h"
 #include "src/sql/notebooktable.h"
 #include "src/sql/notetable.h"
+#include "src/sql/noteloader.h"
 #include "src/sql/linkednotebooktable.h"
 #include "src/sql/resourcetable.h"
 #include "src/sql/sharednotebooktable.h"
+#include "src/sql/writebatch.h"
+#include "src/sql/rowstore.h"
+#include "src/sql/blobstore.h"
 #include "src/nixnote.h"
 #include "src/communication/communicationmanager.h"
 #include "src/communication/communicationerror.h"
@@ -373,6 +378,7 @@ void SyncRunner::processSyncChunk(SyncChunk &chunk, qint32 linkedNotebook) {
         qint32 resLid = resTable.getLid(pair->first);
         if (resLid > 0) {
             QString filename = global.fileManager.getDbaDirPath() + QString::number(resLid) + QString(".png");
+            BlobStore::detach(filename);
             pair->second->save(filename);
         }
         delete pair->second;
@@ -580,6 +586,10 @@ void SyncRunner::syncRemoteNotes(QList<Note> notes, qint32 account) {
     QLOG_TRACE() << "Entering SyncRunner::syncRemoteNotes";
     NoteTable noteTable(db);
     NotebookTable bookTable(db);
+    WriteBatch batch(db);
+    QElapsedTimer timer;
+    timer.start();
+    RowStore::takeRefreshTime();
 
     for (int i = 0; i < notes.size() && keepRunning; i++) {
         Note t = notes[i];
@@ -603,9 +613,13 @@ void SyncRunner::syncRemoteNotes(QList<Note> notes, qint32 account) {
             delete global.cache[lid];
             global.cache.remove(lid);
         }
+        batch.noteWritten();
         if (!finalSync)
             emit noteUpdated(lid);
     }
+    batch.commit();
+    QLOG_DEBUG() << "Applied " << notes.size() << " notes in " << timer.elapsed() << "ms, "
+                 << RowStore::takeRefreshTime() << "ms of it refreshing typed rows";
 
     QLOG_TRACE() << "Leaving SyncRunner::syncRemoteNotes";
 }
@@ -615,6 +629,7 @@ void SyncRunner::syncRemoteNotes(QList<Note> notes, qint32 account) {
 void SyncRunner::syncRemoteResources(QList<Resource> resources) {
     QLOG_TRACE() << "Entering SyncRunner::syncRemoteResources";
     ResourceTable resTable(db);
+    WriteBatch batch(db);
 
     for (int i = 0; i < resources.size(); i++) {
         Resource r = resources[i];
@@ -623,7 +638,9 @@ void SyncRunner::syncRemoteResources(QList<Resource> resources) {
             resTable.sync(lid, r);
         else
             resTable.sync(r);
+        batch.resourceWritten();
     }
+    batch.commit();
     QLOG_TRACE() << "Leaving SyncRunner::syncRemoteResources";
 }
 
@@ -1180,9 +1197,10 @@ qint32 SyncRunner::uploadPersonalNotes() {
 
 
     // Start uploading notes
-    for (int i = 0; i < validLids.size(); i++) {
-        Note note;
-        noteTable.get(note, validLids[i], true, true);
+    NoteLoader loader(db, validLids, true, true);
+    Note note;
+    while (loader.next(note)) {
+        qint32 lid = loader.lid();
 
         qint32 oldUsn = 0;
         if (note.updateSequenceNum.isSet())
@@ -1201,11 +1219,11 @@ qint32 SyncRunner::uploadPersonalNotes() {
         if (usn > maxUsn) {
             maxUsn = usn;
             if (oldUsn == 0)
-                noteTable.updateGuid(validLids[i], note.guid);
-            noteTable.setUpdateSequenceNumber(validLids[i], usn);
-            noteTable.setDirty(validLids[i], false);
+                noteTable.updateGuid(lid, note.guid);
+            noteTable.setUpdateSequenceNumber(lid, usn);
+            noteTable.setDirty(lid, false);
             if (!finalSync)
-                emit(noteSynchronized(validLids[i], false));
+                emit(noteSynchronized(lid, false));
         } else {
             error = true;
         }
@@ -0,0 +1,391 @@
+/*********************************************************************************
+NixNote - An open-source client for the Evernote service.
+Copyright (C) 2013 Randy Baumgarte
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+***********************************************************************************/
+
+#include "lidbitmap.h"
+
+#include <QtAlgorithms>
+#include <algorithm>
+#include <iterator>
+
+
+// Constructor
+LidBitmap::LidBitmap()
+{
+}
+
+
+// Build a set from a list of lids
+LidBitmap LidBitmap::fromList(const QList<qint32> &lids) {
+    LidBitmap bitmap;
+    for (int i=0; i<lids.size(); i++)
+        bitmap.add(lids[i]);
+    return bitmap;
+}
+
+
+// Binary search for a container.  If it isn't there, the position it
+// belongs at is returned as -(position)-1.
+int LidBitmap::find(quint16 key) const {
+    int low = 0;
+    int high = containers.size()-1;
+    while (low <= high) {
+        int mid = (low + high) / 2;
+        quint16 midKey = containers[mid].key;
+        if (midKey < key)
+            low = mid+1;
+        else if (midKey > key)
+            high = mid-1;
+        else
+            return mid;
+    }
+    return -(low+1);
+}
+
+
+// Is a value in a container?
+bool LidBitmap::contains(const Container &c, quint16 low) {
+    if (c.isDense())
+        return (c.bits[low >> 6] >> (low & 63)) & 1;
+    return std::binary_search(c.array.constBegin(), c.array.constEnd(), low);
+}
+
+
+// Switch a container to a bit set
+void LidBitmap::makeDense(Container &c) {
+    c.bits.fill(0, LIDBITMAP_WORDS);
+    for (int i=0; i<c.array.size(); i++)
+        c.bits[c.array[i] >> 6] |= quint64(1) << (c.array[i] & 63);
+    c.array.clear();
+}
+
+
+// Switch a container back to a sorted array
+void LidBitmap::makeSparse(Container &c) {
+    c.array.clear();
+    c.array.reserve(c.count);
+    for (int i=0; i<LIDBITMAP_WORDS; i++) {
+        quint64 word = c.bits[i];
+        while (word != 0) {
+            c.array.append(quint16((i << 6) + qCountTrailingZeroBits(word)));
+            word &= word-1;
+        }
+    }
+    c.bits.clear();
+}
+
+
+// Lids in both containers
+LidBitmap::Container LidBitmap::intersect(const Container &a, const Container &b) {
+    Container result;
+    result.key = a.key;
+    result.count = 0;
+    if (a.isDense() && b.isDense()) {
+        result.bits.resize(LIDBITMAP_WORDS);
+        for (int i=0; i<LIDBITMAP_WORDS; i++) {
+            result.bits[i] = a.bits[i] & b.bits[i];
+            result.count += qPopulationCount(result.bits[i]);
+        }
+        if (result.count <= LIDBITMAP_ARRAY_MAX)
+            makeSparse(result);
+        return result;
+    }
+    if (a.isDense() || b.isDense()) {
+        const Container &sparse = a.isDense() ? b : a;
+        const Container &dense = a.isDense() ? a : b;
+        for (int i=0; i<sparse.array.size(); i++) {
+            if (contains(dense, sparse.array[i]))
+                result.array.append(sparse.array[i]);
+        }
+        result.count = result.array.size();
+        return result;
+    }
+    std::set_intersection(a.array.constBegin(), a.array.constEnd(),
+                          b.array.constBegin(), b.array.constEnd(),
+                          std::back_inserter(result.array));
+    result.count = result.array.size();
+    return result;
+}
+
+
+// Lids in either container
+LidBitmap::Container LidBitmap::unite(const Container &a, const Container &b) {
+    Container result;
+    if (a.isDense() || b.isDense()) {
+        const Container &other = a.isDense() ? b : a;
+        result = a.isDense() ? a : b;
+        if (other.isDense()) {
+            result.count = 0;
+            for (int i=0; i<LIDBITMAP_WORDS; i++) {
+                result.bits[i] |= other.bits[i];
+                result.count += qPopulationCount(result.bits[i]);
+            }
+        } else {
+            for (int i=0; i<other.array.size(); i++) {
+                quint64 &word = result.bits[other.array[i] >> 6];
+                quint64 bit = quint64(1) << (other.array[i] & 63);
+                if (!(word & bit)) {
+                    word |= bit;
+                    result.count++;
+                }
+            }
+        }
+        return result;
+    }
+    result.key = a.key;
+    result.array.reserve(a.count + b.count);
+    std::set_union(a.array.constBegin(), a.array.constEnd(),
+                   b.array.constBegin(), b.array.constEnd(),
+                   std::back_inserter(result.array));
+    result.count = result.array.size();
+    if (result.count > LIDBITMAP_ARRAY_MAX)
+        makeDense(result);
+    return result;
+}
+
+
+// Lids in the first container but not the second
+LidBitmap::Container LidBitmap::subtract(const Container &a, const Container &b) {
+    Container result;
+    result.key = a.key;
+    result.count = 0;
+    if (!a.isDense()) {
+        if (b.isDense()) {
+            for (int i=0; i<a.array.size(); i++) {
+                if (!contains(b, a.array[i]))
+                    result.array.append(a.array[i]);
+            }
+        } else {
+            std::set_difference(a.array.constBegin(), a.array.constEnd(),
+                                b.array.constBegin(), b.array.constEnd(),
+                                std::back_inserter(result.array));
+        }
+        result.count = result.array.size();
+        return result;
+    }
+    result.bits = a.bits;
+    if (b.isDense()) {
+        for (int i=0; i<LIDBITMAP_WORDS; i++) {
+            result.bits[i] &= ~b.bits[i];
+            result.count += qPopulationCount(result.bits[i]);
+        }
+    } else {
+        result.count = a.count;
+        for (int i=0; i<b.array.size(); i++) {
+            quint64 &word = result.bits[b.array[i] >> 6];
+            quint64 bit = quint64(1) << (b.array[i] & 63);
+            if (word & bit) {
+                word &= ~bit;
+                result.count--;
+            }
+        }
+    }
+    if (result.count <= LIDBITMAP_ARRAY_MAX)
+        makeSparse(result);
+    return result;
+}
+
+
+// Add a lid.  Lids arriving in ascending order are appended.
+void LidBitmap::add(qint32 lid) {
+    quint16 key = quint32(lid) >> 16;
+    quint16 low = quint32(lid) & 0xFFFF;
+    int index = find(key);
+    if (index < 0) {
+        Container c;
+        c.key = key;
+        c.count = 1;
+        c.array.append(low);
+        containers.insert(-index-1, c);
+        return;
+    }
+    Container &c = containers[index];
+    if (c.isDense()) {
+        quint64 &word = c.bits[low >> 6];
+        quint64 bit = quint64(1) << (low & 63);
+        if (!(word & bit)) {
+            word |= bit;
+            c.count++;
+        }
+        return;
+    }
+    QVector<quint16>::iterator pos = std::lower_bound(c.array.begin(), c.array.end(), low);
+    if (pos != c.array.end() && *pos == low)
+        return;
+    c.array.insert(pos, low);
+    c.count++;
+    if (c.count > LIDBITMAP_ARRAY_MAX)
+        makeDense(c);
+}
+
+
+// Remove a lid
+void LidBitmap::remove(qint32 lid) {
+    quint16 key = quint32(lid) >> 16;
+    quint16 low = quint32(lid) & 0xFFFF;
+    int index = find(key);
+    if (index < 0)
+        return;
+    Container &c = containers[index];
+    if (c.isDense()) {
+        quint64 &word = c.bits[low >> 6];
+        quint64 bit = quint64(1) << (low & 63);
+        if (!(word & bit))
+            return;
+        word &= ~bit;
+        c.count--;
+        if (c.count <= LIDBITMAP_ARRAY_MAX)
+            makeSparse(c);
+    } else {
+        QVector<quint16>::iterator pos = std::lower_bound(c.array.begin(), c.array.end(), low);
+        if (pos == c.array.end() || *pos != low)
+            return;
+        c.array.erase(pos);
+        c.count--;
+    }
+    if (c.count == 0)
+        containers.remove(index);
+}
+
+
+// Is a lid in the set?
+bool LidBitmap::contains(qint32 lid) const {
+    int index = find(quint32(lid) >> 16);
+    if (index < 0)
+        return false;
+    return contains(containers[index], quint32(lid) & 0xFFFF);
+}
+
+
+// Number of lids
+qint32 LidBitmap::size() const {
+    qint32 total = 0;
+    for (int i=0; i<containers.size(); i++)
+        total += containers[i].count;
+    return total;
+}
+
+
+// Is the set empty?  Empty containers are never kept.
+bool LidBitmap::isEmpty() const {
+    return containers.isEmpty();
+}
+
+
+// Remove every lid
+void LidBitmap::clear() {
+    containers.clear();
+}
+
+
+// Every lid in ascending order
+QList<qint32> LidBitmap::toList() const {
+    QList<qint32> lids;
+    lids.reserve(size());
+    for (int i=0; i<containers.size(); i++) {
+        const Container &c = containers[i];
+        quint32 high = quint32(c.key) << 16;
+        if (!c.isDense()) {
+            for (int j=0; j<c.array.size(); j++)
+                lids.append(qint32(high | c.array[j]));
+            continue;
+        }
+        for (int j=0; j<LIDBITMAP_WORDS; j++) {
+            quint64 word = c.bits[j];
+            while (word != 0) {
+                lids.append(qint32(high | quint32((j << 6) + qCountTrailingZeroBits(word))));
+                word &= word-1;
+            }
+        }
+    }
+    return lids;
+}
+
+
+// AND
+LidBitmap &LidBitmap::operator&=(const LidBitmap &other) {
+    QVector<Container> result;
+    int i = 0, j = 0;
+    while (i < containers.size() && j < other.containers.size()) {
+        if (containers[i].key < other.containers[j].key)
+            i++;
+        else if (containers[i].key > other.containers[j].key)
+            j++;
+        else {
+            Container c = intersect(containers[i++], other.containers[j++]);
+            if (c.count > 0)
+                result.append(c);
+        }
+    }
+    containers = result;
+    return *this;
+}
+
+
+// OR
+LidBitmap &LidBitmap::operator|=(const LidBitmap &other) {
+    QVector<Container> result;
+    result.reserve(containers.size() + other.containers.size());
+    int i = 0, j = 0;
+    while (i < containers.size() || j < other.containers.size()) {
+        if (j >= other.containers.size() ||
+                (i < containers.size() && containers[i].key < other.containers[j].key))
+            result.append(containers[i++]);
+        else if (i >= containers.size() || containers[i].key > other.containers[j].key)
+            result.append(other.containers[j++]);
+        else
+            result.append(unite(containers[i++], other.containers[j++]));
+    }
+    containers = result;
+    return *this;
+}
+
+
+// AND NOT
+LidBitmap &LidBitmap::operator-=(const LidBitmap &other) {
+    QVector<Container> result;
+    int j = 0;
+    for (int i=0; i<containers.size(); i++) {
+        while (j < other.containers.size() && other.containers[j].key < containers[i].key)
+            j++;
+        if (j < other.containers.size() && other.containers[j].key == containers[i].key) {
+            Container c = subtract(containers[i], other.containers[j]);
+            if (c.count > 0)
+                result.append(c);
+        } else {
+            result.append(containers[i]);
+        }
+    }
+    containers = result;
+    return *this;
+}
+
+
+// Do both sets hold the same lids?  A container's representation only
+// depends on its count, so equal sets have equal containers.
+bool LidBitmap::operator==(const LidBitmap &other) const {
+    if (containers.size() != other.containers.size())
+        return false;
+    for (int i=0; i<containers.size(); i++) {
+        const Container &a = containers[i];
+        const Container &b = other.containers[i];
+        if (a.key != b.key || a.count != b.count || a.array != b.array || a.bits != b.bits)
+            return false;
+    }
+    return true;
+}
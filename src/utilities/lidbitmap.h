@@ -0,0 +1,84 @@
+/*********************************************************************************
+NixNote - An open-source client for the Evernote service.
+Copyright (C) 2013 Randy Baumgarte
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+***********************************************************************************/
+
+#ifndef LIDBITMAP_H
+#define LIDBITMAP_H
+
+#include <QVector>
+#include <QList>
+
+// A container holds at most this many values as a sorted array before
+// it switches to a bit set
+#define LIDBITMAP_ARRAY_MAX 4096
+
+// 64 bit words in a dense container (65536 bits)
+#define LIDBITMAP_WORDS 1024
+
+//***********************************************************
+// A compressed set of lids, in the style of a roaring
+// bitmap.  Lids are grouped by their high 16 bits into
+// containers.  A container with only a few lids keeps them
+// as a sorted array of the low 16 bits; once it passes
+// LIDBITMAP_ARRAY_MAX it becomes a 8 KiB bit set.
+//
+// AND, OR & AND NOT work a container at a time, so
+// combining the lid sets of several filter criteria is
+// cheap even with hundreds of thousands of notes.
+//***********************************************************
+
+class LidBitmap
+{
+private:
+    struct Container {
+        quint16 key;                    // High 16 bits of every lid in the container
+        QVector<quint16> array;         // Sorted low bits while the container is sparse
+        QVector<quint64> bits;          // Bit set once it is dense (empty while sparse)
+        qint32 count;                   // Number of lids in the container
+        bool isDense() const { return !bits.isEmpty(); }
+    };
+    QVector<Container> containers;      // Sorted by key
+
+    int find(quint16 key) const;        // Index of a container, or -(insert position)-1
+    static bool contains(const Container &c, quint16 low);
+    static void makeDense(Container &c);
+    static void makeSparse(Container &c);
+    static Container intersect(const Container &a, const Container &b);
+    static Container unite(const Container &a, const Container &b);
+    static Container subtract(const Container &a, const Container &b);
+
+public:
+    LidBitmap();
+    static LidBitmap fromList(const QList<qint32> &lids);
+
+    void add(qint32 lid);                                  // Add a lid
+    void remove(qint32 lid);                               // Remove a lid
+    bool contains(qint32 lid) const;                       // Is a lid in the set?
+    qint32 size() const;                                   // Number of lids
+    bool isEmpty() const;                                  // Is the set empty?
+    void clear();                                          // Remove every lid
+    QList<qint32> toList() const;                          // Every lid in ascending order
+
+    LidBitmap &operator&=(const LidBitmap &other);         // Keep lids which are in both (AND)
+    LidBitmap &operator|=(const LidBitmap &other);         // Add the other lids (OR)
+    LidBitmap &operator-=(const LidBitmap &other);         // Remove the other lids (AND NOT)
+    bool operator==(const LidBitmap &other) const;
+    bool operator!=(const LidBitmap &other) const { return !(*this == other); }
+};
+
+#endif // LIDBITMAP_H
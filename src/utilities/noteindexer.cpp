@@ -21,9 +21,11 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include "noteindexer.h"
 
 #include "src/global.h"
+#include "src/sql/fulltextindex.h"
 #include "src/sql/notetable.h"
 #include "src/sql/nsqlquery.h"
 #include "src/sql/resourcetable.h"
+#include "src/sql/trigramindex.h"
 #include <QTextDocument>
 #include <QtXml>
 #if QT_VERSION < 0x050000
@@ -89,6 +91,8 @@ void NoteIndexer::indexNote(qint32 lid) {
 void NoteIndexer::addTextIndex(int lid, QString content) {
     // Delete any old content
     NSqlQuery sql(db);
+    TrigramIndex::removed(db, lid, "text");
+    FullTextIndex::removed(db, lid, "text");
     sql.prepare("Delete from SearchIndex where lid=:lid and source=:source");
     sql.bindValue(":lid", lid);
     sql.bindValue(":source", "text");
@@ -103,7 +107,10 @@ void NoteIndexer::addTextIndex(int lid, QString content) {
     content = global.normalizeTermForSearchAndIndex(content);
     sql.bindValue(":content", content);
 
-    sql.exec();
+    if (sql.exec()) {
+        FullTextIndex::added(db);
+        TrigramIndex::added(db);
+    }
 
     sql.prepare("Delete from DataStore where lid=:lid and key=:key");
     sql.bindValue(":lid", lid);
@@ -126,6 +133,8 @@ void NoteIndexer::indexResource(qint32 lid) {
 
     // Delete the old index
     QLOG_DEBUG() << "Deleting old resource from index";
+    TrigramIndex::removed(db, lid);
+    FullTextIndex::removed(db, lid);
     sql.prepare("Delete from SearchIndex where lid=:lid");
     sql.bindValue(":lid", lid);
     sql.exec();
@@ -139,7 +148,10 @@ void NoteIndexer::indexResource(qint32 lid) {
             sql.bindValue(":weight", 100);
             sql.bindValue(":source", "recognition");
             sql.bindValue(":content", QString(a.fileName));
-            sql.exec();
+            if (sql.exec()) {
+                FullTextIndex::added(db);
+                TrigramIndex::added(db);
+            }
         }
         if (a.sourceURL.isSet()) {
             sql.prepare("Insert into SearchIndex (lid, weight, source, content) values (:lid, :weight, :source, :content)");
@@ -147,7 +159,10 @@ void NoteIndexer::indexResource(qint32 lid) {
             sql.bindValue(":weight", 100);
             sql.bindValue(":source", "recognition");
             sql.bindValue(":content", QString(a.sourceURL));
-            sql.exec();
+            if (sql.exec()) {
+                FullTextIndex::added(db);
+                TrigramIndex::added(db);
+            }
         }
     }
 
@@ -221,7 +236,10 @@ void NoteIndexer::indexRecognition(qint32 reslid, Resource &r) {
             text = global.normalizeTermForSearchAndIndex(text);
             sql.bindValue(":content", text);
 
-            sql.exec();
+            if (sql.exec()) {
+                FullTextIndex::added(db);
+                TrigramIndex::added(db);
+            }
         }
     }
     QLOG_TRACE() << "Committing";
@@ -265,6 +283,9 @@ void NoteIndexer::indexPdf(qint32 reslid) {
     text = global.normalizeTermForSearchAndIndex(text);
     sql.bindValue(":content", text);
 
-    sql.exec();
+    if (sql.exec()) {
+        FullTextIndex::added(db);
+        TrigramIndex::added(db);
+    }
     QLOG_TRACE_OUT();
 }
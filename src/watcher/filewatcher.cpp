@@ -27,6 +27,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include "src/sql/filewatchertable.h"
 #include "src/xml/batchimport.h"
 #include "src/sql/tagtable.h"
+#include "src/sql/writebatch.h"
 
 #include <QDirIterator>
 
@@ -63,6 +64,7 @@ void FileWatcher::saveDirectory(QString dir){
     QLOG_DEBUG() << "Change in directory " << dir << " detected.. Proceed with file import";
 
     setupSubDirectories(dirs, files, dir);
+    WriteBatch batch(global.db);
     for (int i=0; i<files.size(); i++) {
 
         QString filename = files[i];
@@ -76,8 +78,10 @@ void FileWatcher::saveDirectory(QString dir){
         if (!saveFiles.contains(filename) || scanType == ImportDelete) {
             saveFiles.append(filename);
             saveFile(filename);
+            batch.noteWritten();
         }
     }
+    batch.commit();
 }
 
 void FileWatcher::saveFile(QString filename) {
@@ -112,6 +116,8 @@ void FileWatcher::saveFile(QString filename) {
     NoteTable ntable(global.db);
     ConfigStore cs(global.db);
     qint32 lid = cs.incrementLidCounter();
+    if (lid < 0)
+        return;
 
     QCryptographicHash md5hash(QCryptographicHash::Md5);
     QByteArray hash = md5hash.hash(data, QCryptographicHash::Md5);
@@ -173,6 +179,8 @@ void FileWatcher::saveFile(QString filename) {
     ntable.add(lid, newNote, true);
     QString noteGuid = ntable.getGuid(lid);
     lid = cs.incrementLidCounter();
+    if (lid < 0)
+        return;
 
 
     // Start creating the new resource
@@ -28,6 +28,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include "src/sql/tagtable.h"
 #include "src/sql/searchtable.h"
 #include "src/sql/usertable.h"
+#include "src/sql/writebatch.h"
 #include "src/utilities/crossmemorymapper.h"
 #include "src/utilities/mimereference.h"
 #include "src/global.h"
@@ -72,6 +73,7 @@ void BatchImport::import(QString file) {
     }
 
     reader = new QXmlStreamReader(&xmlFile);
+    WriteBatch batch(global.db);
     while (!reader->atEnd()) {
         reader->readNext();
         if (reader->hasError()) {
@@ -82,8 +84,10 @@ void BatchImport::import(QString file) {
         }
         if (reader->name().toString().toLower() == "noteadd" && reader->isStartElement()) {
             newLid = addNoteNode();
+            batch.noteWritten();
         }
     }
+    batch.commit();
     xmlFile.close();
 
     QString id = file;
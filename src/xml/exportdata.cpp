@@ -24,6 +24,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include "src/sql/tagtable.h"
 #include "src/sql/notebooktable.h"
 #include "src/sql/notetable.h"
+#include "src/sql/noteloader.h"
 #include "src/sql/linkednotebooktable.h"
 #include "src/sql/sharednotebooktable.h"
 #include "src/sql/notebooktable.h"
@@ -516,12 +517,12 @@ void ExportData::writeNotes() {
     }
     QCoreApplication::processEvents();
 
-    for (int i=0; i<lids.size() && !quitNow; i++) {
+    NoteLoader loader(global.db, lids, true, true);
+    Note n;
+    for (int i=0; i<lids.size() && !quitNow && loader.next(n); i++) {
         if (!cmdLine)
             progress->setValue(i+1);
         QCoreApplication::processEvents();
-        Note n;
-        table.get(n,lids[i], true,true);
         writer->writeStartElement("Note");
         if (n.guid.isSet())
             createNode("Guid", n.guid);
@@ -600,7 +601,7 @@ void ExportData::writeNotes() {
                 createNode("LastEditorId", n.attributes.value().lastEditorId);
             writer->writeEndElement();
         }
-        createNode("Dirty", dirtyLids.contains(lids[i]));
+        createNode("Dirty", dirtyLids.contains(loader.lid()));
         writer->writeEndElement();
     }
 }
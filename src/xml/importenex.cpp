@@ -24,6 +24,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #include "src/sql/tagtable.h"
 #include "src/sql/notetable.h"
 #include "src/sql/nsqlquery.h"
+#include "src/sql/writebatch.h"
 
 #include <QMessageBox>
 #include <QPushButton>
@@ -107,8 +108,9 @@ void ImportEnex::import(QString file) {
     progress->show();
 
 
-    NSqlQuery query(global.db);
-    query.exec("begin");
+    // The import has always run in one transaction, keep that when
+    // batching is turned off
+    WriteBatch batch(global.db, global.getWriteBatchSize() > 0 ? -1 : WRITE_BATCH_ALL);
     recCnt = 0;
     while (!reader->atEnd() && !stopNow) {
         reader->readNext();
@@ -140,10 +142,11 @@ void ImportEnex::import(QString file) {
             progress->setValue(recCnt);
             QLOG_DEBUG() << "Importing Note " << recCnt;
             processNoteNode();
+            batch.noteWritten();
         }
     }
     xmlFile.close();
-    query.exec("commit");
+    batch.commit();
     progress->hide();
 }
 
@@ -0,0 +1,91 @@
+#include <QtTest/QtTest>
+#include <QObject>
+#include <QString>
+
+#include "benchmarks.h"
+#include "../src/global.h"
+#include "../src/logger/qslog.h"
+#include "../src/logger/qsdebugoutput.h"
+#include "../src/sql/databaseconnection.h"
+#include "../src/sql/notetable.h"
+#include "../src/sql/writebatch.h"
+
+// Notes added by one run of a benchmark
+#define BENCHMARK_NOTES 1000
+
+extern Global global;
+
+Benchmarks::Benchmarks(QObject *parent) :
+        QObject(parent) {
+    db = nullptr;
+}
+
+
+// Point the program's directories at a temporary directory & open a new
+// database there, so the benchmarks run on the real schema.
+void Benchmarks::initTestCase() {
+    QVERIFY(dir.isValid());
+    QString path = dir.path() + QDir::separator();
+    QDir().mkpath(path + "config");
+    QDir().mkpath(path + "data");
+    global.fileManager.setup(path + "config", path + "data", QDir::currentPath());
+    global.initializeGlobalSettings();
+    global.initializeUserSettings(1);
+    global.fileManager.setupUserDirectories(1);
+    db = new DatabaseConnection(NN_DB_CONNECTION_NAME);
+}
+
+
+void Benchmarks::cleanupTestCase() {
+    delete db;
+    db = nullptr;
+    QSqlDatabase::removeDatabase(NN_DB_CONNECTION_NAME);
+}
+
+
+// NoteTable::add with every insert committed by itself (commit size 0)
+// and inside a write batch of 500 notes
+void Benchmarks::noteAddBenchmark_data() {
+    QTest::addColumn<int>("commitSize");
+    QTest::newRow("autocommit") << 0;
+    QTest::newRow("batch of 500") << 500;
+}
+
+void Benchmarks::noteAddBenchmark() {
+    QFETCH(int, commitSize);
+    NoteTable noteTable(db);
+    qint32 count = noteTable.getCount();
+
+    QBENCHMARK {
+        WriteBatch batch(db, commitSize);
+        for (int i=0; i<BENCHMARK_NOTES; i++) {
+            Note note;
+            note.title = QString("Benchmark note %1").arg(i);
+            note.content = QString("<?xml version=\"1.0\" encoding=\"UTF-8\"?>"
+                                   "<!DOCTYPE en-note SYSTEM \"http://xml.evernote.com/pub/enml2.dtd\">"
+                                   "<en-note><div>Benchmark note %1</div></en-note>").arg(i);
+            note.created = QDateTime::currentMSecsSinceEpoch();
+            note.updated = note.created;
+            note.active = true;
+            QVERIFY(noteTable.add(0, note, true) > 0);
+            batch.noteWritten();
+        }
+        batch.commit();
+    }
+
+    QVERIFY(noteTable.getCount() >= count + BENCHMARK_NOTES);
+}
+
+
+int main(int argc, char *argv[]) {
+    QsLogging::Logger &logger = QsLogging::Logger::instance();
+    logger.setLoggingLevel(QsLogging::WarnLevel);
+    QsLogging::DestinationPtr debugDestination(QsLogging::DestinationFactory::MakeDebugOutputDestination());
+    logger.addDestination(debugDestination.get());
+
+    QApplication app(argc, argv);
+    global.application = &app;
+
+    Benchmarks tc;
+    return QTest::qExec(&tc, argc, argv);
+}
@@ -0,0 +1,29 @@
+#ifndef NIXNOTE2_BENCHMARKS_H
+#define NIXNOTE2_BENCHMARKS_H
+
+#include <QObject>
+#include <QTemporaryDir>
+
+class DatabaseConnection;
+
+// Benchmarks which need the whole program (the real schema, NoteTable,
+// WriteBatch, ...).  They aren't part of the test run, see benchmarks.pro.
+class Benchmarks: public QObject
+{
+    Q_OBJECT
+
+private:
+    QTemporaryDir dir;
+    DatabaseConnection *db;
+
+public:
+    Q_INVOKABLE explicit Benchmarks(QObject *parent=Q_NULLPTR);
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void noteAddBenchmark_data();
+    void noteAddBenchmark();
+};
+
+#endif // NIXNOTE2_BENCHMARKS_H
@@ -2,13 +2,22 @@
 #include <QObject>
 #include <QString>
 #include <QHash>
+#include <QSet>
 #include <QPair>
+#include <QtSql>
+#include <algorithm>
 
 #include "tests.h"
 #include "../src/html/enmlformatter.h"
 #include "../src/logger/qslog.h"
 #include "../src/logger/qslogdest.h"
 #include "../src/utilities/NixnoteStringUtils.h"
+#include "../src/sql/statementcache.h"
+#include "../src/sql/contentcompressor.h"
+#include "../src/utilities/lidbitmap.h"
+#include "../src/sql/lidmap.h"
+#include "../src/sql/changeset.h"
+#include "../src/filters/searchquery.h"
 
 
 // ENML: https://dev.evernote.com/doc/articles/enml.php
@@ -452,6 +461,431 @@ void Tests::enmlHtmlSvgTest() {
 }
 
 
+// Statements are lent out one at a time & the least recently used idle
+// statement is dropped once the cache is over its limit
+void Tests::statementCacheTest() {
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", "statementCacheTest");
+        db.setDatabaseName(":memory:");
+        QVERIFY(db.open());
+        StatementCache cache(2);
+        QString sql1("select 1");
+        QString sql2("select 2");
+        QString sql3("select 3");
+
+        // A miss, then the prepared statement is cached while still in use
+        QSqlQuery q1(db);
+        QVERIFY(!cache.acquire(sql1, q1));
+        QVERIFY(q1.prepare(sql1));
+        QVERIFY(cache.insert(sql1, q1));
+        QVERIFY(!cache.insert(sql1, q1));
+
+        // Still lent out, so a second borrower doesn't get it
+        QSqlQuery other(db);
+        QVERIFY(!cache.acquire(sql1, other));
+        cache.release(sql1);
+        QVERIFY(cache.acquire(sql1, other));
+        QVERIFY(other.exec());
+        QVERIFY(other.next());
+        QCOMPARE(other.value(0).toInt(), 1);
+        cache.release(sql1);
+        QCOMPARE(cache.hits(), quint64(1));
+        QCOMPARE(cache.misses(), quint64(2));
+
+        // sql1 is used after sql2, so sql2 is dropped when sql3 comes in
+        QSqlQuery q2(db);
+        QVERIFY(q2.prepare(sql2));
+        QVERIFY(cache.insert(sql2, q2));
+        cache.release(sql2);
+        QSqlQuery q3(db);
+        QVERIFY(cache.acquire(sql1, q3));
+        cache.release(sql1);
+        QVERIFY(q3.prepare(sql3));
+        QVERIFY(cache.insert(sql3, q3));
+        cache.release(sql3);
+        QCOMPARE(cache.size(), 2);
+        QSqlQuery q4(db);
+        QVERIFY(!cache.acquire(sql2, q4));
+        QVERIFY(cache.acquire(sql1, q4));
+        cache.release(sql1);
+
+        // Statements in use are never dropped, the cache grows instead
+        QSqlQuery q5(db);
+        QVERIFY(cache.acquire(sql1, q5));
+        QSqlQuery q6(db);
+        QVERIFY(cache.acquire(sql3, q6));
+        QSqlQuery q7(db);
+        QVERIFY(q7.prepare(sql2));
+        QVERIFY(cache.insert(sql2, q7));
+        QCOMPARE(cache.size(), 3);
+        cache.release(sql1);
+        cache.release(sql2);
+        cache.release(sql3);
+
+        // A size of 0 turns the cache off
+        StatementCache off(0);
+        QVERIFY(!off.insert(sql1, q1));
+        QVERIFY(!off.acquire(sql1, q1));
+
+        cache.clear();
+        QCOMPARE(cache.size(), 0);
+        q1.finish(); q2.finish(); q3.finish(); q4.finish(); q5.finish(); q6.finish(); q7.finish(); other.finish();
+        db.close();
+    }
+    QSqlDatabase::removeDatabase("statementCacheTest");
+}
+
+// Note content survives a trip through the compressor, & content which
+// isn't compressed is left alone
+void Tests::contentCompressorTest() {
+    QByteArray content("<?xml version=\"1.0\" encoding=\"UTF-8\"?><en-note>");
+    for (int i=0; i<50; i++)
+        content.append("<div>Some fairly repetitive note text</div>");
+    content.append("</en-note>");
+
+    // Large content is compressed & comes back unchanged
+    ContentCompressor::setEnabled(true);
+    QByteArray stored = ContentCompressor::compress(content);
+    QVERIFY(ContentCompressor::isCompressed(stored));
+    QVERIFY(stored.size() < content.size());
+    QCOMPARE(ContentCompressor::uncompress(stored), content);
+
+    // Small content isn't worth it
+    QByteArray small("<en-note>hi</en-note>");
+    QCOMPARE(ContentCompressor::compress(small), small);
+    QVERIFY(!ContentCompressor::isCompressed(small));
+
+    // Plain (old) content is read as it is
+    QCOMPARE(ContentCompressor::uncompress(content), content);
+
+    // With compression off nothing is compressed, but stored values still read
+    ContentCompressor::setEnabled(false);
+    QCOMPARE(ContentCompressor::compress(content), content);
+    QCOMPARE(ContentCompressor::uncompress(stored), content);
+    ContentCompressor::setEnabled(true);
+}
+
+
+// A set's lids in ascending order, to compare with LidBitmap::toList()
+static QList<qint32> sortedLids(const QSet<qint32> &set) {
+    QList<qint32> lids = set.toList();
+    std::sort(lids.begin(), lids.end());
+    return lids;
+}
+
+
+// Lid bitmaps give the same answers as a QSet, on both sides of the
+// switch between sorted arrays & bit sets
+void Tests::lidBitmapTest() {
+    // Every other lid makes the first container dense & leaves the
+    // second sparse.  Every 1000th lid & a short run are all sparse.
+    QSet<qint32> a, b;
+    LidBitmap x, y;
+    for (qint32 i=0; i<70000; i+=2) {
+        a.insert(i);
+        x.add(i);
+    }
+    for (qint32 i=0; i<300000; i+=1000) {
+        b.insert(i);
+        y.add(i);
+    }
+    for (qint32 i=65536; i<65636; i++) {
+        b.insert(i);
+        y.add(i);
+    }
+    QCOMPARE(x.size(), a.size());
+    QCOMPARE(y.size(), b.size());
+    QVERIFY(x.contains(4));
+    QVERIFY(!x.contains(5));
+    QVERIFY(y.contains(65600));
+    QVERIFY(!y.contains(65700));
+    QCOMPARE(x.toList(), sortedLids(a));
+    QVERIFY(LidBitmap::fromList(sortedLids(a)) == x);
+
+    LidBitmap both = x;
+    both &= y;
+    QCOMPARE(both.toList(), sortedLids(QSet<qint32>(a).intersect(b)));
+    LidBitmap either = x;
+    either |= y;
+    QCOMPARE(either.toList(), sortedLids(QSet<qint32>(a).unite(b)));
+    LidBitmap onlyX = x;
+    onlyX -= y;
+    QCOMPARE(onlyX.toList(), sortedLids(QSet<qint32>(a).subtract(b)));
+    LidBitmap onlyY = y;
+    onlyY -= x;
+    QCOMPARE(onlyY.toList(), sortedLids(QSet<qint32>(b).subtract(a)));
+
+    // Growing past the array limit makes a container dense & shrinking
+    // back makes it sparse again.  Either way it equals a bitmap built
+    // from the same lids, so the layout only depends on the count.
+    LidBitmap grow;
+    QSet<qint32> grown;
+    for (qint32 i=0; i<=LIDBITMAP_ARRAY_MAX; i++) {
+        grow.add(i*3);
+        grown.insert(i*3);
+    }
+    QCOMPARE(grow.size(), LIDBITMAP_ARRAY_MAX+1);
+    QVERIFY(grow == LidBitmap::fromList(sortedLids(grown)));
+    grow.remove(0);
+    grown.remove(0);
+    QCOMPARE(grow.size(), LIDBITMAP_ARRAY_MAX);
+    QVERIFY(grow.contains(3));
+    QVERIFY(!grow.contains(0));
+    QVERIFY(grow == LidBitmap::fromList(sortedLids(grown)));
+
+    // Removing everything leaves an empty set
+    LidBitmap empty = x;
+    empty -= x;
+    QVERIFY(empty.isEmpty());
+    QVERIFY(empty == LidBitmap());
+    empty |= y;
+    QVERIFY(empty == y);
+    empty.clear();
+    QCOMPARE(empty.size(), 0);
+}
+
+
+void Tests::lidMapTest() {
+    // DataStore keys of note & tag GUIDs (NOTE_GUID & TAG_GUID)
+    const qint32 noteKey = 5000;
+    const qint32 tagKey = 1000;
+    LidMap map;
+    QString guid;
+    map.insert(noteKey, "note-a", 10);
+    map.insert(tagKey, "tag-a", 20);
+    QCOMPARE(map.getLid(noteKey, "note-a"), 10);
+    QVERIFY(map.getGuid(noteKey, 10, guid));
+    QCOMPARE(guid, QString("note-a"));
+
+    // A guid only resolves under the key it was stored for
+    QCOMPARE(map.getLid(tagKey, "note-a"), 0);
+    QVERIFY(!map.getGuid(tagKey, 10, guid));
+
+    // Empty guids & invalid lids aren't cached
+    map.insert(noteKey, "", 11);
+    map.insert(noteKey, "note-b", 0);
+    QVERIFY(!map.getGuid(noteKey, 11, guid));
+    QCOMPARE(map.getLid(noteKey, "note-b"), 0);
+
+    // A new guid for a lid replaces the old pair
+    map.insert(noteKey, "note-c", 10);
+    QCOMPARE(map.getLid(noteKey, "note-a"), 0);
+    QCOMPARE(map.getLid(noteKey, "note-c"), 10);
+
+    // So does a guid moving to another lid
+    map.insert(noteKey, "note-c", 12);
+    QCOMPARE(map.getLid(noteKey, "note-c"), 12);
+    QVERIFY(!map.getGuid(noteKey, 10, guid));
+
+    map.remove(12);
+    QCOMPARE(map.getLid(noteKey, "note-c"), 0);
+    QVERIFY(!map.getGuid(noteKey, 12, guid));
+
+    // Clearing a key leaves the other kinds alone
+    map.insert(noteKey, "note-d", 13);
+    map.clear(noteKey);
+    QCOMPARE(map.getLid(noteKey, "note-d"), 0);
+    QVERIFY(!map.getGuid(noteKey, 13, guid));
+    QCOMPARE(map.getLid(tagKey, "tag-a"), 20);
+    map.clear();
+    QCOMPARE(map.getLid(tagKey, "tag-a"), 0);
+}
+
+
+void Tests::changeSetTest() {
+    // Rows of one entity are merged, in the order the entities first
+    // changed, with the newest sequence number & each field once
+    ChangeSet set;
+    set.add(1, 6, 10, 5001);
+    set.add(2, 1, 20, 1001);
+    set.add(3, 6, 10, 5002);
+    set.add(4, 6, 10, 5001);
+    set.add(5, 7, 10, 6001);
+    QCOMPARE(set.entries.size(), 3);
+    QCOMPARE(set.entries[0].type, 6);
+    QCOMPARE(set.entries[0].lid, 10);
+    QCOMPARE(set.entries[0].sequence, qint64(4));
+    QCOMPARE(set.entries[0].fields, QList<qint32>() << 5001 << 5002);
+    QCOMPARE(set.entries[1].lid, 20);
+    QCOMPARE(set.entries[1].sequence, qint64(2));
+
+    // The same lid under another entity type is another entry
+    QCOMPARE(set.entries[2].type, 7);
+    QCOMPARE(set.entries[2].sequence, qint64(5));
+
+    // Once everything up to 150 is compacted away, a consumer which has
+    // seen 150 or more still gets everything, one which is further
+    // behind is told to rescan
+    QVERIFY(ChangeSet::isComplete(150, 150));
+    QVERIFY(ChangeSet::isComplete(150, 200));
+    QVERIFY(!ChangeSet::isComplete(150, 149));
+    QVERIFY(!ChangeSet::isComplete(150, 0));
+
+    // A log which was never compacted is complete
+    QVERIFY(ChangeSet::isComplete(0, 0));
+}
+
+
+void Tests::searchAreaTest() {
+    // A box takes its corners in either order
+    SearchArea box;
+    QVERIFY(box.parse("10, 20, -5, 30", false));
+    QCOMPARE(box.south, -5.0);
+    QCOMPARE(box.north, 10.0);
+    QCOMPARE(box.west, 20.0);
+    QCOMPARE(box.east, 30.0);
+    QVERIFY(!box.parse("10,20,30", false));
+    QVERIFY(!box.parse("10,20,x,30", false));
+
+    // 111 km around a point on the equator is about a degree each way
+    SearchArea near;
+    QVERIFY(near.parse("0,10,111", true));
+    QVERIFY(qAbs(near.north - 1.0) < 0.01);
+    QVERIFY(qAbs(near.south + 1.0) < 0.01);
+    QVERIFY(qAbs(near.east - 11.0) < 0.01);
+    QVERIFY(qAbs(near.west - 9.0) < 0.01);
+    QCOMPARE(near.km, 111.0);
+
+    // A degree of longitude is shorter away from the equator
+    QVERIFY(near.parse("60,10,111", true));
+    QVERIFY(near.east - near.west > 3.9);
+    QVERIFY(near.north - near.south < 2.1);
+
+    // A negative radius is a distance all the same
+    QVERIFY(near.parse("0,10,-111", true));
+    QCOMPARE(near.km, 111.0);
+
+    // Across the date line & at the poles every longitude is a candidate
+    QVERIFY(near.parse("0,179.5,111", true));
+    QCOMPARE(near.west, -180.0);
+    QCOMPARE(near.east, 180.0);
+    QVERIFY(near.parse("90,0,10", true));
+    QCOMPARE(near.west, -180.0);
+    QCOMPARE(near.east, 180.0);
+    QVERIFY(!near.parse("0,10", true));
+}
+
+
+void Tests::searchQueryTest() {
+    SearchQuery parsed;
+    parsed.parse(QStringList() << "tag:work" << "-notebook:\"Old Stuff\"" << "hello"
+                               << "-bye" << "under_score", false);
+    QCOMPARE(parsed.terms.size(), 5);
+    QCOMPARE(parsed.terms[0].field, SearchTerm::Tag);
+    QCOMPARE(parsed.terms[0].value, QString("work"));
+    QVERIFY(!parsed.terms[0].negative);
+    QCOMPARE(parsed.terms[1].field, SearchTerm::Notebook);
+    QCOMPARE(parsed.terms[1].value, QString("Old Stuff"));
+    QVERIFY(parsed.terms[1].negative);
+    QCOMPARE(parsed.terms[2].field, SearchTerm::Content);
+    QVERIFY(!parsed.terms[2].negative);
+    QCOMPARE(parsed.terms[3].field, SearchTerm::Content);
+    QCOMPARE(parsed.terms[3].value, QString("bye"));
+    QVERIFY(parsed.terms[3].negative);
+    QCOMPARE(parsed.terms[4].field, SearchTerm::ContentPattern);
+
+    // "any:" itself isn't a term & prefixes an "any:" search doesn't
+    // understand are searched as words
+    SearchQuery anyParsed;
+    anyParsed.parse(QStringList() << "any:" << "tag:a" << "stack:b", true);
+    QCOMPARE(anyParsed.terms.size(), 2);
+    QCOMPARE(anyParsed.terms[0].field, SearchTerm::Tag);
+    QCOMPARE(anyParsed.terms[1].field, SearchTerm::Content);
+    QCOMPARE(anyParsed.terms[1].value, QString("stack:b"));
+
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", "searchQueryTest");
+        db.setDatabaseName(":memory:");
+        QVERIFY(db.open());
+        QSqlQuery sql(db);
+        QVERIFY(sql.exec("create table NoteTable (lid integer primary key)"));
+        QVERIFY(sql.exec("create table Notes (lid integer primary key, notebookLid integer)"));
+        QVERIFY(sql.exec("create table NoteTags (noteLid integer, tagLid integer)"));
+        for (qint32 lid=1; lid<=100; lid++) {
+            sql.exec("insert into NoteTable (lid) values (" + QString::number(lid) + ")");
+            sql.exec("insert into Notes (lid, notebookLid) values (" + QString::number(lid) + ", "
+                     + QString::number(lid%4) + ")");
+            sql.exec("insert into NoteTags (noteLid, tagLid) values (" + QString::number(lid) + ", "
+                     + QString::number(lid%5) + ")");
+        }
+
+        // The tag is made the cheaper term, so it runs first
+        SearchQuery query;
+        query.parse(QStringList() << "notebook:1" << "tag:2" << "-tag:3", false);
+        query.statistics.add("Notes_Guid", "100 1");
+        query.statistics.add("Notes_Notebook_Lid", "100 25");
+        query.statistics.add("NoteTags_Tag_Lid", "100 20 1");
+        QStringList statements;
+        statements << "select lid from Notes where notebookLid=:notebook"
+                   << "select noteLid from NoteTags where tagLid=:tag"
+                   << "select noteLid from NoteTags where tagLid=:tag";
+        SearchPredicate::Type types[] = {
+            SearchPredicate::Intersect, SearchPredicate::Intersect, SearchPredicate::Except
+        };
+        int values[] = { 1, 2, 3 };
+        for (int i=0; i<3; i++) {
+            sql.prepare(statements[i]);
+            sql.bindValue(i == 0 ? ":notebook" : ":tag", values[i]);
+            query.setCurrentTerm(i);
+            query.add(types[i], sql);
+        }
+        query.setCurrentTerm(-1);
+
+        QList<SearchPredicate> plan = query.plan();
+        QCOMPARE(plan.size(), 3);
+        QCOMPARE(plan[0].term, 1);
+        QCOMPARE(plan[1].term, 0);
+        QCOMPARE(plan[2].type, SearchPredicate::Except);
+
+        QVERIFY(query.compile());
+        QVERIFY(query.getSql().contains("lid in (select lid from p0)"));
+        sql.prepare(query.getSql());
+        QMapIterator<QString, QVariant> v(query.getValues());
+        while (v.hasNext()) {
+            v.next();
+            sql.bindValue(v.key(), v.value());
+        }
+        QVERIFY(sql.exec());
+        QList<qint32> found;
+        while (sql.next())
+            found.append(sql.value(0).toInt());
+        std::sort(found.begin(), found.end());
+        QList<qint32> expected;
+        for (qint32 lid=1; lid<=100; lid++) {
+            if (lid%4 == 1 && lid%5 == 2)
+                expected.append(lid);
+        }
+        QCOMPARE(found, expected);
+
+        // Only negative terms start with every note
+        SearchQuery negative;
+        negative.parse(QStringList() << "-tag:0", false);
+        sql.prepare("select noteLid from NoteTags where tagLid=:tag");
+        sql.bindValue(":tag", 0);
+        negative.setCurrentTerm(0);
+        negative.add(SearchPredicate::Except, sql);
+        QVERIFY(negative.compile());
+        sql.prepare(negative.getSql());
+        QMapIterator<QString, QVariant> n(negative.getValues());
+        while (n.hasNext()) {
+            n.next();
+            sql.bindValue(n.key(), n.value());
+        }
+        QVERIFY(sql.exec());
+        int count = 0;
+        while (sql.next())
+            count++;
+        QCOMPARE(count, 80);
+
+        // Nothing to run
+        SearchQuery empty;
+        empty.parse(QStringList(), false);
+        QVERIFY(!empty.compile());
+        db.close();
+    }
+    QSqlDatabase::removeDatabase("searchQueryTest");
+}
+
 
 QT_BEGIN_NAMESPACE
 QTEST_ADD_GPU_BLACKLIST_SUPPORT_DEFS
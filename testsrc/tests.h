@@ -34,6 +34,13 @@ private slots:
     void enmlTidyTest();
     void enmlHtmlCommentTest();
     void enmlHtmlMapTest();
+    void statementCacheTest();
+    void contentCompressorTest();
+    void lidBitmapTest();
+    void lidMapTest();
+    void changeSetTest();
+    void searchAreaTest();
+    void searchQueryTest();
 
 private slots:
     void enmlHtmlSvgTest();
@@ -18,7 +18,13 @@ SOURCES += tests.cpp \
            ../src/logger/qslogdest.cpp \
            ../src/logger/qsdebugoutput.cpp \
            ../src/utilities/NixnoteStringUtils.cpp \
-           ../src/utilities/encrypt.cpp
+           ../src/utilities/encrypt.cpp \
+           ../src/sql/statementcache.cpp \
+           ../src/sql/contentcompressor.cpp \
+           ../src/utilities/lidbitmap.cpp \
+           ../src/filters/searchquery.cpp \
+           ../src/sql/lidmap.cpp \
+           ../src/sql/changeset.cpp
 
 HEADERS += tests.h \
            ../src/html/enmlformatter.h \
@@ -26,7 +32,13 @@ HEADERS += tests.h \
            ../src/logger/qslogdest.h \
            ../src/logger/qsdebugoutput.h \
            ../src/utilities/NixnoteStringUtils.h \
-           ../src/utilities/encrypt.h
+           ../src/utilities/encrypt.h \
+           ../src/sql/statementcache.h \
+           ../src/sql/contentcompressor.h \
+           ../src/utilities/lidbitmap.h \
+           ../src/filters/searchquery.h \
+           ../src/sql/lidmap.h \
+           ../src/sql/changeset.h
 
 CONFIG(debug, debug|release) {
     DESTDIR = qmake-build-debug-t